@@ -0,0 +1,90 @@
+// Copyright (c) 2019 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coin_containers.h"
+#include "streams.h"
+#include "uint256.h"
+#include "version.h"
+
+#include "sigma/coin.h"
+#include "sigma/coinspend.h"
+#include "sigma/spend_metadata.h"
+
+#include <cassert>
+#include <vector>
+
+/* Number of coins in the anonymity set used for proof benchmarks */
+static const size_t ANONYMITY_SET_SIZE = 100;
+
+/* Number of coins loaded per iteration of the state load benchmark */
+static const size_t STATE_COINS = 10000;
+
+static std::vector<sigma::PublicCoin> RandomPublicCoins(size_t n)
+{
+    std::vector<sigma::PublicCoin> coins;
+    coins.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        secp_primitives::GroupElement value;
+        value.randomize();
+        coins.emplace_back(value, sigma::CoinDenomination::SIGMA_DENOM_1);
+    }
+    return coins;
+}
+
+static void SigmaProofGenerate(benchmark::State& state)
+{
+    auto params = sigma::Params::get_default();
+    const sigma::PrivateCoin privcoin(params, sigma::CoinDenomination::SIGMA_DENOM_1);
+
+    std::vector<sigma::PublicCoin> anonymity_set = RandomPublicCoins(ANONYMITY_SET_SIZE - 1);
+    anonymity_set.push_back(privcoin.getPublicCoin());
+
+    sigma::SpendMetaData metaData(0, uint256S("120"), uint256S("120"));
+
+    while (state.KeepRunning()) {
+        sigma::CoinSpend spend(params, privcoin, anonymity_set, metaData, true);
+    }
+}
+
+static void SigmaProofVerify(benchmark::State& state)
+{
+    auto params = sigma::Params::get_default();
+    const sigma::PrivateCoin privcoin(params, sigma::CoinDenomination::SIGMA_DENOM_1);
+
+    std::vector<sigma::PublicCoin> anonymity_set = RandomPublicCoins(ANONYMITY_SET_SIZE - 1);
+    anonymity_set.push_back(privcoin.getPublicCoin());
+
+    sigma::SpendMetaData metaData(0, uint256S("120"), uint256S("120"));
+    sigma::CoinSpend spend(params, privcoin, anonymity_set, metaData, true);
+
+    while (state.KeepRunning()) {
+        assert(spend.Verify(anonymity_set, metaData, true));
+    }
+}
+
+static void SigmaStateLoad(benchmark::State& state)
+{
+    std::vector<sigma::PublicCoin> coins = RandomPublicCoins(STATE_COINS);
+
+    CDataStream serialized(SER_DISK, CLIENT_VERSION);
+    serialized << coins;
+
+    while (state.KeepRunning()) {
+        CDataStream stream(serialized);
+        std::vector<sigma::PublicCoin> loaded;
+        stream >> loaded;
+
+        sigma::mint_info_container mints;
+        int nHeight = 0;
+        for (const auto& coin : loaded) {
+            mints.insert(std::make_pair(coin, sigma::CMintedCoinInfo::make(coin.getDenomination(), 1, nHeight++)));
+        }
+    }
+}
+
+BENCHMARK(SigmaProofGenerate);
+BENCHMARK(SigmaProofVerify);
+BENCHMARK(SigmaStateLoad);
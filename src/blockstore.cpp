@@ -0,0 +1,257 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "blockstore.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//! Size of the read buffer of CBlockFileReader
+static const size_t BLOCK_FILE_READER_BUFFER_SIZE = 64 * 1024;
+
+CBlockFileStore blockFileStore;
+
+#ifdef WIN32
+
+CBlockFileHandle::CBlockFileHandle(const fs::path &path)
+{
+    file = fsbridge::fopen(path, "rb");
+}
+
+CBlockFileHandle::~CBlockFileHandle()
+{
+    if (file)
+        fclose(file);
+}
+
+bool CBlockFileHandle::IsNull() const
+{
+    return file == NULL;
+}
+
+size_t CBlockFileHandle::ReadAt(char *pch, size_t nSize, uint64_t nPos)
+{
+    // No positional reads here, serialize seek + read instead
+    LOCK(cs_file);
+    if (fseek(file, (long)nPos, SEEK_SET) != 0)
+        return 0;
+    return fread(pch, 1, nSize, file);
+}
+
+void CBlockFileHandle::AdviseSequential()
+{
+}
+
+#else
+
+CBlockFileHandle::CBlockFileHandle(const fs::path &path)
+{
+    fd = open(path.string().c_str(), O_RDONLY);
+}
+
+CBlockFileHandle::~CBlockFileHandle()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool CBlockFileHandle::IsNull() const
+{
+    return fd < 0;
+}
+
+size_t CBlockFileHandle::ReadAt(char *pch, size_t nSize, uint64_t nPos)
+{
+    size_t nRead = 0;
+    while (nRead < nSize) {
+        ssize_t n = pread(fd, pch + nRead, nSize - nRead, (off_t)(nPos + nRead));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        nRead += n;
+    }
+    return nRead;
+}
+
+void CBlockFileHandle::AdviseSequential()
+{
+#if defined(__linux__)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+#endif // WIN32
+
+CBlockFileStore::CBlockFileStore(size_t nMaxOpenFilesIn) : nMaxOpenFiles(nMaxOpenFilesIn), nSequentialScans(0)
+{
+}
+
+std::shared_ptr<CBlockFileHandle> CBlockFileStore::Open(FileType type, int nFile)
+{
+    FileKey key(type, nFile);
+
+    LOCK(cs_store);
+    std::map<FileKey, CacheEntry>::iterator it = mapOpenFiles.find(key);
+    if (it != mapOpenFiles.end()) {
+        lruFiles.splice(lruFiles.begin(), lruFiles, it->second.lruPosition);
+        return it->second.handle;
+    }
+
+    fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), type == BLOCK_FILE ? "blk" : "rev");
+    std::shared_ptr<CBlockFileHandle> handle = std::make_shared<CBlockFileHandle>(path);
+    if (handle->IsNull()) {
+        LogPrintf("Unable to open file %s\n", path.string());
+        return NULL;
+    }
+    if (nSequentialScans > 0)
+        handle->AdviseSequential();
+
+    if (nMaxOpenFiles == 0)
+        return handle;
+
+    // Readers still holding an evicted handle keep it open until they are done
+    while (mapOpenFiles.size() >= nMaxOpenFiles) {
+        mapOpenFiles.erase(lruFiles.back());
+        lruFiles.pop_back();
+    }
+
+    lruFiles.push_front(key);
+    CacheEntry &entry = mapOpenFiles[key];
+    entry.handle = handle;
+    entry.lruPosition = lruFiles.begin();
+    return handle;
+}
+
+void CBlockFileStore::Close(FileType type, int nFile)
+{
+    LOCK(cs_store);
+    std::map<FileKey, CacheEntry>::iterator it = mapOpenFiles.find(FileKey(type, nFile));
+    if (it != mapOpenFiles.end()) {
+        lruFiles.erase(it->second.lruPosition);
+        mapOpenFiles.erase(it);
+    }
+}
+
+void CBlockFileStore::CloseAll()
+{
+    LOCK(cs_store);
+    mapOpenFiles.clear();
+    lruFiles.clear();
+}
+
+void CBlockFileStore::SetMaxOpenFiles(size_t nMaxOpenFilesIn)
+{
+    LOCK(cs_store);
+    nMaxOpenFiles = nMaxOpenFilesIn;
+    while (mapOpenFiles.size() > nMaxOpenFiles) {
+        mapOpenFiles.erase(lruFiles.back());
+        lruFiles.pop_back();
+    }
+}
+
+void CBlockFileStore::BeginSequentialScan()
+{
+    LOCK(cs_store);
+    if (nSequentialScans++ == 0) {
+        for (std::map<FileKey, CacheEntry>::iterator it = mapOpenFiles.begin(); it != mapOpenFiles.end(); ++it)
+            it->second.handle->AdviseSequential();
+    }
+}
+
+void CBlockFileStore::EndSequentialScan()
+{
+    LOCK(cs_store);
+    assert(nSequentialScans > 0);
+    nSequentialScans--;
+}
+
+CBlockFileSequentialScan::CBlockFileSequentialScan()
+{
+    blockFileStore.BeginSequentialScan();
+}
+
+CBlockFileSequentialScan::~CBlockFileSequentialScan()
+{
+    blockFileStore.EndSequentialScan();
+}
+
+CBlockFileReader::CBlockFileReader(std::shared_ptr<CBlockFileHandle> fileIn, uint64_t nPos, int nTypeIn, int nVersionIn) :
+    nType(nTypeIn), nVersion(nVersionIn), file(fileIn), nReadPos(nPos), nBufferPos(0), nBufferSize(0)
+{
+}
+
+CBlockFileReader& CBlockFileReader::read(char* pch, size_t nSize)
+{
+    if (!file)
+        throw std::ios_base::failure("CBlockFileReader::read: file handle is NULL");
+
+    while (nSize > 0) {
+        if (nReadPos >= nBufferPos && nReadPos < nBufferPos + nBufferSize) {
+            size_t nOffset = nReadPos - nBufferPos;
+            size_t nNow = std::min(nSize, nBufferSize - nOffset);
+            memcpy(pch, &vBuffer[nOffset], nNow);
+            pch += nNow;
+            nSize -= nNow;
+            nReadPos += nNow;
+            continue;
+        }
+
+        if (nSize >= BLOCK_FILE_READER_BUFFER_SIZE) {
+            // Large reads go straight to the destination
+            if (file->ReadAt(pch, nSize, nReadPos) != nSize)
+                throw std::ios_base::failure("CBlockFileReader::read: end of file");
+            nReadPos += nSize;
+            break;
+        }
+
+        vBuffer.resize(BLOCK_FILE_READER_BUFFER_SIZE);
+        nBufferPos = nReadPos;
+        nBufferSize = file->ReadAt(&vBuffer[0], vBuffer.size(), nReadPos);
+        if (nBufferSize == 0)
+            throw std::ios_base::failure("CBlockFileReader::read: end of file");
+    }
+
+    return (*this);
+}
+
+CBlockFileReader& CBlockFileReader::ignore(size_t nSize)
+{
+    if (!file)
+        throw std::ios_base::failure("CBlockFileReader::ignore: file handle is NULL");
+    // Reading past the end of file is detected by the next read
+    nReadPos += nSize;
+    return (*this);
+}
+
+CBlockFileReader OpenBlockFileReader(const CDiskBlockPos &pos)
+{
+    std::shared_ptr<CBlockFileHandle> file;
+    if (!pos.IsNull())
+        file = blockFileStore.Open(CBlockFileStore::BLOCK_FILE, pos.nFile);
+    return CBlockFileReader(file, pos.nPos, SER_DISK, CLIENT_VERSION);
+}
+
+CBlockFileReader OpenUndoFileReader(const CDiskBlockPos &pos)
+{
+    std::shared_ptr<CBlockFileHandle> file;
+    if (!pos.IsNull())
+        file = blockFileStore.Open(CBlockFileStore::UNDO_FILE, pos.nFile);
+    return CBlockFileReader(file, pos.nPos, SER_DISK, CLIENT_VERSION);
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKSTORE_H
+#define BITCOIN_BLOCKSTORE_H
+
+#include "chain.h"
+#include "fs.h"
+#include "serialize.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! -blockfilehandles default, number of blk/rev files kept open for reading
+static const unsigned int DEFAULT_BLOCK_FILE_HANDLES = 64;
+
+/** Read-only handle of a blk?????.dat or rev?????.dat file, shared between readers */
+class CBlockFileHandle
+{
+private:
+#ifdef WIN32
+    FILE *file;
+    CCriticalSection cs_file;
+#else
+    int fd;
+#endif
+
+    CBlockFileHandle(const CBlockFileHandle&);
+    CBlockFileHandle& operator=(const CBlockFileHandle&);
+
+public:
+    explicit CBlockFileHandle(const fs::path &path);
+    ~CBlockFileHandle();
+
+    bool IsNull() const;
+
+    /** Read up to nSize bytes at nPos without moving any shared file position. Returns the number of bytes read */
+    size_t ReadAt(char *pch, size_t nSize, uint64_t nPos);
+
+    /** Tell the OS the file is going to be read sequentially so it reads ahead more aggressively */
+    void AdviseSequential();
+};
+
+/**
+ * Read access to block and undo files. Keeps the most recently used files open so that every block read doesn't have
+ * to open and seek the file again. Reads are positional so one handle serves any number of threads.
+ * Blocks and undo data are still written through OpenBlockFile/OpenUndoFile.
+ */
+class CBlockFileStore
+{
+public:
+    enum FileType {
+        BLOCK_FILE = 0,
+        UNDO_FILE = 1
+    };
+
+private:
+    typedef std::pair<int, int> FileKey;
+    typedef std::list<FileKey> LruList;
+
+    struct CacheEntry {
+        std::shared_ptr<CBlockFileHandle> handle;
+        LruList::iterator lruPosition;
+    };
+
+    mutable CCriticalSection cs_store;
+    std::map<FileKey, CacheEntry> mapOpenFiles;
+    // most recently used at the front
+    LruList lruFiles;
+    size_t nMaxOpenFiles;
+    int nSequentialScans;
+
+public:
+    explicit CBlockFileStore(size_t nMaxOpenFilesIn = DEFAULT_BLOCK_FILE_HANDLES);
+
+    /** Get an open handle of the file, NULL if the file can't be opened */
+    std::shared_ptr<CBlockFileHandle> Open(FileType type, int nFile);
+
+    /** Forget the handle, required before the file is removed */
+    void Close(FileType type, int nFile);
+    void CloseAll();
+
+    void SetMaxOpenFiles(size_t nMaxOpenFilesIn);
+
+    /** While a sequential scan is in progress block files are read with readahead */
+    void BeginSequentialScan();
+    void EndSequentialScan();
+};
+
+/** Marks a scan over consecutive blocks (rescan, index building) for the lifetime of the object */
+class CBlockFileSequentialScan
+{
+public:
+    CBlockFileSequentialScan();
+    ~CBlockFileSequentialScan();
+};
+
+/** Deserialization stream over a block or undo file starting at a given position. Buffered, uses positional reads */
+class CBlockFileReader
+{
+private:
+    int nType;
+    int nVersion;
+
+    std::shared_ptr<CBlockFileHandle> file;
+    // file position of the next byte to be read
+    uint64_t nReadPos;
+
+    std::vector<char> vBuffer;
+    // file position of the first byte in vBuffer and number of valid bytes there
+    uint64_t nBufferPos;
+    size_t nBufferSize;
+
+public:
+    CBlockFileReader(std::shared_ptr<CBlockFileHandle> fileIn, uint64_t nPos, int nTypeIn, int nVersionIn);
+
+    bool IsNull() const             { return !file; }
+    uint64_t GetPos() const         { return nReadPos; }
+
+    //
+    // Stream subset
+    //
+    int GetType() const             { return nType; }
+    int GetVersion() const          { return nVersion; }
+
+    CBlockFileReader& read(char* pch, size_t nSize);
+    CBlockFileReader& ignore(size_t nSize);
+
+    template<typename T>
+    CBlockFileReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+extern CBlockFileStore blockFileStore;
+
+/** Open a reader at the position in the block/undo file. The reader IsNull() if the file can't be opened */
+CBlockFileReader OpenBlockFileReader(const CDiskBlockPos &pos);
+CBlockFileReader OpenUndoFileReader(const CDiskBlockPos &pos);
+
+#endif // BITCOIN_BLOCKSTORE_H
@@ -16,7 +16,9 @@
 #include "indexnodeconfig.h"
 #include "indexnodeman.h"
 #include "activeindexnode.h"
+#include "validationstats.h"
 #include <zmqserver/zmqabstract.h>
+#include <zmqserver/zmqreplier.h>
 #include "univalue.h"
 
 #include <boost/algorithm/string/split.hpp>
@@ -179,10 +181,18 @@ UniValue apistatus(Type type, const UniValue& data, const UniValue& auth, bool f
     obj.push_back(Pair("pid",           getpid()));
 #endif
     obj.push_back(Pair("modules",       modules));
+    obj.push_back(Pair("replier",       GetReplierStatus()));
 
     return obj;
 }
 
+UniValue validationstats(Type type, const UniValue& data, const UniValue& auth, bool fHelp)
+{
+    UniValue obj = validationStats.ToJSON();
+    obj.push_back(Pair("last", validationStats.LastBlockToJSON()));
+    return obj;
+}
+
 UniValue backup(Type type, const UniValue& data, const UniValue& auth, bool fHelp)
 {
     string directory = find_value(data, "directory").get_str();
@@ -279,6 +289,7 @@ static const CAPICommand commands[] =
   //  --------------------- ------------       ----------------          -------- --------------   --------
     { "misc",               "apiStatus",       &apistatus,               false,     false,           true   },
     { "misc",               "backup",          &backup,                  true,      false,           false  },
+    { "misc",               "validationStats", &validationstats,         true,      false,           true   },
     { "misc",               "rpc",             &rpc,                     true,      false,           false  },
     { "misc",               "stop",            &stop,                    true,      false,           false  }
 };
@@ -141,7 +141,7 @@ bool createSigmaSpendAPITransaction(CWalletTx& wtx,
     if (!sigma::IsSigmaAllowed()) {
         throw JSONAPIError(API_WALLET_ERROR, "Sigma is not activated yet");
     }
-    LOCK2(cs_main, pwalletMain->cs_wallet);
+    // cs_main and cs_wallet aren't held here so the spend proofs can be generated without them
     UniValue outputs(UniValue::VARR);
     outputs = find_value(data, "outputs").get_array();
     std::string label = find_value(data, "label").get_str();
@@ -184,8 +184,10 @@ bool createSigmaSpendAPITransaction(CWalletTx& wtx,
         txMetadataEntry.push_back(Pair(strAddr, txMetadataSubEntry));
     }
 
-    if(!fDummy)
+    if(!fDummy) {
+        LOCK(pwalletMain->cs_wallet);
         EnsureWalletIsUnlocked();
+    }
 
     bool fChangeAddedToFee;
 
@@ -323,6 +325,9 @@ UniValue sendprivate(Type type, const UniValue& data, const UniValue& auth, bool
             UniValue txMetadataEntry(UniValue::VOBJ);
             std::string txidStr;
             try {
+                // keep other spends from selecting the same coins until this one is committed
+                LOCK(pwalletMain->cs_sigmaSpend);
+
                 createSigmaSpendAPITransaction(wtx, data, nFeeRequired, coins, changes, txMetadataEntry, false);
 
                 // Write tx data to filesystem
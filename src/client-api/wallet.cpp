@@ -428,6 +428,46 @@ UniValue StateSinceBlock(UniValue& ret, std::string block){
 
     ret.push_back(Pair("addresses", transactions));
 
+    // where to continue with walletChanges
+    ret.push_back(Pair("journal", strprintf("%016x", pwalletMain->journal.GetId())));
+    ret.push_back(Pair("sequence", pwalletMain->journal.GetLastSequence()));
+
+    return ret;
+}
+
+UniValue StateWalletChanges(UniValue& ret, std::string journal, uint64_t sequence){
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    isminefilter filter = ISMINE_SPENDABLE;
+
+    bool fKnown = IsHex(journal) && journal.size() == 16;
+    std::vector<CWalletChange> changes;
+    if (!fKnown || !pwalletMain->journal.GetChangesSince(strtoull(journal.c_str(), NULL, 16), sequence, changes)) {
+        // the client is too far behind or follows the journal of an earlier run
+        StateSinceBlock(ret, chainActive[0]->GetBlockHash().ToString());
+        ret.push_back(Pair("reset", true));
+        return ret;
+    }
+
+    UniValue transactions(UniValue::VOBJ);
+    UniValue deleted(UniValue::VARR);
+    BOOST_FOREACH(const CWalletChange& change, changes)
+    {
+        const CWalletTx *wtx = pwalletMain->GetWalletTx(change.hash);
+        if (change.type == WALLET_TX_DELETED || !wtx) {
+            deleted.push_back(change.hash.GetHex());
+            continue;
+        }
+        ListAPITransactions(*wtx, transactions, filter);
+    }
+
+    ret.push_back(Pair("addresses", transactions));
+    ret.push_back(Pair("deleted", deleted));
+    ret.push_back(Pair("journal", journal));
+    ret.push_back(Pair("sequence", pwalletMain->journal.GetLastSequence()));
+    ret.push_back(Pair("reset", false));
+
     return ret;
 }
 
@@ -482,6 +522,33 @@ UniValue statewallet(Type type, const UniValue& data, const UniValue& auth, bool
     return ret;
 }
 
+UniValue walletchanges(Type type, const UniValue& data, const UniValue& auth, bool fHelp)
+{
+    if (!EnsureWalletIsAvailable(false))
+        return NullUniValue;
+
+    UniValue ret(UniValue::VOBJ);
+    std::string journal;
+    uint64_t sequence = 0;
+
+    try{
+        UniValue journalUni = find_value(data, "journal");
+        UniValue sequenceUni = find_value(data, "sequence");
+        if(!journalUni.isNull()){
+            journal = journalUni.get_str();
+        }
+        if(!sequenceUni.isNull()){
+            sequence = sequenceUni.get_int64();
+        }
+    }catch (const std::exception& e){
+        throw JSONAPIError(API_WRONG_TYPE_CALLED, "wrong key passed/value type for method");
+    }
+
+    StateWalletChanges(ret, journal, sequence);
+
+    return ret;
+}
+
 UniValue setpassphrase(Type type, const UniValue& data, const UniValue& auth, bool fHelp)
 {
     // encrypt's the wallet should be the wallet be unencrypted.
@@ -677,6 +744,7 @@ static const CAPICommand commands[] =
     { "wallet",             "lockWallet",      &lockwallet,              true,      false,           false  },
     { "wallet",             "unlockWallet",    &unlockwallet,            true,      false,           false  },
     { "wallet",             "stateWallet",     &statewallet,             true,      false,           false  },
+    { "wallet",             "walletChanges",   &walletchanges,           true,      false,           false  },
     { "wallet",             "setPassphrase",   &setpassphrase,           true,      false,           false  },
     { "wallet",             "balance",         &balance,                 true,      false,           false  }
     
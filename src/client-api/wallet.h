@@ -10,4 +10,5 @@
 void ListAPITransactions(const CWalletTx& wtx, UniValue& ret, const isminefilter& filter);
 
 UniValue StateSinceBlock(UniValue& ret, std::string block);
-UniValue StateBlock(UniValue& ret, std::string blockhash);
\ No newline at end of file
+UniValue StateBlock(UniValue& ret, std::string blockhash);
+UniValue StateWalletChanges(UniValue& ret, std::string journal, uint64_t sequence);
\ No newline at end of file
@@ -16,6 +16,8 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <vector>
+
 #include <boost/foreach.hpp>
 #include <boost/unordered_map.hpp>
 
@@ -313,12 +315,54 @@ struct CCoinsCacheEntry
     CCoins coins; // The actual cached data.
     unsigned char flags;
 
+    /**
+     * The outputs the parent view has for this txid, so that flushing to the database rewrites only the outputs
+     * that were spent or created. Element i of vParentAvail is set if output i is available in the parent, its
+     * size is the number of outputs the parent has.
+     */
+    std::vector<bool> vParentAvail;
+    int nParentHeight;
+
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
     };
 
-    CCoinsCacheEntry() : coins(), flags(0) {}
+    CCoinsCacheEntry() : coins(), flags(0), nParentHeight(0) {}
+
+    //! Remember the current coins as the state of the parent view
+    void SetParentState()
+    {
+        vParentAvail.assign(coins.vout.size(), false);
+        for (unsigned int i = 0; i < coins.vout.size(); i++)
+            vParentAvail[i] = !coins.vout[i].IsNull();
+        nParentHeight = coins.nHeight;
+    }
+
+    void CopyParentState(const CCoinsCacheEntry& other)
+    {
+        vParentAvail = other.vParentAvail;
+        nParentHeight = other.nParentHeight;
+    }
+
+    //! Number of outputs the parent view has for this txid, spent ones included
+    uint32_t ParentOutputs() const
+    {
+        return vParentAvail.size();
+    }
+
+    //! Whether output n is available in the parent view
+    bool MaybeInParent(uint32_t n) const
+    {
+        return n < vParentAvail.size() && vParentAvail[n];
+    }
+
+    //! Whether output n has to be written to the parent view to bring it up to date
+    bool IsOutputChanged(uint32_t n) const
+    {
+        bool fAvailable = coins.IsAvailable(n);
+        return fAvailable != MaybeInParent(n) || (fAvailable && coins.nHeight != nParentHeight);
+    }
 };
 
 typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
@@ -358,6 +402,12 @@ public:
     //! Retrieve the block hash whose state this CCoinsView currently represents
     virtual uint256 GetBestBlock() const;
 
+    //! Retrieve the range of blocks that may have been only partially written.
+    //! If the database is in a consistent state, the result is the empty vector.
+    //! Otherwise, a two-element vector is returned consisting of the new and
+    //! the old block hash, in that order.
+    virtual std::vector<uint256> GetHeadBlocks() const;
+
     //! Do a bulk modification (multiple CCoins changes + BestBlock change).
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
@@ -381,6 +431,7 @@ public:
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
+    std::vector<uint256> GetHeadBlocks() const;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
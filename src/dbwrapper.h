@@ -49,12 +49,20 @@ class CDBBatch
 private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
+    // serialized size of the queued keys and values
+    size_t size_estimate;
 
 public:
     /**
      * @param[in] parent    CDBWrapper that this batch is to be submitted to
      */
-    CDBBatch(const CDBWrapper &parent) : parent(parent) { };
+    CDBBatch(const CDBWrapper &parent) : parent(parent), size_estimate(0) { };
+
+    void Clear()
+    {
+        batch.Clear();
+        size_estimate = 0;
+    }
 
     template <typename K, typename V>
     void Write(const K& key, const V& value)
@@ -71,6 +79,7 @@ public:
         leveldb::Slice slValue(&ssValue[0], ssValue.size());
 
         batch.Put(slKey, slValue);
+        size_estimate += ssKey.size() + ssValue.size();
     }
 
     template <typename K>
@@ -82,7 +91,10 @@ public:
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
         batch.Delete(slKey);
+        size_estimate += ssKey.size();
     }
+
+    size_t SizeEstimate() const { return size_estimate; }
 };
 
 class CDBIterator
@@ -276,6 +288,15 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /** Iterator for short scans of records that are likely read again, e.g. all outputs of a transaction.
+     *  Unlike NewIterator() it can keep the blocks it reads in the block cache */
+    CDBIterator *NewIterator(bool fFillCache)
+    {
+        leveldb::ReadOptions scanoptions = iteroptions;
+        scanoptions.fill_cache = fFillCache;
+        return new CDBIterator(*this, pdb->NewIterator(scanoptions));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -29,7 +29,9 @@
 #include "wallettxs.h"
 
 #include "../base58.h"
+#include "../blockstore.h"
 #include "../chainparams.h"
+#include "../clientversion.h"
 #include "../coincontrol.h"
 #include "../coins.h"
 #include "../core_io.h"
@@ -39,6 +41,8 @@
 #include "../primitives/transaction.h"
 #include "../script/script.h"
 #include "../script/standard.h"
+#include "../serialize.h"
+#include "../streams.h"
 #include "../sync.h"
 #include "../tinyformat.h"
 #include "../uint256.h"
@@ -63,6 +67,7 @@
 #include <openssl/sha.h>
 
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -1164,6 +1169,8 @@ static int elysium_initial_scan(int nFirstBlock)
     // used to print the progress to the console and notifies the UI
     ProgressReporter progressReporter(chainActive[nFirstBlock], chainActive[nLastBlock]);
 
+    CBlockFileSequentialScan sequentialScan;
+
     for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock)
     {
         if (ShutdownRequested()) {
@@ -1464,7 +1471,7 @@ static int elysium_file_load(const string &filename, int what, bool verifyHash =
       // memory leak ... gotta unallocate inner layers first....
       // TODO
       // ...
-      metadex.clear();
+      MetaDEx_CLEAR();
       inputLineFunc = input_mp_mdexorder_string;
       break;
 
@@ -1926,7 +1933,7 @@ void clear_all_state()
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
-    metadex.clear();
+    MetaDEx_CLEAR();
     my_pending.clear();
     ResetConsensusParams();
     ClearActivations();
@@ -3101,33 +3108,423 @@ unsigned int n_found = 0;
   return (n_found);
 }
 
+// Binary records of the STO and trade databases
+namespace {
+
+//! Version of the records written, databases without a version hold the legacy string records
+const int BINARY_RECORDS_VERSION = 1;
+
+//! Records written in one batch while upgrading legacy records
+const unsigned int UPGRADE_BATCH_SIZE = 10000;
+
+// Integers are stored big endian, so that keys sort and can be range scanned by them
+void AppendKey(std::string& key, uint32_t n)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        key.push_back(static_cast<char>((n >> shift) & 0xff));
+    }
+}
+
+void AppendKey(std::string& key, const uint256& hash)
+{
+    key.append(reinterpret_cast<const char*>(hash.begin()), hash.size());
+}
+
+// Strings are prefixed by their length, so that a string is never a prefix of another one
+void AppendKey(std::string& key, const std::string& str)
+{
+    AppendKey(key, static_cast<uint32_t>(str.size()));
+    key.append(str);
+}
+
+bool ReadKey(const leveldb::Slice& key, size_t& pos, uint32_t& n)
+{
+    if (key.size() < pos + 4) return false;
+    n = 0;
+    for (int i = 0; i < 4; i++) {
+        n = (n << 8) | static_cast<unsigned char>(key[pos++]);
+    }
+    return true;
+}
+
+bool ReadKey(const leveldb::Slice& key, size_t& pos, uint256& hash)
+{
+    if (key.size() < pos + hash.size()) return false;
+    std::copy(key.data() + pos, key.data() + pos + hash.size(), hash.begin());
+    pos += hash.size();
+    return true;
+}
+
+bool ReadKey(const leveldb::Slice& key, size_t& pos, std::string& str)
+{
+    uint32_t size;
+    if (!ReadKey(key, pos, size) || key.size() < pos + size) return false;
+    str.assign(key.data() + pos, size);
+    pos += size;
+    return true;
+}
+
+template<typename T>
+std::string SerializeRecord(const T& record)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << record;
+    return std::string(ss.begin(), ss.end());
+}
+
+template<typename T>
+bool DeserializeRecord(const leveldb::Slice& value, T& record)
+{
+    try {
+        CDataStream ss(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+        ss >> record;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): malformed record: %s\n", __func__, e.what());
+        return false;
+    }
+    return true;
+}
+
+// The version is kept under a key of a single zero byte, which no legacy key starts with
+int GetRecordsVersion(leveldb::DB* pdb, const leveldb::ReadOptions& readoptions)
+{
+    std::string strValue;
+    int version = 0;
+    if (pdb->Get(readoptions, std::string(1, '\0'), &strValue).ok()) {
+        DeserializeRecord(strValue, version);
+    }
+    return version;
+}
+
+void PutRecordsVersion(leveldb::WriteBatch& batch)
+{
+    batch.Put(std::string(1, '\0'), SerializeRecord(BINARY_RECORDS_VERSION));
+}
+
+// Legacy keys are txids in hex and addresses, binary keys start with a small type byte
+bool IsLegacyKey(const leveldb::Slice& key)
+{
+    return !key.empty() && static_cast<unsigned char>(key[0]) >= '0';
+}
+
+enum STOKeyType : char
+{
+    STOKEY_VERSION = 0,
+    //! <address><block><txid> = receipt
+    STOKEY_RECEIPT = 1,
+    //! <txid><address> = receipt
+    STOKEY_BY_TXID = 2,
+    //! <block><txid><address> = empty
+    STOKEY_BLOCK = 3
+};
+
+struct CMPSTOReceipt
+{
+    int32_t block;
+    uint32_t propertyId;
+    uint64_t amount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(block);
+        READWRITE(propertyId);
+        READWRITE(amount);
+    }
+};
+
+std::string STOKey(STOKeyType type)
+{
+    return std::string(1, type);
+}
+
+std::string STOReceiptKey(const std::string& address, int block, const uint256& txid)
+{
+    std::string key = STOKey(STOKEY_RECEIPT);
+    AppendKey(key, address);
+    AppendKey(key, static_cast<uint32_t>(block));
+    AppendKey(key, txid);
+    return key;
+}
+
+std::string STOByTxidKey(const uint256& txid, const std::string& address)
+{
+    std::string key = STOKey(STOKEY_BY_TXID);
+    AppendKey(key, txid);
+    AppendKey(key, address);
+    return key;
+}
+
+std::string STOBlockKey(int block, const uint256& txid, const std::string& address)
+{
+    std::string key = STOKey(STOKEY_BLOCK);
+    AppendKey(key, static_cast<uint32_t>(block));
+    AppendKey(key, txid);
+    AppendKey(key, address);
+    return key;
+}
+
+void PutSTOReceipt(leveldb::WriteBatch& batch, const std::string& address, const uint256& txid, const CMPSTOReceipt& receipt)
+{
+    std::string value = SerializeRecord(receipt);
+    batch.Put(STOReceiptKey(address, receipt.block, txid), value);
+    batch.Put(STOByTxidKey(txid, address), value);
+    batch.Put(STOBlockKey(receipt.block, txid, address), "");
+}
+
+enum TradeKeyType : char
+{
+    TRADEKEY_VERSION = 0,
+    //! <txid> = trade
+    TRADEKEY_TRADE = 1,
+    //! <txid1><txid2> = match
+    TRADEKEY_MATCH = 2,
+    //! <txid><other txid> = 0 if txid is the first txid of the match, 1 otherwise
+    TRADEKEY_MATCH_BY_TXID = 3,
+    //! <property 1><property 2><txid1><txid2> = empty
+    TRADEKEY_PAIR = 4,
+    //! <address><block><block index><txid> = empty
+    TRADEKEY_ADDRESS = 5,
+    //! <block><trade or match key> = empty
+    TRADEKEY_BLOCK = 6
+};
+
+struct CMPTradeRecord
+{
+    std::string address;
+    uint32_t propertyIdForSale;
+    uint32_t propertyIdDesired;
+    int32_t block;
+    int32_t blockIndex;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(address);
+        READWRITE(propertyIdForSale);
+        READWRITE(propertyIdDesired);
+        READWRITE(block);
+        READWRITE(blockIndex);
+    }
+};
+
+struct CMPMatchRecord
+{
+    uint256 txid1;
+    uint256 txid2;
+    std::string address1;
+    std::string address2;
+    uint32_t prop1;
+    uint32_t prop2;
+    int64_t amount1;
+    int64_t amount2;
+    int32_t block;
+    int64_t fee;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid1);
+        READWRITE(txid2);
+        READWRITE(address1);
+        READWRITE(address2);
+        READWRITE(prop1);
+        READWRITE(prop2);
+        READWRITE(amount1);
+        READWRITE(amount2);
+        READWRITE(block);
+        READWRITE(fee);
+    }
+};
+
+std::string TradeKey(TradeKeyType type)
+{
+    return std::string(1, type);
+}
+
+std::string TradeRecordKey(const uint256& txid)
+{
+    std::string key = TradeKey(TRADEKEY_TRADE);
+    AppendKey(key, txid);
+    return key;
+}
+
+std::string MatchRecordKey(const uint256& txid1, const uint256& txid2)
+{
+    std::string key = TradeKey(TRADEKEY_MATCH);
+    AppendKey(key, txid1);
+    AppendKey(key, txid2);
+    return key;
+}
+
+std::string MatchByTxidKey(const uint256& txid, const uint256& otherTxid)
+{
+    std::string key = TradeKey(TRADEKEY_MATCH_BY_TXID);
+    AppendKey(key, txid);
+    AppendKey(key, otherTxid);
+    return key;
+}
+
+std::string TradePairKey(uint32_t prop1, uint32_t prop2)
+{
+    std::string key = TradeKey(TRADEKEY_PAIR);
+    AppendKey(key, prop1);
+    AppendKey(key, prop2);
+    return key;
+}
+
+std::string TradeAddressKey(const std::string& address)
+{
+    std::string key = TradeKey(TRADEKEY_ADDRESS);
+    AppendKey(key, address);
+    return key;
+}
+
+std::string TradeBlockKey(int block, const std::string& recordKey)
+{
+    std::string key = TradeKey(TRADEKEY_BLOCK);
+    AppendKey(key, static_cast<uint32_t>(block));
+    key.append(recordKey);
+    return key;
+}
+
+std::string TradeAddressRecordKey(const uint256& txid, const CMPTradeRecord& trade)
+{
+    std::string key = TradeAddressKey(trade.address);
+    AppendKey(key, static_cast<uint32_t>(trade.block));
+    AppendKey(key, static_cast<uint32_t>(trade.blockIndex));
+    AppendKey(key, txid);
+    return key;
+}
+
+std::string TradePairRecordKey(const CMPMatchRecord& match)
+{
+    std::string key = TradePairKey(match.prop1, match.prop2);
+    AppendKey(key, match.txid1);
+    AppendKey(key, match.txid2);
+    return key;
+}
+
+void PutTrade(leveldb::WriteBatch& batch, const uint256& txid, const CMPTradeRecord& trade)
+{
+    std::string key = TradeRecordKey(txid);
+    batch.Put(key, SerializeRecord(trade));
+    batch.Put(TradeAddressRecordKey(txid, trade), "");
+    batch.Put(TradeBlockKey(trade.block, key), "");
+}
+
+void DeleteTrade(leveldb::WriteBatch& batch, const uint256& txid, const CMPTradeRecord& trade)
+{
+    std::string key = TradeRecordKey(txid);
+    batch.Delete(key);
+    batch.Delete(TradeAddressRecordKey(txid, trade));
+    batch.Delete(TradeBlockKey(trade.block, key));
+}
+
+void PutMatch(leveldb::WriteBatch& batch, const CMPMatchRecord& match)
+{
+    std::string key = MatchRecordKey(match.txid1, match.txid2);
+    batch.Put(key, SerializeRecord(match));
+    batch.Put(MatchByTxidKey(match.txid1, match.txid2), std::string(1, '\0'));
+    batch.Put(MatchByTxidKey(match.txid2, match.txid1), std::string(1, '\1'));
+    batch.Put(TradePairRecordKey(match), "");
+    batch.Put(TradeBlockKey(match.block, key), "");
+}
+
+void DeleteMatch(leveldb::WriteBatch& batch, const CMPMatchRecord& match)
+{
+    std::string key = MatchRecordKey(match.txid1, match.txid2);
+    batch.Delete(key);
+    batch.Delete(MatchByTxidKey(match.txid1, match.txid2));
+    batch.Delete(MatchByTxidKey(match.txid2, match.txid1));
+    batch.Delete(TradePairRecordKey(match));
+    batch.Delete(TradeBlockKey(match.block, key));
+}
+
+std::string FormatTradeRecord(const CMPTradeRecord& trade)
+{
+    return strprintf("%s:%d:%d:%d:%d", trade.address, trade.propertyIdForSale, trade.propertyIdDesired, trade.block, trade.blockIndex);
+}
+
+std::string FormatMatchRecord(const CMPMatchRecord& match)
+{
+    return strprintf("%s:%s:%u:%u:%d:%d:%d:%d", match.address1, match.address2, match.prop1, match.prop2,
+        match.amount1, match.amount2, match.block, match.fee);
+}
+
+}
+
 // MPSTOList here
+void CMPSTOList::upgradeRecords()
+{
+    if (!pdb || GetRecordsVersion(pdb, readoptions) >= BINARY_RECORDS_VERSION) return;
+
+    // Every legacy record is an address with the list "txid:block:property:amount," of its receipts
+    leveldb::WriteBatch batch;
+    unsigned int nBatch = 0, nUpgraded = 0;
+    leveldb::Iterator* it = NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (!IsLegacyKey(it->key())) continue;
+        std::string address = it->key().ToString();
+        std::string strValue = it->value().ToString();
+        std::vector<std::string> vecReceipts;
+        boost::split(vecReceipts, strValue, boost::is_any_of(","), token_compress_on);
+        for (size_t i = 0; i < vecReceipts.size(); i++) {
+            std::vector<std::string> vstr;
+            boost::split(vstr, vecReceipts[i], boost::is_any_of(":"), token_compress_on);
+            if (4 != vstr.size()) continue;
+            try {
+                CMPSTOReceipt receipt;
+                receipt.block = boost::lexical_cast<int32_t>(vstr[1]);
+                receipt.propertyId = boost::lexical_cast<uint32_t>(vstr[2]);
+                receipt.amount = boost::lexical_cast<uint64_t>(vstr[3]);
+                PutSTOReceipt(batch, address, uint256S(vstr[0]), receipt);
+                ++nUpgraded;
+            } catch (const boost::bad_lexical_cast& e) {
+                PrintToLog("STODB error - unexpected receipt (%s)\n", vecReceipts[i]);
+            }
+        }
+        batch.Delete(it->key());
+        if (++nBatch >= UPGRADE_BATCH_SIZE) {
+            pdb->Write(syncoptions, &batch);
+            batch.Clear();
+            nBatch = 0;
+        }
+    }
+    delete it;
+
+    PutRecordsVersion(batch);
+    Status status = pdb->Write(syncoptions, &batch);
+    PrintToLog("%s(): upgraded %d STO receipts: %s\n", __FUNCTION__, nUpgraded, status.ToString());
+}
+
 std::string CMPSTOList::getMySTOReceipts(string filterAddress)
 {
   if (!pdb) return "";
   string mySTOReceipts = "";
-  Slice skey, svalue;
+  std::set<uint256> seenTxids;
+  // the receipts are listed by recipient, so a filtered address is a prefix of its receipts
+  std::string prefix = STOKey(STOKEY_RECEIPT);
+  if (!filterAddress.empty()) AppendKey(prefix, filterAddress);
   Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      skey = it->key();
-      string recipientAddress = skey.ToString();
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      size_t pos = 1;
+      std::string recipientAddress;
+      uint32_t block;
+      uint256 txid;
+      CMPSTOReceipt receipt;
+      if (!ReadKey(it->key(), pos, recipientAddress) || !ReadKey(it->key(), pos, block) || !ReadKey(it->key(), pos, txid)) continue;
       if(!IsMyAddress(recipientAddress)) continue; // not ours, not interested
-      if((!filterAddress.empty()) && (filterAddress != recipientAddress)) continue; // not the filtered address
       // ours, get info
-      svalue = it->value();
-      string strValue = svalue.ToString();
-      // break into individual receipts
-      std::vector<std::string> vstr;
-      boost::split(vstr, strValue, boost::is_any_of(","), token_compress_on);
-      for(uint32_t i = 0; i<vstr.size(); i++) {
-          // add to array
-          std::vector<std::string> svstr;
-          boost::split(svstr, vstr[i], boost::is_any_of(":"), token_compress_on);
-          if(4 == svstr.size()) {
-              size_t txidMatch = mySTOReceipts.find(svstr[0]);
-              if(txidMatch==std::string::npos) mySTOReceipts += svstr[0]+":"+svstr[1]+":"+recipientAddress+":"+svstr[2]+",";
-          }
-      }
+      if (!DeserializeRecord(it->value(), receipt)) continue;
+      if (!seenTxids.insert(txid).second) continue;
+      mySTOReceipts += strprintf("%s:%d:%s:%d,", txid.ToString(), block, recipientAddress, receipt.propertyId);
   }
   delete it;
   // above code will leave a trailing comma - strip it
@@ -3146,71 +3543,45 @@ void CMPSTOList::getRecipients(const uint256 txid, string filterAddress, UniValu
   if (filterAddress == "*") filter = false;
   if ((filterAddress != "") && (filterAddress != "*")) { filterByWallet = false; filterByAddress = true; }
 
-  // iterate through SDB, dropping all records where key is not filterAddress (if filtering)
-  int count = 0;
-
   // the fee is variable based on version of STO - provide number of recipients and allow calling function to work out fee
   *numRecipients = 0;
 
-  Slice skey, svalue;
+  // every recipient of the STO has a record under the txid
+  std::string prefix = STOKey(STOKEY_BY_TXID);
+  AppendKey(prefix, txid);
   Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
   {
-      skey = it->key();
-      string recipientAddress = skey.ToString();
-      svalue = it->value();
-      string strValue = svalue.ToString();
-      // see if txid is in the data
-      size_t txidMatch = strValue.find(txid.ToString());
-      if(txidMatch!=std::string::npos)
+      size_t pos = prefix.size();
+      std::string recipientAddress;
+      if (!ReadKey(it->key(), pos, recipientAddress)) continue;
+      ++*numRecipients;
+      // this address was a recipient of this STO, check filter and add the details
+      if(filter)
       {
-          ++*numRecipients;
-          // the txid exists inside the data, this address was a recipient of this STO, check filter and add the details
-          if(filter)
-          {
-              if( ( (filterByAddress) && (filterAddress == recipientAddress) ) || ( (filterByWallet) && (IsMyAddress(recipientAddress)) ) )
-              { } else { continue; } // move on if no filter match (but counter still increased for fee)
-          }
-          std::vector<std::string> vstr;
-          boost::split(vstr, strValue, boost::is_any_of(","), token_compress_on);
-          for(uint32_t i = 0; i<vstr.size(); i++)
-          {
-              std::vector<std::string> svstr;
-              boost::split(svstr, vstr[i], boost::is_any_of(":"), token_compress_on);
-              if(4 == svstr.size())
-              {
-                  if(svstr[0] == txid.ToString())
-                  {
-                      //add data to array
-                      uint64_t amount = 0;
-                      uint64_t propertyId = 0;
-                      try
-                      {
-                          amount = boost::lexical_cast<uint64_t>(svstr[3]);
-                          propertyId = boost::lexical_cast<uint64_t>(svstr[2]);
-                      } catch (const boost::bad_lexical_cast &e)
-                      {
-                          PrintToLog("DEBUG STO - error in converting values from leveldb\n");
-                          delete it;
-                          return; //(something went wrong)
-                      }
-                      UniValue recipient(UniValue::VOBJ);
-                      recipient.push_back(Pair("address", recipientAddress));
-                      if(isPropertyDivisible(propertyId))
-                      {
-                         recipient.push_back(Pair("amount", FormatDivisibleMP(amount)));
-                      }
-                      else
-                      {
-                         recipient.push_back(Pair("amount", FormatIndivisibleMP(amount)));
-                      }
-                      *total += amount;
-                      recipientArray->push_back(recipient);
-                      ++count;
-                  }
-              }
-          }
+          if( ( (filterByAddress) && (filterAddress == recipientAddress) ) || ( (filterByWallet) && (IsMyAddress(recipientAddress)) ) )
+          { } else { continue; } // move on if no filter match (but counter still increased for fee)
       }
+      CMPSTOReceipt receipt;
+      if (!DeserializeRecord(it->value(), receipt))
+      {
+          PrintToLog("DEBUG STO - error in converting values from leveldb\n");
+          delete it;
+          return; //(something went wrong)
+      }
+      //add data to array
+      UniValue recipient(UniValue::VOBJ);
+      recipient.push_back(Pair("address", recipientAddress));
+      if(isPropertyDivisible(receipt.propertyId))
+      {
+         recipient.push_back(Pair("amount", FormatDivisibleMP(receipt.amount)));
+      }
+      else
+      {
+         recipient.push_back(Pair("amount", FormatIndivisibleMP(receipt.amount)));
+      }
+      *total += receipt.amount;
+      recipientArray->push_back(recipient);
   }
 
   delete it;
@@ -3221,72 +3592,53 @@ bool CMPSTOList::exists(string address)
 {
   if (!pdb) return false;
 
-  string strValue;
-  Status status = pdb->Get(readoptions, address, &strValue);
-
-  if (!status.ok())
-  {
-    if (status.IsNotFound()) return false;
-  }
+  std::string prefix = STOKey(STOKEY_RECEIPT);
+  AppendKey(prefix, address);
+  Iterator* it = NewIterator();
+  it->Seek(prefix);
+  bool found = it->Valid() && it->key().starts_with(prefix);
+  delete it;
 
-  return true;
+  return found;
 }
 
 void CMPSTOList::recordSTOReceive(string address, const uint256 &txid, int nBlock, unsigned int propertyId, uint64_t amount)
 {
   if (!pdb) return;
 
-  bool addressExists = s_stolistdb->exists(address);
-  if (addressExists)
-  {
-      //retrieve existing record
-      std::vector<std::string> vstr;
-      string strValue;
-      Status status = pdb->Get(readoptions, address, &strValue);
-      if (status.ok())
-      {
-          // add details to record
-          // see if we are overwriting (check)
-          size_t txidMatch = strValue.find(txid.ToString());
-          if(txidMatch!=std::string::npos) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n",address,txid.ToString());
-
-          const string key = address;
-          const string newValue = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-          strValue += newValue;
-          // write updated record
-          Status status;
-          if (pdb)
-          {
-              status = pdb->Put(writeoptions, key, strValue);
-              PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-          }
-      }
-  }
-  else
-  {
-      const string key = address;
-      const string value = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-      Status status;
-      if (pdb)
-      {
-          status = pdb->Put(writeoptions, key, value);
-          PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-      }
-  }
+  // see if we are overwriting (check)
+  string strValue;
+  if (pdb->Get(readoptions, STOByTxidKey(txid, address), &strValue).ok()) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n",address,txid.ToString());
+
+  CMPSTOReceipt receipt;
+  receipt.block = nBlock;
+  receipt.propertyId = propertyId;
+  receipt.amount = amount;
+
+  leveldb::WriteBatch batch;
+  PutSTOReceipt(batch, address, txid, receipt);
+  Status status = pdb->Write(writeoptions, &batch);
+  ++nWritten;
+  PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
 }
 
 void CMPSTOList::printAll()
 {
   int count = 0;
-  Slice skey, svalue;
+  std::string prefix = STOKey(STOKEY_RECEIPT);
   Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
   {
-    skey = it->key();
-    svalue = it->value();
+    size_t pos = 1;
+    std::string address;
+    uint32_t block;
+    uint256 txid;
+    CMPSTOReceipt receipt;
+    if (!ReadKey(it->key(), pos, address) || !ReadKey(it->key(), pos, block) || !ReadKey(it->key(), pos, txid)) continue;
+    if (!DeserializeRecord(it->value(), receipt)) continue;
     ++count;
-    PrintToLog("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+    PrintToLog("entry #%8d= %s:%s:%d:%u:%lu\n", count, address, txid.ToString(), receipt.block, receipt.propertyId, receipt.amount);
   }
 
   delete it;
@@ -3300,44 +3652,95 @@ void CMPSTOList::printStats()
 /**
  * This function deletes records of STO receivers above/equal to a specific block from the STO database.
  *
- * Returns the number of records changed.
+ * Returns the number of records deleted.
  */
 int CMPSTOList::deleteAboveBlock(int blockNum)
 {
+  if (!pdb) return 0;
   unsigned int n_found = 0;
-  std::vector<std::string> vecSTORecords;
+  std::string start = STOKey(STOKEY_BLOCK);
+  AppendKey(start, static_cast<uint32_t>(blockNum));
+  leveldb::WriteBatch batch;
+  leveldb::Iterator* it = NewIterator();
+  for (it->Seek(start); it->Valid() && it->key().starts_with(STOKey(STOKEY_BLOCK)); it->Next()) {
+      size_t pos = 1;
+      uint32_t block;
+      uint256 txid;
+      std::string address;
+      if (!ReadKey(it->key(), pos, block) || !ReadKey(it->key(), pos, txid) || !ReadKey(it->key(), pos, address)) continue;
+      batch.Delete(STOReceiptKey(address, block, txid));
+      batch.Delete(STOByTxidKey(txid, address));
+      batch.Delete(it->key());
+      ++n_found;
+  }
+  delete it;
+
+  Status status = pdb->Write(writeoptions, &batch);
+  PrintToLog("%s(%d); stodb deleted records= %d: %s\n", __FUNCTION__, blockNum, n_found, status.ToString());
+
+  return (n_found);
+}
+
+// MPTradeList here
+void CMPTradeList::upgradeRecords()
+{
+  if (!pdb || GetRecordsVersion(pdb, readoptions) >= BINARY_RECORDS_VERSION) return;
+
+  // Legacy trades are "txid" = "address:propertyforsale:propertydesired:block:index", matches are
+  // "txid1+txid2" = "address1:address2:property1:property2:amount1:amount2:block[:fee]"
+  leveldb::WriteBatch batch;
+  unsigned int nBatch = 0, nUpgraded = 0;
   leveldb::Iterator* it = NewIterator();
   for (it->SeekToFirst(); it->Valid(); it->Next()) {
-      std::string newValue;
-      std::string oldValue = it->value().ToString();
-      bool needsUpdate = false;
-      boost::split(vecSTORecords, oldValue, boost::is_any_of(","), boost::token_compress_on);
-      for (uint32_t i = 0; i<vecSTORecords.size(); i++) {
-          std::vector<std::string> vecSTORecordFields;
-          boost::split(vecSTORecordFields, vecSTORecords[i], boost::is_any_of(":"), boost::token_compress_on);
-          if (4 != vecSTORecordFields.size()) continue;
-          if (atoi(vecSTORecordFields[1]) < blockNum) {
-              newValue += vecSTORecords[i].append(","); // STO before the reorg, add data back to new value string
+      if (!IsLegacyKey(it->key())) continue;
+      std::string strKey = it->key().ToString();
+      std::string strValue = it->value().ToString();
+      std::vector<std::string> vstr;
+      boost::split(vstr, strValue, boost::is_any_of(":"), token_compress_on);
+      try {
+          if (strKey.size() == 64 && vstr.size() == 5) {
+              CMPTradeRecord trade;
+              trade.address = vstr[0];
+              trade.propertyIdForSale = boost::lexical_cast<uint32_t>(vstr[1]);
+              trade.propertyIdDesired = boost::lexical_cast<uint32_t>(vstr[2]);
+              trade.block = boost::lexical_cast<int32_t>(vstr[3]);
+              trade.blockIndex = boost::lexical_cast<int32_t>(vstr[4]);
+              PutTrade(batch, uint256S(strKey), trade);
+              ++nUpgraded;
+          } else if (strKey.size() == 129 && (vstr.size() == 7 || vstr.size() == 8)) {
+              CMPMatchRecord match;
+              match.txid1 = uint256S(strKey.substr(0, 64));
+              match.txid2 = uint256S(strKey.substr(65, 64));
+              match.address1 = vstr[0];
+              match.address2 = vstr[1];
+              match.prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
+              match.prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
+              match.amount1 = boost::lexical_cast<int64_t>(vstr[4]);
+              match.amount2 = boost::lexical_cast<int64_t>(vstr[5]);
+              match.block = boost::lexical_cast<int32_t>(vstr[6]);
+              match.fee = vstr.size() == 8 ? boost::lexical_cast<int64_t>(vstr[7]) : 0;
+              PutMatch(batch, match);
+              ++nUpgraded;
           } else {
-              needsUpdate = true;
+              PrintToLog("TRADEDB error - unexpected record (%s:%s)\n", strKey, strValue);
           }
+      } catch (const boost::bad_lexical_cast& e) {
+          PrintToLog("TRADEDB error - unexpected record (%s:%s)\n", strKey, strValue);
       }
-      if (needsUpdate) { // rewrite record with existing key and new value
-          ++n_found;
-          leveldb::Status status = pdb->Put(writeoptions, it->key().ToString(), newValue);
-          PrintToLog("DEBUG STO - rewriting STO data after reorg\n");
-          PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+      batch.Delete(it->key());
+      if (++nBatch >= UPGRADE_BATCH_SIZE) {
+          pdb->Write(syncoptions, &batch);
+          batch.Clear();
+          nBatch = 0;
       }
   }
-
-  PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
-
   delete it;
 
-  return (n_found);
+  PutRecordsVersion(batch);
+  Status status = pdb->Write(syncoptions, &batch);
+  PrintToLog("%s(): upgraded %d trade records: %s\n", __FUNCTION__, nUpgraded, status.ToString());
 }
 
-// MPTradeList here
 bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, UniValue& tradeArray, int64_t& totalSold, int64_t& totalReceived)
 {
   if (!pdb) return false;
@@ -3346,63 +3749,49 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
   totalReceived = 0;
   totalSold = 0;
 
-  std::vector<std::string> vstr;
-  string txidStr = txid.ToString();
+  // every match of the trade has a record under its txid
+  std::string prefix = TradeKey(TRADEKEY_MATCH_BY_TXID);
+  AppendKey(prefix, txid);
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      // search key to see if this is a matching trade
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
-      std::string matchTxid;
-      size_t txidMatch = strKey.find(txidStr);
-      if (txidMatch == std::string::npos) continue; // no match
-
-      // sanity check key is the correct length for a matched trade
-      if (strKey.length() != 129) continue;
-
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
       // obtain the txid of the match
-      if (txidMatch==0) { matchTxid = strKey.substr(65,64); } else { matchTxid = strKey.substr(0,64); }
-
-      // ensure correct amount of tokens in value string
-      boost::split(vstr, strValue, boost::is_any_of(":"), token_compress_on);
-      if (vstr.size() != 8) {
-          PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
+      size_t pos = prefix.size();
+      uint256 matchTxid;
+      if (!ReadKey(it->key(), pos, matchTxid)) continue;
+      bool fFirst = it->value().size() == 1 && it->value()[0] == '\0';
+
+      std::string strValue;
+      CMPMatchRecord match;
+      if (!pdb->Get(readoptions, fFirst ? MatchRecordKey(txid, matchTxid) : MatchRecordKey(matchTxid, txid), &strValue).ok() ||
+          !DeserializeRecord(strValue, match)) {
+          PrintToLog("TRADEDB error - missing match of %s and %s\n", txid.ToString(), matchTxid.ToString());
           continue;
       }
+      ++nRead;
 
-      // decode the details from the value string
-      std::string address1 = vstr[0];
-      std::string address2 = vstr[1];
-      uint32_t prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
-      uint32_t prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
-      int64_t amount1 = boost::lexical_cast<int64_t>(vstr[4]);
-      int64_t amount2 = boost::lexical_cast<int64_t>(vstr[5]);
-      int blockNum = atoi(vstr[6]);
-      int64_t tradingFee = boost::lexical_cast<int64_t>(vstr[7]);
-
-      std::string strAmount1 = FormatMP(prop1, amount1);
-      std::string strAmount2 = FormatMP(prop2, amount2);
-      std::string strTradingFee = FormatMP(prop2, tradingFee);
-      std::string strAmount2PlusFee = FormatMP(prop2, amount2+tradingFee);
+      std::string strAmount1 = FormatMP(match.prop1, match.amount1);
+      std::string strAmount2 = FormatMP(match.prop2, match.amount2);
+      std::string strTradingFee = FormatMP(match.prop2, match.fee);
+      std::string strAmount2PlusFee = FormatMP(match.prop2, match.amount2+match.fee);
 
       // populate trade object and add to the trade array, correcting for orientation of trade
       UniValue trade(UniValue::VOBJ);
-      trade.push_back(Pair("txid", matchTxid));
-      trade.push_back(Pair("block", blockNum));
-      if (prop1 == propertyId) {
-          trade.push_back(Pair("address", address1));
+      trade.push_back(Pair("txid", matchTxid.ToString()));
+      trade.push_back(Pair("block", match.block));
+      if (match.prop1 == propertyId) {
+          trade.push_back(Pair("address", match.address1));
           trade.push_back(Pair("amountsold", strAmount1));
           trade.push_back(Pair("amountreceived", strAmount2));
           trade.push_back(Pair("tradingfee", strTradingFee));
-          totalReceived += amount2;
-          totalSold += amount1;
+          totalReceived += match.amount2;
+          totalSold += match.amount1;
       } else {
-          trade.push_back(Pair("address", address2));
+          trade.push_back(Pair("address", match.address2));
           trade.push_back(Pair("amountsold", strAmount2PlusFee));
           trade.push_back(Pair("amountreceived", strAmount1));
-          trade.push_back(Pair("tradingfee", FormatMP(prop1, 0))); // not the liquidity taker so no fee for this participant - include attribute for standardness
-          totalReceived += amount1;
-          totalSold += amount2;
+          trade.push_back(Pair("tradingfee", FormatMP(match.prop1, 0))); // not the liquidity taker so no fee for this participant - include attribute for standardness
+          totalReceived += match.amount1;
+          totalSold += match.amount2;
       }
       tradeArray.push_back(trade);
       ++count;
@@ -3426,39 +3815,38 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
   std::vector<std::pair<int64_t, UniValue> > vecResponse;
   bool propertyIdSideAIsDivisible = isPropertyDivisible(propertyIdSideA);
   bool propertyIdSideBIsDivisible = isPropertyDivisible(propertyIdSideB);
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
-      std::vector<std::string> vecKeys;
-      std::vector<std::string> vecValues;
+  // matches of the pair are listed under the pair in either orientation
+  std::string prefixes[2] = {TradePairKey(propertyIdSideA, propertyIdSideB), TradePairKey(propertyIdSideB, propertyIdSideA)};
+  for (int side = 0; side < (propertyIdSideA == propertyIdSideB ? 1 : 2); side++) {
+    for(it->Seek(prefixes[side]); it->Valid() && it->key().starts_with(prefixes[side]); it->Next()) {
+      size_t pos = prefixes[side].size();
+      uint256 txid1, txid2;
+      std::string strValue;
+      CMPMatchRecord match;
+      if (!ReadKey(it->key(), pos, txid1) || !ReadKey(it->key(), pos, txid2)) continue;
+      if (!pdb->Get(readoptions, MatchRecordKey(txid1, txid2), &strValue).ok() || !DeserializeRecord(strValue, match)) {
+          PrintToLog("TRADEDB error - missing match of %s and %s\n", txid1.ToString(), txid2.ToString());
+          continue;
+      }
+      ++nRead;
+
       uint256 sellerTxid, matchingTxid;
       std::string sellerAddress, matchingAddress;
       int64_t amountReceived = 0, amountSold = 0;
-      if (strKey.size() != 129) continue; // only interested in matches
-      boost::split(vecKeys, strKey, boost::is_any_of("+"), boost::token_compress_on);
-      boost::split(vecValues, strValue, boost::is_any_of(":"), boost::token_compress_on);
-      if (vecKeys.size() != 2 || vecValues.size() != 8) {
-          PrintToLog("TRADEDB error - unexpected number of tokens (%s:%s)\n", strKey, strValue);
-          continue;
-      }
-      uint32_t tradePropertyIdSideA = boost::lexical_cast<uint32_t>(vecValues[2]);
-      uint32_t tradePropertyIdSideB = boost::lexical_cast<uint32_t>(vecValues[3]);
-      if (tradePropertyIdSideA == propertyIdSideA && tradePropertyIdSideB == propertyIdSideB) {
-          sellerTxid.SetHex(vecKeys[1]);
-          sellerAddress = vecValues[1];
-          amountSold = boost::lexical_cast<int64_t>(vecValues[4]);
-          matchingTxid.SetHex(vecKeys[0]);
-          matchingAddress = vecValues[0];
-          amountReceived = boost::lexical_cast<int64_t>(vecValues[5]);
-      } else if (tradePropertyIdSideB == propertyIdSideA && tradePropertyIdSideA == propertyIdSideB) {
-          sellerTxid.SetHex(vecKeys[0]);
-          sellerAddress = vecValues[0];
-          amountSold = boost::lexical_cast<int64_t>(vecValues[5]);
-          matchingTxid.SetHex(vecKeys[1]);
-          matchingAddress = vecValues[1];
-          amountReceived = boost::lexical_cast<int64_t>(vecValues[4]);
+      if (side == 0) {
+          sellerTxid = match.txid2;
+          sellerAddress = match.address2;
+          amountSold = match.amount1;
+          matchingTxid = match.txid1;
+          matchingAddress = match.address1;
+          amountReceived = match.amount2;
       } else {
-          continue;
+          sellerTxid = match.txid1;
+          sellerAddress = match.address1;
+          amountSold = match.amount2;
+          matchingTxid = match.txid2;
+          matchingAddress = match.address2;
+          amountReceived = match.amount1;
       }
 
       rational_t unitPrice(amountReceived, amountSold);
@@ -3468,7 +3856,7 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
       std::string unitPriceStr = xToString(unitPrice); // TODO: not here!
       std::string inversePriceStr = xToString(inversePrice);
 
-      int64_t blockNum = boost::lexical_cast<int64_t>(vecValues[6]);
+      int64_t blockNum = match.block;
 
       UniValue trade(UniValue::VOBJ);
       trade.push_back(Pair("block", blockNum));
@@ -3489,6 +3877,7 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
       trade.push_back(Pair("matchingtxid", matchingTxid.GetHex()));
       trade.push_back(Pair("matchingaddress", matchingAddress));
       vecResponse.push_back(make_pair(blockNum, trade));
+    }
   }
 
   // sort the response most recent first before adding to the array
@@ -3516,40 +3905,40 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
 void CMPTradeList::getTradesForAddress(std::string address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter)
 {
   if (!pdb) return;
-  std::map<std::string,uint256> mapTrades;
+  // the trades of an address are listed under the address by block then index
+  std::string prefix = TradeAddressKey(address);
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
-      std::vector<std::string> vecValues;
-      if (strKey.size() != 64) continue; // only interested in trades
-      uint256 txid = uint256S(strKey);
-      size_t addressMatch = strValue.find(address);
-      if (addressMatch == std::string::npos) continue;
-      boost::split(vecValues, strValue, boost::is_any_of(":"), token_compress_on);
-      if (vecValues.size() != 5) {
-          PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
-          continue;
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      size_t pos = prefix.size() + 8;
+      uint256 txid;
+      if (!ReadKey(it->key(), pos, txid)) continue;
+      if (propertyIdFilter != 0) {
+          std::string strValue;
+          CMPTradeRecord trade;
+          if (!pdb->Get(readoptions, TradeRecordKey(txid), &strValue).ok() || !DeserializeRecord(strValue, trade)) {
+              PrintToLog("TRADEDB error - missing trade %s\n", txid.ToString());
+              continue;
+          }
+          ++nRead;
+          if (propertyIdFilter != trade.propertyIdForSale && propertyIdFilter != trade.propertyIdDesired) continue;
       }
-      uint32_t propertyIdForSale = boost::lexical_cast<uint32_t>(vecValues[1]);
-      uint32_t propertyIdDesired = boost::lexical_cast<uint32_t>(vecValues[2]);
-      int64_t blockNum = boost::lexical_cast<uint32_t>(vecValues[3]);
-      int64_t txIndex = boost::lexical_cast<uint32_t>(vecValues[4]);
-      if (propertyIdFilter != 0 && propertyIdFilter != propertyIdForSale && propertyIdFilter != propertyIdDesired) continue;
-      std::string sortKey = strprintf("%06d%010d", blockNum, txIndex);
-      mapTrades.insert(std::make_pair(sortKey, txid));
+      vecTransactions.push_back(txid);
   }
   delete it;
-  for (std::map<std::string,uint256>::iterator it = mapTrades.begin(); it != mapTrades.end(); it++) {
-      vecTransactions.push_back(it->second);
-  }
 }
 
 void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex)
 {
   if (!pdb) return;
-  std::string strValue = strprintf("%s:%d:%d:%d:%d", address, propertyIdForSale, propertyIdDesired, blockNum, blockIndex);
-  Status status = pdb->Put(writeoptions, txid.ToString(), strValue);
+  CMPTradeRecord trade;
+  trade.address = address;
+  trade.propertyIdForSale = propertyIdForSale;
+  trade.propertyIdDesired = propertyIdDesired;
+  trade.block = blockNum;
+  trade.blockIndex = blockIndex;
+  leveldb::WriteBatch batch;
+  PutTrade(batch, txid, trade);
+  Status status = pdb->Write(writeoptions, &batch);
   ++nWritten;
   if (elysium_debug_tradedb) PrintToLog("%s(): %s\n", __FUNCTION__, status.ToString());
 }
@@ -3557,15 +3946,22 @@ void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& addres
 void CMPTradeList::recordMatchedTrade(const uint256 txid1, const uint256 txid2, string address1, string address2, unsigned int prop1, unsigned int prop2, uint64_t amount1, uint64_t amount2, int blockNum, int64_t fee)
 {
   if (!pdb) return;
-  const string key = txid1.ToString() + "+" + txid2.ToString();
-  const string value = strprintf("%s:%s:%u:%u:%lu:%lu:%d:%d", address1, address2, prop1, prop2, amount1, amount2, blockNum, fee);
-  Status status;
-  if (pdb)
-  {
-    status = pdb->Put(writeoptions, key, value);
-    ++nWritten;
-    if (elysium_debug_tradedb) PrintToLog("%s(): %s\n", __FUNCTION__, status.ToString());
-  }
+  CMPMatchRecord match;
+  match.txid1 = txid1;
+  match.txid2 = txid2;
+  match.address1 = address1;
+  match.address2 = address2;
+  match.prop1 = prop1;
+  match.prop2 = prop2;
+  match.amount1 = amount1;
+  match.amount2 = amount2;
+  match.block = blockNum;
+  match.fee = fee;
+  leveldb::WriteBatch batch;
+  PutMatch(batch, match);
+  Status status = pdb->Write(writeoptions, &batch);
+  ++nWritten;
+  if (elysium_debug_tradedb) PrintToLog("%s(): %s\n", __FUNCTION__, status.ToString());
 }
 
 /**
@@ -3575,32 +3971,43 @@ void CMPTradeList::recordMatchedTrade(const uint256 txid1, const uint256 txid2,
  */
 int CMPTradeList::deleteAboveBlock(int blockNum)
 {
-  leveldb::Slice skey, svalue;
-  unsigned int count = 0;
-  std::vector<std::string> vstr;
-  int block = 0;
+  if (!pdb) return 0;
   unsigned int n_found = 0;
+  std::string start = TradeKey(TRADEKEY_BLOCK);
+  AppendKey(start, static_cast<uint32_t>(blockNum));
+  leveldb::WriteBatch batch;
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(start); it->Valid() && it->key().starts_with(TradeKey(TRADEKEY_BLOCK)); it->Next())
   {
-    skey = it->key();
-    svalue = it->value();
-    ++count;
-    string strvalue = it->value().ToString();
-    boost::split(vstr, strvalue, boost::is_any_of(":"), token_compress_on);
-    if (7 == vstr.size()) block = atoi(vstr[6]); // trade matches have 7 tokens, key is txid+txid, only care about block
-    if (5 == vstr.size()) block = atoi(vstr[3]); // trades have 5 tokens, key is txid, only care about block
-    if (block >= blockNum) {
-        ++n_found;
-        PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __FUNCTION__, skey.ToString(), svalue.ToString());
-        pdb->Delete(writeoptions, skey);
+    // the block index lists the key of the trade or match
+    std::string recordKey = it->key().ToString().substr(5);
+    std::string strValue;
+    if (!pdb->Get(readoptions, recordKey, &strValue).ok()) {
+        batch.Delete(it->key());
+        continue;
     }
-  }
-
-  PrintToLog("%s(%d); tradedb n_found= %d\n", __FUNCTION__, blockNum, n_found);
 
+    CMPTradeRecord trade;
+    CMPMatchRecord match;
+    size_t pos = 1;
+    uint256 txid;
+    if (recordKey[0] == TRADEKEY_TRADE && ReadKey(recordKey, pos, txid) && DeserializeRecord(strValue, trade)) {
+        PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __FUNCTION__, txid.ToString(), FormatTradeRecord(trade));
+        DeleteTrade(batch, txid, trade);
+    } else if (recordKey[0] == TRADEKEY_MATCH && DeserializeRecord(strValue, match)) {
+        PrintToLog("%s() DELETING FROM TRADEDB: %s+%s=%s\n", __FUNCTION__, match.txid1.ToString(), match.txid2.ToString(), FormatMatchRecord(match));
+        DeleteMatch(batch, match);
+    } else {
+        batch.Delete(recordKey);
+        batch.Delete(it->key());
+    }
+    ++n_found;
+  }
   delete it;
 
+  Status status = pdb->Write(writeoptions, &batch);
+  PrintToLog("%s(%d); tradedb n_found= %d: %s\n", __FUNCTION__, blockNum, n_found, status.ToString());
+
   return (n_found);
 }
 
@@ -3612,9 +4019,9 @@ void CMPTradeList::printStats()
 int CMPTradeList::getMPTradeCountTotal()
 {
     int count = 0;
-    Slice skey, svalue;
     Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next())
+    // trades and matches, without the index records
+    for(it->Seek(TradeKey(TRADEKEY_TRADE)); it->Valid() && static_cast<unsigned char>(it->key()[0]) <= TRADEKEY_MATCH; it->Next())
     {
         ++count;
     }
@@ -3625,15 +4032,20 @@ int CMPTradeList::getMPTradeCountTotal()
 void CMPTradeList::printAll()
 {
   int count = 0;
-  Slice skey, svalue;
   Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(TradeKey(TRADEKEY_TRADE)); it->Valid() && static_cast<unsigned char>(it->key()[0]) <= TRADEKEY_MATCH; it->Next())
   {
-    skey = it->key();
-    svalue = it->value();
+    CMPTradeRecord trade;
+    CMPMatchRecord match;
+    size_t pos = 1;
+    uint256 txid;
     ++count;
-    PrintToLog("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+    if (it->key()[0] == TRADEKEY_TRADE && ReadKey(it->key(), pos, txid) && DeserializeRecord(it->value(), trade)) {
+        PrintToLog("entry #%8d= %s:%s\n", count, txid.ToString(), FormatTradeRecord(trade));
+    } else if (it->key()[0] == TRADEKEY_MATCH && DeserializeRecord(it->value(), match)) {
+        PrintToLog("entry #%8d= %s+%s:%s\n", count, match.txid1.ToString(), match.txid2.ToString(), FormatMatchRecord(match));
+    }
   }
 
   delete it;
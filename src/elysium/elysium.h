@@ -130,15 +130,20 @@ public:
     std::string FetchInvalidReason(const uint256& txid);
 };
 
-/** LevelDB based storage for STO recipients.
+/** LevelDB based storage for STO recipients. Receipts are binary records listed by recipient and by txid.
  */
 class CMPSTOList : public CDBBase
 {
+private:
+    //! Converts the legacy "txid:block:property:amount," lists of the recipients into receipt records
+    void upgradeRecords();
+
 public:
     CMPSTOList(const boost::filesystem::path& path, bool fWipe)
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading send-to-owners database: %s\n", status.ToString());
+        upgradeRecords();
     }
 
     virtual ~CMPSTOList()
@@ -155,15 +160,21 @@ public:
     void recordSTOReceive(std::string, const uint256&, int, unsigned int, uint64_t);
 };
 
-/** LevelDB based storage for the trade history. Trades are listed with key "txid1+txid2".
+/** LevelDB based storage for the trade history. Trades and matches are binary records, indexed by txid, property
+ * pair, address and block.
  */
 class CMPTradeList : public CDBBase
 {
+private:
+    //! Converts the legacy colon delimited trade and match strings into binary records
+    void upgradeRecords();
+
 public:
     CMPTradeList(const boost::filesystem::path& path, bool fWipe)
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading trades database: %s\n", status.ToString());
+        upgradeRecords();
     }
 
     virtual ~CMPTradeList()
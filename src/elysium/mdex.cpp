@@ -25,11 +25,13 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 typedef boost::multiprecision::cpp_dec_float_100 dec_float;
 typedef boost::multiprecision::checked_int128_t int128_t;
@@ -60,6 +62,63 @@ md_Set* elysium::get_Indexes(md_PricesMap* p, rational_t price)
     return (md_Set*) NULL;
 }
 
+namespace {
+
+//! Position of an order in the order book, stays valid until the order is erased
+struct OrderHandle
+{
+    uint32_t property;
+    md_PricesMap::iterator priceIt;
+    md_Set::iterator offerIt;
+};
+
+//! Open orders by txid
+std::map<uint256, OrderHandle> ordersByTxid;
+//! Txids of the open orders of an address
+std::map<std::string, std::set<uint256> > ordersByAddress;
+
+void IndexOrder(uint32_t property, md_PricesMap::iterator priceIt, md_Set::iterator offerIt)
+{
+    OrderHandle handle = {property, priceIt, offerIt};
+    ordersByTxid[offerIt->getHash()] = handle;
+    ordersByAddress[offerIt->getAddr()].insert(offerIt->getHash());
+}
+
+// Erases an order from the order book and the indexes, returns the next order of the price level
+md_Set::iterator EraseOrder(md_Set& indexes, md_Set::iterator offerIt)
+{
+    ordersByTxid.erase(offerIt->getHash());
+    std::map<std::string, std::set<uint256> >::iterator addrIt = ordersByAddress.find(offerIt->getAddr());
+    if (addrIt != ordersByAddress.end()) {
+        addrIt->second.erase(offerIt->getHash());
+        if (addrIt->second.empty()) ordersByAddress.erase(addrIt);
+    }
+    return indexes.erase(offerIt);
+}
+
+// Orders are cancelled in the order of the book, as the cancellations are recorded one by one
+bool CompareOrderHandles(const OrderHandle& lhs, const OrderHandle& rhs)
+{
+    if (lhs.property != rhs.property) return lhs.property < rhs.property;
+    if (lhs.priceIt->first != rhs.priceIt->first) return lhs.priceIt->first < rhs.priceIt->first;
+    return MetaDEx_compare()(*lhs.offerIt, *rhs.offerIt);
+}
+
+std::vector<OrderHandle> GetOrdersOfAddress(const std::string& addr)
+{
+    std::vector<OrderHandle> orders;
+    std::map<std::string, std::set<uint256> >::const_iterator addrIt = ordersByAddress.find(addr);
+    if (addrIt == ordersByAddress.end()) return orders;
+
+    for (std::set<uint256>::const_iterator it = addrIt->second.begin(); it != addrIt->second.end(); ++it) {
+        orders.push_back(ordersByTxid.at(*it));
+    }
+    std::sort(orders.begin(), orders.end(), CompareOrderHandles);
+    return orders;
+}
+
+} // anonymous namespace
+
 enum MatchReturnType
 {
     NOTHING = 0,
@@ -136,6 +195,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 {
     const uint32_t propertyForSale = pnew->getProperty();
     const uint32_t propertyDesired = pnew->getDesProperty();
+    // only the remaining amount of the new order changes while it is matched
+    const rational_t buyersPrice = pnew->inversePrice();
     MatchReturnType NewReturn = NOTHING;
     bool bBuyerSatisfied = false;
 
@@ -155,11 +216,12 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
         const rational_t sellersPrice = priceIt->first;
 
         if (elysium_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
-            xToString(pnew->inversePrice()), xToString(sellersPrice));
+            xToString(buyersPrice), xToString(sellersPrice));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
-        if (pnew->inversePrice() < sellersPrice) {
-            continue;
+        // Prices are sorted, so no later price level satisfies it either.
+        if (buyersPrice < sellersPrice) {
+            break;
         }
 
         md_Set* const pofferSet = &(priceIt->second);
@@ -198,7 +260,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             assert(pnew->getProperty() != pnew->getDesProperty());
             assert(pnew->getProperty() == pold->getDesProperty());
             assert(pold->getProperty() == pnew->getDesProperty());
-            assert(pold->unitPrice() <= pnew->inversePrice());
+            assert(pold->unitPrice() <= buyersPrice);
             assert(pnew->unitPrice() <= pold->inversePrice());
 
             ///////////////////////////
@@ -234,7 +296,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             // orders shall not execute, and no representable fill is made
             const rational_t xEffectivePrice(nWouldPay, nCouldBuy);
 
-            if (xEffectivePrice > pnew->inversePrice()) {
+            if (xEffectivePrice > buyersPrice) {
                 if (elysium_debug_metadex1) PrintToLog(
                         "-- effective price is too expensive: %s\n", xToString(xEffectivePrice));
                 ++offerIt;
@@ -253,7 +315,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             // postconditions
             assert(xEffectivePrice >= pold->unitPrice());
-            assert(xEffectivePrice <= pnew->inversePrice());
+            assert(xEffectivePrice <= buyersPrice);
             assert(0 <= seller_amountLeft);
             assert(0 <= buyer_amountLeft);
             assert(seller_amountForSale == seller_amountLeft + buyer_amountGot);
@@ -315,12 +377,12 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             if (elysium_debug_metadex1) PrintToLog("++ erased old: %s\n", offerIt->ToString());
             // erase the old seller element
-            pofferSet->erase(offerIt++);
+            offerIt = EraseOrder(*pofferSet, offerIt);
 
             // insert the updated one in place of the old
             if (0 < seller_replacement.getAmountRemaining()) {
                 PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
-                pofferSet->insert(seller_replacement);
+                IndexOrder(propertyDesired, priceIt, pofferSet->insert(seller_replacement).first);
             }
 
             if (bBuyerSatisfied) {
@@ -456,39 +518,31 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool elysium::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
-
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = NULL;
-
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
-
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
-
-    // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
-    if (false == ret.second) return false;
-
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
+    // Reject duplicates before anything is created for the metadex object
+    if (ordersByTxid.count(objMetaDEx.getHash())) return false;
+    md_PricesMap* pprices = get_Prices(objMetaDEx.getProperty());
+    if (pprices) {
+        md_PricesMap::const_iterator it = pprices->find(objMetaDEx.unitPrice());
+        if (it != pprices->end() && it->second.count(objMetaDEx)) return false;
+    }
 
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
+    // Obtain the price map for the property and the set of metadex objects at this price, creating them if needed
+    md_PricesMap& prices = metadex[objMetaDEx.getProperty()];
+    md_PricesMap::iterator priceIt = prices.insert(std::make_pair(objMetaDEx.unitPrice(), md_Set())).first;
+    md_Set::iterator offerIt = priceIt->second.insert(objMetaDEx).first;
 
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    metadex[objMetaDEx.getProperty()] = *p_prices;
+    IndexOrder(objMetaDEx.getProperty(), priceIt, offerIt);
 
     return true;
 }
 
+void elysium::MetaDEx_CLEAR()
+{
+    ordersByTxid.clear();
+    ordersByAddress.clear();
+    metadex.clear();
+}
+
 // pretty much directly linked to the ADD TX21 command off the wire
 int elysium::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64_t amount, int block, uint32_t property_desired, int64_t amount_desired, const uint256& txid, unsigned int idx)
 {
@@ -570,7 +624,7 @@ int elysium::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block, co
             bool bValid = true;
             p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            indexes->erase(iitt++);
+            iitt = EraseOrder(*indexes, iitt);
         }
     }
 
@@ -594,33 +648,29 @@ int elysium::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        md_Set* indexes = &(my_it->second);
-
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
+    // iterate over the orders of the sender
+    std::vector<OrderHandle> orders = GetOrdersOfAddress(sender_addr);
+    for (std::vector<OrderHandle>::iterator it = orders.begin(); it != orders.end(); ++it) {
+        p_mdex = &(*it->offerIt);
 
-            if (elysium_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
+        if (elysium_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
+        if ((it->property != prop) || (p_mdex->getDesProperty() != property_desired)) {
+            continue;
+        }
 
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
 
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
+        // move from reserve to main
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
 
-            // record the cancellation
-            bool bValid = true;
-            p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            indexes->erase(iitt++);
-        }
+        EraseOrder(it->priceIt->second, it->offerIt);
     }
 
     if (elysium_debug_metadex3) MetaDEx_debug_print();
@@ -629,7 +679,7 @@ int elysium::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block
 }
 
 /**
- * Scans the orderbook and remove everything for an address.
+ * Removes everything of an address from the orderbook.
  */
 int elysium::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block, const std::string& sender_addr, unsigned char ecosystem)
 {
@@ -639,48 +689,29 @@ int elysium::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block,
 
     if (elysium_debug_metadex2) MetaDEx_debug_print();
 
-    PrintToLog("<<<<<<\n");
-
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        unsigned int prop = my_it->first;
+    std::vector<OrderHandle> orders = GetOrdersOfAddress(sender_addr);
+    for (std::vector<OrderHandle>::iterator it = orders.begin(); it != orders.end(); ++it) {
+        unsigned int prop = it->property;
 
         // skip property, if it is not in the expected ecosystem
         if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
         if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
 
-        PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
-
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
-
-            PrintToLog("  # Price Level: %s\n", xToString(price));
-
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
+        const CMPMetaDEx& obj = *it->offerIt;
 
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, obj.ToString());
 
-                rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+        // move from reserve to balance
+        assert(update_tally_map(obj.getAddr(), obj.getProperty(), -obj.getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(obj.getAddr(), obj.getProperty(), obj.getAmountRemaining(), BALANCE));
 
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-
-                // record the cancellation
-                bool bValid = true;
-                p_txlistdb->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, obj.getHash(), bValid, block, obj.getProperty(), obj.getAmountRemaining());
 
-                indexes.erase(it++);
-            }
-        }
+        EraseOrder(it->priceIt->second, it->offerIt);
     }
-    PrintToLog(">>>>>>\n");
 
     if (elysium_debug_metadex2) MetaDEx_debug_print();
 
@@ -704,7 +735,9 @@ int elysium::MetaDEx_SHUTDOWN_ALLPAIR()
                     // move from reserve to balance
                     assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                     assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                    indexes.erase(it++);
+                    it = EraseOrder(indexes, it);
+                } else {
+                    ++it;
                 }
             }
         }
@@ -728,29 +761,20 @@ int elysium::MetaDEx_SHUTDOWN()
                 // move from reserve to balance
                 assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                 assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                indexes.erase(it++);
+                it = EraseOrder(indexes, it);
             }
         }
     }
     return rc;
 }
 
-// searches the metadex maps to see if a trade is still open
-// allows search to be optimized if propertyIdForSale is specified
+// looks up the txid in the index of open trades
+// the trade must be for sale of propertyIdForSale, if it is specified
 bool elysium::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 {
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
-        md_PricesMap & prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set & indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                CMPMetaDEx obj = *it;
-                if( obj.getHash().GetHex() == txid.GetHex() ) return true;
-            }
-        }
-    }
-    return false;
+    std::map<uint256, OrderHandle>::const_iterator it = ordersByTxid.find(txid);
+    if (it == ordersByTxid.end()) return false;
+    return propertyIdForSale == 0 || propertyIdForSale == it->second.property;
 }
 
 /**
@@ -837,14 +861,7 @@ void elysium::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
  */
 const CMPMetaDEx* elysium::MetaDEx_RetrieveTrade(const uint256& txid)
 {
-    for (md_PropertiesMap::iterator propIter = metadex.begin(); propIter != metadex.end(); ++propIter) {
-        md_PricesMap & prices = propIter->second;
-        for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
-            md_Set & indexes = pricesIter->second;
-            for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
-                if (txid == (*tradesIter).getHash()) return &(*tradesIter);
-            }
-        }
-    }
-    return (CMPMetaDEx*) NULL;
+    std::map<uint256, OrderHandle>::const_iterator it = ordersByTxid.find(txid);
+    if (it == ordersByTxid.end()) return (CMPMetaDEx*) NULL;
+    return &(*it->second.offerIt);
 }
@@ -1788,7 +1788,7 @@ UniValue elysium_gettransaction(const UniValue& params, bool fHelp)
     return txobj;
 }
 
-UniValue elysium_listtransactions(const UniValue& params, bool fHelp)
+void elysium_listtransactions(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() > 5)
         throw runtime_error(
@@ -1844,14 +1844,15 @@ UniValue elysium_listtransactions(const UniValue& params, bool fHelp)
     // obtain a sorted list of Elysium layer wallet transactions (including STO receipts and pending)
     std::map<std::string,uint256> walletTransactions = FetchWalletElysiumTransactions(nFrom+nCount, nStartBlock, nEndBlock);
 
-    // reverse iterate over (now ordered) transactions and populate RPC objects for each one
-    UniValue response(UniValue::VARR);
-    for (std::map<std::string,uint256>::reverse_iterator it = walletTransactions.rbegin(); it != walletTransactions.rend(); it++) {
+    // reverse iterate over (now ordered) transactions and write RPC objects for each one as they are populated
+    writer.BeginArray();
+    for (std::map<std::string,uint256>::reverse_iterator it = walletTransactions.rbegin(); it != walletTransactions.rend() && !writer.IsClosed(); it++) {
         uint256 txHash = it->second;
         UniValue txobj(UniValue::VOBJ);
         int populateResult = populateRPCTransactionObject(txHash, txobj, addressParam);
-        if (0 == populateResult) response.push_back(txobj);
+        if (0 == populateResult) writer.Value(txobj);
     }
+    writer.EndArray();
 
     // TODO: reenable cutting!
 /*
@@ -1866,7 +1867,13 @@ UniValue elysium_listtransactions(const UniValue& params, bool fHelp)
     if (first != response.begin()) response.erase(response.begin(), first);
     std::reverse(response.begin(), response.end());
 */
-    return response;
+}
+
+UniValue elysium_listtransactions(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    elysium_listtransactions(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 #ifdef ENABLE_WALLET
@@ -2457,8 +2464,17 @@ static const CRPCCommand commands[] =
 #endif
 };
 
+static const CRPCStreamCommand streamCommands[] =
+{ //  name                         streamActor
+  //  ---------------------------  --------------------------
+    { "elysium_listtransactions",  &elysium_listtransactions },
+    { "listtransactions_MP",       &elysium_listtransactions },
+};
+
 void RegisterElysiumDataRetrievalRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(streamCommands); vcidx++)
+        tableRPC.appendStreamActor(streamCommands[vcidx].name, streamCommands[vcidx].streamActor);
 }
@@ -3,9 +3,6 @@
 #include "sigmadb.h"
 #include "sigmaprimitives.h"
 
-#include "../main.h"
-#include "../sync.h"
-
 #include <iterator>
 #include <vector>
 
@@ -22,10 +19,8 @@ bool VerifySigmaSpend(
 {
     std::vector<SigmaPublicKey> anonimitySet; // Don't preallocate the vector due to it will allow attacker to crash all client.
 
-    {
-        LOCK(cs_main);
-        sigmaDb->GetAnonimityGroup(property, denomination, group, groupSize, std::back_inserter(anonimitySet));
-    }
+    // The group comes from the cache of the database, which doesn't need cs_main.
+    sigmaDb->GetAnonimityGroup(property, denomination, group, groupSize, std::back_inserter(anonimitySet));
 
     // If the size of anonimity set is not the expected once then no need to verify the proof.
     if (anonimitySet.size() != groupSize) {
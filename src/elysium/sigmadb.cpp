@@ -16,6 +16,7 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -264,6 +265,17 @@ SigmaDatabase::~SigmaDatabase()
 {
 }
 
+void SigmaDatabase::Clear()
+{
+    // wipe database via parent class
+    CDBBase::Clear();
+    // the group size is a setting rather than state, so it stays
+    RecordGroupSize(groupSize);
+
+    LOCK(cs_groupCache);
+    groupCache.clear();
+}
+
 std::pair<SigmaMintGroup, SigmaMintIndex> SigmaDatabase::RecordMint(
     PropertyId propertyId,
     SigmaDenomination denomination,
@@ -292,6 +304,19 @@ std::pair<SigmaMintGroup, SigmaMintIndex> SigmaDatabase::RecordMint(
 
     AddEntry(key, GetSlice(buffer), height);
 
+    {
+        LOCK(cs_groupCache);
+        auto it = groupCache.find(GroupKey(propertyId, denomination, lastGroup));
+        if (it != groupCache.end() && it->second.size() == nextIdx) {
+            if (pubKey.IsMember()) {
+                it->second.push_back(pubKey);
+            } else {
+                // Read again, which fails the same way as without the cache
+                groupCache.erase(it);
+            }
+        }
+    }
+
     // Raise event.
     MintAdded(propertyId, denomination, lastGroup, nextIdx, pubKey, height);
 
@@ -368,6 +393,7 @@ void SigmaDatabase::DeleteAll(int startBlock)
 
     leveldb::WriteBatch batch;
     std::vector<std::function<void()>> defers; // functions to be called after delete whole keys
+    std::set<GroupKey> groups; // groups which lose coins
     for (; it->Valid() && IsSequenceEntry(it.get()); it->Prev()) {
 
         CDataStream deserialized(
@@ -409,6 +435,8 @@ void SigmaDatabase::DeleteAll(int startBlock)
             SigmaPublicKey pub;
             pubkeyDeserialized >> pub;
 
+            groups.insert(GroupKey(propertyId, denomination, groupId));
+
             // function to trigger event
             defers.push_back([this, propertyId, denomination, pub]() {
                 MintRemoved(propertyId, denomination, pub);
@@ -445,6 +473,13 @@ void SigmaDatabase::DeleteAll(int startBlock)
         throw std::runtime_error("Fail to update database");
     }
 
+    {
+        LOCK(cs_groupCache);
+        for (auto& group : groups) {
+            groupCache.erase(group);
+        }
+    }
+
     for (auto &defer : defers) {
         defer();
     }
@@ -516,10 +551,18 @@ uint16_t SigmaDatabase::InitGroupSize(uint16_t groupSize)
     return groupSize;
 }
 
-size_t SigmaDatabase::GetAnonimityGroup(
-    uint32_t propertyId, uint8_t denomination, uint32_t groupId, size_t count,
-    std::function<void(elysium::SigmaPublicKey&)> insertF)
+const std::vector<SigmaPublicKey>& SigmaDatabase::GetCachedGroup(
+    uint32_t propertyId, uint8_t denomination, uint32_t groupId)
 {
+    AssertLockHeld(cs_groupCache);
+
+    GroupKey groupKey(propertyId, denomination, groupId);
+    auto cached = groupCache.find(groupKey);
+    if (cached != groupCache.end()) {
+        return cached->second;
+    }
+
+    // The lock is held while reading so that a mint recorded meanwhile is either read here or appended afterwards.
     auto firstKey = CreateMintKey(propertyId, denomination, groupId, 0);
 
     auto it = NewIterator();
@@ -529,8 +572,8 @@ size_t SigmaDatabase::GetAnonimityGroup(
     uint16_t mintIdx;
     uint8_t mintDenom;
 
-    size_t i = 0;
-    for (; i < count && it->Valid(); i++, it->Next()) {
+    std::vector<SigmaPublicKey> group;
+    for (; it->Valid(); it->Next()) {
         if (!ParseMintKey(it->key(), mintPropId, mintDenom, mintGroupId, mintIdx) ||
             mintPropId != propertyId ||
             mintDenom != denomination ||
@@ -538,7 +581,7 @@ size_t SigmaDatabase::GetAnonimityGroup(
             break;
         }
 
-        if (mintIdx != i) {
+        if (mintIdx != group.size()) {
             throw std::runtime_error("GetAnonimityGroup() : coin index is out of order");
         }
 
@@ -547,6 +590,28 @@ size_t SigmaDatabase::GetAnonimityGroup(
         if (!pub.IsMember()) {
             throw std::runtime_error("GetAnonimityGroup() : coin is invalid");
         }
+        group.push_back(std::move(pub));
+    }
+
+    if (group.empty()) {
+        // Spends may name any group, only existing ones are kept
+        static const std::vector<SigmaPublicKey> emptyGroup;
+        return emptyGroup;
+    }
+
+    return groupCache.emplace(groupKey, std::move(group)).first->second;
+}
+
+size_t SigmaDatabase::GetAnonimityGroup(
+    uint32_t propertyId, uint8_t denomination, uint32_t groupId, size_t count,
+    std::function<void(elysium::SigmaPublicKey&)> insertF)
+{
+    LOCK(cs_groupCache);
+    auto& group = GetCachedGroup(propertyId, denomination, groupId);
+
+    size_t i = 0;
+    for (; i < count && i < group.size(); i++) {
+        auto pub = group[i];
         insertF(pub);
     }
 
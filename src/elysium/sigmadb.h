@@ -6,6 +6,7 @@
 #include "property.h"
 #include "sigmaprimitives.h"
 
+#include "../sync.h"
 #include "../uint256.h"
 
 #include <univalue.h>
@@ -15,7 +16,9 @@
 
 #include <leveldb/slice.h>
 
+#include <map>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <inttypes.h>
@@ -46,6 +49,9 @@ public:
     SigmaDatabase(const boost::filesystem::path& path, bool wipe, uint16_t groupSize = 0);
     ~SigmaDatabase() override;
 
+    /** Extends clearing of CDBBase. */
+    void Clear();
+
 public:
     std::pair<SigmaMintGroup, SigmaMintIndex> RecordMint(
         PropertyId propertyId,
@@ -105,6 +111,15 @@ protected:
     void AddEntry(const leveldb::Slice& key, const leveldb::Slice& value, int block);
 
 private:
+    typedef std::tuple<uint32_t, uint8_t, uint32_t> GroupKey;
+
+    // Decoded and membership checked coins of the groups read so far, in sync with the database so that spends can
+    // be verified without cs_main. Updated by RecordMint and DeleteAll after they wrote to the database.
+    std::map<GroupKey, std::vector<SigmaPublicKey>> groupCache;
+    CCriticalSection cs_groupCache;
+
+    const std::vector<SigmaPublicKey>& GetCachedGroup(uint32_t propertyId, uint8_t denomination, uint32_t groupId);
+
     void RecordGroupSize(uint16_t groupSize);
 
     std::unique_ptr<leveldb::Iterator> NewIterator() const;
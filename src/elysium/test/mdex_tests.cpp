@@ -0,0 +1,69 @@
+#include "elysium/mdex.h"
+#include "elysium/tx.h"
+
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace elysium;
+
+BOOST_FIXTURE_TEST_SUITE(elysium_mdex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(mdex_indexes_follow_inserts)
+{
+    uint256 txidA = uint256S("a1");
+    uint256 txidB = uint256S("b2");
+    CMPMetaDEx tradeA("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 100, 3, 1000, 1, 2000, txidA, 1, CMPTransaction::ADD);
+    CMPMetaDEx tradeB("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 101, 3, 1000, 1, 3000, txidB, 1, CMPTransaction::ADD);
+
+    MetaDEx_CLEAR();
+    BOOST_CHECK(!MetaDEx_isOpen(txidA));
+    BOOST_CHECK(MetaDEx_RetrieveTrade(txidA) == NULL);
+
+    BOOST_CHECK(MetaDEx_INSERT(tradeA));
+    BOOST_CHECK(MetaDEx_INSERT(tradeB));
+    BOOST_CHECK(!MetaDEx_INSERT(tradeA));
+
+    BOOST_CHECK(MetaDEx_isOpen(txidA));
+    BOOST_CHECK(MetaDEx_isOpen(txidA, 3));
+    BOOST_CHECK(!MetaDEx_isOpen(txidA, 1));
+    BOOST_CHECK(MetaDEx_isOpen(txidB));
+
+    const CMPMetaDEx* trade = MetaDEx_RetrieveTrade(txidB);
+    BOOST_REQUIRE(trade != NULL);
+    BOOST_CHECK_EQUAL(trade->getHash().GetHex(), txidB.GetHex());
+    BOOST_CHECK_EQUAL(trade->getAmountDesired(), 3000);
+
+    // Both orders are in the book, at different prices
+    md_PricesMap* prices = get_Prices(3);
+    BOOST_REQUIRE(prices != NULL);
+    BOOST_CHECK_EQUAL(prices->size(), 2);
+
+    MetaDEx_CLEAR();
+    BOOST_CHECK(!MetaDEx_isOpen(txidA));
+    BOOST_CHECK(!MetaDEx_isOpen(txidB));
+    BOOST_CHECK(get_Prices(3) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(mdex_duplicate_insert_leaves_book_unchanged)
+{
+    uint256 txid = uint256S("c3");
+    CMPMetaDEx trade("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 100, 3, 1000, 1, 2000, txid, 1, CMPTransaction::ADD);
+    // Same transaction at another price
+    CMPMetaDEx repriced("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 100, 3, 1000, 1, 5000, txid, 1, CMPTransaction::ADD);
+
+    MetaDEx_CLEAR();
+    BOOST_CHECK(MetaDEx_INSERT(trade));
+    BOOST_CHECK(!MetaDEx_INSERT(repriced));
+
+    // No price level was created for the rejected order
+    md_PricesMap* prices = get_Prices(3);
+    BOOST_REQUIRE(prices != NULL);
+    BOOST_CHECK_EQUAL(prices->size(), 1);
+    BOOST_CHECK_EQUAL(MetaDEx_RetrieveTrade(txid)->getAmountDesired(), 2000);
+
+    MetaDEx_CLEAR();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
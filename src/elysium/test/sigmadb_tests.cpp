@@ -504,6 +504,53 @@ BOOST_AUTO_TEST_CASE(get_anonimity_group_by_iterator)
     BOOST_CHECK_EQUAL(mints, result);
 }
 
+BOOST_AUTO_TEST_CASE(get_anonimity_group_after_record_and_delete)
+{
+    auto db = CreateDb();
+    auto mints = CreateMints(4);
+
+    db->RecordMint(1, 0, mints[0], 10);
+    db->RecordMint(1, 0, mints[1], 10);
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 2), db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+
+    // Mints recorded after the group was read are part of it
+    db->RecordMint(1, 0, mints[2], 11);
+    db->RecordMint(1, 0, mints[3], 12);
+    BOOST_CHECK_EQUAL(mints, db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 3), db->GetAnonimityGroupAsVector(1, 0, 0, 3));
+
+    // And deleted mints are not
+    db->DeleteAll(11);
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 2), db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+
+    db->RecordMint(1, 0, mints[3], 11);
+    BOOST_CHECK_EQUAL(
+        std::vector<SigmaPublicKey>({mints[0], mints[1], mints[3]}),
+        db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+}
+
+BOOST_AUTO_TEST_CASE(get_anonimity_group_after_clear)
+{
+    auto db = CreateDb();
+    auto mints = CreateMints(4);
+
+    db->RecordMint(1, 0, mints[0], 10);
+    db->RecordMint(1, 0, mints[1], 10);
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 2), db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+
+    // Clearing drops the cached group as well, mints recorded afterwards start a new one
+    db->Clear();
+    BOOST_CHECK_EQUAL(0, db->GetMintCount(1, 0, 0));
+    BOOST_CHECK_EQUAL(TEST_MAX_COINS_PER_GROUP, db->GetGroupSize());
+
+    db->RecordMint(1, 0, mints[2], 10);
+    db->RecordMint(1, 0, mints[3], 11);
+    BOOST_CHECK_EQUAL(
+        std::vector<SigmaPublicKey>({mints[2], mints[3]}),
+        db->GetAnonimityGroupAsVector(1, 0, 0, 4));
+    BOOST_CHECK(mints[2] == db->GetMint(1, 0, 0, 0));
+}
+
 BOOST_AUTO_TEST_CASE(group_size_default)
 {
     auto db = CreateDb(0);
@@ -0,0 +1,142 @@
+#include "elysium/elysium.h"
+#include "elysium/sp.h"
+
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <leveldb/db.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(elysium_tradelist_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(trades_by_address_and_block)
+{
+    std::unique_ptr<CMPTradeList> db(new CMPTradeList(pathTemp / "MP_tradelist_test", true));
+    uint256 txidA = uint256S("a1");
+    uint256 txidB = uint256S("b2");
+    uint256 txidC = uint256S("c3");
+
+    db->recordNewTrade(txidB, "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 3, 1, 101, 2);
+    db->recordNewTrade(txidA, "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 3, 4, 101, 1);
+    db->recordNewTrade(txidC, "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe", 1, 3, 102, 1);
+    db->recordMatchedTrade(txidC, txidB, "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe", "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 1, 3, 10, 20, 102, 0);
+    BOOST_CHECK_EQUAL(db->getMPTradeCountTotal(), 4);
+
+    // Ordered by block then index
+    std::vector<uint256> vecTrades;
+    db->getTradesForAddress("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", vecTrades);
+    BOOST_CHECK(vecTrades == std::vector<uint256>({txidA, txidB}));
+
+    vecTrades.clear();
+    db->getTradesForAddress("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", vecTrades, 1);
+    BOOST_CHECK(vecTrades == std::vector<uint256>({txidB}));
+
+    // The match is deleted with the trade of its block
+    BOOST_CHECK_EQUAL(db->deleteAboveBlock(102), 2);
+    BOOST_CHECK_EQUAL(db->getMPTradeCountTotal(), 2);
+    vecTrades.clear();
+    db->getTradesForAddress("1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe", vecTrades);
+    BOOST_CHECK(vecTrades.empty());
+}
+
+BOOST_AUTO_TEST_CASE(legacy_trades_are_upgraded)
+{
+    boost::filesystem::path path = pathTemp / "MP_tradelist_legacy_test";
+    uint256 txidA = uint256S("a1");
+    uint256 txidB = uint256S("b2");
+    {
+        leveldb::DB* pdb;
+        leveldb::Options options;
+        options.create_if_missing = true;
+        BOOST_REQUIRE(leveldb::DB::Open(options, path.string(), &pdb).ok());
+        pdb->Put(leveldb::WriteOptions(), txidA.ToString(), "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH:3:1:101:1");
+        pdb->Put(leveldb::WriteOptions(), txidB.ToString(), "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe:1:3:102:1");
+        pdb->Put(leveldb::WriteOptions(), txidB.ToString() + "+" + txidA.ToString(),
+            "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe:1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH:1:3:10:20:102");
+        delete pdb;
+    }
+
+    std::unique_ptr<CMPTradeList> db(new CMPTradeList(path, false));
+    BOOST_CHECK_EQUAL(db->getMPTradeCountTotal(), 3);
+
+    std::vector<uint256> vecTrades;
+    db->getTradesForAddress("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", vecTrades);
+    BOOST_CHECK(vecTrades == std::vector<uint256>({txidA}));
+
+    BOOST_CHECK_EQUAL(db->deleteAboveBlock(102), 2);
+    BOOST_CHECK_EQUAL(db->getMPTradeCountTotal(), 1);
+
+    // Upgraded once only
+    db.reset(new CMPTradeList(path, false));
+    BOOST_CHECK_EQUAL(db->getMPTradeCountTotal(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(legacy_sto_receipts_are_upgraded)
+{
+    boost::filesystem::path path = pathTemp / "MP_stolist_legacy_test";
+    uint256 txidA = uint256S("a1");
+    uint256 txidB = uint256S("b2");
+    {
+        leveldb::DB* pdb;
+        leveldb::Options options;
+        options.create_if_missing = true;
+        BOOST_REQUIRE(leveldb::DB::Open(options, path.string(), &pdb).ok());
+        pdb->Put(leveldb::WriteOptions(), "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH",
+            txidA.ToString() + ":100:3:50," + txidB.ToString() + ":101:3:7");
+        pdb->Put(leveldb::WriteOptions(), "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe", txidA.ToString() + ":100:3:25");
+        delete pdb;
+    }
+
+    // The amounts are formatted by the divisibility of their property
+    CMPSPInfo* spsOld = _my_sps;
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_sto_test", true);
+
+    std::unique_ptr<CMPSTOList> db(new CMPSTOList(path, false));
+    BOOST_CHECK(db->exists("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH"));
+    BOOST_CHECK(db->exists("1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe"));
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0, numRecipients = 0;
+    db->getRecipients(txidA, "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2U);
+    BOOST_CHECK_EQUAL(total, 75U);
+    BOOST_REQUIRE_EQUAL(recipients.size(), 2U);
+    std::set<std::string> addresses;
+    for (size_t i = 0; i < recipients.size(); i++) {
+        addresses.insert(find_value(recipients[i].get_obj(), "address").get_str());
+    }
+    BOOST_CHECK(addresses == std::set<std::string>({"1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", "1JfhmcyW2Y3TbXaWNpGBGBTpXhtaCoYfHe"}));
+
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    db->getRecipients(txidB, "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 1U);
+    BOOST_CHECK_EQUAL(total, 7U);
+    BOOST_REQUIRE_EQUAL(recipients.size(), 1U);
+    BOOST_CHECK_EQUAL(find_value(recipients[0].get_obj(), "address").get_str(), "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH");
+
+    BOOST_CHECK_EQUAL(db->deleteAboveBlock(101), 1);
+
+    // Upgraded once only
+    db.reset(new CMPSTOList(path, false));
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    db->getRecipients(txidB, "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 0U);
+    db->getRecipients(txidA, "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2U);
+
+    db.reset();
+    delete _my_sps;
+    _my_sps = spsOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
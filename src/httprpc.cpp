@@ -20,6 +20,7 @@
 #include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** Sanitize UTF-8 encoded strings in RPC responses */
@@ -148,6 +149,17 @@ static bool RPCAuthorized(const std::string& strAuth)
     return multiUserAuthorized(strUserPass);
 }
 
+// Sink of a reply sent in chunks, its headers go out with the first one
+static bool WriteJSONRPCChunk(HTTPRequest* req, bool* pfStarted, const std::string& strChunk)
+{
+    if (!*pfStarted) {
+        req->WriteHeader("Content-Type", "application/json");
+        *pfStarted = true;
+    }
+    // Chunks end between JSON tokens, so they don't split multi-byte characters
+    return req->WriteReplyChunk(HTTP_OK, fSanitizeResponse ? SanitizeInvalidUTF8(strChunk) : strChunk);
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -184,14 +196,32 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
         std::string strReply;
+        bool fStarted = false;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+            // Large results are sent in chunks while they are produced, errors before that get the usual reply
+            CJSONStreamWriter writer(boost::bind(&WriteJSONRPCChunk, req, &fStarted, _1));
+            try {
+                writer.BeginObject();
+                writer.Key("result");
+                tableRPC.execute(jreq.strMethod, jreq.params, writer);
+                writer.KeyValue("error", NullUniValue);
+                writer.KeyValue("id", jreq.id);
+                writer.EndObject();
+                writer.WriteRaw("\n");
+            } catch (...) {
+                if (!writer.HasFlushed())
+                    throw;
+                // The client notices the truncated reply, it isn't valid JSON
+                LogPrintf("%s: %s failed while its result was sent\n", __func__, jreq.strMethod);
+                req->WriteReply(HTTP_OK);
+                return false;
+            }
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            strReply = writer.GetBuffer();
             if (fSanitizeResponse) {
                 strReply = SanitizeInvalidUTF8(strReply);
             }
@@ -202,7 +232,8 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-        req->WriteHeader("Content-Type", "application/json");
+        if (!fStarted)
+            req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
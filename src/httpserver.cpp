@@ -37,9 +37,14 @@
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
 #include <boost/foreach.hpp>
 
+#include <atomic>
+
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Maximum size of a chunked reply waiting for the client, the worker producing it blocks beyond that */
+static const uint64_t MAX_REPLY_BACKLOG = 1024 * 1024;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -183,6 +188,8 @@ static WorkQueue<HTTPClosure>* workQueue = 0;
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
+//! Workers producing chunked replies stop waiting for slow clients
+static std::atomic<bool> fRepliesInterrupted(false);
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -454,6 +461,7 @@ bool StartHTTPServer()
 void InterruptHTTPServer()
 {
     LogPrint("http", "Interrupting HTTP server\n");
+    fRepliesInterrupted = true;
     if (eventHTTP) {
         // Unlisten sockets
         BOOST_FOREACH (evhttp_bound_socket *socket, boundSockets) {
@@ -534,13 +542,98 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Chunked reply, shared by the worker producing it and the main http thread sending it.
+ * The worker counts the bytes it posted, the main thread those the client took.
+ */
+struct HTTPReplyStream
+{
+    struct evhttp_request* req;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    uint64_t nPosted;
+    uint64_t nSent;
+    bool fClosed;
+    //! Bytes handed to libevent, only used by the main thread
+    uint64_t nQueued;
+
+    HTTPReplyStream(struct evhttp_request* reqIn) : req(reqIn), nPosted(0), nSent(0), fClosed(false), nQueued(0) {}
+
+    void Start(int nStatus);
+    void Chunk(struct evbuffer* evb);
+    void End();
+    void SetSent(uint64_t nSentIn, bool fClosedIn);
+};
+
+static void http_reply_closed_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyStream* stream = (HTTPReplyStream*)arg;
+    stream->SetSent(stream->nQueued, true);
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010000
+// Called once the output buffer of the connection was written
+static void http_reply_sent_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyStream* stream = (HTTPReplyStream*)arg;
+    stream->SetSent(stream->nQueued, false);
+}
+#endif
+
+void HTTPReplyStream::SetSent(uint64_t nSentIn, bool fClosedIn)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nSent = nSentIn;
+        fClosed = fClosed || fClosedIn;
+    }
+    cond.notify_all();
+}
+
+void HTTPReplyStream::Start(int nStatus)
+{
+    // The client may have gone away while the reply was produced
+    struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (!evcon) {
+        SetSent(nQueued, true);
+        return;
+    }
+    evhttp_connection_set_closecb(evcon, http_reply_closed_cb, this);
+    evhttp_send_reply_start(req, nStatus, NULL);
+}
+
+void HTTPReplyStream::Chunk(struct evbuffer* evb)
+{
+    if (evhttp_request_get_connection(req)) {
+        nQueued += evbuffer_get_length(evb);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010000
+        evhttp_send_reply_chunk_with_cb(req, evb, http_reply_sent_cb, this);
+#else
+        evhttp_send_reply_chunk(req, evb);
+#endif
+    }
+    evbuffer_free(evb);
+}
+
+void HTTPReplyStream::End()
+{
+    struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_set_closecb(evcon, NULL, NULL);
+    // Frees the request if the connection is gone already
+    evhttp_send_reply_end(req);
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
                                                        replySent(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && stream) {
+        // End a chunked reply which was cut short, the client notices the incomplete body
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        WriteReply(HTTP_INTERNAL);
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -594,6 +687,21 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
+    if (stream) {
+        // Post the last part without waiting for the client, then end the chunked reply
+        if (!strReply.empty()) {
+            struct evbuffer* evb = evbuffer_new();
+            evbuffer_add(evb, strReply.data(), strReply.size());
+            HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(&HTTPReplyStream::Chunk, stream, evb));
+            ev->trigger(0);
+        }
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(&HTTPReplyStream::End, stream));
+        ev->trigger(0);
+        stream.reset();
+        replySent = true;
+        req = 0;
+        return;
+    }
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -605,6 +713,36 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+bool HTTPRequest::WriteReplyChunk(int nStatus, const std::string& strChunk)
+{
+    assert(!replySent && req);
+    if (!stream) {
+        stream.reset(new HTTPReplyStream(req));
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(&HTTPReplyStream::Start, stream, nStatus));
+        ev->trigger(0);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(stream->mutex);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010000
+        // Don't let a slow client pile up the reply in memory
+        while (!stream->fClosed && !fRepliesInterrupted && stream->nPosted - stream->nSent > MAX_REPLY_BACKLOG)
+            stream->cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+#endif
+        if (stream->fClosed || fRepliesInterrupted)
+            return false;
+        stream->nPosted += strChunk.size();
+    }
+
+    if (!strChunk.empty()) {
+        struct evbuffer* evb = evbuffer_new();
+        evbuffer_add(evb, strChunk.data(), strChunk.size());
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(&HTTPReplyStream::Chunk, stream, evb));
+        ev->trigger(0);
+    }
+    return true;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
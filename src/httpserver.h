@@ -5,6 +5,7 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <memory>
 #include <string>
 #include <stdint.h>
 #include <boost/thread.hpp>
@@ -19,6 +20,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -57,6 +59,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! Set once a chunked reply was started
+    std::shared_ptr<HTTPReplyStream> stream;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -110,8 +114,19 @@ public:
      *
      * @note Can be called only once. As this will give the request back to the
      * main thread, do not call any other HTTPRequest methods after calling this.
+     * If a chunked reply was started, strReply is its last part and nStatus is ignored.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write a part of a reply whose body is produced piece by piece. The first part
+     * sends the headers with nStatus and starts a chunked reply, WriteReply ends it.
+     * Blocks while too much of the reply waits for a slow client.
+     * Returns false once the client went away, the rest of the reply is dropped then.
+     *
+     * @note Write all headers before the first part.
+     */
+    bool WriteReplyChunk(int nStatus, const std::string& strChunk);
 };
 
 /** Event handler closure.
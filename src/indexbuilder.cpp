@@ -0,0 +1,299 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "main.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+CIndexBuilder indexBuilder;
+
+namespace {
+
+/** Transaction index, kept in the block tree database */
+class CTxIndexBuild : public CBuildableIndex
+{
+private:
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+
+public:
+    std::vector<std::string> GetNames() const
+    {
+        return std::vector<std::string>(1, "txindex");
+    }
+
+    uint256 GetBestBlock() const
+    {
+        return pblocktree->GetTxIndexBestBlock();
+    }
+
+    bool PrepareBlock(const CBlock &block, const CBlockIndex *pindex, bool fConnect)
+    {
+        vPos.clear();
+        // Block connection doesn't index the genesis block either
+        if (!fConnect || !pindex->pprev)
+            return true;
+        CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+        for (const CTransaction &tx : block.vtx) {
+            vPos.push_back(std::make_pair(tx.GetHash(), pos));
+            pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+        }
+        return true;
+    }
+
+    bool CommitBlock(const CBlockIndex *pindex, bool fConnect)
+    {
+        // Entries of disconnected blocks stay as in DisconnectBlock
+        if (!fConnect)
+            return pblocktree->WriteTxIndexBestBlock(pindex->pprev ? pindex->pprev->GetBlockHash() : uint256());
+        return pblocktree->WriteTxIndex(vPos, pindex->GetBlockHash());
+    }
+};
+
+/** Address, spent and timestamp indexes, kept in the index database */
+class CExplorerIndexBuild : public CBuildableIndex
+{
+private:
+    std::unique_ptr<CDbIndexHelper> helper;
+    CAmount nSupplyChange;
+
+public:
+    CExplorerIndexBuild() : nSupplyChange(0) {}
+
+    std::vector<std::string> GetNames() const
+    {
+        std::vector<std::string> vNames;
+        if (fAddressIndex)
+            vNames.push_back("addressindex");
+        if (fSpentIndex)
+            vNames.push_back("spentindex");
+        if (fTimestampIndex)
+            vNames.push_back("timestampindex");
+        return vNames;
+    }
+
+    uint256 GetBestBlock() const
+    {
+        return pindexdb->GetBestBlock();
+    }
+
+    bool PrepareBlock(const CBlock &block, const CBlockIndex *pindex, bool fConnect)
+    {
+        helper.reset(new CDbIndexHelper(fAddressIndex, fSpentIndex));
+        nSupplyChange = 0;
+        // Block connection doesn't index the genesis block either
+        if (!pindex->pprev)
+            return true;
+
+        CBlockUndo blockUndo;
+        CDiskBlockPos pos = pindex->GetUndoPos();
+        if (pos.IsNull() || !UndoReadFromDisk(blockUndo, pos, pindex->pprev->GetBlockHash()))
+            return error("%s: no undo data for block %s", __func__, pindex->GetBlockHash().ToString());
+        if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: block and undo data inconsistent", __func__);
+
+        // The outputs spent by the block are all the indexes need to know about the inputs
+        CCoinsView viewDummy;
+        CCoinsViewCache view(&viewDummy);
+        CAmount nFees = 0;
+        for (unsigned int i = 1; i < block.vtx.size(); i++) {
+            const CTransaction &tx = block.vtx[i];
+            if (!tx.IsZerocoinSpend() && !tx.IsSigmaSpend() && !tx.IsZerocoinRemint()) {
+                const CTxUndo &txundo = blockUndo.vtxundo[i - 1];
+                if (txundo.vprevout.size() != tx.vin.size())
+                    return error("%s: transaction and undo data inconsistent", __func__);
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint &out = tx.vin[j].prevout;
+                    CCoinsModifier coins = view.ModifyCoins(out.hash);
+                    if (coins->vout.size() <= out.n)
+                        coins->vout.resize(out.n + 1);
+                    coins->vout[out.n] = txundo.vprevout[j].txout;
+                }
+            }
+            nFees += GetBlockTransactionFee(tx, view);
+        }
+
+        if (fConnect) {
+            for (unsigned int i = 0; i < block.vtx.size(); i++)
+                helper->ConnectTransaction(block.vtx[i], pindex->nHeight, i, view);
+        } else {
+            // Same order as DisconnectBlock
+            for (int i = block.vtx.size() - 1; i >= 0; i--) {
+                helper->DisconnectTransactionOutputs(block.vtx[i], pindex->nHeight, i, view);
+                helper->DisconnectTransactionInputs(block.vtx[i], pindex->nHeight, i, view);
+            }
+        }
+        nSupplyChange = block.vtx[0].GetValueOut() - nFees;
+        return true;
+    }
+
+    bool CommitBlock(const CBlockIndex *pindex, bool fConnect)
+    {
+        return pindexdb->WriteBlock(pindex, fConnect, *helper, nSupplyChange, fTimestampIndex);
+    }
+};
+
+}
+
+CIndexBuilder::CIndexBuilder() : fTipChanged(false)
+{
+}
+
+bool CIndexBuilder::AddIndexes()
+{
+    if (fTxIndex)
+        vIndexes.push_back(std::unique_ptr<CBuildableIndex>(new CTxIndexBuild()));
+    if (fAddressIndex || fSpentIndex || fTimestampIndex)
+        vIndexes.push_back(std::unique_ptr<CBuildableIndex>(new CExplorerIndexBuild()));
+    vFailed.assign(vIndexes.size(), false);
+    return !vIndexes.empty();
+}
+
+void CIndexBuilder::Start(boost::thread_group &threadGroup)
+{
+    if (!AddIndexes())
+        return;
+
+    RegisterValidationInterface(this);
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "indexbuild",
+                                          boost::function<void()>(boost::bind(&CIndexBuilder::ThreadBuild, this))));
+}
+
+void CIndexBuilder::Stop()
+{
+    if (vIndexes.empty())
+        return;
+    UnregisterValidationInterface(this);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    vIndexes.clear();
+    vFailed.clear();
+}
+
+void CIndexBuilder::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fTipChanged = true;
+    }
+    cond.notify_all();
+}
+
+CIndexBuilder::StepResult CIndexBuilder::Step(size_t nIndex)
+{
+    CBuildableIndex &index = *vIndexes[nIndex];
+
+    // Find the next block to connect, or the block to disconnect if the index is on a stale fork
+    uint256 hashCursor;
+    const CBlockIndex *pindex = NULL;
+    bool fConnect = true;
+    {
+        LOCK(cs_main);
+        hashCursor = index.GetBestBlock();
+        if (hashCursor.IsNull()) {
+            pindex = chainActive.Genesis();
+        } else {
+            BlockMap::iterator it = mapBlockIndex.find(hashCursor);
+            if (it == mapBlockIndex.end()) {
+                LogPrintf("%s: best block %s of the index is unknown\n", __func__, hashCursor.ToString());
+                return STEP_FAILED;
+            }
+            if (chainActive.Contains(it->second)) {
+                pindex = chainActive.Next(it->second);
+            } else {
+                pindex = it->second;
+                fConnect = false;
+            }
+        }
+        if (pindex == NULL)
+            return STEP_SYNCED;
+    }
+
+    // The heavy lifting happens without cs_main
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+        LogPrintf("%s: failed to read block %s\n", __func__, pindex->GetBlockHash().ToString());
+        return STEP_FAILED;
+    }
+    if (!index.PrepareBlock(block, pindex, fConnect))
+        return STEP_FAILED;
+
+    LOCK(cs_main);
+    // Block connection may have moved the index meanwhile
+    if (index.GetBestBlock() != hashCursor)
+        return STEP_PROGRESS;
+    if (!index.CommitBlock(pindex, fConnect)) {
+        LogPrintf("%s: failed to write block %s\n", __func__, pindex->GetBlockHash().ToString());
+        return STEP_FAILED;
+    }
+    return STEP_PROGRESS;
+}
+
+void CIndexBuilder::ThreadBuild()
+{
+    int64_t nLastLog = GetTimeMillis();
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        bool fIdle = true;
+        for (size_t i = 0; i < vIndexes.size(); i++) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (vFailed[i])
+                    continue;
+            }
+            StepResult result = Step(i);
+            if (result == STEP_FAILED) {
+                LogPrintf("Building %s failed, it is not updated any more\n", boost::algorithm::join(vIndexes[i]->GetNames(), ", "));
+                boost::unique_lock<boost::mutex> lock(mutex);
+                vFailed[i] = true;
+            } else if (result == STEP_PROGRESS) {
+                fIdle = false;
+            }
+        }
+
+        if (!fIdle) {
+            if (GetTimeMillis() - nLastLog > 30000) {
+                for (const CIndexBuildProgress &progress : GetProgress())
+                    LogPrintf("Building %s: height %d\n", progress.strName, progress.nBestHeight);
+                nLastLog = GetTimeMillis();
+            }
+            continue;
+        }
+
+        // Everything is in sync, block connection takes over until the tip moves in a way it can't handle
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fTipChanged)
+            cond.wait(lock);
+        fTipChanged = false;
+    }
+}
+
+std::vector<CIndexBuildProgress> CIndexBuilder::GetProgress() const
+{
+    std::vector<CIndexBuildProgress> vProgress;
+    LOCK(cs_main);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (size_t i = 0; i < vIndexes.size(); i++) {
+        CIndexBuildProgress progress;
+        uint256 hashBest = vIndexes[i]->GetBestBlock();
+        BlockMap::iterator it = mapBlockIndex.find(hashBest);
+        progress.nBestHeight = it != mapBlockIndex.end() ? it->second->nHeight : -1;
+        progress.fSynced = hashBest == (chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256());
+        progress.fFailed = vFailed[i];
+        for (const std::string &strName : vIndexes[i]->GetNames()) {
+            progress.strName = strName;
+            vProgress.push_back(progress);
+        }
+    }
+    return vProgress;
+}
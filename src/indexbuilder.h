@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEXBUILDER_H
+#define BITCOIN_INDEXBUILDER_H
+
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CBlockIndex;
+
+namespace boost {
+class thread_group;
+}
+
+/** An optional index which can be built from the blocks and undo data of the active chain */
+class CBuildableIndex
+{
+public:
+    virtual ~CBuildableIndex() {}
+
+    //! Names of the indexes as in the command line options
+    virtual std::vector<std::string> GetNames() const = 0;
+
+    //! Block the index is in sync with, null if nothing was indexed yet (protected by cs_main)
+    virtual uint256 GetBestBlock() const = 0;
+
+    //! Compute the changes of connecting or disconnecting the block. Called without cs_main held
+    virtual bool PrepareBlock(const CBlock &block, const CBlockIndex *pindex, bool fConnect) = 0;
+
+    //! Write the prepared changes and move the best block to the block or its parent (protected by cs_main)
+    virtual bool CommitBlock(const CBlockIndex *pindex, bool fConnect) = 0;
+};
+
+struct CIndexBuildProgress
+{
+    std::string strName;
+    bool fSynced;
+    bool fFailed;
+    //! -1 if nothing was indexed yet
+    int nBestHeight;
+};
+
+/**
+ * Brings optional indexes that lag behind the active chain up to date in the background: after they were switched
+ * on, wiped, or left on a stale fork. Block connection keeps an index updated once it is in sync. The builder sleeps
+ * until the tip changes and checks the indexes again.
+ */
+class CIndexBuilder : public CValidationInterface
+{
+private:
+    std::vector<std::unique_ptr<CBuildableIndex> > vIndexes;
+    // set when an index failed, it is not touched again
+    std::vector<bool> vFailed;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fTipChanged;
+
+    void ThreadBuild();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindex);
+
+public:
+    enum StepResult {
+        STEP_SYNCED,
+        STEP_PROGRESS,
+        STEP_FAILED
+    };
+
+    CIndexBuilder();
+
+    /** Set up the enabled indexes (fTxIndex, fAddressIndex, ...), false if none is enabled */
+    bool AddIndexes();
+
+    /** Start building the enabled indexes. Does nothing if none is enabled */
+    void Start(boost::thread_group &threadGroup);
+
+    /** Connect or disconnect one block to bring the nIndex-th index closer to the active chain */
+    StepResult Step(size_t nIndex);
+
+    /** Forget the indexes, the builder thread must have been stopped */
+    void Stop();
+
+    std::vector<CIndexBuildProgress> GetProgress() const;
+};
+
+extern CIndexBuilder indexBuilder;
+
+#endif // BITCOIN_INDEXBUILDER_H
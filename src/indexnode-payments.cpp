@@ -8,9 +8,11 @@
 #include "indexnode-sync.h"
 #include "indexnodeman.h"
 #include "netfulfilledman.h"
+#include "sigverifyqueue.h"
 #include "spork.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 
 /** Object for who's going to get paid on which blocks */
@@ -289,7 +291,10 @@ void CIndexnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
         if (netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::INDEXNODEPAYMENTSYNC)) {
             // Asking for the payments list multiple times in a short period of time is no good
             LogPrintf("INDEXNODEPAYMENTSYNC -- peer already asked me for the list, peer=%d\n", pfrom->id);
-            if (!fTestNet) Misbehaving(pfrom->GetId(), 20);
+            if (!fTestNet) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 20);
+            }
             return;
         }
         netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::INDEXNODEPAYMENTSYNC);
@@ -349,42 +354,56 @@ void CIndexnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
             return;
         }
 
-        int nDos = 0;
-        if (!vote.CheckSignature(mnInfo.pubKeyIndexnode, pCurrentBlockIndex->nHeight, nDos)) {
-            if (nDos) {
-                LogPrintf("INDEXNODEPAYMENTVOTE -- ERROR: invalid signature\n");
-                if (!fTestNet) Misbehaving(pfrom->GetId(), nDos);
-            } else {
-                // only warn about anything non-critical (i.e. nDos == 0) in debug mode
-                LogPrint("mnpayments", "INDEXNODEPAYMENTVOTE -- WARNING: invalid signature\n");
-            }
-            // Either our info or vote info could be outdated.
-            // In case our info is outdated, ask for an update,
-            mnodeman.AskForMN(pfrom, vote.vinIndexnode);
-            // but there is nothing we can do if vote info itself is outdated
-            // (i.e. it was signed by a mn which changed its key),
-            // so just quit here.
+        if (sigVerifyQueue.IsRunning()) {
+            // votes arrive in bursts, their signatures are checked by the signature threads
+            sigVerifyQueue.Push(pfrom, nHash, mnInfo.pubKeyIndexnode, vote.vchSig, vote.GetSignatureMessage(),
+                                boost::bind(&CIndexnodePayments::ProcessPaymentVote, this, _1, vote, mnInfo.pubKeyIndexnode, pCurrentBlockIndex->nHeight, _2));
             return;
         }
 
-        CTxDestination address1;
-        ExtractDestination(vote.payee, address1);
-        CBitcoinAddress address2(address1);
-
-        LogPrint("mnpayments", "INDEXNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, pCurrentBlockIndex->nHeight, vote.vinIndexnode.prevout.ToStringShort());
+        ProcessPaymentVote(pfrom, vote, mnInfo.pubKeyIndexnode, pCurrentBlockIndex->nHeight, false);
+    }
+}
 
-        if (AddPaymentVote(vote)) {
-            vote.Relay();
-            indexnodeSync.AddedPaymentVote();
+void CIndexnodePayments::ProcessPaymentVote(CNode *pfrom, CIndexnodePaymentVote vote, const CPubKey &pubKeyIndexnode, int nValidationHeight, bool fSignatureChecked) {
+    // a signature found invalid by the signature threads is checked again for the error and the ban score,
+    // this only costs peers sending bad votes
+    int nDos = 0;
+    if (!fSignatureChecked && !vote.CheckSignature(pubKeyIndexnode, nValidationHeight, nDos)) {
+        if (nDos) {
+            LogPrintf("INDEXNODEPAYMENTVOTE -- ERROR: invalid signature\n");
+            if (Params().NetworkIDString() != CBaseChainParams::TESTNET) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), nDos);
+            }
+        } else {
+            // only warn about anything non-critical (i.e. nDos == 0) in debug mode
+            LogPrint("mnpayments", "INDEXNODEPAYMENTVOTE -- WARNING: invalid signature\n");
         }
+        // Either our info or vote info could be outdated.
+        // In case our info is outdated, ask for an update,
+        mnodeman.AskForMN(pfrom, vote.vinIndexnode);
+        // but there is nothing we can do if vote info itself is outdated
+        // (i.e. it was signed by a mn which changed its key),
+        // so just quit here.
+        return;
+    }
+
+    CTxDestination address1;
+    ExtractDestination(vote.payee, address1);
+    CBitcoinAddress address2(address1);
+
+    LogPrint("mnpayments", "INDEXNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, nValidationHeight, vote.vinIndexnode.prevout.ToStringShort());
+
+    if (AddPaymentVote(vote)) {
+        vote.Relay();
+        indexnodeSync.AddedPaymentVote();
     }
 }
 
 bool CIndexnodePaymentVote::Sign() {
     std::string strError;
-    std::string strMessage = vinIndexnode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     if (!darkSendSigner.SignMessage(strMessage, vchSig, activeIndexnode.keyIndexnode)) {
         LogPrintf("CIndexnodePaymentVote::Sign -- SignMessage() failed\n");
@@ -664,6 +683,7 @@ bool CIndexnodePaymentVote::IsValid(CNode *pnode, int nValidationHeight, std::st
         if (nRank > MNPAYMENTS_SIGNATURES_TOTAL * 2 && nBlockHeight > nValidationHeight) {
             strError = strprintf("Indexnode is not in the top %d (%d)", MNPAYMENTS_SIGNATURES_TOTAL * 2, nRank);
             LogPrintf("CIndexnodePaymentVote::IsValid -- Error: %s\n", strError);
+            LOCK(cs_main);
             Misbehaving(pnode->GetId(), 20);
         }
         // Still invalid however
@@ -746,13 +766,17 @@ void CIndexnodePaymentVote::Relay() {
     RelayInv(inv);
 }
 
+std::string CIndexnodePaymentVote::GetSignatureMessage() const {
+    return vinIndexnode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           ScriptToAsmStr(payee);
+}
+
 bool CIndexnodePaymentVote::CheckSignature(const CPubKey &pubKeyIndexnode, int nValidationHeight, int &nDos) {
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinIndexnode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     std::string strError = "";
     if (!darkSendSigner.VerifyMessage(pubKeyIndexnode, vchSig, strMessage, strError)) {
@@ -28,6 +28,7 @@ static const int MIN_INDEXNODE_PAYMENT_PROTO_VERSION_2 = PROTOCOL_VERSION;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapIndexnodeBlocks;
+extern CCriticalSection cs_mapIndexnodePaymentVotes;
 extern CCriticalSection cs_mapIndexnodePayeeVotes;
 
 extern CIndexnodePayments mnpayments;
@@ -149,6 +150,7 @@ public:
     }
 
     bool Sign();
+    std::string GetSignatureMessage() const;
     bool CheckSignature(const CPubKey& pubKeyIndexnode, int nValidationHeight, int &nDos);
 
     bool IsValid(CNode* pnode, int nValidationHeight, std::string& strError);
@@ -209,6 +211,8 @@ public:
 
     int GetMinIndexnodePaymentsProto();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Add a vote which passed the cheap checks, fSignatureChecked if its signature was found valid already
+    void ProcessPaymentVote(CNode* pfrom, CIndexnodePaymentVote vote, const CPubKey& pubKeyIndexnode, int nValidationHeight, bool fSignatureChecked);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutIndexnodeRet);
     std::string ToString() const;
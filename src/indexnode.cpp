@@ -829,9 +829,7 @@ bool CIndexnodeBroadcast::Sign(CKey &keyCollateralAddress) {
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyIndexnode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     if (!darkSendSigner.SignMessage(strMessage, vchSig, keyCollateralAddress)) {
         LogPrintf("CIndexnodeBroadcast::Sign -- SignMessage() failed\n");
@@ -846,14 +844,20 @@ bool CIndexnodeBroadcast::Sign(CKey &keyCollateralAddress) {
     return true;
 }
 
+std::string CIndexnodeBroadcast::GetSignatureMessage() const {
+    return addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
+           pubKeyCollateralAddress.GetID().ToString() + pubKeyIndexnode.GetID().ToString() +
+           boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
 bool CIndexnodeBroadcast::CheckSignature(int &nDos) {
     std::string strMessage;
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyIndexnode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    if (fSignatureChecked) return true;
+
+    strMessage = GetSignatureMessage();
 
     LogPrint("indexnode", "CIndexnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
@@ -887,7 +891,7 @@ bool CIndexnodePing::Sign(CKey &keyIndexnode, CPubKey &pubKeyIndexnode) {
     std::string strIndexNodeSignMessage;
 
     sigTime = GetAdjustedTime();
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!darkSendSigner.SignMessage(strMessage, vchSig, keyIndexnode)) {
         LogPrintf("CIndexnodePing::Sign -- SignMessage() failed\n");
@@ -902,8 +906,12 @@ bool CIndexnodePing::Sign(CKey &keyIndexnode, CPubKey &pubKeyIndexnode) {
     return true;
 }
 
+std::string CIndexnodePing::GetSignatureMessage() const {
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CIndexnodePing::CheckSignature(CPubKey &pubKeyIndexnode, int &nDos) {
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
     std::string strError = "";
     nDos = 0;
 
@@ -940,7 +948,7 @@ bool CIndexnodePing::SimpleCheck(int &nDos) {
     return true;
 }
 
-bool CIndexnodePing::CheckAndUpdate(CIndexnode *pmn, bool fFromNewBroadcast, int &nDos) {
+bool CIndexnodePing::CheckBeforeSignature(CIndexnode *pmn, bool fFromNewBroadcast, int &nDos) {
     // don't ban by default
     nDos = 0;
 
@@ -986,7 +994,13 @@ bool CIndexnodePing::CheckAndUpdate(CIndexnode *pmn, bool fFromNewBroadcast, int
         return false;
     }
 
-    if (!CheckSignature(pmn->pubKeyIndexnode, nDos)) return false;
+    return true;
+}
+
+bool CIndexnodePing::CheckAndUpdate(CIndexnode *pmn, bool fFromNewBroadcast, int &nDos, bool fSignatureChecked) {
+    if (!CheckBeforeSignature(pmn, fFromNewBroadcast, nDos)) return false;
+
+    if (!fSignatureChecked && !CheckSignature(pmn->pubKeyIndexnode, nDos)) return false;
 
     // so, ping seems to be ok
 
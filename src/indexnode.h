@@ -81,9 +81,13 @@ public:
     bool IsExpired() { return GetTime() - sigTime > INDEXNODE_NEW_START_REQUIRED_SECONDS; }
 
     bool Sign(CKey& keyIndexnode, CPubKey& pubKeyIndexnode);
+    std::string GetSignatureMessage() const;
     bool CheckSignature(CPubKey& pubKeyIndexnode, int &nDos);
     bool SimpleCheck(int& nDos);
-    bool CheckAndUpdate(CIndexnode* pmn, bool fFromNewBroadcast, int& nDos);
+    /// The checks of CheckAndUpdate which run before the signature is checked
+    bool CheckBeforeSignature(CIndexnode* pmn, bool fFromNewBroadcast, int& nDos);
+    /// fSignatureChecked skips the signature, when it was checked with pmn's key already
+    bool CheckAndUpdate(CIndexnode* pmn, bool fFromNewBroadcast, int& nDos, bool fSignatureChecked = false);
     void Relay();
 
     CIndexnodePing& operator=(CIndexnodePing from)
@@ -348,11 +352,13 @@ class CIndexnodeBroadcast : public CIndexnode
 public:
 
     bool fRecovery;
+    /// The signature was checked by the signature queue already, not serialized
+    bool fSignatureChecked;
 
-    CIndexnodeBroadcast() : CIndexnode(), fRecovery(false) {}
-    CIndexnodeBroadcast(const CIndexnode& mn) : CIndexnode(mn), fRecovery(false) {}
+    CIndexnodeBroadcast() : CIndexnode(), fRecovery(false), fSignatureChecked(false) {}
+    CIndexnodeBroadcast(const CIndexnode& mn) : CIndexnode(mn), fRecovery(false), fSignatureChecked(false) {}
     CIndexnodeBroadcast(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralAddressNew, CPubKey pubKeyIndexnodeNew, int nProtocolVersionIn) :
-        CIndexnode(addrNew, vinNew, pubKeyCollateralAddressNew, pubKeyIndexnodeNew, nProtocolVersionIn), fRecovery(false) {}
+        CIndexnode(addrNew, vinNew, pubKeyCollateralAddressNew, pubKeyIndexnodeNew, nProtocolVersionIn), fRecovery(false), fSignatureChecked(false) {}
 
     ADD_SERIALIZE_METHODS;
 
@@ -386,6 +392,7 @@ public:
     bool CheckOutpoint(int& nDos);
 
     bool Sign(CKey& keyCollateralAddress);
+    std::string GetSignatureMessage() const;
     bool CheckSignature(int& nDos);
     void RelayIndexNode();
 };
@@ -12,9 +12,12 @@
 #include "indexnodeconfig.h"
 #include "indexnodeman.h"
 #include "netfulfilledman.h"
+#include "sigverifyqueue.h"
 #include "util.h"
 #include "validationinterface.h"
 
+#include <boost/bind.hpp>
+
 /** Indexnode manager */
 CIndexnodeMan mnodeman;
 
@@ -545,6 +548,36 @@ indexnode_info_t CIndexnodeMan::GetIndexnodeInfo(const CPubKey& pubKeyIndexnode)
     return info;
 }
 
+bool CIndexnodeMan::GetSeenBroadcast(const uint256& hash, CIndexnodeBroadcast& mnb)
+{
+    LOCK(cs);
+    std::map<uint256, std::pair<int64_t, CIndexnodeBroadcast> >::iterator it = mapSeenIndexnodeBroadcast.find(hash);
+    if (it == mapSeenIndexnodeBroadcast.end())
+        return false;
+    mnb = it->second.second;
+    return true;
+}
+
+bool CIndexnodeMan::GetSeenPing(const uint256& hash, CIndexnodePing& mnp)
+{
+    LOCK(cs);
+    std::map<uint256, CIndexnodePing>::iterator it = mapSeenIndexnodePing.find(hash);
+    if (it == mapSeenIndexnodePing.end())
+        return false;
+    mnp = it->second;
+    return true;
+}
+
+bool CIndexnodeMan::GetSeenVerification(const uint256& hash, CIndexnodeVerification& mnv)
+{
+    LOCK(cs);
+    std::map<uint256, CIndexnodeVerification>::iterator it = mapSeenIndexnodeVerification.find(hash);
+    if (it == mapSeenIndexnodeVerification.end())
+        return false;
+    mnv = it->second;
+    return true;
+}
+
 bool CIndexnodeMan::Has(const CTxIn& vin)
 {
     LOCK(cs);
@@ -960,18 +993,23 @@ void CIndexnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         LogPrintf("MNANNOUNCE -- Indexnode announce, indexnode=%s\n", mnb.vin.prevout.ToStringShort());
 
-        int nDos = 0;
-
-        if (CheckMnbAndUpdateIndexnodeList(pfrom, mnb, nDos)) {
-            // use announced Indexnode as a peer
-            addrman.Add(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            Misbehaving(pfrom->GetId(), nDos);
+        if (sigVerifyQueue.IsRunning()) {
+            uint256 hash = mnb.GetHash();
+            bool fQueue;
+            {
+                // seen and malformed broadcasts don't need their signature checked, they are handled right away
+                LOCK2(cs_main, cs);
+                int nDos = 0;
+                fQueue = !mapSeenIndexnodeBroadcast.count(hash) && CIndexnodeBroadcast(mnb).SimpleCheck(nDos);
+            }
+            if (fQueue) {
+                sigVerifyQueue.Push(pfrom, hash, mnb.pubKeyCollateralAddress, mnb.vchSig, mnb.GetSignatureMessage(),
+                                    boost::bind(&CIndexnodeMan::ProcessBroadcast, this, _1, mnb, _2));
+                return;
+            }
         }
 
-        if(fIndexnodesAdded) {
-            NotifyIndexnodeUpdates();
-        }
+        ProcessBroadcast(pfrom, mnb, false);
     } else if (strCommand == NetMsgType::MNPING) { //Indexnode Ping
 
         CIndexnodePing mnp;
@@ -998,7 +1036,13 @@ void CIndexnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+        if(pmn && sigVerifyQueue.IsRunning()) {
+            if(mnp.CheckBeforeSignature(pmn, false, nDos)) {
+                sigVerifyQueue.Push(pfrom, nHash, pmn->pubKeyIndexnode, mnp.vchSig, mnp.GetSignatureMessage(),
+                                    boost::bind(&CIndexnodeMan::ProcessPing, this, _1, mnp, pmn->pubKeyIndexnode, _2));
+                return;
+            }
+        } else if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1023,27 +1067,36 @@ void CIndexnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         LogPrint("indexnode", "DSEG -- Indexnode list, indexnode=%s\n", vin.prevout.ToStringShort());
 
-        LOCK(cs);
-
         if(vin == CTxIn()) { //only should ask for this once
             //local network
             bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
 
             if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
-                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForIndexnodeList.find(pfrom->addr);
-                if (i != mAskedUsForIndexnodeList.end()){
-                    int64_t t = (*i).second;
-                    if (GetTime() < t) {
-                        Misbehaving(pfrom->GetId(), 34);
-                        LogPrintf("DSEG -- peer already asked me for the list, peer=%d\n", pfrom->id);
-                        return;
+                bool fAskedRecently = false;
+                {
+                    LOCK(cs);
+                    std::map<CNetAddr, int64_t>::iterator i = mAskedUsForIndexnodeList.find(pfrom->addr);
+                    if (i != mAskedUsForIndexnodeList.end()){
+                        int64_t t = (*i).second;
+                        fAskedRecently = GetTime() < t;
                     }
+                    if (!fAskedRecently) {
+                        int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
+                        mAskedUsForIndexnodeList[pfrom->addr] = askAgain;
+                    }
+                }
+                // cs_main is taken before cs, so not while cs is held
+                if (fAskedRecently) {
+                    LOCK(cs_main);
+                    Misbehaving(pfrom->GetId(), 34);
+                    LogPrintf("DSEG -- peer already asked me for the list, peer=%d\n", pfrom->id);
+                    return;
                 }
-                int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
-                mAskedUsForIndexnodeList[pfrom->addr] = askAgain;
             }
         } //else, asking for a specific node which is ok
 
+        LOCK(cs);
+
         int nInvCount = 0;
 
         BOOST_FOREACH(CIndexnode& mn, vIndexnodes) {
@@ -1097,6 +1150,48 @@ void CIndexnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
     }
 }
 
+void CIndexnodeMan::ProcessBroadcast(CNode* pfrom, CIndexnodeBroadcast mnb, bool fSignatureChecked)
+{
+    // a signature found invalid by the signature threads is checked again for the ban score
+    mnb.fSignatureChecked = fSignatureChecked;
+
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateIndexnodeList(pfrom, mnb, nDos)) {
+        // use announced Indexnode as a peer
+        addrman.Add(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+
+    if(fIndexnodesAdded) {
+        NotifyIndexnodeUpdates();
+    }
+}
+
+void CIndexnodeMan::ProcessPing(CNode* pfrom, CIndexnodePing mnp, const CPubKey& pubKeyIndexnode, bool fSignatureChecked)
+{
+    LOCK2(cs_main, cs);
+
+    CIndexnode* pmn = Find(mnp.vin);
+    if(pmn && pmn->IsNewStartRequired()) return;
+
+    // the indexnode may have announced another key while the signature was checked
+    if(pmn && pmn->pubKeyIndexnode != pubKeyIndexnode) fSignatureChecked = false;
+
+    int nDos = 0;
+    if(mnp.CheckAndUpdate(pmn, false, nDos, fSignatureChecked)) return;
+
+    if(nDos > 0) {
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != NULL) {
+        return;
+    }
+
+    AskForMN(pfrom, mnp.vin);
+}
+
 // Verification of indexnodes via unique direct requests.
 
 void CIndexnodeMan::DoFullVerificationStep()
@@ -307,6 +307,9 @@ public:
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Handle a broadcast or a ping once its signature was checked, fSignatureChecked if it was found valid
+    void ProcessBroadcast(CNode* pfrom, CIndexnodeBroadcast mnb, bool fSignatureChecked);
+    void ProcessPing(CNode* pfrom, CIndexnodePing mnp, const CPubKey& pubKeyIndexnode, bool fSignatureChecked);
 
     void DoFullVerificationStep();
     void CheckSameAddr();
@@ -326,6 +329,14 @@ public:
     bool CheckMnbAndUpdateIndexnodeList(CNode* pfrom, CIndexnodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    /// Seen objects for inventory requests, locked since the message workers update them
+    bool HasSeenBroadcast(const uint256& hash) { LOCK(cs); return mapSeenIndexnodeBroadcast.count(hash) && !mMnbRecoveryRequests.count(hash); }
+    bool HasSeenPing(const uint256& hash) { LOCK(cs); return mapSeenIndexnodePing.count(hash); }
+    bool HasSeenVerification(const uint256& hash) { LOCK(cs); return mapSeenIndexnodeVerification.count(hash); }
+    bool GetSeenBroadcast(const uint256& hash, CIndexnodeBroadcast& mnb);
+    bool GetSeenPing(const uint256& hash, CIndexnodePing& mnp);
+    bool GetSeenVerification(const uint256& hash, CIndexnodeVerification& mnv);
+
     void UpdateLastPaid();
 
     void CheckAndRebuildIndexnodeIndex();
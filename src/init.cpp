@@ -11,6 +11,7 @@
 #include "init.h"
 
 #include "addrman.h"
+#include "blockstore.h"
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -19,10 +20,12 @@
 #include "consensus/validation.h"
 #include "fs.h"
 #include "httpserver.h"
+#include "indexbuilder.h"
 #include "httprpc.h"
 #include "key.h"
 #include "main.h"
 #include "zerocoin.h"
+#include "sigma.h"
 #include "miner.h"
 #include "net.h"
 #include "policy/policy.h"
@@ -44,6 +47,7 @@
 #ifdef ENABLE_CLIENTAPI
 #include "zmqserver/zmqabstract.h"
 #include "zmqserver/zmqinterface.h"
+#include "zmqserver/zmqreplier.h"
 #include "client-api/server.h"
 #include "client-api/register.h"
 #include "client-api/settings.h"
@@ -94,6 +98,7 @@ static CZMQReplierInterface* pzmqReplierInterface = NULL;
 #include "netfulfilledman.h"
 #include "flat-database.h"
 #include "instantx.h"
+#include "sigverifyqueue.h"
 #include "spork.h"
 
 
@@ -252,6 +257,8 @@ void PrepareShutdown(){
 #endif
     GenerateBitcoins(false, 0, Params());
     StopNode();
+    ClearWorkerMessages();
+    sigVerifyQueue.Clear();
 
     CFlatDB<CIndexnodeMan> flatdb1("incache.dat", "magicIndexnodeCache");
     flatdb1.Dump(mnodeman);
@@ -273,6 +280,8 @@ void PrepareShutdown(){
         fFeeEstimatesInitialized = false;
     }
 
+    indexBuilder.Stop();
+
     {
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
@@ -280,12 +289,19 @@ void PrepareShutdown(){
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsFlusher;
+        pcoinsFlusher = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
+        delete pindexdb;
+        pindexdb = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete pzerocoinhintdb;
+        pzerocoinhintdb = NULL;
+        blockFileStore.CloseAll();
     }
 
 #ifdef ENABLE_ELYSIUM
@@ -344,6 +360,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopLogWriter();
 }
 
 /**
@@ -412,12 +429,16 @@ std::string HelpMessage(HelpMessageMode mode) {
 #endif
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
+    strUsage += HelpMessageOpt("-blockfilehandles=<n>", strprintf(_("Number of block and undo files kept open for reading (default: %u)"), DEFAULT_BLOCK_FILE_HANDLES));
     strUsage += HelpMessageOpt("-dbcache=<n>",
                                strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache,
                                          nMaxDbCache, nDefaultDbCache));
-    if (showDebug)
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the chain state cache to disk in the background while blocks keep being connected (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes when flushing the chain state in the background (default: %u)", nDefaultDbBatchSize));
         strUsage += HelpMessageOpt("-feefilter", strprintf(
                 "Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
+    }
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>",
                                strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"),
@@ -486,6 +507,12 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(
             _("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"),
             DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgworkers=<n>", strprintf(
+            _("Set the number of threads handling address, ping and indexnode messages (0 to %d, 0 = handle them with all other messages, default: %d)"),
+            MAX_MESSAGE_WORKERS, DEFAULT_MESSAGE_WORKERS));
+    strUsage += HelpMessageOpt("-sigverifythreads=<n>", strprintf(
+            _("Set the number of threads checking the signatures of indexnode payment votes, pings and announcements (0 to %d, 0 = check them while handling the messages, default: %d)"),
+            MAX_SIGVERIFY_THREADS, DEFAULT_SIGVERIFY_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(
             _("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
@@ -511,6 +538,9 @@ std::string HelpMessage(HelpMessageMode mode) {
             _("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"),
             DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>",
+                               strprintf(_("Socket events mode, which must be one of: %s (default: %s)"),
+                                         GetSupportedSocketEventsModes(), GetSocketEventsModeName(DEFAULT_SOCKETEVENTS)));
     strUsage += HelpMessageOpt("-timeout=<n>",
                                strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"),
                                          DEFAULT_CONNECT_TIMEOUT));
@@ -565,6 +595,8 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-checkpoints",
                                    strprintf("Disable expensive verification for known chain history (default: %u)",
                                              DEFAULT_CHECKPOINTS_ENABLED));
+        strUsage += HelpMessageOpt("-zcassumevalid=<hex>",
+                                   "Skip zerocoin spend proof verification for this block and its ancestors (default: none)");
         strUsage += HelpMessageOpt("-disablesafemode",
                                    strprintf("Disable safemode, override a real safe mode event (default: %u)",
                                              DEFAULT_DISABLE_SAFEMODE));
@@ -608,10 +640,24 @@ std::string HelpMessage(HelpMessageMode mode) {
                                strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"),
                                                            DEFAULT_LOGTIMESTAMPS));
+    strUsage += HelpMessageOpt("-lograte=<n>",
+                               strprintf(_("Log at most <n> messages per second of each debug category, 0 = unlimited (default: %u)"),
+                                         DEFAULT_LOGRATE));
     if (showDebug) {
         strUsage += HelpMessageOpt("-logtimemicros",
                                    strprintf("Add microsecond precision to debug timestamps (default: %u)",
                                              DEFAULT_LOGTIMEMICROS));
+        strUsage += HelpMessageOpt("-logqueue=<n>",
+                                   strprintf("Number of messages waiting to be written to debug.log before logging threads are held up (default: %u, maximum: %u)",
+                                             DEFAULT_LOGQUEUE, MAX_LOGQUEUE));
+        strUsage += HelpMessageOpt("-logdropdebug",
+                                   strprintf("Drop debug category messages rather than wait while the log queue is full (default: %u)",
+                                             DEFAULT_LOGDROPDEBUG));
+#ifdef DEBUG_LOCKSTATS
+        strUsage += HelpMessageOpt("-lockstatsinterval=<n>",
+                                   strprintf("Log the locks waited for longest every <n> seconds, 0 = never (default: %u)",
+                                             DEFAULT_LOCKSTATS_INTERVAL));
+#endif
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(
                 "Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)",
@@ -622,6 +668,9 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>",
                                    strprintf("Limit size of signature cache to <n> MiB (default: %u)",
                                              DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigmaspendcachesize=<n>",
+                                   strprintf("Limit size of verified sigma spend cache to <n> MiB (default: %u)",
+                                             DEFAULT_MAX_SIGMA_SPEND_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf(
                 "Maximum tip age in seconds to consider node in initial block download (default: %u)",
                 DEFAULT_MAX_TIP_AGE));
@@ -691,6 +740,14 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-rpcthreads=<n>",
                                strprintf(_("Set the number of threads to service RPC calls (default: %d)"),
                                          DEFAULT_HTTP_THREADS));
+#ifdef ENABLE_CLIENTAPI
+    strUsage += HelpMessageOpt("-apiworkers=<n>",
+                               strprintf(_("Set the number of threads to service client API requests of each API port (default: %d)"),
+                                         DEFAULT_API_WORKERS));
+    strUsage += HelpMessageOpt("-apipubvalidationstats",
+                               strprintf(_("Publish the validation stage timings on the client API after every block (default: %u)"),
+                                         DEFAULT_API_PUB_VALIDATION_STATS));
+#endif
     strUsage += HelpMessageOpt("-blockspamfilter=<n>", strprintf(_("Use block spam filter (default: %u)"), DEFAULT_BLOCK_SPAM_FILTER));
     strUsage += HelpMessageOpt("-blockspamfiltermaxsize=<n>", strprintf(_("Maximum size of the list of indexes in the block spam filter (default: %u)"), DEFAULT_BLOCK_SPAM_FILTER_MAX_SIZE));
     strUsage += HelpMessageOpt("-blockspamfiltermaxavg=<n>", strprintf(_("Maximum average size of an index occurrence in the block spam filter (default: %u)"), DEFAULT_BLOCK_SPAM_FILTER_MAX_AVG));
@@ -1144,6 +1201,11 @@ void InitLogging() {
     fLogTimestamps = GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogTimeMicros = GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    // both are unsigned int, larger values would wrap around
+    nLogQueueSize = std::min(std::max((int64_t)1, GetArg("-logqueue", DEFAULT_LOGQUEUE)), (int64_t)MAX_LOGQUEUE);
+    fLogDropDebug = GetBoolArg("-logdropdebug", DEFAULT_LOGDROPDEBUG);
+    nLogRateLimit = std::min(std::max((int64_t)0, GetArg("-lograte", DEFAULT_LOGRATE)),
+                             (int64_t)std::numeric_limits<unsigned int>::max());
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("Index version %s\n", FormatFullVersion());
@@ -1232,12 +1294,31 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
+    // Block and undo files kept open for reading need descriptors as well
+    int nBlockFileHandles = std::max((int)GetArg("-blockfilehandles", DEFAULT_BLOCK_FILE_HANDLES), 0);
+    int nCoreFileDescriptors = MIN_CORE_FILEDESCRIPTORS + nBlockFileHandles;
+    blockFileStore.SetMaxOpenFiles(nBlockFileHandles);
+
+    std::string strSocketEvents = GetArg("-socketevents", GetSocketEventsModeName(DEFAULT_SOCKETEVENTS));
+    if (!ParseSocketEventsMode(strSocketEvents, nSocketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"),
+                                   strSocketEvents, GetSupportedSocketEventsModes()));
+    // Fall back to select here already, so the connection count is trimmed to what it can wait for
+    if (nSocketEventsMode != SOCKETEVENTS_SELECT) {
+        boost::scoped_ptr<CSocketEvents> probe(CreateSocketEvents(nSocketEventsMode));
+        if (!probe) {
+            InitWarning(strprintf(_("Socket events mode %s is not available, falling back to select."), strSocketEvents));
+            nSocketEventsMode = SOCKETEVENTS_SELECT;
+        }
+    }
+
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
-    int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
-    if (nFD < MIN_CORE_FILEDESCRIPTORS)
+    if (nSocketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - nCoreFileDescriptors)), 0);
+    int nFD = RaiseFileDescriptorLimit(nMaxConnections + nCoreFileDescriptors);
+    if (nFD < nCoreFileDescriptors)
         return InitError(_("Not enough file descriptors available."));
-    nMaxConnections = std::min(nFD - MIN_CORE_FILEDESCRIPTORS, nMaxConnections);
+    nMaxConnections = std::min(nFD - nCoreFileDescriptors, nMaxConnections);
 
     if (nMaxConnections < nUserMaxConnections)
         InitWarning(strprintf(_("Reducing -maxconnections from %d to %d, because of system limitations."),
@@ -1282,6 +1363,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    if (mapArgs.count("-zcassumevalid"))
+        hashZerocoinAssumeValid = uint256S(GetArg("-zcassumevalid", ""));
 
     // mempool AC_CONFIG_SUBDIRSlimits
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
@@ -1298,6 +1381,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nMessageWorkers = std::max(0, std::min((int)GetArg("-msgworkers", DEFAULT_MESSAGE_WORKERS), MAX_MESSAGE_WORKERS));
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1449,8 +1534,10 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
 
-    if (fPrintToDebugLog)
+    if (fPrintToDebugLog) {
         OpenDebugLog();
+        StartLogWriter();
+    }
 
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
@@ -1465,6 +1552,14 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
+
+    LogPrintf("Using %u threads for indexnode and peer messages\n", nMessageWorkers);
+    for (int i = 0; i < nMessageWorkers; i++)
+        threadGroup.create_thread(&ThreadMessageWorker);
+
+    int nSigVerifyThreads = std::max(0, std::min((int)GetArg("-sigverifythreads", DEFAULT_SIGVERIFY_THREADS), MAX_SIGVERIFY_THREADS));
+    LogPrintf("Using %u threads for indexnode message signatures\n", nSigVerifyThreads);
+    sigVerifyQueue.Start(nSigVerifyThreads, threadGroup);
 	    if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1475,6 +1570,12 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+#ifdef DEBUG_LOCKSTATS
+    int64_t nLockStatsInterval = GetArg("-lockstatsinterval", DEFAULT_LOCKSTATS_INTERVAL);
+    if (nLockStatsInterval > 0)
+        scheduler.scheduleEvery(boost::bind(&LogLockStats, LOCKSTATS_LOG_TOP), nLockStatsInterval);
+#endif
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1763,6 +1864,12 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", false))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    // The explorer indexes get a share of their own only when enabled
+    int64_t nIndexDBCache = 1 << 20;
+    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
+        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+        nIndexDBCache = std::min(nTotalCache / 4, nMaxIndexDBCache << 20);
+    nTotalCache -= nIndexDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2,
                                     (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
@@ -1771,6 +1878,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     nCoinCacheUsage = nTotalCache / 300;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for address, spent and timestamp index database\n", nIndexDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
@@ -1787,11 +1895,17 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                 LogPrintf("UnloadBlockIndex() \n");
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsFlusher;
+                pcoinsFlusher = NULL;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
+                delete pindexdb;
                 delete pblocktree;
+                delete pzerocoinhintdb;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                // Never wiped, the hints are what makes replaying legacy zerocoin spends on reindex fast
+                pzerocoinhintdb = new CZerocoinSpendHintDB(1 << 20);
 
                 if (!fReindex) {
                     // Check existing block index database version, reindex if needed
@@ -1803,9 +1917,20 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                     }
                 }
 
+                pindexdb = new CIndexDB(nIndexDBCache, false, fReindex || fReindexChainState);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                if (GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH)) {
+                    pcoinsFlusher = new CCoinsViewBackgroundFlush(pcoinscatcher, pcoinsdbview,
+                                                                  std::max<int64_t>(GetArg("-dbbatchsize", nDefaultDbBatchSize), 1));
+                    pcoinsTip = new CCoinsViewCache(pcoinsFlusher);
+                } else {
+                    pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                }
                 LogPrintf("fReindex = %s\n", fReindex);
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1848,12 +1973,6 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                     break;
                 }
 
-                // Check for changed -txindex state
-                if (fTxIndex != GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -txindex");
-                    break;
-                }
-
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1862,6 +1981,44 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                     break;
                 }
 
+                // Address, spent and timestamp indexes used to be kept in the block index database
+                if (!fReindex && !pindexdb->MigrateFrom(*pblocktree, pcoinsTip->GetBestBlock())) {
+                    strLoadError = _("Error upgrading index database");
+                    break;
+                }
+
+                // Optional indexes switched on are built in the background by the index builder
+                {
+                    LOCK(cs_main);
+                    bool fTxIndexCursor = false;
+                    if (fTxIndex && !pblocktree->ReadFlag("txindexcursor", fTxIndexCursor)) {
+                        // Older versions kept the transaction index in sync with the chain state
+                        pblocktree->WriteTxIndexBestBlock(pcoinsTip->GetBestBlock());
+                    }
+                    if (fTxIndex != GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+                        LogPrintf("Transaction index switched %s\n", fTxIndex ? "off" : "on");
+                        fTxIndex = !fTxIndex;
+                        pblocktree->WriteTxIndexBestBlock(uint256());
+                    }
+                    pblocktree->WriteFlag("txindex", fTxIndex);
+                    pblocktree->WriteFlag("txindexcursor", true);
+
+                    if (fAddressIndex != GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
+                        fSpentIndex != GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
+                        fTimestampIndex != GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
+                        // The address, spent and timestamp indexes share one database and are rebuilt together
+                        LogPrintf("Address, spent or timestamp index switched on or off, rebuilding them\n");
+                        fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+                        fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+                        fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+                        delete pindexdb;
+                        pindexdb = new CIndexDB(nIndexDBCache, false, true);
+                        pblocktree->WriteFlag("addressindex", fAddressIndex);
+                        pblocktree->WriteFlag("spentindex", fSpentIndex);
+                        pblocktree->WriteFlag("timestampindex", fTimestampIndex);
+                    }
+                }
+
                 if (!fReindex && chainActive.Tip() != NULL) {
                     uiInterface.InitMessage(_("Rewinding blocks..."));
                     if (!RewindBlockIndex(chainparams)) {
@@ -2057,6 +2214,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 
     threadGroup.add_thread(new boost::thread(threadAttr, boost::bind(&ThreadImport, vImportFiles)));
 
+    // Build the optional indexes that are behind the chain, e.g. after they were switched on
+    indexBuilder.Start(threadGroup);
+
     // Wait for genesis block to be processed
     {
         boost::unique_lock<boost::mutex> lock(cs_GenesisWait);
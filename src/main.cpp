@@ -16,6 +16,7 @@
 #include "addrman.h"
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockstore.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -48,6 +49,7 @@
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
 #include "validationinterface.h"
+#include "validationstats.h"
 #include "versionbits.h"
 #include "definition.h"
 #include "utiltime.h"
@@ -750,7 +752,10 @@ CBlockIndex *FindForkInGlobalIndex(const CChain &chain, const CBlockLocator &loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewBackgroundFlush *pcoinsFlusher = NULL;
 CBlockTreeDB *pblocktree = NULL;
+CIndexDB *pindexdb = NULL;
+CZerocoinSpendHintDB *pzerocoinhintdb = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1118,6 +1123,14 @@ int64_t GetTransactionSigOpCost(const CTransaction &tx, const CCoinsViewCache &i
     return nSigOps;
 }
 
+CAmount GetBlockTransactionFee(const CTransaction &tx, const CCoinsViewCache &inputs) {
+    if (tx.IsCoinBase() || tx.IsCoinStake() || tx.IsZerocoinSpend() || tx.IsZerocoinRemint())
+        return 0;
+    if (tx.IsSigmaSpend())
+        return sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
+    return inputs.GetValueIn(tx) - tx.GetValueOut();
+}
+
 
 bool CheckTransaction(
         const CTransaction &tx,
@@ -1253,7 +1266,7 @@ bool AcceptToMemoryPoolWorker(
         bool isCheckWalletTransaction,
         bool markZcoinSpendTransactionSerial) {
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
-    LogPrintf("AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n",
+    LogPrint("mempool", "AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n",
               fCheckInputs, tx.IsZerocoinSpend() || tx.IsSigmaSpend(), fTestNet);
     uint256 hash = tx.GetHash();
     AssertLockHeld(cs_main);
@@ -1867,7 +1880,7 @@ bool AcceptToMemoryPoolWorker(
 #endif
     SyncWithWallets(tx, NULL, NULL);
 
-    LogPrintf("AcceptToMemoryPoolWorker -> OK\n");
+    LogPrint("mempool", "AcceptToMemoryPoolWorker -> OK\n");
 
     return true;
 }
@@ -1924,13 +1937,13 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+            CBlockFileReader file(OpenBlockFileReader(postx));
             if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
+                return error("%s: OpenBlockFileReader failed", __func__);
             CBlockHeader header;
             try {
                 file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                file.ignore(postx.nTxOffset);
                 file >> txOut;
             } catch (const std::exception &e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
@@ -1976,7 +1989,7 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
+    if (!pindexdb->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
 
     return true;
@@ -1991,7 +2004,7 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!pindexdb->ReadSpentIndex(key, value))
         return false;
 
     return true;
@@ -2003,7 +2016,7 @@ bool GetAddressIndex(uint160 addressHash, AddressType type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pindexdb->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
@@ -2015,7 +2028,7 @@ bool GetAddressUnspent(uint160 addressHash, AddressType type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pindexdb->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
@@ -2051,9 +2064,9 @@ bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, con
     block.SetNull();
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    CBlockFileReader filein(OpenBlockFileReader(pos));
     if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        return error("ReadBlockFromDisk: OpenBlockFileReader failed for %s", pos.ToString());
 
     // Read block
     try {
@@ -2086,10 +2099,141 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus
     return true;
 }
 
+// Hashes the transactions of a raw block, starting after its header, without deserializing them. Witness data is
+// left out of the hashes like CTransaction::GetHash() does. False if the transactions can't be parsed or don't
+// take up the rest of the block
+static bool RawBlockTransactionHashes(const std::vector<unsigned char> &block, size_t nHeaderSize, std::vector<uint256> &vHashes) {
+    vHashes.clear();
+    try {
+        CDataStream ssBlock((const char *)block.data() + nHeaderSize, (const char *)block.data() + block.size(), SER_DISK, CLIENT_VERSION);
+        auto position = [&]() { return block.size() - ssBlock.size(); };
+        auto skipBytes = [&]() { ssBlock.ignore(ReadCompactSize(ssBlock)); };
+
+        uint64_t nTx = ReadCompactSize(ssBlock);
+        while (nTx-- > 0) {
+            size_t nStart = position();
+            ssBlock.ignore(4);
+
+            // The same layout decisions as SerializeTransaction()
+            size_t nBodyStart = position();
+            unsigned char flags = 0;
+            uint64_t nIn = ReadCompactSize(ssBlock);
+            if (nIn == 0) {
+                ssBlock >> flags;
+                if (flags != 1)
+                    return false;
+                nBodyStart = position();
+                nIn = ReadCompactSize(ssBlock);
+            }
+            for (uint64_t i = 0; i < nIn; i++) {
+                ssBlock.ignore(36);
+                skipBytes();
+                ssBlock.ignore(4);
+            }
+            uint64_t nOut = ReadCompactSize(ssBlock);
+            for (uint64_t i = 0; i < nOut; i++) {
+                ssBlock.ignore(8);
+                skipBytes();
+            }
+            size_t nBodyEnd = position();
+            if (flags) {
+                for (uint64_t i = 0; i < nIn; i++) {
+                    uint64_t nStack = ReadCompactSize(ssBlock);
+                    for (uint64_t j = 0; j < nStack; j++)
+                        skipBytes();
+                }
+            }
+            size_t nLockTime = position();
+            ssBlock.ignore(4);
+
+            CHashWriter hasher(SER_GETHASH, 0);
+            if (flags) {
+                hasher.write((const char *)block.data() + nStart, 4);
+                hasher.write((const char *)block.data() + nBodyStart, nBodyEnd - nBodyStart);
+                hasher.write((const char *)block.data() + nLockTime, 4);
+            } else {
+                hasher.write((const char *)block.data() + nStart, position() - nStart);
+            }
+            vHashes.push_back(hasher.GetHash());
+        }
+        return ssBlock.empty();
+    }
+    catch (const std::exception &) {
+        return false;
+    }
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char> &block, const CBlockIndex *pindex, const CMessageHeader::MessageStartChars &messageStart) {
+    // Block is preceded by the message start and its size
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    pos.nPos -= MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    CBlockFileReader filein(OpenBlockFileReader(pos));
+    if (filein.IsNull())
+        return error("%s: OpenBlockFileReader failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockStart) >> nSize;
+
+        if (memcmp(blockStart, messageStart, MESSAGE_START_SIZE) != 0)
+            return error("%s: block magic doesn't match at %s", __func__, pos.ToString());
+        if (nSize > MAX_SIZE)
+            return error("%s: block size %u is too large at %s", __func__, nSize, pos.ToString());
+
+        block.resize(nSize);
+        filein.read((char *)block.data(), nSize);
+    }
+    catch (const std::exception &e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    // Instead of hashing the header compare it to what the index has, the index entry is keyed by its hash
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    if (block.size() < ssHeader.size() || memcmp(block.data(), &ssHeader[0], ssHeader.size()) != 0)
+        return error("%s: header doesn't match index for %s at %s", __func__,
+                     pindex->ToString(), pindex->GetBlockPos().ToString());
+
+    // The header alone doesn't cover a corrupted or truncated body
+    std::vector<uint256> vHashes;
+    bool fMutated = false;
+    if (!RawBlockTransactionHashes(block, ssHeader.size(), vHashes) ||
+            ComputeMerkleRoot(vHashes, &fMutated) != pindex->hashMerkleRoot || fMutated)
+        return error("%s: transactions don't match the merkle root of %s at %s", __func__,
+                     pindex->ToString(), pindex->GetBlockPos().ToString());
+
+    return true;
+}
+
+bool RawBlockHasWitness(const std::vector<unsigned char> &block) {
+    // A block with witness data must carry the witness commitment nonce in its coinbase, so it's enough to check
+    // if the coinbase uses the extended format: its version is followed by the empty vin marker
+    try {
+        CDataStream ssBlock((const char *)block.data(), (const char *)block.data() + block.size(), SER_DISK, CLIENT_VERSION);
+        CBlockHeader header;
+        header.SerializationOp(ssBlock, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
+        uint64_t nTx = ReadCompactSize(ssBlock);
+        if (nTx == 0)
+            return false;
+        int32_t nTxVersion;
+        unsigned char nMarker;
+        ssBlock >> nTxVersion >> nMarker;
+        return nMarker == 0;
+    }
+    catch (const std::exception &) {
+        // Malformed, let the caller fall back to the deserialized block
+        return true;
+    }
+}
+
 bool ReadBlockHeaderFromDisk(CBlock &block, const CDiskBlockPos &pos) {
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    CBlockFileReader filein(OpenBlockFileReader(pos));
     if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        return error("ReadBlockFromDisk: OpenBlockFileReader failed for %s", pos.ToString());
 
     try {
         block.SerializationOp(filein, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
@@ -2568,32 +2712,6 @@ namespace {
         return true;
     }
 
-    bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
-        // Open history file to read
-        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-            return error("%s: OpenUndoFile failed", __func__);
-
-        // Read block
-        uint256 hashChecksum;
-        try {
-            filein >> blockundo;
-            filein >> hashChecksum;
-        }
-        catch (const std::exception &e) {
-            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-        }
-
-        // Verify checksum
-        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-        hasher << hashBlock;
-        hasher << blockundo;
-        if (hashChecksum != hasher.GetHash())
-            return error("%s: Checksum mismatch", __func__);
-
-        return true;
-    }
-
 /** Abort with a message */
     /*bool AbortNode(const std::string &strMessage, const std::string &userMessage = "") {
         strMiscWarning = strMessage;
@@ -2613,6 +2731,32 @@ namespace {
 
 } // anon namespace
 
+bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
+    // Open history file to read
+    CBlockFileReader filein(OpenUndoFileReader(pos));
+    if (filein.IsNull())
+        return error("%s: OpenUndoFileReader failed", __func__);
+
+    // Read block
+    uint256 hashChecksum;
+    try {
+        filein >> blockundo;
+        filein >> hashChecksum;
+    }
+    catch (const std::exception &e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << hashBlock;
+    hasher << blockundo;
+    if (hashChecksum != hasher.GetHash())
+        return error("%s: Checksum mismatch", __func__);
+
+    return true;
+}
+
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -2707,11 +2851,9 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
                 if (!ApplyTxInUndo(undo, view, out))
                     fClean = false;
             }
-            nFees += view.GetValueIn(tx) - tx.GetValueOut();
         }
 
-        if(tx.IsSigmaSpend())
-            nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
+        nFees += GetBlockTransactionFee(tx, view);
 
         dbIndexHelper.DisconnectTransactionInputs(tx, pindex->nHeight, i, view);
     }
@@ -2721,20 +2863,19 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
 
     //The pfClean flag is specified only when called from CVerifyDB::VerifyDB.
     //When called from there, no real disconnect happens.
-    if(!pfClean) {
-        if (fAddressIndex) {
-            if (!pblocktree->EraseAddressIndex(dbIndexHelper.getAddressIndex())) {
-                AbortNode(state, "Failed to delete address index");
-                return error("Failed to delete address index");
-            }
-            if (!pblocktree->UpdateAddressUnspentIndex(dbIndexHelper.getAddressUnspentIndex())) {
-                AbortNode(state, "Failed to write address unspent index");
-                return error("Failed to write address unspent index");
-            }
-            if (!pblocktree->AddTotalSupply(-(block.vtx[0].GetValueOut() - nFees))) {
-                AbortNode(state, "Failed to write total supply");
-                return error("Failed to write total supply");
-            }
+    //Indexes not in sync with the block are rolled back by the index builder instead.
+    if (!pfClean && (fAddressIndex || fSpentIndex || fTimestampIndex) &&
+        pindexdb->GetBestBlock() == pindex->GetBlockHash()) {
+        if (!pindexdb->WriteBlock(pindex, false, dbIndexHelper, block.vtx[0].GetValueOut() - nFees, fTimestampIndex)) {
+            AbortNode(state, "Failed to delete address index");
+            return error("Failed to delete address index");
+        }
+    }
+    //Transaction index entries of disconnected blocks stay, only the best block moves back.
+    if (!pfClean && fTxIndex && pblocktree->GetTxIndexBestBlock() == pindex->GetBlockHash()) {
+        if (!pblocktree->WriteTxIndexBestBlock(pindex->pprev->GetBlockHash())) {
+            AbortNode(state, "Failed to write transaction index");
+            return error("Failed to write transaction index");
         }
     }
 
@@ -2822,6 +2963,15 @@ public:
 // Protected by cs_main
 static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
 
+/** Stage the checks of a sigma or zerocoin transaction are timed under, VALIDATION_STAGE_COUNT for other transactions */
+static ValidationStage GetPrivacyValidationStage(const CTransaction &tx) {
+    if (tx.IsSigmaSpend() || tx.IsSigmaMint())
+        return VALIDATION_SIGMA;
+    if (tx.IsZerocoinSpend() || tx.IsZerocoinMint() || tx.IsZerocoinRemint())
+        return VALIDATION_ZEROCOIN;
+    return VALIDATION_STAGE_COUNT;
+}
+
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
 static int64_t nTimeVerify = 0;
@@ -2854,11 +3004,15 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
             view.SetBestBlock(pindex->GetBlockHash());
         return true;
     }
+
+    // A block which is only checked isn't connected, its times aren't recorded
+    const uint256 hashTimed = fJustCheck ? uint256() : pindex->GetBlockHash();
 		    // Set proof-of-stake hash modifier
     pindex->nStakeModifier = ComputeStakeModifier(pindex->pprev, block.IsProofOfStake() ? block.vtx[1].vin[0].prevout.hash : block.GetHash());
 
     // Check proof-of-stake
     if (block.IsProofOfStake()) {
+         CValidationTimer timerStake(VALIDATION_STAKE, hashTimed);
          const COutPoint &prevout = block.vtx[1].vin[0].prevout;
          const CCoins *coins = view.AccessCoins(prevout.hash);
           if (!coins)
@@ -2970,6 +3124,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    int64_t nTimeScripts = 0;
 
     std::vector <uint256> vOrphanErase;
     std::vector<int> prevheights;
@@ -2991,6 +3146,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
 
     block.zerocoinTxInfo = std::make_shared<CZerocoinTxInfo>();
+    block.zerocoinTxInfo->fSpendsAssumedValid = IsZerocoinSpendAssumedValid(pindex);
     block.sigmaTxInfo = std::make_shared<sigma::CSigmaTxInfo>();
 
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
@@ -3035,10 +3191,8 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
         }
 
         if (tx.IsZerocoinSpend() || tx.IsZerocoinMint() || tx.IsSigmaSpend() || tx.IsSigmaMint() || tx.IsZerocoinRemint()) {
-            if( tx.IsSigmaSpend())
-                nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
-
             // Check transaction against zerocoin state
+            CValidationTimer timerPrivacy(GetPrivacyValidationStage(tx), hashTimed);
             if (!CheckTransaction(tx, state, txHash, false, pindex->nHeight, false, true, block.zerocoinTxInfo.get(), block.sigmaTxInfo.get()))
                 return state.DoS(100, error("stateful zerocoin check failed"),
                                  REJECT_INVALID, "bad-txns-zerocoin");
@@ -3057,19 +3211,20 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
                              REJECT_INVALID, "bad-blk-sigops");
 
         txdata.emplace_back(tx);
+        nFees += GetBlockTransactionFee(tx, view);
         if (!tx.IsCoinBase() && !tx.IsZerocoinSpend() && !tx.IsSigmaSpend() && !tx.IsZerocoinRemint()) {
 	        if (tx.IsCoinStake())
                 nActualStakeReward = tx.GetValueOut() - view.GetValueIn(tx);
-            else
-                nFees += view.GetValueIn(tx) - tx.GetValueOut();
             
             std::vector <CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
+            int64_t nScriptStart = GetTimeMicros();
             if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, txdata[i],
                              nScriptCheckThreads ? &vChecks : NULL))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                              tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
+            nTimeScripts += GetTimeMicros() - nScriptStart;
         }
 
         CTxUndo undoDummy;
@@ -3115,6 +3270,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     // to recognize that block is actually invalid.
     // TODO: resync data (both ways?) and try to reprocess this block later.
     std::string strError = "";
+    CValidationTimer timerIndexnode(VALIDATION_INDEXNODE, hashTimed);
     if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
         return state.DoS(0, error("ConnectBlock(): %s", strError), REJECT_INVALID, "bad-cb-amount");
     }
@@ -3125,23 +3281,35 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
         return state.DoS(0, error("ConnectBlock(): couldn't find indexnode or superblock payments"),
                          REJECT_INVALID, "bad-cb-payee");
     }
+    timerIndexnode.Stop();
     // END INDEXNODE
 
-    if (!control.Wait())
-        return state.DoS(100, false);
+    int64_t nWaitStart = GetTimeMicros();
+    bool fScriptsValid = control.Wait();
     int64_t nTime4 = GetTimeMicros();
+    validationStats.Add(VALIDATION_SCRIPTS, hashTimed, nTimeScripts + nTime4 - nWaitStart);
+    if (!fScriptsValid)
+        return state.DoS(100, false);
     nTimeVerify += nTime4 - nTime2;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2),
              nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs - 1), nTimeVerify * 0.000001);
 
-
-    if (!ConnectBlockZC(state, chainparams, pindex, &block, fJustCheck) ||
-        !sigma::ConnectBlockSigma(state, chainparams, pindex, &block, fJustCheck))
-        return false;
+    {
+        CValidationTimer timer(VALIDATION_ZEROCOIN, hashTimed);
+        if (!ConnectBlockZC(state, chainparams, pindex, &block, fJustCheck))
+            return false;
+    }
+    {
+        CValidationTimer timer(VALIDATION_SIGMA, hashTimed);
+        if (!sigma::ConnectBlockSigma(state, chainparams, pindex, &block, fJustCheck))
+            return false;
+    }
 
     if (fJustCheck)
         return true;
 
+    CValidationTimer timerIndex(VALIDATION_INDEX, hashTimed);
+
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         if (pindex->GetUndoPos().IsNull()) {
@@ -3160,31 +3328,17 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
+    // While an optional index lags behind the chain the index builder writes it
+    if (fTxIndex && pblocktree->GetTxIndexBestBlock() == pindex->pprev->GetBlockHash())
+        if (!pblocktree->WriteTxIndex(vPos, pindex->GetBlockHash()))
             return AbortNode(state, "Failed to write transaction index");
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(dbIndexHelper.getAddressIndex()))
-            return AbortNode(state, "Failed to write address index");
-
-        if (!pblocktree->UpdateAddressUnspentIndex(dbIndexHelper.getAddressUnspentIndex()))
-            return AbortNode(state, "Failed to write address unspent index");
-
-        if (!pblocktree->AddTotalSupply(block.vtx[0].GetValueOut() - nFees))
-            return AbortNode(state, "Failed to write total supply");
-    }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(dbIndexHelper.getSpentIndex()))
-            return AbortNode(state, "Failed to write transaction index");
-
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
+    if ((fAddressIndex || fSpentIndex || fTimestampIndex) && pindexdb->GetBestBlock() == pindex->pprev->GetBlockHash())
+        if (!pindexdb->WriteBlock(pindex, true, dbIndexHelper, block.vtx[0].GetValueOut() - nFees, fTimestampIndex))
+            return AbortNode(state, "Failed to write address, spent or timestamp index");
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
+    timerIndex.Stop();
 
     int64_t nTime5 = GetTimeMicros();
     nTimeIndex += nTime5 - nTime4;
@@ -3314,6 +3468,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
             nLastSetChain = nNow;
         }
         size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // Entries still being written in the background take memory too
+        if (pcoinsFlusher)
+            cacheSize += pcoinsFlusher->DynamicMemoryUsage();
         // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0 / 9) > nCoinCacheUsage;
         // The cache is over the limit, we have to write now.
@@ -3352,9 +3509,12 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
                     return AbortNode(state, "Files to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files. A background chainstate write may still need the blocks for replay
+            if (fFlushForPrune) {
+                if (pcoinsFlusher && !pcoinsFlusher->Sync())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -3366,8 +3526,23 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Flush the chainstate (which may refer to block index entries). It can be written in several batches
+            // only if the new best block descends from the one in the database, otherwise an interrupted write
+            // couldn't be completed by replaying blocks on startup.
+            bool fFlushed;
+            if (pcoinsFlusher) {
+                bool fBatched = false;
+                if (!fFlushForPrune) {
+                    BlockMap::iterator itDB = mapBlockIndex.find(pcoinsFlusher->GetBestBlock());
+                    BlockMap::iterator itTip = mapBlockIndex.find(pcoinsTip->GetBestBlock());
+                    fBatched = itDB != mapBlockIndex.end() && itTip != mapBlockIndex.end() &&
+                               itTip->second->GetAncestor(itDB->second->nHeight) == itDB->second;
+                }
+                fFlushed = pcoinsFlusher->Flush(*pcoinsTip, fBatched, fBatched && mode != FLUSH_STATE_ALWAYS);
+            } else {
+                fFlushed = pcoinsTip->Flush();
+            }
+            if (!fFlushed)
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
@@ -3613,6 +3788,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
     nTimeReadFromDisk += nTime2 - nTime1;
+    validationStats.Add(VALIDATION_READ, pindexNew->GetBlockHash(), nTime2 - nTime1);
     int64_t nTime3;
 //    LogPrintf("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
@@ -3640,6 +3816,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
         return false;
     int64_t nTime5 = GetTimeMicros();
     nTimeChainState += nTime5 - nTime4;
+    validationStats.Add(VALIDATION_FLUSH, pindexNew->GetBlockHash(), nTime5 - nTime3);
     LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001,
              nTimeChainState * 0.000001);
 
@@ -3654,6 +3831,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     //! Elysium: begin block connect notification
     if (fElysium) {
         LogPrint("handler", "Elysium handler: block connect begin [height: %d]\n", GetHeight());
+        CValidationTimer timer(VALIDATION_ELYSIUM, pindexNew->GetBlockHash());
         elysium_handler_block_begin(GetHeight(), pindexNew);
     }
 #endif
@@ -3684,6 +3862,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
         //! Elysium: new confirmed transaction notification
         if (fElysium) {
             LogPrint("handler", "Elysium handler: new confirmed transaction [height: %d, idx: %u]\n", GetHeight(), nTxIdx);
+            CValidationTimer timer(VALIDATION_ELYSIUM, pindexNew->GetBlockHash());
             if (elysium_handler_tx(tx, GetHeight(), nTxIdx++, pindexNew)) ++nNumMetaTxs;
         }
 #endif
@@ -3709,6 +3888,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     //! Elysium: end of block connect notification
     if (fElysium) {
         LogPrint("handler", "Elysium handler: block connect end [new height: %d, found: %u txs]\n", GetHeight(), nNumMetaTxs);
+        CValidationTimer timer(VALIDATION_ELYSIUM, pindexNew->GetBlockHash());
         elysium_handler_block_end(GetHeight(), pindexNew, nNumMetaTxs);
     }
 #endif
@@ -3719,6 +3899,8 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001,
              nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+    validationStats.Add(VALIDATION_CONNECT, pindexNew->GetBlockHash(), nTime6 - nTime1);
+    validationStats.BlockConnected(pindexNew);
     return true;
 }
 
@@ -4496,12 +4678,17 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         if (block.fChecked)
             return true;
 
+        // Times are recorded for blocks on their way to be connected, not for templates, proposals or VerifyDB
+        const uint256 hashTimed = fCheckPOW && !isVerifyDB ? block.GetHash() : uint256();
+
         // Check that the header is valid (particularly PoW).  This is mostly
         // redundant with the call in AcceptBlockHeader.
+        CValidationTimer timerHeader(VALIDATION_HEADER, hashTimed);
         if (!CheckBlockHeader(block, state, consensusParams, block.IsProofOfWork() && fCheckPOW)) {
             LogPrintf("CheckBlock - CheckBlockHeader -> failed!\n");
             return false;
         }
+        timerHeader.Stop();
 
         // Check the merkle root.
         if (fCheckMerkleRoot) {
@@ -4560,9 +4747,10 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         }
 
         // // Check proof-of-stake block signature
-        if (nHeight > Params().GetConsensus().nFirstPOSBlock)
+        if (nHeight > Params().GetConsensus().nFirstPOSBlock && fCheckSig)
         {
-            if (fCheckSig && !CheckBlockSignature(block))
+            CValidationTimer timer(VALIDATION_STAKE, hashTimed);
+            if (!CheckBlockSignature(block))
                 return state.DoS(100, false, REJECT_INVALID, "bad-block-signature", false, "bad proof-of-stake block signature");
         }
 
@@ -4605,6 +4793,8 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         }
 
         BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            // Sigma proofs and zerocoin spends are verified here, the rest of the checks are cheap
+            CValidationTimer timer(GetPrivacyValidationStage(tx), hashTimed);
             // We don't check transactions against zerocoin state here, we'll check it again later in ConnectBlock
             if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, false, NULL, NULL)) {
                 LogPrintf("block=%s\n", block.ToString());
@@ -4626,6 +4816,7 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         if (fCheckPOW && fCheckMerkleRoot)
             block.fChecked = true;
 
+        CValidationTimer timerSigma(VALIDATION_SIGMA, hashTimed);
         if (!sigma::CheckSigmaBlock(state, block)) {
             return false;
         }
@@ -5235,6 +5426,8 @@ void PruneOneBlockFile(const int fileNumber) {
 void UnlinkPrunedFiles(std::set<int> &setFilesToPrune) {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileStore.Close(CBlockFileStore::BLOCK_FILE, *it);
+        blockFileStore.Close(CBlockFileStore::UNDO_FILE, *it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5351,6 +5544,51 @@ CBlockIndex *InsertBlockIndex(uint256 hash) {
     return pindexNew;
 }
 
+/**
+ * Complete a chainstate write interrupted between its batches. The coin database then holds the outputs of some
+ * blocks between the old and the new best block, replaying the blocks in between brings all of it to the new one.
+ */
+bool ReplayBlocks(const CChainParams &chainparams, CCoinsViewCache *view) {
+    std::vector<uint256> vhashHeads = view->GetHeadBlocks();
+    if (vhashHeads.empty())
+        return true;
+    if (vhashHeads.size() != 2)
+        return error("%s: unknown inconsistent state", __func__);
+
+    BlockMap::iterator itNew = mapBlockIndex.find(vhashHeads[0]);
+    BlockMap::iterator itOld = mapBlockIndex.find(vhashHeads[1]);
+    if (itNew == mapBlockIndex.end() || itOld == mapBlockIndex.end())
+        return error("%s: coin database head blocks are not in the block index", __func__);
+    CBlockIndex *pindexNew = itNew->second;
+    CBlockIndex *pindexOld = itOld->second;
+    if (pindexNew->GetAncestor(pindexOld->nHeight) != pindexOld)
+        return error("%s: coin database head blocks are not on one chain", __func__);
+
+    LogPrintf("Replaying blocks %d to %d to complete an interrupted chainstate write\n",
+              pindexOld->nHeight + 1, pindexNew->nHeight);
+    uiInterface.ShowProgress(_("Replaying blocks..."), 0);
+    for (int nHeight = pindexOld->nHeight + 1; nHeight <= pindexNew->nHeight; nHeight++) {
+        CBlockIndex *pindex = pindexNew->GetAncestor(nHeight);
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+        // Some of the changes may already be in the database, spending an output twice or re-adding one is harmless
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            if (!tx.IsCoinBase() && !tx.IsZerocoinSpend() && !tx.IsSigmaSpend() && !tx.IsZerocoinRemint()) {
+                BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+                    view->ModifyCoins(txin.prevout.hash)->Spend(txin.prevout.n);
+                }
+            }
+            view->ModifyCoins(tx.GetHash())->FromTx(tx, nHeight);
+        }
+        uiInterface.ShowProgress(_("Replaying blocks..."),
+                                 (int)((nHeight - pindexOld->nHeight) * 100 / (pindexNew->nHeight - pindexOld->nHeight)));
+    }
+    view->SetBestBlock(pindexNew->GetBlockHash());
+    uiInterface.ShowProgress("", 100);
+    return view->Flush();
+}
+
 bool static LoadBlockIndexDB() {
     LogPrintf("LoadBlockIndexDB\n");
     const CChainParams &chainparams = Params();
@@ -5463,6 +5701,10 @@ bool static LoadBlockIndexDB() {
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
 
+    // Finish the chainstate write interrupted by a crash or shutdown, if any
+    if (!ReplayBlocks(chainparams, pcoinsTip))
+        return false;
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end()) {
@@ -6227,28 +6469,36 @@ bool static AlreadyHave(const CInv &inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
             return instantsend.AlreadyHave(inv.hash);
 
         case MSG_SPORK:
+        {
+            LOCK(cs_mapSporks);
             return mapSporks.count(inv.hash);
+        }
 
+        // The indexnode maps are updated by the message workers
         case MSG_INDEXNODE_PAYMENT_VOTE:
+        {
+            LOCK(cs_mapIndexnodePaymentVotes);
             return mnpayments.mapIndexnodePaymentVotes.count(inv.hash);
+        }
 
         case MSG_INDEXNODE_PAYMENT_BLOCK:
         {
             BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+            LOCK(cs_mapIndexnodeBlocks);
             return mi != mapBlockIndex.end() && mnpayments.mapIndexnodeBlocks.find(mi->second->nHeight) != mnpayments.mapIndexnodeBlocks.end();
         }
 
         case MSG_INDEXNODE_ANNOUNCE:
-            return mnodeman.mapSeenIndexnodeBroadcast.count(inv.hash) && !mnodeman.IsMnbRecoveryRequested(inv.hash);
+            return mnodeman.HasSeenBroadcast(inv.hash);
 
         case MSG_INDEXNODE_PING:
-            return mnodeman.mapSeenIndexnodePing.count(inv.hash);
+            return mnodeman.HasSeenPing(inv.hash);
 
         case MSG_DSTX:
             return mapDarksendBroadcastTxes.count(inv.hash);
 
         case MSG_INDEXNODE_VERIFY:
-            return mnodeman.mapSeenIndexnodeVerification.count(inv.hash);
+            return mnodeman.HasSeenVerification(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -6312,53 +6562,66 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
-                    else if (inv.type == MSG_WITNESS_BLOCK)
-                        pfrom->PushMessage(NetMsgType::BLOCK, block);
-                    else if (inv.type == MSG_FILTERED_BLOCK) {
-                        bool send = false;
-                        CMerkleBlock merkleBlock;
-                        {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                send = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                    // Plain blocks are sent as they are stored on disk: no need to deserialize them, check the hash
+                    // and serialize them again. Witness data is stripped only by the deserializing path below
+                    std::vector<unsigned char> vRawBlock;
+                    bool fSentRaw = false;
+                    if ((inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK) &&
+                            ReadRawBlockFromDisk(vRawBlock, mi->second, Params().MessageStart()) &&
+                            (inv.type == MSG_WITNESS_BLOCK || !RawBlockHasWitness(vRawBlock))) {
+                        pfrom->PushMessage(NetMsgType::BLOCK, CFlatData(vRawBlock));
+                        fSentRaw = true;
+                    }
+
+                    if (!fSentRaw) {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_BLOCK)
+                            pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
+                        else if (inv.type == MSG_WITNESS_BLOCK)
+                            pfrom->PushMessage(NetMsgType::BLOCK, block);
+                        else if (inv.type == MSG_FILTERED_BLOCK) {
+                            bool send = false;
+                            CMerkleBlock merkleBlock;
+                            {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter) {
+                                    send = true;
+                                    merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                }
                             }
+                            if (send) {
+                                pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                // This avoids hurting performance by pointlessly requiring a round-trip
+                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                // they must either disconnect and retry or request the full block.
+                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                // however we MUST always provide at least what the remote peer needs
+                                typedef std::pair<unsigned int, uint256> PairType;
+                                BOOST_FOREACH(PairType & pair, merkleBlock.vMatchedTxn)
+                                    pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX,
+                                            block.vtx[pair.first]);
+                            }
+                            // else
+                            // no response
+                        } else if (inv.type == MSG_CMPCT_BLOCK) {
+                            // If a peer is asking for old blocks, we're almost guaranteed
+                            // they wont have a useful mempool to match against a compact block,
+                            // and we don't feel like constructing the object for them, so
+                            // instead we respond with the full, non-compact block.
+                            bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+                            if (CanDirectFetch(consensusParams) &&
+                                    mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                                CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
+                                pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
+                                        NetMsgType::CMPCTBLOCK, cmpctblock);
+                            } else
+                                pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
+                                        NetMsgType::BLOCK, block);
                         }
-                        if (send) {
-                            pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH(PairType & pair, merkleBlock.vMatchedTxn)
-                                pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX,
-                                        block.vtx[pair.first]);
-                        }
-                        // else
-                        // no response
-                    } else if (inv.type == MSG_CMPCT_BLOCK) {
-                        // If a peer is asking for old blocks, we're almost guaranteed
-                        // they wont have a useful mempool to match against a compact block,
-                        // and we don't feel like constructing the object for them, so
-                        // instead we respond with the full, non-compact block.
-                        bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
-                        if (CanDirectFetch(consensusParams) &&
-                                mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
-                            pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
-                                    NetMsgType::CMPCTBLOCK, cmpctblock);
-                        } else
-                            pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
-                                    NetMsgType::BLOCK, block);
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -6480,6 +6743,7 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_SPORK) {
+                    LOCK(cs_mapSporks);
                     if(mapSporks.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -6490,6 +6754,7 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_INDEXNODE_PAYMENT_VOTE) {
+                    LOCK(cs_mapIndexnodePaymentVotes);
                     if(mnpayments.HasVerifiedPaymentVote(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -6501,7 +6766,7 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
 
                 if (!pushed && inv.type == MSG_INDEXNODE_PAYMENT_BLOCK) {
                     BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                    LOCK(cs_mapIndexnodeBlocks);
+                    LOCK2(cs_mapIndexnodeBlocks, cs_mapIndexnodePaymentVotes);
                     if (mi != mapBlockIndex.end() && mnpayments.mapIndexnodeBlocks.count(mi->second->nHeight)) {
                         BOOST_FOREACH(CIndexnodePayee& payee, mnpayments.mapIndexnodeBlocks[mi->second->nHeight].vecPayees) {
                             std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
@@ -6519,20 +6784,22 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_INDEXNODE_ANNOUNCE) {
-                    if(mnodeman.mapSeenIndexnodeBroadcast.count(inv.hash)){
+                    CIndexnodeBroadcast mnb;
+                    if(mnodeman.GetSeenBroadcast(inv.hash, mnb)){
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenIndexnodeBroadcast[inv.hash].second;
+                        ss << mnb;
                         pfrom->PushMessage(NetMsgType::MNANNOUNCE, ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_INDEXNODE_PING) {
-                    if(mnodeman.mapSeenIndexnodePing.count(inv.hash)) {
+                    CIndexnodePing mnp;
+                    if(mnodeman.GetSeenPing(inv.hash, mnp)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenIndexnodePing[inv.hash];
+                        ss << mnp;
                         pfrom->PushMessage(NetMsgType::MNPING, ss);
                         pushed = true;
                     }
@@ -6549,10 +6816,11 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_INDEXNODE_VERIFY) {
-                    if(mnodeman.mapSeenIndexnodeVerification.count(inv.hash)) {
+                    CIndexnodeVerification mnv;
+                    if(mnodeman.GetSeenVerification(inv.hash, mnv)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenIndexnodeVerification[inv.hash];
+                        ss << mnv;
                         pfrom->PushMessage(NetMsgType::MNVERIFY, ss);
                         pushed = true;
                     }
@@ -6617,11 +6885,6 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
         }
     }
 
-    {
-        LOCK(cs_main);
-        CNode::CheckDandelionEmbargoes();
-    }
-
     if (strCommand == NetMsgType::VERSION) {
         // Feeler connections exist only to verify if address is online.
         if (pfrom->fFeeler) {
@@ -7904,7 +8167,9 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
     } else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlock block;
+        int64_t nTimeDeserialize = GetTimeMicros();
         vRecv >> block;
+        validationStats.Add(VALIDATION_DESERIALIZE, block.GetHash(), GetTimeMicros() - nTimeDeserialize);
         LogPrint("net", "received block %s peer=%d\n", block.GetHash().ToString(), pfrom->id);
         CValidationState state;
         // Process all blocks from whitelisted peers, even if not requested,
@@ -7943,8 +8208,9 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
         vector <CAddress> vAddr = addrman.GetAddr();
+        LOCK(pfrom->cs_vAddrToSend);
+        pfrom->vAddrToSend.clear();
         BOOST_FOREACH(
         const CAddress &addr, vAddr)
         pfrom->PushAddress(addr);
@@ -8138,6 +8404,170 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
     return true;
 }
 
+namespace {
+
+/**
+ * Messages of the subsystems which don't touch chain state are handed to the message worker threads, so that a slow
+ * peer or an indexnode list sync doesn't hold up block relay in the message handler thread. Every subsystem is a lane
+ * whose messages are handled one at a time, in the order they were received, while the lanes run in parallel. The
+ * subsystems take their own locks, cs_main only where they need chain state.
+ */
+enum MessageLane {
+    LANE_PEER = 0, // addresses and pings
+    LANE_INDEXNODE,
+    LANE_INDEXNODE_PAYMENTS,
+    LANE_COUNT
+};
+
+boost::mutex csWorkerMessages;
+boost::condition_variable condWorkerMessages;
+std::deque<std::unique_ptr<CWorkerMessage> > vWorkerMessages[LANE_COUNT];
+// a worker is handling a message of the lane
+bool fLaneBusy[LANE_COUNT] = {};
+
+// Requires csWorkerMessages
+std::unique_ptr<CWorkerMessage> PopWorkerMessageLocked(int &nLane)
+{
+    for (nLane = 0; nLane < LANE_COUNT; nLane++) {
+        if (!fLaneBusy[nLane] && !vWorkerMessages[nLane].empty()) {
+            std::unique_ptr<CWorkerMessage> msg(std::move(vWorkerMessages[nLane].front()));
+            vWorkerMessages[nLane].pop_front();
+            fLaneBusy[nLane] = true;
+            return msg;
+        }
+    }
+    return std::unique_ptr<CWorkerMessage>();
+}
+
+}
+
+int GetMessageLane(const std::string &strCommand)
+{
+    if (strCommand == NetMsgType::ADDR || strCommand == NetMsgType::GETADDR ||
+        strCommand == NetMsgType::PING || strCommand == NetMsgType::PONG)
+        return LANE_PEER;
+    if (strCommand == NetMsgType::MNANNOUNCE || strCommand == NetMsgType::MNPING ||
+        strCommand == NetMsgType::DSEG || strCommand == NetMsgType::MNVERIFY ||
+        strCommand == NetMsgType::SYNCSTATUSCOUNT)
+        return LANE_INDEXNODE;
+    if (strCommand == NetMsgType::INDEXNODEPAYMENTVOTE || strCommand == NetMsgType::INDEXNODEPAYMENTSYNC)
+        return LANE_INDEXNODE_PAYMENTS;
+    return -1;
+}
+
+void QueueWorkerMessage(CNode *pfrom, int nLane, const std::string &strCommand, const CDataStream &vRecv,
+                        int64_t nTimeReceived, unsigned int nMessageSize) {
+    assert(nLane >= 0 && nLane < LANE_COUNT);
+    pfrom->AddRef();
+    pfrom->fWorkerMessage = true;
+    {
+        boost::unique_lock<boost::mutex> lock(csWorkerMessages);
+        vWorkerMessages[nLane].push_back(std::unique_ptr<CWorkerMessage>(
+                new CWorkerMessage(pfrom, strCommand, vRecv, nTimeReceived, nMessageSize)));
+    }
+    condWorkerMessages.notify_one();
+}
+
+std::unique_ptr<CWorkerMessage> PopWorkerMessage(int &nLane) {
+    boost::unique_lock<boost::mutex> lock(csWorkerMessages);
+    return PopWorkerMessageLocked(nLane);
+}
+
+void FinishWorkerMessage(std::unique_ptr<CWorkerMessage> msg, int nLane) {
+    {
+        boost::unique_lock<boost::mutex> lock(csWorkerMessages);
+        fLaneBusy[nLane] = false;
+    }
+    // Another worker may be waiting for the lane
+    condWorkerMessages.notify_all();
+
+    CNode *pfrom = msg->pfrom;
+    pfrom->fWorkerMessage = false;
+    {
+        LOCK(cs_vNodes);
+        pfrom->Release();
+    }
+    WakeMessageHandler();
+}
+
+int nMessageWorkers = 0;
+
+// Process one message, exceptions caused by malformed messages are logged
+static bool ProcessMessageCaught(CNode *pfrom, const std::string &strCommand, CDataStream &vRecv,
+                                 int64_t nTimeReceived, unsigned int nMessageSize, const CChainParams &chainparams) {
+    bool fRet = false;
+    try {
+        fRet = ProcessMessage(pfrom, strCommand, vRecv, nTimeReceived, chainparams);
+        boost::this_thread::interruption_point();
+    }
+    catch (const std::ios_base::failure &e) {
+        if (strstr(e.what(), "end of data")) {
+            // Allow exceptions from under-length message on vRecv
+            LogPrintf(
+                    "%s(%s, %u bytes): Exception '%s' caught, normally caused by a message being shorter than its stated length\n",
+                    __func__, SanitizeString(strCommand), nMessageSize, e.what());
+        } else if (strstr(e.what(), "size too large")) {
+            // Allow exceptions from over-long size
+            LogPrintf("%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand),
+                      nMessageSize, e.what());
+        } else if (strstr(e.what(), "non-canonical ReadCompactSize()")) {
+            // Allow exceptions from non-canonical encoding
+            LogPrintf("%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand),
+                      nMessageSize, e.what());
+        } else {
+            PrintExceptionContinue(&e, "ProcessMessages() 1");
+        }
+    }
+    catch (const boost::thread_interrupted &) {
+        throw;
+    }
+    catch (const std::exception &e) {
+        LogPrintf("Exception with strCommand=%s\n", strCommand);
+        PrintExceptionContinue(&e, "ProcessMessages() 2");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ProcessMessages() 3");
+    }
+
+    if (!fRet)
+        LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize,
+                  pfrom->id);
+    return fRet;
+}
+
+void ThreadMessageWorker() {
+    RenameThread("bitcoin-msgworker");
+    const CChainParams &chainparams = Params();
+    while (true) {
+        std::unique_ptr<CWorkerMessage> msg;
+        int nLane;
+        {
+            boost::unique_lock<boost::mutex> lock(csWorkerMessages);
+            while (!(msg = PopWorkerMessageLocked(nLane)))
+                condWorkerMessages.wait(lock);
+        }
+
+        CNode *pfrom = msg->pfrom;
+        if (!pfrom->fDisconnect)
+            ProcessMessageCaught(pfrom, msg->strCommand, msg->vRecv, msg->nTimeReceived, msg->nMessageSize,
+                                 chainparams);
+
+        FinishWorkerMessage(std::move(msg), nLane);
+    }
+}
+
+void ClearWorkerMessages() {
+    boost::unique_lock<boost::mutex> lock(csWorkerMessages);
+    for (int nLane = 0; nLane < LANE_COUNT; nLane++) {
+        for (const std::unique_ptr<CWorkerMessage> &msg : vWorkerMessages[nLane]) {
+            msg->pfrom->fWorkerMessage = false;
+            LOCK(cs_vNodes);
+            msg->pfrom->Release();
+        }
+        vWorkerMessages[nLane].clear();
+        fLaneBusy[nLane] = false;
+    }
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode *pfrom) {
     const CChainParams &chainparams = Params();
@@ -8202,43 +8632,21 @@ bool ProcessMessages(CNode *pfrom) {
             continue;
         }
 
-        // Process message
-        bool fRet = false;
-        try {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams);
-            boost::this_thread::interruption_point();
-        }
-        catch (const std::ios_base::failure &e) {
-            if (strstr(e.what(), "end of data")) {
-                // Allow exceptions from under-length message on vRecv
-                LogPrintf(
-                        "%s(%s, %u bytes): Exception '%s' caught, normally caused by a message being shorter than its stated length\n",
-                        __func__, SanitizeString(strCommand), nMessageSize, e.what());
-            } else if (strstr(e.what(), "size too large")) {
-                // Allow exceptions from over-long size
-                LogPrintf("%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand),
-                          nMessageSize, e.what());
-            } else if (strstr(e.what(), "non-canonical ReadCompactSize()")) {
-                // Allow exceptions from non-canonical encoding
-                LogPrintf("%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand),
-                          nMessageSize, e.what());
-            } else {
-                PrintExceptionContinue(&e, "ProcessMessages() 1");
-            }
-        }
-        catch (const boost::thread_interrupted &) {
-            throw;
+        // Hand the message to the workers if they take care of it. The node is skipped by the message
+        // handler thread until the worker is done with it
+        int nLane = nMessageWorkers > 0 && pfrom->nVersion != 0 ? GetMessageLane(strCommand) : -1;
+        if (nLane >= 0) {
+            QueueWorkerMessage(pfrom, nLane, strCommand, vRecv, msg.nTime, nMessageSize);
+            break;
         }
-        catch (const std::exception &e) {
-            LogPrintf("Exception with strCommand=%s\n", strCommand);
-            PrintExceptionContinue(&e, "ProcessMessages() 2");
-        } catch (...) {
-            PrintExceptionContinue(NULL, "ProcessMessages() 3");
+
+        {
+            LOCK(cs_main);
+            CNode::CheckDandelionEmbargoes();
         }
 
-        if (!fRet)
-            LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize,
-                      pfrom->id);
+        // Process message
+        ProcessMessageCaught(pfrom, strCommand, vRecv, msg.nTime, nMessageSize, chainparams);
 
         break;
     }
@@ -8316,6 +8724,7 @@ bool SendMessages(CNode *pto) {
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_vAddrToSend);
             vector <CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             BOOST_FOREACH(
@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -36,7 +37,11 @@
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
+class CBlockUndo;
 class CBlockTreeDB;
+class CCoinsViewBackgroundFlush;
+class CIndexDB;
+class CZerocoinSpendHintDB;
 class CBloomFilter;
 class CChainParams;
 class CInv;
@@ -95,6 +100,10 @@ static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000; // 50KB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of message worker threads allowed */
+static const int MAX_MESSAGE_WORKERS = 16;
+/** -msgworkers default (number of threads handling messages which don't touch chain state, 0 = none) */
+static const int DEFAULT_MESSAGE_WORKERS = 2;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -200,7 +209,11 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nMessageWorkers;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -295,6 +308,35 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** A message handed to the message worker threads */
+struct CWorkerMessage
+{
+    CNode *pfrom;
+    std::string strCommand;
+    CDataStream vRecv;
+    int64_t nTimeReceived;
+    unsigned int nMessageSize;
+
+    CWorkerMessage(CNode *pfromIn, const std::string &strCommandIn, const CDataStream &vRecvIn,
+                   int64_t nTimeReceivedIn, unsigned int nMessageSizeIn) :
+        pfrom(pfromIn), strCommand(strCommandIn), vRecv(vRecvIn), nTimeReceived(nTimeReceivedIn),
+        nMessageSize(nMessageSizeIn) {}
+};
+/** Lane of the message workers that handles a command, -1 if the message handler thread handles it */
+int GetMessageLane(const std::string &strCommand);
+/** Queue a message for the message workers. The node is referenced and skipped by the message handler thread until
+ *  a worker is done with the message */
+void QueueWorkerMessage(CNode *pfrom, int nLane, const std::string &strCommand, const CDataStream &vRecv,
+                        int64_t nTimeReceived, unsigned int nMessageSize);
+/** Next message of a lane no worker is busy with, NULL if there is none. The lane stays busy until
+ *  FinishWorkerMessage() */
+std::unique_ptr<CWorkerMessage> PopWorkerMessage(int &nLane);
+/** Done with a message of PopWorkerMessage(): frees its lane and hands the node back to the message handler thread */
+void FinishWorkerMessage(std::unique_ptr<CWorkerMessage> msg, int nLane);
+/** Run an instance of the message worker thread */
+void ThreadMessageWorker();
+/** Drop the messages left for the message workers, once the worker threads are stopped */
+void ClearWorkerMessages();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -347,6 +389,8 @@ void Misbehaving(NodeId nodeid, int howmuch);
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
+/** Complete a chainstate write that was interrupted between its batches, by replaying the blocks in between */
+bool ReplayBlocks(const CChainParams &chainparams, CCoinsViewCache *view);
 
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(
@@ -401,6 +445,12 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
  */
 int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags);
 
+/**
+ * Fee a transaction of a block adds to the block reward. Coinbase, coinstake and zerocoin spends pay none.
+ * @param[in] inputs Map of previous transactions that have outputs we're spending
+ */
+CAmount GetBlockTransactionFee(const CTransaction& tx, const CCoinsViewCache& inputs);
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
@@ -515,6 +565,11 @@ bool GetAddressUnspent(uint160 addressHash, AddressType type,
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
+/** Read the block exactly as it is stored on disk. Checked against the header and the merkle root in the index, the transactions are hashed but not deserialized */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+/** Whether a raw block read by ReadRawBlockFromDisk carries witness data */
+bool RawBlockHasWitness(const std::vector<unsigned char>& block);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -598,9 +653,18 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Writes pcoinsTip flushes to the coin database, NULL if -backgroundflush is off (protected by cs_main) */
+extern CCoinsViewBackgroundFlush *pcoinsFlusher;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variable that points to the address, spent and timestamp index database (protected by cs_main) */
+extern CIndexDB *pindexdb;
+
+/** Global variable that points to the zerocoin spend hint database, kept across reindexes (protected by cs_main) */
+extern CZerocoinSpendHintDB *pzerocoinhintdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -35,6 +35,7 @@
 #include "sigma.h"
 #include "sigma/remint.h"
 #include <algorithm>
+#include <boost/chrono.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <queue>
@@ -132,37 +133,74 @@ void BlockAssembler::resetBlock()
     blockFinished = false;
 }
 
+namespace {
+
+/** Last template built. While the tip and the selected transactions stay the same it's extended with the mempool
+ *  transactions it doesn't have yet, instead of selecting everything again */
+struct CCachedBlockTemplate {
+    uint256 hashPrevBlock;
+    CScript scriptPubKey;
+    bool fProofOfStake;
+    // time of the last full selection
+    int64_t nFullBuildTime;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    std::set<uint256> setTxIds;
+    CBlockTemplateTotals totals;
+
+    CCachedBlockTemplate() : fProofOfStake(false), nFullBuildTime(0) {}
+};
+
+CCriticalSection cs_templateCache;
+CCachedBlockTemplate cachedTemplate;
+CBlockTemplateStats templateStats;
+
+int64_t GetThreadCpuTimeMicros()
+{
+#if defined(BOOST_CHRONO_HAS_THREAD_CLOCK)
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(
+            boost::chrono::thread_clock::now().time_since_epoch()).count();
+#else
+    return 0;
+#endif
+}
+
+}
+
+CBlockTemplateStats GetBlockTemplateStats()
+{
+    LOCK(cs_templateCache);
+    return templateStats;
+}
+
 CBlockTemplate* BlockAssembler::CreateNewBlock(
     const CScript& scriptPubKeyIn,
     const vector<uint256>& tx_ids,bool fProofOfStake)
 {
     // Create new block
-    LogPrintf("BlockAssembler::CreateNewBlock()\n");
+    LogPrint("miner", "BlockAssembler::CreateNewBlock()\n");
+
+    int64_t nTimeStart = GetTimeMicros();
+    int64_t nCpuTimeStart = GetThreadCpuTimeMicros();
 
     const Consensus::Params &params = Params().GetConsensus();
     uint32_t nBlockTime;
-    bool fMTP;
     {
         LOCK2(cs_main, mempool.cs);
         nBlockTime = GetAdjustedTime();
     }
 
-    fMTP = false;
-    int nFeeReductionFactor = 1;
-    CAmount coin = COIN / nFeeReductionFactor;
-
     resetBlock();
-    unique_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
+    pblocktemplate.reset(new CBlockTemplate());
     if(!pblocktemplate.get())
         return NULL;
-    CBlock *pblock = &pblocktemplate->block; // pointer for convenience
+    pblock = &pblocktemplate->block; // pointer for convenience
     // Create coinbase tx
     CMutableTransaction coinbaseTx;
     coinbaseTx.vin.resize(1);
     coinbaseTx.vin[0].prevout.SetNull();
     coinbaseTx.vout.resize(1);
     CBlockIndex* pindexPrev = chainActive.Tip();
-    const int nHeight = pindexPrev->nHeight + 1;
+    nHeight = pindexPrev->nHeight + 1;
     if (fProofOfStake)
     {
         // Make the coinbase tx empty in case of proof of stake
@@ -206,12 +244,8 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
     double actualPriority = -1;
 
     std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
-    bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-    uint64_t nBlockSize = 1500;
-    uint64_t nBlockTx = 0;
-    unsigned int nBlockSigOps = 100;
-    int lastFewTxs = 0;
-    CAmount nFees = 0;
+    fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
+    CBlockTemplateTotals totals;
     {
         LOCK2(cs_main, mempool.cs);
         pblock->nTime = nBlockTime;
@@ -223,11 +257,18 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         if (chainparams.MineBlocksOnDemand())
             pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
 
-        int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+        nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
                                   ? nMedianTimePast
                                   : pblock->GetBlockTime();
 
-        bool fPriorityBlock = nBlockPrioritySize > 0;
+        // Templates restricted to given transactions are never cached
+        bool fIncremental = false;
+        if (tx_ids.empty()) {
+            LOCK(cs_templateCache);
+            fIncremental = ExtendCachedTemplate(scriptPubKeyIn, fProofOfStake, pindexPrev, totals, nBlockMaxSize);
+        }
+
+        bool fPriorityBlock = nBlockPrioritySize > 0 && !fIncremental;
         if (fPriorityBlock) {
             vecPriority.reserve(mempool.mapTx.size());
             for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
@@ -243,10 +284,8 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
 
         CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
         CTxMemPool::txiter iter;
-        std::size_t nSigmaSpend = 0;
-        CAmount nValueSigmaSpend(0);
 
-        while (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty())
+        while (!fIncremental && (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty()))
         {
             bool priorityTx = false;
             if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
@@ -266,12 +305,10 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
             }
 
             if (inBlock.count(iter)) {
-                LogPrintf("skip, due to exist!\n");
                 continue; // could have been added to the priorityBlock
             }
 
             const CTransaction& tx = iter->GetTx();
-            LogPrintf("Trying to add tx=%s\n", tx.GetHash().ToString());
 
             if (!tx_ids.empty() && std::find(tx_ids.begin(), tx_ids.end(), tx.GetHash()) == tx_ids.end()) {
                 continue; // Skip because we were asked to include only transactions in tx_ids.
@@ -289,154 +326,28 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
                 if (priorityTx)
                     waitPriMap.insert(std::make_pair(iter,actualPriority));
                 else waitSet.insert(iter);
-                LogPrintf("skip tx=%s, due to fOrphan=%s\n", tx.GetHash().ToString(), fOrphan);
+                LogPrint("miner", "skip tx=%s, parent is not in block\n", tx.GetHash().ToString());
                 continue;
             }
 
             unsigned int nTxSize = iter->GetTxSize();
             if (fPriorityBlock &&
-                (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
+                (totals.nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
                 fPriorityBlock = false;
                 waitPriMap.clear();
             }
-//            if (!priorityTx && (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && nBlockSize >= nBlockMinSize)) {
-//                LogPrintf("skip tx=%s\n", tx.GetHash().ToString());
-//                LogPrintf("iter->GetModifiedFee()=%s\n", iter->GetModifiedFee());
-//                LogPrintf("::minRelayTxFee.GetFee(nTxSize)=%s\n", ::minRelayTxFee.GetFee(nTxSize));
-//                LogPrintf("nBlockSize=%s\n", nBlockSize);
-//                LogPrintf("nBlockMinSize=%s\n", nBlockMinSize);
-//                LogPrintf("***********************************");
-//                break;
-//            }
-            if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
-                    LogPrintf("stop due to size overweight", tx.GetHash().ToString());
-                    LogPrintf("nBlockSize=%s\n", nBlockSize);
-                    LogPrintf("nBlockMaxSize=%s\n", nBlockMaxSize);
-                    break;
-                }
-                // Once we're within 1000 bytes of a full block, only look at 50 more txs
-                // to try to fill the remaining space.
-                if (nBlockSize > nBlockMaxSize - 1000) {
-                    lastFewTxs++;
-                }
-                LogPrintf("skip tx=%s\n", tx.GetHash().ToString());
-                LogPrintf("nBlockSize=%s\n", nBlockSize);
-                LogPrintf("nBlockMaxSize=%s\n", nBlockMaxSize);
-                continue;
-            }
-            if (tx.IsCoinBase()) {
-                LogPrintf("skip tx=%s, coinbase tx\n", tx.GetHash().ToString());
-                continue;
-            }
-
-            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff)) {
-                LogPrintf("skip tx=%s, not IsFinalTx\n", tx.GetHash().ToString());
-                continue;
-            }
-
-            if (tx.IsSigmaMint() || tx.IsSigmaSpend()) {
-                sigma::CSigmaState * sigmaState = sigma::CSigmaState::GetState();
-                if(sigmaState->IsSurgeConditionDetected())
-                    continue;
-            }
-
-            // temporarily disable zerocoin. Re-enable after sigma release
-            // Make exception for regtest network (for remint tests)
-            if (!chainparams.GetConsensus().IsRegtest() && (tx.IsZerocoinSpend() || tx.IsZerocoinMint()))
-                continue;
-
-            if(tx.IsSigmaSpend() && nHeight >= chainparams.GetConsensus().nDisableUnpaddedSigmaBlock && nHeight < chainparams.GetConsensus().nSigmaPaddingBlock)
-                continue;
-
-            if (tx.IsSigmaSpend() || tx.IsZerocoinRemint()) {
-                // Sigma spend and zerocoin->sigma remint are subject to the same limits
-                CAmount spendAmount = tx.IsSigmaSpend() ? sigma::GetSpendAmount(tx) : sigma::CoinRemintToV3::GetAmount(tx);
-
-                if (tx.vin.size() > params.nMaxSigmaInputPerTransaction ||
-                    spendAmount > params.nMaxValueSigmaSpendPerTransaction) {
-                    continue;
-                }
-                if (tx.vin.size() + nSigmaSpend > params.nMaxSigmaInputPerBlock) {
-                    continue;
-                }
-                if (spendAmount + nValueSigmaSpend > params.nMaxValueSigmaSpendPerBlock) {
-                    continue;
-                }
-
-                //mempool.countZCSpend--;
-                // Size limits
-                unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-
-                LogPrintf("\n\n######################################\n");
-                LogPrintf("nBlockMaxSize = %d\n", nBlockMaxSize);
-                LogPrintf("nBlockSize = %d\n", nBlockSize);
-                LogPrintf("nTxSize = %d\n", nTxSize);
-                LogPrintf("nBlockSize + nTxSize  = %d\n", nBlockSize + nTxSize);
-                LogPrintf("nBlockSigOpsCost  = %d\n", nBlockSigOpsCost);
-                LogPrintf("GetLegacySigOpCount  = %d\n", GetLegacySigOpCount(tx));
-                LogPrintf("######################################\n\n\n");
-
-                if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                    LogPrintf("failed by sized\n");
-                    continue;
-                }
-
-                // Legacy limits on sigOps:
-                unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-                if (nBlockSigOpsCost + nTxSigOps >= MAX_BLOCK_SIGOPS_COST) {
-                    LogPrintf("failed by sized\n");
-                    continue;
-                }
 
-                CAmount nTxFees = iter->GetFee();
-
-                pblock->vtx.push_back(tx);
-                pblocktemplate->vTxFees.push_back(nTxFees);
-                pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
-                nBlockSize += nTxSize;
-                ++nBlockTx;
-                nBlockSigOpsCost += nTxSigOps;
-                nFees += nTxFees;
-                nSigmaSpend += tx.vin.size();
-                nValueSigmaSpend += spendAmount;
-                inBlock.insert(iter);
+            TemplateAddResult result = AddToTemplate(iter, totals, nBlockMaxSize);
+            if (result == BLOCK_FULL)
+                break;
+            if (result == TX_SKIPPED)
                 continue;
-            }
 
+            inBlock.insert(iter);
 
-            unsigned int nTxSigOps = iter->GetSigOpCost();
-            LogPrintf("nTxSigOps=%s\n", nTxSigOps);
-            LogPrintf("nBlockSigOps=%s\n", nBlockSigOps);
-            LogPrintf("MAX_BLOCK_SIGOPS_COST=%s\n", MAX_BLOCK_SIGOPS_COST);
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST) {
-                if (nBlockSigOps > MAX_BLOCK_SIGOPS_COST - 2) {
-                    LogPrintf("stop due to cross fee\n", tx.GetHash().ToString());
-                    break;
-                }
-                LogPrintf("skip tx=%s, nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST\n", tx.GetHash().ToString());
+            // Sigma spends and remints are not parents of other mempool transactions
+            if (tx.IsSigmaSpend() || tx.IsZerocoinRemint())
                 continue;
-            }
-            CAmount nTxFees = iter->GetFee();
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-            LogPrintf("added to block=%s\n", tx.GetHash().ToString());
-            if (fPrintPriority)
-            {
-                double dPriority = iter->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                          dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
-            }
-
-            inBlock.insert(iter);
 
             // Add transactions that depend on this one to the priority queue
             BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
@@ -457,13 +368,12 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
                 }
             }
         }
-        CAmount blockReward = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus(), nBlockTime);
+        CAmount blockReward = totals.nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus(), nBlockTime);
         // Update coinbase transaction with additional info about indexnode and governance payments,
         // get some info back to pass to getblocktemplate
         bool fPayIDXNode = nHeight >= chainparams.GetConsensus().nIndexnodePaymentsStartBlock && !fProofOfStake;
         CAmount indexnodePayment = 0;
         if (fPayIDXNode) {
-            const Consensus::Params &params = chainparams.GetConsensus();
             indexnodePayment = GetIndexnodePayment(chainparams.GetConsensus(),false,nHeight);
             FillBlockPayments(coinbaseTx, nHeight, indexnodePayment, pblock->txoutIndexnode, pblock->voutSuperblock);
         }
@@ -471,16 +381,17 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         if(pblock->txoutIndexnode != CTxOut() && indexnodePayment != 0)
             coinbaseTx.vout[0].nValue -= indexnodePayment;
 
-        nLastBlockTx = nBlockTx;
-        nLastBlockSize = nBlockSize;
-        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
+        nLastBlockTx = totals.nBlockTx;
+        nLastBlockSize = totals.nBlockSize;
+        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d%s\n", totals.nBlockSize, totals.nBlockTx,
+                  totals.nFees, totals.nBlockSigOps, fIncremental ? " (updated)" : "");
 
         // Compute final coinbase transaction.
         if(!fProofOfStake)//Only Set vout of coinbasetx as blockreward in PoW Blocks
             coinbaseTx.vout[0].nValue += blockReward;
         coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
         pblock->vtx[0] = coinbaseTx;
-        pblocktemplate->vTxFees[0] = -nFees;
+        pblocktemplate->vTxFees[0] = -totals.nFees;
 
         // Fill in header
         pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
@@ -491,19 +402,213 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(
         pblock->nNonce = fProofOfStake ? 0 : 1;
         pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0]);
 
-        //LogPrintf("CreateNewBlock(): AFTER pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0])\n");
-
+        // Scripts and sigma proofs of mempool transactions are found in the signature and sigma spend caches,
+        // so this is cheap for transactions validated on mempool acceptance
         CValidationState state;
-        //LogPrintf("CreateNewBlock(): BEFORE TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)\n");
         if ( !fProofOfStake && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
             throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
         }
-        //LogPrintf("CreateNewBlock(): AFTER TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)\n");
+
+        int64_t nTime = GetTimeMicros() - nTimeStart;
+        int64_t nCpuTime = GetThreadCpuTimeMicros() - nCpuTimeStart;
+        LOCK(cs_templateCache);
+        if (tx_ids.empty()) {
+            if (!fIncremental) {
+                cachedTemplate.hashPrevBlock = pindexPrev->GetBlockHash();
+                cachedTemplate.scriptPubKey = scriptPubKeyIn;
+                cachedTemplate.fProofOfStake = fProofOfStake;
+                cachedTemplate.nFullBuildTime = GetTime();
+            }
+            cachedTemplate.pblocktemplate.reset(new CBlockTemplate(*pblocktemplate));
+            cachedTemplate.setTxIds.clear();
+            for (size_t i = 1; i < pblock->vtx.size(); i++)
+                cachedTemplate.setTxIds.insert(pblock->vtx[i].GetHash());
+            cachedTemplate.totals = totals;
+        }
+        ++(fIncremental ? templateStats.nIncrementalBuilds : templateStats.nFullBuilds);
+        templateStats.nLastBuildTime = nTime;
+        templateStats.nLastBuildCpuTime = nCpuTime;
+        templateStats.nTotalBuildTime += nTime;
+        templateStats.nTotalBuildCpuTime += nCpuTime;
     }
-    //LogPrintf("CreateNewBlock(): pblocktemplate.release()\n");
     return pblocktemplate.release();
 }
 
+bool BlockAssembler::ExtendCachedTemplate(const CScript& scriptPubKeyIn, bool fProofOfStake, const CBlockIndex* pindexPrev,
+                                          CBlockTemplateTotals& totals, unsigned int nBlockMaxSize)
+{
+    AssertLockHeld(mempool.cs);
+    AssertLockHeld(cs_templateCache);
+
+    if (!cachedTemplate.pblocktemplate ||
+            cachedTemplate.hashPrevBlock != pindexPrev->GetBlockHash() ||
+            cachedTemplate.scriptPubKey != scriptPubKeyIn ||
+            cachedTemplate.fProofOfStake != fProofOfStake ||
+            GetTime() - cachedTemplate.nFullBuildTime > MAX_TEMPLATE_UPDATE_AGE)
+        return false;
+
+    // Template transactions removed from the mempool (conflicts, eviction, expiry) invalidate the selection
+    BOOST_FOREACH(const uint256 &txid, cachedTemplate.setTxIds) {
+        if (!mempool.exists(txid))
+            return false;
+    }
+
+    CBlock &cachedBlock = cachedTemplate.pblocktemplate->block;
+    pblock->vtx = cachedBlock.vtx;
+    pblocktemplate->vTxFees = cachedTemplate.pblocktemplate->vTxFees;
+    pblocktemplate->vTxSigOpsCost = cachedTemplate.pblocktemplate->vTxSigOpsCost;
+    totals = cachedTemplate.totals;
+
+    // Mempool transactions not in the template yet, in the score order the full selection uses. A child that comes
+    // before its parent in this order waits for the next full selection
+    std::set<uint256> setTxIds = cachedTemplate.setTxIds;
+    unsigned int nConsidered = 0;
+    CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
+    for (; mi != mempool.mapTx.get<3>().end(); ++mi) {
+        CTxMemPool::txiter iter = mempool.mapTx.project<0>(mi);
+        const uint256 &txid = iter->GetTx().GetHash();
+        if (setTxIds.count(txid))
+            continue;
+        nConsidered++;
+
+        bool fOrphan = false;
+        BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter)) {
+            if (!setTxIds.count(parent->GetTx().GetHash())) {
+                fOrphan = true;
+                break;
+            }
+        }
+        if (fOrphan)
+            continue;
+
+        TemplateAddResult result = AddToTemplate(iter, totals, nBlockMaxSize);
+        if (result == BLOCK_FULL)
+            break;
+        if (result == TX_ADDED)
+            setTxIds.insert(txid);
+    }
+
+    LogPrint("miner", "%s: %u mempool transactions considered\n", __func__, nConsidered);
+    return true;
+}
+
+BlockAssembler::TemplateAddResult BlockAssembler::AddToTemplate(CTxMemPool::txiter iter, CBlockTemplateTotals& totals,
+                                                                unsigned int nBlockMaxSize)
+{
+    const Consensus::Params &params = chainparams.GetConsensus();
+    const CTransaction& tx = iter->GetTx();
+    unsigned int nTxSize = iter->GetTxSize();
+
+    if (totals.nBlockSize + nTxSize >= nBlockMaxSize) {
+        if (totals.nBlockSize >  nBlockMaxSize - 100 || totals.lastFewTxs > 50) {
+            LogPrint("miner", "stop due to size overweight, nBlockSize=%u nBlockMaxSize=%u\n", totals.nBlockSize, nBlockMaxSize);
+            return BLOCK_FULL;
+        }
+        // Once we're within 1000 bytes of a full block, only look at 50 more txs
+        // to try to fill the remaining space.
+        if (totals.nBlockSize > nBlockMaxSize - 1000) {
+            totals.lastFewTxs++;
+        }
+        LogPrint("miner", "skip tx=%s, nBlockSize=%u nBlockMaxSize=%u\n", tx.GetHash().ToString(), totals.nBlockSize, nBlockMaxSize);
+        return TX_SKIPPED;
+    }
+    if (tx.IsCoinBase()) {
+        LogPrint("miner", "skip tx=%s, coinbase tx\n", tx.GetHash().ToString());
+        return TX_SKIPPED;
+    }
+
+    if (!IsFinalTx(tx, nHeight, nLockTimeCutoff)) {
+        LogPrint("miner", "skip tx=%s, not IsFinalTx\n", tx.GetHash().ToString());
+        return TX_SKIPPED;
+    }
+
+    if (tx.IsSigmaMint() || tx.IsSigmaSpend()) {
+        sigma::CSigmaState * sigmaState = sigma::CSigmaState::GetState();
+        if(sigmaState->IsSurgeConditionDetected())
+            return TX_SKIPPED;
+    }
+
+    // temporarily disable zerocoin. Re-enable after sigma release
+    // Make exception for regtest network (for remint tests)
+    if (!params.IsRegtest() && (tx.IsZerocoinSpend() || tx.IsZerocoinMint()))
+        return TX_SKIPPED;
+
+    if(tx.IsSigmaSpend() && nHeight >= params.nDisableUnpaddedSigmaBlock && nHeight < params.nSigmaPaddingBlock)
+        return TX_SKIPPED;
+
+    if (tx.IsSigmaSpend() || tx.IsZerocoinRemint()) {
+        // Sigma spend and zerocoin->sigma remint are subject to the same limits
+        CAmount spendAmount = tx.IsSigmaSpend() ? sigma::GetSpendAmount(tx) : sigma::CoinRemintToV3::GetAmount(tx);
+
+        if (tx.vin.size() > params.nMaxSigmaInputPerTransaction ||
+            spendAmount > params.nMaxValueSigmaSpendPerTransaction) {
+            return TX_SKIPPED;
+        }
+        if (tx.vin.size() + totals.nSigmaSpend > params.nMaxSigmaInputPerBlock) {
+            return TX_SKIPPED;
+        }
+        if (spendAmount + totals.nValueSigmaSpend > params.nMaxValueSigmaSpendPerBlock) {
+            return TX_SKIPPED;
+        }
+
+        // Size limits
+        unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        if (totals.nBlockSize + nTxSize >= nBlockMaxSize) {
+            LogPrint("miner", "skip tx=%s, nBlockSize=%u nTxSize=%u\n", tx.GetHash().ToString(), totals.nBlockSize, nTxSize);
+            return TX_SKIPPED;
+        }
+
+        // Legacy limits on sigOps:
+        unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+        if (totals.nBlockSigOpsCost + nTxSigOps >= MAX_BLOCK_SIGOPS_COST) {
+            LogPrint("miner", "skip tx=%s, nBlockSigOpsCost=%u nTxSigOps=%u\n", tx.GetHash().ToString(), totals.nBlockSigOpsCost, nTxSigOps);
+            return TX_SKIPPED;
+        }
+
+        CAmount nTxFees = iter->GetFee();
+
+        pblock->vtx.push_back(tx);
+        pblocktemplate->vTxFees.push_back(nTxFees);
+        pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
+        totals.nBlockSize += nTxSize;
+        ++totals.nBlockTx;
+        totals.nBlockSigOpsCost += nTxSigOps;
+        totals.nFees += nTxFees;
+        totals.nSigmaSpend += tx.vin.size();
+        totals.nValueSigmaSpend += spendAmount;
+        return TX_ADDED;
+    }
+
+    unsigned int nTxSigOps = iter->GetSigOpCost();
+    if (totals.nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST) {
+        if (totals.nBlockSigOps > MAX_BLOCK_SIGOPS_COST - 2) {
+            LogPrint("miner", "stop due to sigops, nBlockSigOps=%u\n", totals.nBlockSigOps);
+            return BLOCK_FULL;
+        }
+        LogPrint("miner", "skip tx=%s, nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST\n", tx.GetHash().ToString());
+        return TX_SKIPPED;
+    }
+    CAmount nTxFees = iter->GetFee();
+    // Added
+    pblock->vtx.push_back(tx);
+    pblocktemplate->vTxFees.push_back(nTxFees);
+    pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
+    totals.nBlockSize += nTxSize;
+    ++totals.nBlockTx;
+    totals.nBlockSigOps += nTxSigOps;
+    totals.nFees += nTxFees;
+    LogPrint("miner", "added to block=%s\n", tx.GetHash().ToString());
+    if (fPrintPriority)
+    {
+        double dPriority = iter->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
+        LogPrintf("priority %.1f fee %s txid %s\n",
+                  dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
+    }
+    return TX_ADDED;
+}
+
 
 CBlockTemplate* BlockAssembler::CreateNewBlockWithKey(CReserveKey &reservekey) {
     LogPrintf("CreateNewBlockWithKey()\n");
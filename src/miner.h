@@ -26,6 +26,9 @@ static const bool DEFAULT_GENERATE = false;
 static const int DEFAULT_GENERATE_THREADS = 1;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** A cached block template is extended with new mempool transactions for at most this many seconds,
+ *  after that transactions are selected again to restore fee ordering */
+static const int64_t MAX_TEMPLATE_UPDATE_AGE = 60;
 
 struct CBlockTemplate
 {
@@ -35,6 +38,36 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
+/** Running totals of a block template being filled, coinbase reserve included */
+struct CBlockTemplateTotals
+{
+    uint64_t nBlockSize;
+    uint64_t nBlockTx;
+    unsigned int nBlockSigOps;
+    uint64_t nBlockSigOpsCost;
+    CAmount nFees;
+    std::size_t nSigmaSpend;
+    CAmount nValueSigmaSpend;
+    int lastFewTxs;
+
+    CBlockTemplateTotals() : nBlockSize(1500), nBlockTx(0), nBlockSigOps(100), nBlockSigOpsCost(100), nFees(0),
+                             nSigmaSpend(0), nValueSigmaSpend(0), lastFewTxs(0) {}
+};
+
+/** Block template build counters, times in microseconds */
+struct CBlockTemplateStats
+{
+    uint64_t nFullBuilds;
+    uint64_t nIncrementalBuilds;
+    int64_t nLastBuildTime;
+    int64_t nLastBuildCpuTime;
+    int64_t nTotalBuildTime;
+    int64_t nTotalBuildCpuTime;
+
+    CBlockTemplateStats() : nFullBuilds(0), nIncrementalBuilds(0), nLastBuildTime(0), nLastBuildCpuTime(0),
+                            nTotalBuildTime(0), nTotalBuildCpuTime(0) {}
+};
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 struct CTxMemPoolModifiedEntry {
@@ -164,6 +197,8 @@ private:
     int lastFewTxs;
     bool blockFinished;
 
+    bool fPrintPriority;
+
 public:
     BlockAssembler(const CChainParams& chainparams);
     /** Construct a new block template with coinbase to scriptPubKeyIn */
@@ -177,6 +212,18 @@ private:
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
 
+    enum TemplateAddResult {
+        TX_ADDED,
+        TX_SKIPPED,
+        BLOCK_FULL
+    };
+    /** Check a mempool tx against the block limits and consensus rules and add it to the template if it passes */
+    TemplateAddResult AddToTemplate(CTxMemPool::txiter iter, CBlockTemplateTotals& totals, unsigned int nBlockMaxSize);
+    /** Start from the cached template if it's still valid for the tip and add transactions that entered the mempool
+     *  since it was built. Returns false if the template has to be built from scratch */
+    bool ExtendCachedTemplate(const CScript& scriptPubKeyIn, bool fProofOfStake, const CBlockIndex* pindexPrev,
+                              CBlockTemplateTotals& totals, unsigned int nBlockMaxSize);
+
     // Methods for how to add transactions to a block.
     /** Add transactions based on tx "priority" */
     void addPriorityTxs();
@@ -209,6 +256,9 @@ private:
     void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/** Counters of CreateNewBlock calls, shown by getmininginfo */
+CBlockTemplateStats GetBlockTemplateStats();
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
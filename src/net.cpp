@@ -138,6 +138,8 @@ uint64_t nLocalHostNonce = 0;
 static std::vector <ListenSocket> vhListenSocket;
 CAddrMan addrman;
 int nMaxConnections = DEFAULT_MAX_PEER_CONNECTIONS;
+SocketEventsMode nSocketEventsMode = DEFAULT_SOCKETEVENTS;
+static std::unique_ptr<CSocketEvents> socketEvents;
 bool fAddressesInitialized = false;
 std::string strSubVersion;
 
@@ -156,6 +158,8 @@ CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
+// set when a node the message handler thread skipped can be serviced again
+static std::atomic<bool> fMessageHandlerWake(false);
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -428,7 +432,7 @@ CNode *ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout,
                                       &proxyConnectionFailed) :
         ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!CanWaitForSocket(nSocketEventsMode, hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -1109,7 +1113,7 @@ static void AcceptConnection(const ListenSocket &hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (!CanWaitForSocket(nSocketEventsMode, hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1243,8 +1247,34 @@ void CNode::CloseDandelionConnections(const CNode* const pnode)
               CNode::GetDandelionRoutingDataDebugString());
 }
 
+// Stop waiting for the socket of the node. Only used by the socket handler thread
+static void UnregisterNodeSocket(CNode *pnode, std::map<SOCKET, CNode *> &mapSocketNodes) {
+    if (pnode->hSocketEvents == INVALID_SOCKET)
+        return;
+    socketEvents->Remove(pnode->hSocketEvents);
+    std::map<SOCKET, CNode *>::iterator it = mapSocketNodes.find(pnode->hSocketEvents);
+    if (it != mapSocketNodes.end() && it->second == pnode)
+        mapSocketNodes.erase(it);
+    pnode->hSocketEvents = INVALID_SOCKET;
+    pnode->nSocketInterest = 0;
+    pnode->fSocketRecvReady = false;
+    pnode->fSocketSendReady = false;
+}
+
 void ThreadSocketHandler() {
     unsigned int nPrevNodeCount = 0;
+    // registered sockets of the nodes, to find the node of a ready socket
+    std::map<SOCKET, CNode *> mapSocketNodes;
+    std::map<SOCKET, const ListenSocket *> mapListenSockets;
+    BOOST_FOREACH(const ListenSocket &hListenSocket, vhListenSocket)
+    {
+        if (socketEvents->Add(hListenSocket.socket, CSocketEvents::EVENT_RECV, true))
+            mapListenSockets[hListenSocket.socket] = &hListenSocket;
+        else
+            LogPrintf("Cannot wait for connections on listening socket %d\n", hListenSocket.socket);
+    }
+    std::vector<std::pair<SOCKET, int> > vReady;
+
     while (true) {
         //
         // Disconnect nodes
@@ -1265,6 +1295,7 @@ void ThreadSocketHandler() {
                     pnode->grantOutbound.Release();
 
                     // close socket and cleanup
+                    UnregisterNodeSocket(pnode, mapSocketNodes);
                     pnode->CloseSocketDisconnect();
 
                     // hold in disconnected pool until all refs are released
@@ -1312,46 +1343,32 @@ void ThreadSocketHandler() {
         }
 
         //
-        // Find which sockets have data to receive
+        // Update what is waited for on each socket
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(
-        const ListenSocket &hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
+        // Readiness left over from the last round, which doesn't have to be waited for
+        bool fReadyPending = false;
         {
             LOCK(cs_vNodes);
+            // Sockets closed by other threads go first, their descriptors may belong to new nodes already
+            BOOST_FOREACH(CNode * pnode, vNodes)
+            {
+                if (pnode->hSocketEvents != INVALID_SOCKET && pnode->hSocketEvents != pnode->hSocket)
+                    UnregisterNodeSocket(pnode, mapSocketNodes);
+            }
+
             BOOST_FOREACH(CNode * pnode, vNodes)
             {
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
 
                 // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
+                // * If there is data to send, wait for sending data. As this only
                 //   happens when optimistic write failed, we choose to first drain the
                 //   write buffer in this case before receiving more. This avoids
                 //   needlessly queueing received data, if the remote peer is not themselves
                 //   receiving data. This means properly utilizing TCP flow control signalling.
                 // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
+                //   or there is space left in the buffer, wait for receiving data.
                 // * (if neither of the above applies, there is certainly one message
                 //   in the receiver buffer ready to be processed).
                 // Together, that means that at least one of the following is always possible,
@@ -1359,48 +1376,85 @@ void ThreadSocketHandler() {
                 // * We send some data.
                 // * We wait for data to be received (and disconnect after timeout).
                 // * We process a message in the buffer (message handler thread).
+                // The backend is only told when this changes, which is when the send buffer
+                // fills or drains and when the receive buffer floods or is processed.
+                int nInterest = pnode->nSocketInterest;
+                bool fSendPending = false;
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
                     if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
+                        nInterest = CSocketEvents::EVENT_SEND;
+                        fSendPending = true;
                     }
                 }
-                {
+                if (!fSendPending) {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (
-                            pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                            pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                    if (lockRecv)
+                        nInterest = (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                                     pnode->GetTotalRecvSize() <= ReceiveFloodSize()) ? CSocketEvents::EVENT_RECV : 0;
+                }
+
+                if (pnode->hSocketEvents == INVALID_SOCKET) {
+                    if (!socketEvents->Add(pnode->hSocket, nInterest, false)) {
+                        LogPrintf("Cannot wait for socket of peer=%d, disconnecting\n", pnode->id);
+                        pnode->fDisconnect = true;
+                        continue;
+                    }
+                    pnode->hSocketEvents = pnode->hSocket;
+                    pnode->nSocketInterest = nInterest;
+                    mapSocketNodes[pnode->hSocket] = pnode;
+                } else if (nInterest != pnode->nSocketInterest) {
+                    if (!socketEvents->Modify(pnode->hSocket, nInterest)) {
+                        pnode->fDisconnect = true;
+                        continue;
+                    }
+                    pnode->nSocketInterest = nInterest;
                 }
+
+                if (((nInterest & CSocketEvents::EVENT_RECV) && pnode->fSocketRecvReady) ||
+                    ((nInterest & CSocketEvents::EVENT_SEND) && pnode->fSocketSendReady))
+                    fReadyPending = true;
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        //
+        // Wait for the sockets
+        //
+        int64_t nTimeout = fReadyPending ? 0 : 50; // frequency to poll pnode->vSend
+        if (!socketEvents->Wait(nTimeout, vReady)) {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket %s error %s\n", socketEvents->GetName(), NetworkErrorString(nErr));
+            MilliSleep(nTimeout);
+        }
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+        std::vector<const ListenSocket *> vAccept;
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(const PAIRTYPE(SOCKET, int) &ready, vReady)
+            {
+                std::map<SOCKET, const ListenSocket *>::const_iterator itListen = mapListenSockets.find(ready.first);
+                if (itListen != mapListenSockets.end()) {
+                    vAccept.push_back(itListen->second);
+                    continue;
+                }
+                std::map<SOCKET, CNode *>::iterator it = mapSocketNodes.find(ready.first);
+                if (it == mapSocketNodes.end())
+                    continue;
+                // Errors are found by the next recv() or send()
+                if (ready.second & (CSocketEvents::EVENT_RECV | CSocketEvents::EVENT_ERROR))
+                    it->second->fSocketRecvReady = true;
+                if (ready.second & (CSocketEvents::EVENT_SEND | CSocketEvents::EVENT_ERROR))
+                    it->second->fSocketSendReady = true;
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
         }
 
         //
         // Accept new connections
         //
-        BOOST_FOREACH(
-        const ListenSocket &hListenSocket, vhListenSocket)
+        BOOST_FOREACH(const ListenSocket *pListenSocket, vAccept)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
-                AcceptConnection(hListenSocket);
-            }
+            AcceptConnection(*pListenSocket);
         }
 
         //
@@ -1422,7 +1476,7 @@ void ThreadSocketHandler() {
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            if (pnode->fSocketRecvReady && (pnode->nSocketInterest & CSocketEvents::EVENT_RECV)) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
                     {
@@ -1435,6 +1489,10 @@ void ThreadSocketHandler() {
                             pnode->nLastRecv = GetTime();
                             pnode->nRecvBytes += nBytes;
                             pnode->RecordBytesRecv(nBytes);
+                            // A short read drained the socket, more data is reported as a new event.
+                            // Otherwise the rest is read in the next round, after the other nodes had their turn.
+                            if (nBytes < (int) sizeof(pchBuf))
+                                pnode->fSocketRecvReady = false;
                         } else if (nBytes == 0) {
                             // socket closed gracefully
                             if (!pnode->fDisconnect)
@@ -1449,6 +1507,7 @@ void ThreadSocketHandler() {
                                     LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                                 pnode->CloseSocketDisconnect();
                             }
+                            pnode->fSocketRecvReady = false;
                         }
                     }
                 }
@@ -1459,10 +1518,13 @@ void ThreadSocketHandler() {
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (pnode->fSocketSendReady) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
+                if (lockSend) {
                     SocketSendData(pnode);
+                    // Anything left over means the socket buffer is full, which frees up as a new event
+                    pnode->fSocketSendReady = false;
+                }
             }
 
             //
@@ -2008,7 +2070,7 @@ void ThreadMessageHandler() {
 
         BOOST_FOREACH(CNode * pnode, vNodesCopy)
         {
-            if (pnode->fDisconnect)
+            if (pnode->fDisconnect || pnode->fWorkerMessage)
                 continue;
 
             // Receive messages
@@ -2043,13 +2105,18 @@ void ThreadMessageHandler() {
             pnode->Release();
         }
 
-        if (fSleep)
+        if (fSleep && !fMessageHandlerWake.exchange(false))
             messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() +
                                                      boost::posix_time::milliseconds(100));
     }
 }
 
 
+void WakeMessageHandler() {
+    fMessageHandlerWake = true;
+    messageHandlerCondition.notify_one();
+}
+
 bool BindListenPort(const CService &addrBind, std::string &strError, bool fWhitelisted) {
     strError = "";
     int nOne = 1;
@@ -2070,7 +2137,7 @@ bool BindListenPort(const CService &addrBind, std::string &strError, bool fWhite
         LogPrintf("%s\n", strError);
         return false;
     }
-    if (!IsSelectableSocket(hListenSocket)) {
+    if (!CanWaitForSocket(nSocketEventsMode, hListenSocket)) {
         strError = "Error: Couldn't create a listenable socket for incoming connections";
         LogPrintf("%s\n", strError);
         return false;
@@ -2343,6 +2410,14 @@ void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
     // Send and receive from sockets, accept connections
+    socketEvents.reset(CreateSocketEvents(nSocketEventsMode));
+    if (!socketEvents) {
+        LogPrintf("Socket events mode %s is not available, falling back to select\n", GetSocketEventsModeName(nSocketEventsMode));
+        // New sockets are checked against the limits of select from now on
+        nSocketEventsMode = SOCKETEVENTS_SELECT;
+        socketEvents.reset(CreateSocketEvents(SOCKETEVENTS_SELECT));
+    }
+    LogPrintf("Using %s for socket events\n", socketEvents->GetName());
     threadGroup.create_thread(
         boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
@@ -2815,9 +2890,14 @@ CNode::CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNa
     fNetworkNode = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fWorkerMessage = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    hSocketEvents = INVALID_SOCKET;
+    nSocketInterest = 0;
+    fSocketRecvReady = false;
+    fSocketSendReady = false;
     hashContinue = uint256();
     nStartingHeight = -1;
     filterInventoryKnown.reset();
@@ -14,6 +14,7 @@
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
+#include "socketevents.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
@@ -103,6 +104,8 @@ bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
+/** Let the message handler thread look at the nodes again, without waiting for its next round */
+void WakeMessageHandler();
 
 struct CombinerAll
 {
@@ -170,6 +173,8 @@ extern CAddrMan addrman;
 
 /** Maximum number of connections to simultaneously allow (aka connection slots) */
 extern int nMaxConnections;
+/** How the socket handler thread waits for the sockets, set before the listening sockets are bound */
+extern SocketEventsMode nSocketEventsMode;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
@@ -338,6 +343,12 @@ public:
     std::deque<CSerializeData> vSendMsg;
     CCriticalSection cs_vSend;
 
+    // Socket event state, only used by the socket handler thread
+    SOCKET hSocketEvents; // socket as registered with the event backend
+    int nSocketInterest; // CSocketEvents::EVENT_* waited for
+    bool fSocketRecvReady; // readiness reported and not used up yet
+    bool fSocketSendReady;
+
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
@@ -365,6 +376,9 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     bool fDisconnect;
+    // A message of the node is with the message workers. The message handler thread leaves the node
+    // alone until the worker is done, which keeps the messages of the node in order
+    std::atomic<bool> fWorkerMessage;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in its version message that we should not relay tx invs
@@ -406,6 +420,8 @@ public:
     int nStartingHeight;
 
     // flood relay
+    // vAddrToSend and addrKnown are filled by the message workers relaying addresses of other nodes
+    CCriticalSection cs_vAddrToSend;
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
@@ -544,11 +560,13 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_vAddrToSend);
         addrKnown.insert(addr.GetKey());
     }
 
     void PushAddress(const CAddress& addr)
     {
+        LOCK(cs_vAddrToSend);
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
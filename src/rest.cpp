@@ -17,6 +17,7 @@
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -59,7 +60,8 @@ struct CCoin {
 };
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern UniValue blockInfoToJSON(const CBlock& block, const CBlockIndex* blockindex);
+extern void blockToJSON(CJSONWriter& writer, const CBlock& block, const UniValue& blockInfo, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
@@ -216,22 +218,34 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
-    CBlockIndex* pblockindex = NULL;
+    std::vector<unsigned char> vRawBlock;
+    bool fRawBlock = false;
+    UniValue blockInfo;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
-        pblockindex = mapBlockIndex[hash];
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        // Binary and hex formats are served as the block is stored on disk unless witness data has to be stripped
+        if (rf != RF_JSON && ReadRawBlockFromDisk(vRawBlock, pblockindex, Params().MessageStart()) &&
+                (!(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS) || !RawBlockHasWitness(vRawBlock)))
+            fRawBlock = true;
+        else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+        if (rf == RF_JSON)
+            blockInfo = blockInfoToJSON(block, pblockindex);
     }
 
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (fRawBlock)
+        ssBlock << CFlatData(vRawBlock);
+    else if (rf != RF_JSON)
+        ssBlock << block;
 
     switch (rf) {
     case RF_BINARY: {
@@ -249,10 +263,12 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
+        // Large blocks are sent in chunks while their transactions are described
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        CJSONStreamWriter writer(boost::bind(&HTTPRequest::WriteReplyChunk, req, HTTP_OK, _1));
+        blockToJSON(writer, block, blockInfo, showTxDetails);
+        writer.WriteRaw("\n");
+        req->WriteReply(HTTP_OK, writer.GetBuffer());
         return true;
     }
 
@@ -9,15 +9,19 @@
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "indexbuilder.h"
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "sigma.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationstats.h"
 #include "hash.h"
 #include "base58.h"
 #include <stdint.h>
@@ -154,7 +158,11 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/**
+ * Fields of blockToJSON but the transactions, an empty "tx" array keeps their place.
+ * The block index is only looked at here, so only this part needs cs_main.
+ */
+UniValue blockInfoToJSON(const CBlock& block, const CBlockIndex* blockindex)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
@@ -171,19 +179,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx.GetHash().GetHex());
-    }
-    result.push_back(Pair("tx", txs));
+    result.push_back(Pair("tx", UniValue(UniValue::VARR)));
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
@@ -209,6 +205,48 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+/** Write blockToJSON's object with the transactions added one by one, blockInfo comes from blockInfoToJSON */
+void blockToJSON(CJSONWriter& writer, const CBlock& block, const UniValue& blockInfo, bool txDetails = false)
+{
+    const std::vector<std::string> keys = blockInfo.getKeys();
+    const std::vector<UniValue> values = blockInfo.getValues();
+
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != "tx")
+        {
+            writer.KeyValue(keys[i], values[i]);
+            continue;
+        }
+
+        writer.Key("tx");
+        writer.BeginArray();
+        BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        {
+            if (writer.IsClosed())
+                break;
+            if(txDetails)
+            {
+                UniValue objTx(UniValue::VOBJ);
+                TxToJSON(tx, uint256(), objTx);
+                writer.Value(objTx);
+            }
+            else
+                writer.Value(tx.GetHash().GetHex());
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    CJSONTreeWriter writer;
+    blockToJSON(writer, block, blockInfoToJSON(block, blockindex), txDetails);
+    return writer.GetResult();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -321,35 +359,66 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("depends", depends));
 }
 
-UniValue mempoolToJSON(bool fVerbose = false)
+/** Verbose mempool entries described at once, the mempool isn't locked while they are written */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 1000;
+
+void mempoolToJSON(CJSONWriter& writer, bool fVerbose = false)
 {
     if (fVerbose)
     {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+        vector<uint256> vtxid;
         {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.push_back(Pair(hash.ToString(), info));
+            LOCK(mempool.cs);
+            vtxid.reserve(mempool.mapTx.size());
+            BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+                vtxid.push_back(e.GetTx().GetHash());
         }
-        return o;
+
+        // Transactions which left the mempool meanwhile are skipped
+        writer.BeginObject();
+        for (size_t nStart = 0; nStart < vtxid.size() && !writer.IsClosed(); nStart += MEMPOOL_JSON_BATCH_SIZE)
+        {
+            size_t nEnd = std::min(vtxid.size(), nStart + MEMPOOL_JSON_BATCH_SIZE);
+            vector<UniValue> vInfo;
+            vInfo.reserve(nEnd - nStart);
+            {
+                LOCK(mempool.cs);
+                for (size_t i = nStart; i < nEnd; i++)
+                {
+                    vInfo.push_back(UniValue(UniValue::VOBJ));
+                    CTxMemPool::txiter it = mempool.mapTx.find(vtxid[i]);
+                    if (it != mempool.mapTx.end())
+                        entryToJSON(vInfo.back(), *it);
+                }
+            }
+            for (size_t i = nStart; i < nEnd; i++)
+            {
+                if (!vInfo[i - nStart].empty())
+                    writer.KeyValue(vtxid[i].ToString(), vInfo[i - nStart]);
+            }
+        }
+        writer.EndObject();
     }
     else
     {
         vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        writer.BeginArray();
         BOOST_FOREACH(const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Value(hash.ToString());
+        writer.EndArray();
     }
 }
 
-UniValue getrawmempool(const UniValue& params, bool fHelp)
+UniValue mempoolToJSON(bool fVerbose = false)
+{
+    CJSONTreeWriter writer;
+    mempoolToJSON(writer, fVerbose);
+    return writer.GetResult();
+}
+
+void getrawmempool(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() > 1)
         throw runtime_error(
@@ -377,7 +446,14 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    mempoolToJSON(writer, fVerbose);
+}
+
+UniValue getrawmempool(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    getrawmempool(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 UniValue clearmempool(const UniValue& params, bool fHelp)
@@ -690,7 +766,7 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
-UniValue getblock(const UniValue& params, bool fHelp)
+void getblock(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -731,8 +807,6 @@ UniValue getblock(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -740,27 +814,54 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    UniValue blockInfo;
+    {
+        LOCK(cs_main);
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if (!fVerbose)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+        if (!fVerbose)
+        {
+            // Hex dump the block as it is stored on disk unless witness data has to be stripped
+            std::vector<unsigned char> vRawBlock;
+            if (ReadRawBlockFromDisk(vRawBlock, pblockindex, Params().MessageStart()) &&
+                    (!(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS) || !RawBlockHasWitness(vRawBlock)))
+            {
+                writer.Value(HexStr(vRawBlock.begin(), vRawBlock.end()));
+                return;
+            }
+        }
+
+        if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+        if (!fVerbose)
+        {
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+            ssBlock << block;
+            writer.Value(HexStr(ssBlock.begin(), ssBlock.end()));
+            return;
+        }
+
+        blockInfo = blockInfoToJSON(block, pblockindex);
     }
 
-    return blockToJSON(block, pblockindex);
+    // The transactions are written without holding cs_main, a slow client doesn't stall the node
+    blockToJSON(writer, block, blockInfo);
+}
+
+UniValue getblock(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    getblock(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 struct CCoinsStats
@@ -1066,6 +1167,16 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "        \"startTime\": xx,       (numeric) the minimum median time past of a block at which the bit gains its meaning\n"
             "        \"timeout\": xx          (numeric) the median time past of a block at which the deployment is considered failed if not yet locked in\n"
             "     }\n"
+            "  },\n"
+            "  \"chainstateflush\": {       (object) chain state writes, only with -backgroundflush\n"
+            "     \"flushes\": xx,           (numeric) number of writes since startup\n"
+            "     \"backgroundflushes\": xx, (numeric) number of those done in the background\n"
+            "     \"inprogress\": xx,        (boolean) if a background write is in progress\n"
+            "     \"lastduration\": xx,      (numeric) duration of the last write in milliseconds\n"
+            "     \"lastbytes\": xx,         (numeric) bytes written by the last write\n"
+            "     \"lastbatches\": xx,       (numeric) database batches of the last write\n"
+            "     \"totalduration\": xx,     (numeric) duration of all writes in milliseconds\n"
+            "     \"totalbytes\": xx         (numeric) bytes written by all writes\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -1110,6 +1221,51 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    if (pcoinsFlusher)
+    {
+        CCoinsFlushStats stats = pcoinsFlusher->GetStats();
+        UniValue flush(UniValue::VOBJ);
+        flush.push_back(Pair("flushes",           stats.nFlushes));
+        flush.push_back(Pair("backgroundflushes", stats.nBackgroundFlushes));
+        flush.push_back(Pair("inprogress",        stats.fInProgress));
+        flush.push_back(Pair("lastduration",      stats.nLastDuration * 0.001));
+        flush.push_back(Pair("lastbytes",         stats.nLastBytes));
+        flush.push_back(Pair("lastbatches",       (int)stats.nLastBatches));
+        flush.push_back(Pair("totalduration",     stats.nTotalDuration * 0.001));
+        flush.push_back(Pair("totalbytes",        stats.nTotalBytes));
+        obj.push_back(Pair("chainstateflush", flush));
+    }
+    return obj;
+}
+
+UniValue getindexinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getindexinfo\n"
+            "Returns the status of the enabled optional indexes. Indexes behind the chain are built in the background.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                 (object) txindex, addressindex, spentindex or timestampindex\n"
+            "    \"synced\": xx,           (boolean) if the index is in sync with the active chain\n"
+            "    \"best_block_height\": xx (numeric) height of the block the index is in sync with, -1 if none yet\n"
+            "    \"failed\": xx            (boolean) if building the index failed, see debug.log\n"
+            "  }, ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    for (const CIndexBuildProgress &progress : indexBuilder.GetProgress()) {
+        UniValue index(UniValue::VOBJ);
+        index.push_back(Pair("synced",            progress.fSynced));
+        index.push_back(Pair("best_block_height", progress.nBestHeight));
+        index.push_back(Pair("failed",            progress.fFailed));
+        obj.push_back(Pair(progress.strName, index));
+    }
     return obj;
 }
 
@@ -1241,9 +1397,59 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
     ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
+    sigma::CSpendCacheStats spendCacheStats = sigma::GetSpendCacheStats();
+    UniValue spendCache(UniValue::VOBJ);
+    spendCache.push_back(Pair("entries", (int64_t) spendCacheStats.nEntries));
+    spendCache.push_back(Pair("usage", (int64_t) spendCacheStats.nMemoryUsage));
+    spendCache.push_back(Pair("hits", (int64_t) spendCacheStats.nHits));
+    spendCache.push_back(Pair("misses", (int64_t) spendCacheStats.nMisses));
+    spendCache.push_back(Pair("evictions", (int64_t) spendCacheStats.nEvictions));
+    ret.push_back(Pair("sigmaspendcache", spendCache));
+
     return ret;
 }
 
+UniValue getvalidationstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getvalidationstats ( reset )\n"
+            "\nReturns the time spent per block on each stage of block validation since startup, in microseconds.\n"
+            "Times are counted for the block they were spent on once it is connected; block templates, proposals\n"
+            "and the blocks of the startup check are not counted.\n"
+            "\nArguments:\n"
+            "1. reset  (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": xxxxx,             (numeric) Number of blocks connected\n"
+            "  \"stages\": {                  (json object) read, deserialize, header, stake, scripts, zerocoin, sigma,\n"
+            "                                 indexnode, elysium, index, flush and connect (the whole block)\n"
+            "    \"stage\": {\n"
+            "      \"blocks\": xxxxx,         (numeric) Number of blocks which went through the stage\n"
+            "      \"total\": xxxxx,          (numeric) Total time\n"
+            "      \"average\": xxxxx,        (numeric) Average time per block\n"
+            "      \"max\": xxxxx,            (numeric) Longest time of a block\n"
+            "      \"histogram\": [n,...]     (array) Blocks below 1, 2, 4, ... microseconds, the last entry counts everything longer\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"last\": {                    (json object) The last block connected\n"
+            "    \"height\": xxxxx,\n"
+            "    \"hash\": \"hash\",\n"
+            "    \"stages\": { \"stage\": xxxxx, ... }\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationstats", "")
+            + HelpExampleRpc("getvalidationstats", "true")
+        );
+
+    UniValue result = validationStats.ToJSON();
+    result.push_back(Pair("last", validationStats.LastBlockToJSON()));
+    if (params.size() > 0 && params[0].get_bool())
+        validationStats.Reset();
+    return result;
+}
+
 UniValue getmempoolinfo(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -1256,7 +1462,14 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"bytes\": xxxxx,              (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
-            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
+            "  \"mempoolminfee\": xxxxx,      (numeric) Minimum fee for tx to be accepted\n"
+            "  \"sigmaspendcache\": {         (json object) Sigma spends verified on mempool acceptance\n"
+            "    \"entries\": xxxxx,          (numeric) Number of cached proofs\n"
+            "    \"usage\": xxxxx,            (numeric) Memory usage of the cache\n"
+            "    \"hits\": xxxxx,             (numeric) Proofs not verified again thanks to the cache\n"
+            "    \"misses\": xxxxx,           (numeric) Proofs that had to be verified\n"
+            "    \"evictions\": xxxxx         (numeric) Entries dropped to keep the cache within its limit\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1353,6 +1566,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockheader",         &getblockheader,         true  },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
+    { "blockchain",         "getindexinfo",           &getindexinfo,           true  },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true  },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true  },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        true  },
@@ -1361,6 +1575,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "clearmempool",           &clearmempool,           true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     /* Not shown in help */
@@ -1368,8 +1583,17 @@ static const CRPCCommand commands[] =
     { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
 };
 
+static const CRPCStreamCommand streamCommands[] =
+{ //  name                      streamActor
+  //  ------------------------  ------------------------
+    { "getblock",               &getblock               },
+    { "getrawmempool",          &getrawmempool          },
+};
+
 void RegisterBlockchainRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(streamCommands); vcidx++)
+        tableRPC.appendStreamActor(streamCommands[vcidx].name, streamCommands[vcidx].streamActor);
 }
@@ -26,6 +26,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
 {
     { "stop", 0 },
     { "setmocktime", 0 },
+    { "getlockstats", 0 },
+    { "getvalidationstats", 0 },
     { "getaddednodeinfo", 0 },
     { "generate", 0 },
     { "generate", 1 },
@@ -0,0 +1,150 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include <assert.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn) :
+    sink(sinkIn), nFlushSize(nFlushSizeIn), fAfterKey(false), fFlushed(false), fClosed(false)
+{
+}
+
+// Separate the value from the previous member of its container
+void CJSONStreamWriter::BeginValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (vHasMembers.empty())
+        return;
+    if (vHasMembers.back())
+        strBuffer += ',';
+    vHasMembers.back() = true;
+}
+
+// Values end at a token boundary, so the text may be handed on there
+void CJSONStreamWriter::EndValue()
+{
+    if (strBuffer.size() >= nFlushSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    strBuffer += '{';
+    vHasMembers.push_back(false);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vHasMembers.empty() && !fAfterKey);
+    vHasMembers.pop_back();
+    strBuffer += '}';
+    EndValue();
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    strBuffer += '[';
+    vHasMembers.push_back(false);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vHasMembers.empty() && !fAfterKey);
+    vHasMembers.pop_back();
+    strBuffer += ']';
+    EndValue();
+}
+
+void CJSONStreamWriter::Key(const std::string& strKey)
+{
+    assert(!vHasMembers.empty() && !fAfterKey);
+    BeginValue();
+    strBuffer += UniValue(strKey).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& val)
+{
+    BeginValue();
+    strBuffer += val.write();
+    EndValue();
+}
+
+void CJSONStreamWriter::WriteRaw(const std::string& strText)
+{
+    strBuffer += strText;
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    // Once the reader went away, the rest of the document is dropped
+    if (!fClosed && !sink(strBuffer))
+        fClosed = true;
+    fFlushed = true;
+    strBuffer.clear();
+}
+
+// Add a value to the container nParents levels up the stack, or make it the result
+void CJSONTreeWriter::Add(const UniValue& val, size_t nParents)
+{
+    if (nParents == 0)
+        result = val;
+    else if (vStack[nParents - 1].isObject())
+        vStack[nParents - 1].pushKV(strKey, val);
+    else
+        vStack[nParents - 1].push_back(val);
+}
+
+// The closed container is added to its parent before it's dropped
+void CJSONTreeWriter::EndContainer()
+{
+    strKey = vStackKeys.back();
+    vStackKeys.pop_back();
+    Add(vStack.back(), vStack.size() - 1);
+    vStack.pop_back();
+}
+
+void CJSONTreeWriter::BeginObject()
+{
+    vStack.push_back(UniValue(UniValue::VOBJ));
+    vStackKeys.push_back(strKey);
+}
+
+void CJSONTreeWriter::EndObject()
+{
+    assert(!vStack.empty() && vStack.back().isObject());
+    EndContainer();
+}
+
+void CJSONTreeWriter::BeginArray()
+{
+    vStack.push_back(UniValue(UniValue::VARR));
+    vStackKeys.push_back(strKey);
+}
+
+void CJSONTreeWriter::EndArray()
+{
+    assert(!vStack.empty() && vStack.back().isArray());
+    EndContainer();
+}
+
+void CJSONTreeWriter::Key(const std::string& strKeyIn)
+{
+    assert(!vStack.empty() && vStack.back().isObject());
+    strKey = strKeyIn;
+}
+
+void CJSONTreeWriter::Value(const UniValue& val)
+{
+    Add(val, vStack.size());
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <univalue.h>
+
+/** Buffered text of a CJSONStreamWriter which is handed to its sink at once */
+static const size_t DEFAULT_JSON_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Receives a JSON document piece by piece: containers are opened and closed, members of objects are written as a
+ * key followed by a value. Large results are produced into a writer so they don't need to be held as a whole.
+ */
+class CJSONWriter
+{
+public:
+    virtual ~CJSONWriter() {}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    //! Name of the next member of the current object
+    virtual void Key(const std::string& strKey) = 0;
+    virtual void Value(const UniValue& val) = 0;
+    //! The reader went away, producers may stop early
+    virtual bool IsClosed() const { return false; }
+
+    void KeyValue(const std::string& strKey, const UniValue& val)
+    {
+        Key(strKey);
+        Value(val);
+    }
+};
+
+/** Writes the document as text, which is handed to a sink whenever enough of it piled up */
+class CJSONStreamWriter : public CJSONWriter
+{
+public:
+    //! Takes a part of the text, false once the reader went away
+    typedef boost::function<bool(const std::string& strText)> Sink;
+
+private:
+    Sink sink;
+    size_t nFlushSize;
+    std::string strBuffer;
+    //! For each open container, whether it has members already
+    std::vector<bool> vHasMembers;
+    //! A key was written, its value follows
+    bool fAfterKey;
+    bool fFlushed;
+    bool fClosed;
+
+    void BeginValue();
+    void EndValue();
+
+public:
+    CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn = DEFAULT_JSON_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& strKey);
+    void Value(const UniValue& val);
+    bool IsClosed() const { return fClosed; }
+
+    //! Append text outside of the document, e.g. a trailing newline
+    void WriteRaw(const std::string& strText);
+    //! Hand the buffered text to the sink
+    void Flush();
+    //! Whether text was handed to the sink, an error can't replace the document any more then
+    bool HasFlushed() const { return fFlushed; }
+    //! Text which wasn't handed to the sink yet
+    const std::string& GetBuffer() const { return strBuffer; }
+};
+
+/** Builds the document as a UniValue */
+class CJSONTreeWriter : public CJSONWriter
+{
+private:
+    UniValue result;
+    //! Open containers, and the keys they are added under once closed. A deque doesn't copy them as it grows
+    std::deque<UniValue> vStack;
+    std::vector<std::string> vStackKeys;
+    std::string strKey;
+
+    void Add(const UniValue& val, size_t nParents);
+    void EndContainer();
+
+public:
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& strKeyIn);
+    void Value(const UniValue& val);
+
+    const UniValue& GetResult() const { return result; }
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
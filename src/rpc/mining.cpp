@@ -277,6 +277,14 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
+            "  \"blocktemplate\": {          (json object) Block template builds\n"
+            "    \"fullbuilds\": n,          (numeric) Templates built by selecting all mempool transactions\n"
+            "    \"incrementalbuilds\": n,   (numeric) Templates built by extending the previous template\n"
+            "    \"lastbuildtime\": xxx,     (numeric) Wall time of the last build in milliseconds\n"
+            "    \"lastbuildcputime\": xxx,  (numeric) Thread CPU time of the last build in milliseconds\n"
+            "    \"avgbuildtime\": xxx,      (numeric) Average wall time of a build in milliseconds\n"
+            "    \"avgbuildcputime\": xxx    (numeric) Average thread CPU time of a build in milliseconds\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmininginfo", "")
@@ -300,6 +308,17 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("testnet",          Params().TestnetToBeDeprecatedFieldRPC()));
     obj.push_back(Pair("chain",            Params().NetworkIDString()));
     obj.push_back(Pair("generate",         getgenerate(params, false)));
+
+    CBlockTemplateStats templateStats = GetBlockTemplateStats();
+    uint64_t nBuilds = templateStats.nFullBuilds + templateStats.nIncrementalBuilds;
+    UniValue templateObj(UniValue::VOBJ);
+    templateObj.push_back(Pair("fullbuilds",        templateStats.nFullBuilds));
+    templateObj.push_back(Pair("incrementalbuilds", templateStats.nIncrementalBuilds));
+    templateObj.push_back(Pair("lastbuildtime",     templateStats.nLastBuildTime * 0.001));
+    templateObj.push_back(Pair("lastbuildcputime",  templateStats.nLastBuildCpuTime * 0.001));
+    templateObj.push_back(Pair("avgbuildtime",      nBuilds ? templateStats.nTotalBuildTime * 0.001 / nBuilds : 0.0));
+    templateObj.push_back(Pair("avgbuildcputime",   nBuilds ? templateStats.nTotalBuildCpuTime * 0.001 / nBuilds : 0.0));
+    obj.push_back(Pair("blocktemplate",    templateObj));
     return obj;
 }
 
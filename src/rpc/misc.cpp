@@ -15,6 +15,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 #include "spork.h"
+#include "sync.h"
 #ifdef ENABLE_WALLET
 #include "indexnode-sync.h"
 #include "wallet/wallet.h"
@@ -601,6 +602,108 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+#ifdef DEBUG_LOCKSTATS
+static UniValue LockHistogramToJSON(const uint64_t histogram[LOCKSTATS_BUCKETS])
+{
+    UniValue result(UniValue::VARR);
+    for (int i = 0; i < LOCKSTATS_BUCKETS; i++)
+        result.push_back(histogram[i]);
+    return result;
+}
+#endif
+
+UniValue getlockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( reset )\n"
+            "\nReturns how long every LOCK site waited for and held its lock, grouped by lock, by total wait.\n"
+            "Only available in builds configured with --enable-lockstats.\n"
+            "\nArguments:\n"
+            "1. reset  (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"lock\": \"name\",        (string) The lock as passed to LOCK\n"
+            "    \"acquired\": n,         (numeric) Number of acquisitions\n"
+            "    \"contended\": n,        (numeric) Number of acquisitions which had to wait for another thread\n"
+            "    \"wait\": n,             (numeric) Total wait in microseconds\n"
+            "    \"hold\": n,             (numeric) Total hold time in microseconds\n"
+            "    \"sites\": [             (array) The sites acquiring the lock, by total wait\n"
+            "      {\n"
+            "        \"site\": \"file:line\",\n"
+            "        \"acquired\": n,\n"
+            "        \"contended\": n,\n"
+            "        \"tryfailed\": n,    (numeric) Number of TRY_LOCKs which did not get the lock\n"
+            "        \"wait\": n,\n"
+            "        \"maxwait\": n,\n"
+            "        \"hold\": n,\n"
+            "        \"maxhold\": n,\n"
+            "        \"waithistogram\": [n,...], (array) Waits below 1, 2, 4, ... microseconds, the last entry counts everything longer\n"
+            "        \"holdhistogram\": [n,...]  (array) Hold times in the same buckets\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleRpc("getlockstats", "true")
+        );
+
+#ifdef DEBUG_LOCKSTATS
+    std::vector<CLockSiteStats> vSites = GetLockStats();
+    if (params.size() > 0 && params[0].get_bool())
+        ResetLockStats();
+
+    // the sites are ordered by total wait, so are the locks by their first site
+    std::vector<std::string> vLocks;
+    std::map<std::string, std::vector<const CLockSiteStats*> > mapSites;
+    for (size_t i = 0; i < vSites.size(); i++) {
+        if (mapSites.count(vSites[i].strName) == 0)
+            vLocks.push_back(vSites[i].strName);
+        mapSites[vSites[i].strName].push_back(&vSites[i]);
+    }
+
+    UniValue result(UniValue::VARR);
+    BOOST_FOREACH(const std::string& strLock, vLocks) {
+        uint64_t nAcquired = 0, nContended = 0;
+        int64_t nWait = 0, nHold = 0;
+        UniValue sites(UniValue::VARR);
+        BOOST_FOREACH(const CLockSiteStats* site, mapSites[strLock]) {
+            nAcquired += site->nAcquired;
+            nContended += site->nContended;
+            nWait += site->nWaitTotal;
+            nHold += site->nHoldTotal;
+
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("site", strprintf("%s:%d", site->strFile, site->nLine)));
+            obj.push_back(Pair("acquired", site->nAcquired));
+            obj.push_back(Pair("contended", site->nContended));
+            obj.push_back(Pair("tryfailed", site->nTryFailed));
+            obj.push_back(Pair("wait", site->nWaitTotal));
+            obj.push_back(Pair("maxwait", site->nWaitMax));
+            obj.push_back(Pair("hold", site->nHoldTotal));
+            obj.push_back(Pair("maxhold", site->nHoldMax));
+            obj.push_back(Pair("waithistogram", LockHistogramToJSON(site->waitHistogram)));
+            obj.push_back(Pair("holdhistogram", LockHistogramToJSON(site->holdHistogram)));
+            sites.push_back(obj);
+        }
+
+        UniValue lock(UniValue::VOBJ);
+        lock.push_back(Pair("lock", strLock));
+        lock.push_back(Pair("acquired", nAcquired));
+        lock.push_back(Pair("contended", nContended));
+        lock.push_back(Pair("wait", nWait));
+        lock.push_back(Pair("hold", nHold));
+        lock.push_back(Pair("sites", sites));
+        result.push_back(lock);
+    }
+    return result;
+#else
+    throw JSONRPCError(RPC_MISC_ERROR, "Lock statistics are not compiled in, configure with --enable-lockstats");
+#endif
+}
+
 bool getAddressFromIndex(AddressType const & type, const uint160 &hash, std::string &address)
 {
     if (type == AddressType::payToScriptHash) {
@@ -851,7 +954,7 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
     return result;
 }
 
-UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+void getaddressdeltas(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() != 1 || !params[0].isObject())
         throw runtime_error(
@@ -918,9 +1021,17 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         }
     }
 
-    UniValue result(UniValue::VARR);
+    // Unknown address types are reported before anything is written
+    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        std::string address;
+        if (!getAddressFromIndex((*it).second, (*it).first, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+    }
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+    writer.BeginArray();
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end() && !writer.IsClosed(); it++) {
         std::string address;
         if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
@@ -933,10 +1044,17 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         delta.push_back(Pair("blockindex", (int)it->first.txindex));
         delta.push_back(Pair("height", it->first.blockHeight));
         delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        writer.Value(delta);
     }
 
-    return result;
+    writer.EndArray();
+}
+
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    getaddressdeltas(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
@@ -995,7 +1113,7 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
 
 }
 
-UniValue getaddresstxids(const UniValue& params, bool fHelp)
+void getaddresstxids(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (fHelp || params.size() != 1)
         throw runtime_error(
@@ -1053,9 +1171,10 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
     }
 
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+    writer.BeginArray();
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end() && !writer.IsClosed(); it++) {
         int height = it->first.blockHeight;
         std::string txid = it->first.txhash.GetHex();
 
@@ -1063,19 +1182,25 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             txids.insert(std::make_pair(height, txid));
         } else {
             if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
+                writer.Value(txid);
             }
         }
     }
 
     if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end() && !writer.IsClosed(); it++) {
+            writer.Value(it->second);
         }
     }
 
-    return result;
+    writer.EndArray();
+}
 
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    getaddresstxids(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 UniValue getspentinfo(const UniValue& params, bool fHelp)
@@ -1144,8 +1269,8 @@ UniValue gettotalsupply(const UniValue& params, bool fHelp)
 
     CAmount total = 0;
 
-    if(!pblocktree->ReadTotalSupply(total))
-        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database. This functionality requires -addressindex to be enabled. Enabling -addressindex requires reindexing.");
+    if(!pindexdb->ReadTotalSupply(total))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database. This functionality requires -addressindex to be enabled and built, see getindexinfo.");
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("total", total));
@@ -1236,7 +1361,7 @@ UniValue getzerocoinsupply(const UniValue& params, bool fHelp)
     CAmount total = 0;
 
     if(!getZerocoinSupply(total))
-        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the zerocoin supply from the database. This functionality requires -addressindex to be enabled. Enabling -addressindex requires reindexing.");
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the zerocoin supply from the database. This functionality requires -addressindex to be enabled and built, see getindexinfo.");
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("total", total));
@@ -1280,7 +1405,7 @@ UniValue getinfoex(const UniValue& params, bool fHelp)
 
     CAmount total = 0, zerocoin = 0;
 
-    if(!pblocktree->ReadTotalSupply(total))
+    if(!pindexdb->ReadTotalSupply(total))
         throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database");
 
     if(!getZerocoinSupply(zerocoin))
@@ -1300,6 +1425,7 @@ static const CRPCCommand commands[] =
     { "util",               "createmultisig",         &createmultisig,         true  },
     { "util",               "verifymessage",          &verifymessage,          true  },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, true  },
+    { "util",               "getlockstats",           &getlockstats,           true  },
 
         /* Address index */
     { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
@@ -1316,8 +1442,17 @@ static const CRPCCommand commands[] =
 
 };
 
+static const CRPCStreamCommand streamCommands[] =
+{ //  name                      streamActor
+  //  ------------------------  ------------------------
+    { "getaddressdeltas",       &getaddressdeltas       },
+    { "getaddresstxids",        &getaddresstxids        },
+};
+
 void RegisterMiscRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(streamCommands); vcidx++)
+        tableRPC.appendStreamActor(streamCommands[vcidx].name, streamCommands[vcidx].streamActor);
 }
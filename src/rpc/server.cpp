@@ -287,6 +287,13 @@ static const CRPCCommand vRPCCommands[] =
     { "index",               "getpoolinfo",           &getpoolinfo,            true  },
 };
 
+static const CRPCStreamCommand vRPCStreamCommands[] =
+{ //  name                      streamActor
+  //  ------------------------  ------------------------
+    { "getaddressdeltas",       &getaddressdeltas       },
+    { "getaddresstxids",        &getaddresstxids        },
+};
+
 CRPCTable::CRPCTable()
 {
     unsigned int vcidx;
@@ -297,6 +304,8 @@ CRPCTable::CRPCTable()
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
     }
+    for (vcidx = 0; vcidx < (sizeof(vRPCStreamCommands) / sizeof(vRPCStreamCommands[0])); vcidx++)
+        mapStreamActors[vRPCStreamCommands[vcidx].name] = vRPCStreamCommands[vcidx].streamActor;
 }
 
 const CRPCCommand *CRPCTable::operator[](const std::string &name) const
@@ -321,6 +330,19 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::appendStreamActor(const std::string& name, rpcstreamfn_type actor)
+{
+    if (IsRPCRunning())
+        return false;
+
+    map<string, rpcstreamfn_type>::const_iterator it = mapStreamActors.find(name);
+    if (it != mapStreamActors.end())
+        return false;
+
+    mapStreamActors[name] = actor;
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
@@ -467,6 +489,39 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+void CRPCTable::execute(const std::string &strMethod, const UniValue &params, CJSONWriter& writer) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    // Find method
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    if (!pcmd)
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        // Execute
+        map<string, rpcstreamfn_type>::const_iterator it = mapStreamActors.find(strMethod);
+        if (it != mapStreamActors.end())
+            it->second(params, false, writer);
+        else
+            writer.Value(pcmd->actor(params, false));
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
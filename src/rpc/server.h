@@ -7,6 +7,7 @@
 #define BITCOIN_RPCSERVER_H
 
 #include "amount.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "uint256.h"
 
@@ -128,6 +129,8 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+//! Writes the result piece by piece, for commands whose results may be large
+typedef void(*rpcstreamfn_type)(const UniValue& params, bool fHelp, CJSONWriter& writer);
 
 class CRPCCommand
 {
@@ -138,6 +141,14 @@ public:
     bool okSafeMode;
 };
 
+/** The stream actor of a command, registered with CRPCTable::appendStreamActor */
+class CRPCStreamCommand
+{
+public:
+    std::string name;
+    rpcstreamfn_type streamActor;
+};
+
 /**
  * Bitcoin RPC command dispatcher.
  */
@@ -145,6 +156,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, rpcstreamfn_type> mapStreamActors;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -159,6 +171,13 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method, writing its result into writer. Methods with a stream actor
+     * write it piece by piece, the result of the others is written as a whole.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    void execute(const std::string &method, const UniValue &params, CJSONWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -172,6 +191,12 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Appends the stream actor of a command, used by the execute overload taking a writer.
+     * Returns false if RPC server is already running or the command has a stream actor already.
+     */
+    bool appendStreamActor(const std::string& name, rpcstreamfn_type actor);
 };
 
 extern CRPCTable tableRPC;
@@ -197,7 +222,9 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 extern UniValue getaddressmempool(const UniValue& params, bool fHelp);
 extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
 extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
+extern void getaddressdeltas(const UniValue& params, bool fHelp, CJSONWriter& writer);
 extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
+extern void getaddresstxids(const UniValue& params, bool fHelp, CJSONWriter& writer);
 extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
 
 extern UniValue getpoolinfo(const UniValue& params, bool fHelp);
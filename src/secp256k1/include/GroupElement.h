@@ -16,19 +16,28 @@ class GroupElement final {
 public:
     static constexpr std::size_t serialize_size = 34;
 
+    // Size in bytes of the inline storage for secp256k1_gej: three field
+    // elements of 40 bytes and the infinity flag, padded to the alignment.
+    static constexpr std::size_t storage_size = 3 * 40 + 8;
+
 public:
 
   GroupElement();
 
   ~GroupElement();
 
-  GroupElement(const GroupElement& other);
+  GroupElement(const GroupElement& other) noexcept;
+
+  // Move constructor, the coordinates are stored inline so this is a plain copy.
+  GroupElement(GroupElement&& other) noexcept;
 
   GroupElement(const char* x,const char* y,  int base = 10);
 
   GroupElement& set(const GroupElement& other);
 
-  GroupElement& operator=(const GroupElement& other);
+  GroupElement& operator=(const GroupElement& other) noexcept;
+
+  GroupElement& operator=(GroupElement&& other) noexcept;
 
   // Operator for multiplying with a scalar number.
   GroupElement operator*(const Scalar& multiplier) const;
@@ -50,6 +59,10 @@ public:
 
   bool operator!=(const GroupElement&other) const;
 
+  // Converts the element to affine coordinates in place. Comparison, hashing
+  // and serialization of a normalized element need no field inversion.
+  GroupElement& normalize();
+
   bool isMember() const;
 
   bool isInfinity() const;
@@ -113,7 +126,8 @@ private:
     GroupElement(const void *g);
 
 private:
-    void *g_; // secp256k1_gej
+    // secp256k1_gej, stored inline to avoid a heap allocation per value.
+    alignas(8) unsigned char g_[storage_size];
 
 };
 
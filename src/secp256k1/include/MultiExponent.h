@@ -1,24 +1,26 @@
 #ifndef SECP_MULTIEXPONENT_H
 #define SECP_MULTIEXPONENT_H
 
+#include <cstddef>
 #include <vector>
 #include "../include/GroupElement.h"
 #include "../include/Scalar.h"
 
 namespace secp_primitives {
 
+// Computes sum(generators[i] * powers[i]). The generators and powers are
+// borrowed, not copied, so they must outlive the MultiExponent object.
 class MultiExponent {
 public:
-    MultiExponent(const MultiExponent& other);
     MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers);
-    ~MultiExponent();
+    MultiExponent(const GroupElement* generators, const Scalar* powers, std::size_t n_points);
 
-    GroupElement get_multiple();
+    GroupElement get_multiple() const;
 
 private:
-    void  *sc_; // secp256k1_scalar[]
-    void  *pt_; // secp256k1_gej[]
-    int n_points;
+    const GroupElement *generators_;
+    const Scalar *powers_;
+    std::size_t n_points;
 };
 
 }// namespace secp_primitives
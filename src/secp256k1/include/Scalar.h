@@ -2,6 +2,7 @@
 #define SCALAR_H__
 
 #include <array>
+#include <cstddef>
 #include <functional>
 #include <ostream>
 #include <string>
@@ -21,7 +22,10 @@ public:
     Scalar(uint64_t value);
 
     // Copy constructor
-    Scalar(const Scalar& other);
+    Scalar(const Scalar& other) noexcept;
+
+    // Move constructor, the limbs are stored inline so this is a plain copy.
+    Scalar(Scalar&& other) noexcept;
 
     Scalar(const unsigned char* str);
 
@@ -29,7 +33,9 @@ public:
 
     Scalar& set(const Scalar& other);
 
-    Scalar& operator=(const Scalar& other);
+    Scalar& operator=(const Scalar& other) noexcept;
+
+    Scalar& operator=(Scalar&& other) noexcept;
 
     Scalar& operator=(unsigned int i);
 
@@ -122,8 +128,13 @@ private:
     // Constructor from secp object.
     Scalar(const void *value);
 
+public:
+    // Size in bytes of the inline storage for secp256k1_scalar.
+    static constexpr std::size_t storage_size = 32;
+
 private:
-    void *value_; // secp256k1_scalar
+    // secp256k1_scalar, stored inline to avoid a heap allocation per value.
+    alignas(8) unsigned char value_[storage_size];
 
 };
 
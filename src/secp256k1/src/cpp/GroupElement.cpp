@@ -23,12 +23,34 @@
 
 static secp256k1_ecmult_context ctx;
 
+// Returns true if the jacobian value is already in affine form (z == 1),
+// so it can be converted to secp256k1_ge without a field inversion.
+static bool gej_is_affine(const secp256k1_gej &gej)
+{
+    if (gej.infinity) {
+        return true;
+    }
+
+    secp256k1_fe one, z(gej.z);
+    secp256k1_fe_set_int(&one, 1);
+    secp256k1_fe_normalize_var(&z);
+    return secp256k1_fe_equal_var(&z, &one);
+}
+
 // Converts the value from secp256k1_gej to secp256k1_ge and returns.
 static secp256k1_ge gej_to_ge(const secp256k1_gej &gej)
 {
     secp256k1_ge ge;
-    secp256k1_gej j(gej);
-    secp256k1_ge_set_gej(&ge, &j);
+    if (gej_is_affine(gej)) {
+        ge.x = gej.x;
+        ge.y = gej.y;
+        ge.infinity = gej.infinity;
+    } else {
+        secp256k1_gej j(gej);
+        secp256k1_ge_set_gej(&ge, &j);
+    }
+    secp256k1_fe_normalize_var(&ge.x);
+    secp256k1_fe_normalize_var(&ge.y);
     return ge;
 }
 
@@ -159,22 +181,30 @@ static void _negate (uint8_t(&num) [Len])
     }
 }
 
+// Both field implementations fill the storage, the 10x26 one up to the padding of its infinity flag
+static_assert((sizeof(secp256k1_gej) + 7) / 8 * 8 == GroupElement::storage_size, "GroupElement storage doesn't match secp256k1_gej");
+static_assert(alignof(secp256k1_gej) <= 8, "GroupElement storage is not aligned enough for secp256k1_gej");
+
 GroupElement::GroupElement()
-        : g_(new secp256k1_gej())
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
     secp256k1_gej_clear(g);
     g->infinity = 1;
 }
 
-GroupElement::GroupElement(const GroupElement& other)
-        : g_(new secp256k1_gej(*reinterpret_cast<secp256k1_gej *>(other.g_)))
+GroupElement::GroupElement(const GroupElement& other) noexcept
+{
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(other.g_);
+}
+
+GroupElement::GroupElement(GroupElement&& other) noexcept
 {
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(other.g_);
 }
 
 GroupElement::GroupElement(const void *g)
-        : g_(new secp256k1_gej(*reinterpret_cast<const secp256k1_gej *>(g)))
 {
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(g);
 }
 
 static void _convertToFieldElement(secp256k1_fe *r, const char* str, int base) {
@@ -225,7 +255,6 @@ static void _convertToFieldElement(secp256k1_fe *r, const char* str, int base) {
 }
 
 GroupElement::GroupElement(const char* x,const char* y, int base)
-        : g_(new secp256k1_gej())
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
 
@@ -239,17 +268,21 @@ GroupElement::GroupElement(const char* x,const char* y, int base)
 
 GroupElement::~GroupElement()
 {
-    delete reinterpret_cast<secp256k1_gej *>(g_);
 }
 
-GroupElement& GroupElement::operator=(const GroupElement &other)
+GroupElement& GroupElement::operator=(const GroupElement &other) noexcept
+{
+    return set(other);
+}
+
+GroupElement& GroupElement::operator=(GroupElement &&other) noexcept
 {
     return set(other);
 }
 
 GroupElement& GroupElement::set(const GroupElement &other)
 {
-    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<secp256k1_gej *>(other.g_);
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(other.g_);
     return *this;
 }
 
@@ -258,7 +291,7 @@ GroupElement GroupElement::operator*(const Scalar& multiplier) const
     secp256k1_gej result;
     secp256k1_scalar ng;
     secp256k1_scalar_set_int(&ng,0);
-    secp256k1_ecmult(&ctx,&result,reinterpret_cast<secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_scalar *>(multiplier.get_value()),&ng);
+    secp256k1_ecmult(&ctx,&result,reinterpret_cast<const secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_scalar *>(multiplier.get_value()),&ng);
     return &result;
 }
 
@@ -274,21 +307,21 @@ GroupElement& GroupElement::operator*=(const Scalar& multiplier)
 GroupElement GroupElement::operator+(const GroupElement &other) const
 {
     secp256k1_gej result_gej;
-    secp256k1_gej_add_var(&result_gej, reinterpret_cast<secp256k1_gej *>(g_), reinterpret_cast<secp256k1_gej *>(other.g_), NULL);
+    secp256k1_gej_add_var(&result_gej, reinterpret_cast<const secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_gej *>(other.g_), NULL);
     return &result_gej;
 }
 
 GroupElement& GroupElement::operator+=(const GroupElement& other)
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
-    secp256k1_gej_add_var(g, g, reinterpret_cast<secp256k1_gej *>(other.g_), NULL);
+    secp256k1_gej_add_var(g, g, reinterpret_cast<const secp256k1_gej *>(other.g_), NULL);
     return *this;
 }
 
 GroupElement GroupElement::inverse() const
 {
     secp256k1_gej result_gej;
-    secp256k1_gej_neg(&result_gej,reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_gej_neg(&result_gej,reinterpret_cast<const secp256k1_gej *>(g_));
     return &result_gej;
 }
 
@@ -300,8 +333,8 @@ void GroupElement::square()
 
 bool GroupElement::operator==(const  GroupElement& other) const
 {
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
-    auto og = reinterpret_cast<secp256k1_gej *>(other.g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
+    auto og = reinterpret_cast<const secp256k1_gej *>(other.g_);
 
     if(g->infinity && og->infinity)
         return true;
@@ -322,9 +355,21 @@ bool GroupElement::operator!=(const  GroupElement& other) const
     return !(*this == other);
 }
 
+GroupElement& GroupElement::normalize()
+{
+    auto g = reinterpret_cast<secp256k1_gej *>(g_);
+    if (!g->infinity && !gej_is_affine(*g)) {
+        // Store the affine coordinates back with z = 1
+        secp256k1_ge ge;
+        secp256k1_ge_set_gej(&ge, g);
+        secp256k1_gej_set_ge(g, &ge);
+    }
+    return *this;
+}
+
 bool GroupElement::isMember() const
 {
-    secp256k1_ge v1 = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge v1 = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     if (secp256k1_ge_is_infinity(&v1)) {
         return true;
     }
@@ -388,7 +433,7 @@ GroupElement& GroupElement::generate(unsigned char* seed){
 }
 
 void GroupElement::sha256(unsigned char* result) const{
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
     unsigned char buff[64];
     secp256k1_fe_get_b32(&buff[0], &g->x);
     secp256k1_fe_get_b32(&buff[32], &g->y);
@@ -447,7 +492,7 @@ std::string _convertToString(const unsigned char(&buffer) [Len], int base) {
 
 std::string GroupElement::tostring() const {
     int base = 10;
-    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
 
     if (ge.infinity) {
     return std::string("O");
@@ -469,7 +514,7 @@ std::string GroupElement::tostring() const {
 
 std::string GroupElement::GetHex() const {
     int base = 16;
-    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
 
     if (ge.infinity) {
         return std::string("O");
@@ -495,7 +540,7 @@ size_t GroupElement::memoryRequired() const  {
 
 
 unsigned char* GroupElement::serialize() const {
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
     unsigned char* data = new unsigned char[ 2 * sizeof(secp256k1_fe)];
     memcpy(&data[0], &g->x.n[0], sizeof(secp256k1_fe));
     memcpy(&data[0] + sizeof(secp256k1_fe), &g->y.n[0], sizeof(secp256k1_fe));
@@ -503,7 +548,7 @@ unsigned char* GroupElement::serialize() const {
 }
 
 unsigned char* GroupElement::serialize(unsigned char* buffer) const {
-    secp256k1_ge value = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge value = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     secp256k1_fe x = value.x;
     secp256k1_fe y = value.y;
     secp256k1_fe_normalize(&x);
@@ -538,7 +583,7 @@ std::vector<unsigned char> GroupElement::getvch() const {
 
 std::size_t GroupElement::hash() const
 {
-    auto ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    auto ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     std::array<unsigned char, 32 * 2> coord;
 
     if (ge.infinity) {
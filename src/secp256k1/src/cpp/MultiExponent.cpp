@@ -13,70 +13,74 @@
 #include "../src/ecmult_impl.h"
 
 
-typedef struct {
-    secp256k1_scalar *sc;
-    secp256k1_gej *pt;
-} ecmult_multi_data;
-
-int ecmult_multi_callback(secp256k1_scalar *sc, secp256k1_gej *pt, size_t idx, void *cbdata) {
-    ecmult_multi_data *data = (ecmult_multi_data*) cbdata;
-    *sc = data->sc[idx];
-    *pt = data->pt[idx];
-    return 1;
-}
-
 namespace secp_primitives {
 
-MultiExponent::MultiExponent(const MultiExponent& other)
-        : sc_(new secp256k1_scalar[other.n_points])
-        , pt_(new secp256k1_gej[other.n_points])
-        , n_points(other.n_points)
-{
-    for(int i = 0; i < n_points; ++i)
-    {
-        (reinterpret_cast<secp256k1_scalar *>(sc_))[i] = (reinterpret_cast<secp256k1_scalar *>(other.sc_))[i];
-        (reinterpret_cast<secp256k1_gej *>(pt_))[i] = (reinterpret_cast<secp256k1_gej *>(other.pt_))[i];
+namespace {
+
+// Scratch space reused by every multi-exponentiation running on the current
+// thread. Its frame buffers survive between calls, so in steady state
+// verification and proof generation do no scratch allocations at all.
+class ThreadScratch {
+public:
+    ThreadScratch() : scratch(secp256k1_scratch_create(NULL, 0)) {}
+
+    ~ThreadScratch() {
+        secp256k1_scratch_destroy(scratch);
     }
-}
 
-MultiExponent::MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers){
-    sc_ = new secp256k1_scalar[powers.size()];
-    pt_ = new secp256k1_gej[generators.size()];
-    n_points = generators.size();
-    for(int i = 0; i < n_points; ++i)
-    {
-        (reinterpret_cast<secp256k1_scalar *>(sc_))[i] = *reinterpret_cast<const secp256k1_scalar *>(powers[i].get_value());
-        (reinterpret_cast<secp256k1_gej *>(pt_))[i] = *reinterpret_cast<const secp256k1_gej *>(generators[i].get_value());
+    secp256k1_scratch* get(size_t max_size) {
+        scratch->max_size = max_size;
+        return scratch;
     }
+
+private:
+    secp256k1_scratch *scratch;
+};
+
+secp256k1_scratch* get_thread_scratch(size_t max_size) {
+    static thread_local ThreadScratch scratch;
+    return scratch.get(max_size);
 }
 
-MultiExponent::~MultiExponent(){
-    delete []reinterpret_cast<secp256k1_scalar *>(sc_);
-    delete []reinterpret_cast<secp256k1_gej *>(pt_);
+} // namespace
+
+MultiExponent::MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers)
+        : generators_(generators.data())
+        , powers_(powers.data())
+        , n_points(generators.size())
+{
 }
 
-GroupElement MultiExponent::get_multiple() {
+MultiExponent::MultiExponent(const GroupElement* generators, const Scalar* powers, std::size_t n_points)
+        : generators_(generators)
+        , powers_(powers)
+        , n_points(n_points)
+{
+}
+
+GroupElement MultiExponent::get_multiple() const {
     secp256k1_gej r;
 
-    ecmult_multi_data data;
-    data.sc = reinterpret_cast<secp256k1_scalar *>(sc_);
-    data.pt = reinterpret_cast<secp256k1_gej *>(pt_);
+    auto callback = [](secp256k1_scalar *sc, secp256k1_gej *pt, size_t idx, void *cbdata) -> int {
+        const MultiExponent *data = reinterpret_cast<const MultiExponent *>(cbdata);
+        *sc = *reinterpret_cast<const secp256k1_scalar *>(data->powers_[idx].get_value());
+        *pt = *reinterpret_cast<const secp256k1_gej *>(data->generators_[idx].get_value());
+        return 1;
+    };
 
     secp256k1_scratch *scratch;
     if (n_points > ECMULT_PIPPENGER_THRESHOLD) {
         int bucket_window = secp256k1_pippenger_bucket_window(n_points);
         size_t scratch_size = secp256k1_pippenger_scratch_size(n_points, bucket_window);
-        scratch = secp256k1_scratch_create(NULL, scratch_size + PIPPENGER_SCRATCH_OBJECTS*ALIGNMENT);
+        scratch = get_thread_scratch(scratch_size + PIPPENGER_SCRATCH_OBJECTS*ALIGNMENT);
     } else {
         size_t scratch_size = secp256k1_strauss_scratch_size(n_points);
-        scratch = secp256k1_scratch_create(NULL, scratch_size + STRAUSS_SCRATCH_OBJECTS*ALIGNMENT);
+        scratch = get_thread_scratch(scratch_size + STRAUSS_SCRATCH_OBJECTS*ALIGNMENT);
     }
 
     secp256k1_ecmult_context ctx;
 
-    secp256k1_ecmult_multi_var(&ctx, scratch, &r, NULL, ecmult_multi_callback, &data, n_points);
-
-    secp256k1_scratch_destroy(scratch);
+    secp256k1_ecmult_multi_var(&ctx, scratch, &r, NULL, callback, const_cast<MultiExponent *>(this), n_points);
 
     return  reinterpret_cast<secp256k1_scalar *>(&r);
 }
@@ -9,7 +9,10 @@
 #include "txmempool.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
+#include "crypto/common.h"
 #include "crypto/sha256.h"
+#include "memusage.h"
+#include "random.h"
 #include "sigma/coinspend.h"
 #include "sigma/coin.h"
 #include "sigma/remint.h"
@@ -23,6 +26,8 @@
 
 #include <boost/foreach.hpp>
 #include <boost/scope_exit.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <ios>
 
@@ -30,6 +35,101 @@ namespace sigma {
 
 static CSigmaState sigmaState;
 
+namespace {
+
+class CSpendCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Cache of sigma spend proofs verified when the transaction was accepted to mempool, so the proof is not
+ * verified again when the transaction is connected in a block. Works like CSignatureCache
+ */
+class CSpendCache
+{
+private:
+    //! Entries are SHA256(nonce || tx hash || input index || padding flag || anonymity set tip || anonymity set size)
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CSpendCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_spendcache;
+
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+    std::atomic<uint64_t> nEvictions;
+
+public:
+    CSpendCache() : nHits(0), nMisses(0), nEvictions(0)
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256 &hashTx, uint32_t nIn, bool fPadding,
+            const uint256 &setTipHash, uint64_t nSetSize)
+    {
+        unsigned char flag = fPadding ? 1 : 0;
+        unsigned char buf[12];
+        WriteLE32(buf, nIn);
+        WriteLE64(buf + 4, nSetSize);
+        CSHA256().Write(nonce.begin(), 32).Write(hashTx.begin(), 32).Write(buf, 4).Write(&flag, 1)
+            .Write(setTipHash.begin(), 32).Write(buf + 4, 8).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+        if (setValid.count(entry) == 0) {
+            ++nMisses;
+            return false;
+        }
+        ++nHits;
+        return true;
+    }
+
+    void Set(const uint256& entry)
+    {
+        size_t nMaxCacheSize = GetArg("-maxsigmaspendcachesize", DEFAULT_MAX_SIGMA_SPEND_CACHE_SIZE) * ((size_t) 1 << 20);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
+        {
+            map_type::size_type s = GetRand(setValid.bucket_count());
+            map_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+                ++nEvictions;
+            }
+        }
+
+        setValid.insert(entry);
+    }
+
+    CSpendCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+        CSpendCacheStats stats;
+        stats.nEntries = setValid.size();
+        stats.nMemoryUsage = memusage::DynamicUsage(setValid);
+        stats.nHits = nHits;
+        stats.nMisses = nMisses;
+        stats.nEvictions = nEvictions;
+        return stats;
+    }
+};
+
+CSpendCache spendCache;
+
+}
+
+CSpendCacheStats GetSpendCacheStats() {
+    return spendCache.GetStats();
+}
+
 static bool CheckSigmaSpendSerial(
         CValidationState &state,
         CSigmaTxInfo *sigmaTxInfo,
@@ -268,6 +368,7 @@ bool CheckSigmaSpendTransaction(
         // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
         while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
             index = index->pprev;
+        const CBlockIndex *setTip = index;
 
         // Build a vector with all the public coins with given denomination and accumulator id before
         // the block on which the spend occured.
@@ -291,7 +392,21 @@ bool CheckSigmaSpendTransaction(
                 return state.DoS(1, error("Incorrect sigma spend transaction version"));
         }
 
-        passVerify = spend->Verify(anonymity_set, newMetaData, fPadding);
+        // Transactions are verified with nHeight == INT_MAX on mempool acceptance. Remember the result so that
+        // connecting the block (and checking block templates) doesn't have to verify the proof again. Entries are
+        // not erased on connect, stale ones are evicted when the cache is full
+        bool fUseCache = !isVerifyDB && !isCheckWallet;
+        uint256 cacheEntry;
+        if (fUseCache) {
+            spendCache.ComputeEntry(cacheEntry, hashTx, vinIndex, fPadding, setTip->GetBlockHash(), anonymity_set.size());
+            passVerify = spendCache.Get(cacheEntry);
+        }
+
+        if (!passVerify) {
+            passVerify = spend->Verify(anonymity_set, newMetaData, fPadding);
+            if (passVerify && fUseCache && nHeight == INT_MAX)
+                spendCache.Set(cacheEntry);
+        }
         if (passVerify) {
             Scalar serial = spend->getCoinSerialNumber();
             // do not check for duplicates in case we've seen exact copy of this tx in this block before
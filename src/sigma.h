@@ -20,8 +20,22 @@ namespace sigma_mintspend { class sigma_mintspend_test; }
 namespace sigma_partialspend_mempool_tests { class partialspend; }
 namespace zerocoin_tests3_v3 { class zerocoin_mintspend_v3; }
 
+// Limit size of the verified sigma spend cache to 4MB (over 50000 entries on 64-bit systems)
+static const unsigned int DEFAULT_MAX_SIGMA_SPEND_CACHE_SIZE = 4;
+
 namespace sigma {
 
+// Counters of the cache of sigma spends verified on mempool acceptance
+struct CSpendCacheStats {
+    size_t nEntries;
+    size_t nMemoryUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEvictions;
+};
+
+CSpendCacheStats GetSpendCacheStats();
+
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
 // index
 class CSigmaTxInfo {
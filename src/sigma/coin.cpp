@@ -168,6 +168,8 @@ PublicCoin::PublicCoin(const GroupElement& coin, const CoinDenomination d)
     : value(coin)
     , denomination(d)
 {
+    // Stored coins are kept in affine form so lookups and hashing are cheap.
+    value.normalize();
 }
 
 const GroupElement& PublicCoin::getValue() const{
@@ -51,6 +51,22 @@ CoinSpend::CoinSpend(
     updateMetaData(coin, m);
 }
 
+CoinSpend::CoinSpend(
+    const Params* p,
+    CoinDenomination denomination,
+    const uint256& accumulatorBlockHash)
+    :
+    params(p),
+    denomination(denomination),
+    accumulatorBlockHash(accumulatorBlockHash),
+    ecdsaSignature(64, 0),
+    ecdsaPubkey(33, 0),
+    sigmaProof(p->get_n(), p->get_m())
+{
+    sigmaProof.r1Proof_.f_.resize(p->get_m() * (p->get_n() - 1));
+    sigmaProof.Gk_.resize(p->get_m());
+}
+
 void CoinSpend::updateMetaData(const PrivateCoin& coin, const SpendMetaData& m){
     // Proves that the coin is correct w.r.t. serial number and hidden coin secret
     // (This proof is bound to the coin 'metadata', i.e., transaction hash)
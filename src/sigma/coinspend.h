@@ -28,6 +28,12 @@ public:
               const SpendMetaData& m,
               bool fPadding);
 
+    // Constructs a spend with an empty proof that serializes to exactly the
+    // size of a real one. Used to size transactions before proving.
+    CoinSpend(const Params* p,
+              CoinDenomination denomination,
+              const uint256& accumulatorBlockHash);
+
     void updateMetaData(const PrivateCoin& coin, const SpendMetaData& m);
 
     const Scalar& getCoinSerialNumber();
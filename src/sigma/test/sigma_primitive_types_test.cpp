@@ -20,4 +20,28 @@ BOOST_AUTO_TEST_CASE(scalar_test)
     BOOST_CHECK(s == s2);
 }
 
+BOOST_AUTO_TEST_CASE(group_element_normalize_test)
+{
+    // A product is in jacobian coordinates, normalizing it keeps the point.
+    secp_primitives::GroupElement g;
+    g.randomize();
+    g *= secp_primitives::Scalar(123456789);
+    g += g;
+    secp_primitives::GroupElement h(g);
+    h.normalize();
+    BOOST_CHECK(h == g);
+    BOOST_CHECK(h.GetHex() == g.GetHex());
+
+    // Operations on the affine point give the same results.
+    BOOST_CHECK(h + g == g + g);
+    BOOST_CHECK(h * secp_primitives::Scalar(7) == g * secp_primitives::Scalar(7));
+    BOOST_CHECK(h.normalize() == g);
+
+    // The point at infinity stays at infinity.
+    secp_primitives::GroupElement inf(g + g.inverse());
+    BOOST_CHECK(inf.isInfinity());
+    inf.normalize();
+    BOOST_CHECK(inf.isInfinity());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
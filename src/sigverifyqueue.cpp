@@ -0,0 +1,152 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigverifyqueue.h"
+
+#include "darksend.h"
+#include "net.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+
+CSignatureVerifyQueue sigVerifyQueue;
+
+static void ReleaseNode(CNode* pfrom)
+{
+    if (!pfrom)
+        return;
+    LOCK(cs_vNodes);
+    pfrom->Release();
+}
+
+void CSignatureVerifyQueue::Start(int nThreadsIn, boost::thread_group& threadGroup)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads = nThreadsIn;
+    }
+    for (int i = 0; i < nThreadsIn; i++)
+        threadGroup.create_thread(boost::bind(&CSignatureVerifyQueue::Thread, this));
+}
+
+void CSignatureVerifyQueue::Thread()
+{
+    RenameThread("index-sigverify");
+    while (true) {
+        std::shared_ptr<CEntry> entry;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (vTodo.empty())
+                cond.wait(lock);
+            entry = vTodo.front();
+            vTodo.pop_front();
+            entry->state = ENTRY_CHECKING;
+        }
+
+        std::string strError;
+        bool fValid = darkSendSigner.VerifyMessage(entry->pubkey, entry->vchSig, entry->strMessage, strError);
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            entry->state = fValid ? ENTRY_VALID : ENTRY_INVALID;
+            // Whoever is applying the results picks this one up once it's at the front
+            if (fApplying || vEntries.front() != entry)
+                continue;
+            fApplying = true;
+        }
+        ApplyResults();
+    }
+}
+
+// Run the callbacks of the checked messages at the front of the queue. Requires fApplying to be set by the caller
+void CSignatureVerifyQueue::ApplyResults()
+{
+    while (true) {
+        std::shared_ptr<CEntry> entry;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vEntries.empty() || vEntries.front()->state < ENTRY_VALID) {
+                fApplying = false;
+                return;
+            }
+            entry = vEntries.front();
+            vEntries.pop_front();
+            setHashes.erase(entry->hash);
+        }
+
+        try {
+            entry->callback(entry->pfrom, entry->state == ENTRY_VALID);
+        } catch (const boost::thread_interrupted&) {
+            ReleaseNode(entry->pfrom);
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fApplying = false;
+            throw;
+        } catch (const std::exception& e) {
+            PrintExceptionContinue(&e, "CSignatureVerifyQueue::ApplyResults()");
+        }
+        ReleaseNode(entry->pfrom);
+    }
+}
+
+void CSignatureVerifyQueue::Clear()
+{
+    std::deque<std::shared_ptr<CEntry> > vDropped;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        vDropped.swap(vEntries);
+        vTodo.clear();
+        setHashes.clear();
+        nThreads = 0;
+        fApplying = false;
+    }
+    for (const std::shared_ptr<CEntry>& entry : vDropped)
+        ReleaseNode(entry->pfrom);
+}
+
+bool CSignatureVerifyQueue::IsRunning()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nThreads > 0;
+}
+
+size_t CSignatureVerifyQueue::size()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return vEntries.size();
+}
+
+bool CSignatureVerifyQueue::Push(CNode* pfrom, const uint256& hash, const CPubKey& pubkey,
+                                 const std::vector<unsigned char>& vchSig, const std::string& strMessage,
+                                 const Callback& callback)
+{
+    std::shared_ptr<CEntry> entry(new CEntry);
+    entry->hash = hash;
+    entry->pfrom = pfrom;
+    entry->pubkey = pubkey;
+    entry->vchSig = vchSig;
+    entry->strMessage = strMessage;
+    entry->callback = callback;
+    entry->state = ENTRY_QUEUED;
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nThreads > 0) {
+            if (!setHashes.insert(hash).second) {
+                LogPrint("indexnode", "CSignatureVerifyQueue::Push -- hash=%s queued already\n", hash.ToString());
+                return false;
+            }
+            // The caller holds a reference to the node, so it doesn't go away meanwhile
+            if (pfrom)
+                pfrom->AddRef();
+            vEntries.push_back(entry);
+            vTodo.push_back(entry);
+            cond.notify_one();
+            return true;
+        }
+    }
+
+    std::string strError;
+    callback(pfrom, darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, strError));
+    return true;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SIGVERIFYQUEUE_H
+#define SIGVERIFYQUEUE_H
+
+#include "pubkey.h"
+#include "uint256.h"
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class CNode;
+class CSignatureVerifyQueue;
+
+/** -sigverifythreads default (threads checking indexnode message signatures, 0 = check them inline) */
+static const int DEFAULT_SIGVERIFY_THREADS = 2;
+static const int MAX_SIGVERIFY_THREADS = 16;
+
+extern CSignatureVerifyQueue sigVerifyQueue;
+
+/**
+ * Checks the compact signatures of indexnode messages on worker threads. Handlers run the cheap checks of a message
+ * and push its signature, the workers recover the public keys in parallel and the results are applied in the order
+ * the messages were pushed: each message's callback runs once its signature and those of all messages pushed before
+ * it were checked. Messages of a hash which is still queued are dropped.
+ */
+class CSignatureVerifyQueue
+{
+public:
+    //! Applies a message, called with the peer it came from (may be NULL) and whether its signature is valid
+    typedef boost::function<void(CNode* pfrom, bool fValid)> Callback;
+
+private:
+    enum EntryState {
+        ENTRY_QUEUED,
+        ENTRY_CHECKING,
+        ENTRY_VALID,
+        ENTRY_INVALID
+    };
+
+    struct CEntry
+    {
+        uint256 hash;
+        CNode* pfrom;
+        CPubKey pubkey;
+        std::vector<unsigned char> vchSig;
+        std::string strMessage;
+        Callback callback;
+        EntryState state;
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Messages in the order they were pushed, until their callbacks ran
+    std::deque<std::shared_ptr<CEntry> > vEntries;
+    //! Messages whose signatures no worker picked up yet
+    std::deque<std::shared_ptr<CEntry> > vTodo;
+    std::set<uint256> setHashes;
+    int nThreads;
+    //! A thread is running callbacks, the others leave the results to it
+    bool fApplying;
+
+    void ApplyResults();
+
+public:
+    CSignatureVerifyQueue() : nThreads(0), fApplying(false) {}
+
+    void Start(int nThreadsIn, boost::thread_group& threadGroup);
+    //! Worker loop, ends when the thread is interrupted
+    void Thread();
+    //! Drop the queued messages once the workers were stopped
+    void Clear();
+
+    bool IsRunning();
+    size_t size();
+
+    /**
+     * Queue the signature check of a message and run its callback once it's done, false if a message of the hash
+     * is queued already. Without workers the signature is checked and the callback runs right away.
+     */
+    bool Push(CNode* pfrom, const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig,
+              const std::string& strMessage, const Callback& callback);
+};
+
+#endif // SIGVERIFYQUEUE_H
@@ -0,0 +1,294 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "socketevents.h"
+
+#include "netbase.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <map>
+#include <set>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_EPOLL;
+#else
+const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_SELECT;
+#endif
+
+namespace {
+
+/** Portable fallback, rebuilds the fd_sets from the registered sockets on every wait */
+class CSelectSocketEvents : public CSocketEvents
+{
+private:
+    std::map<SOCKET, int> mapInterest;
+
+public:
+    const char *GetName() const
+    {
+        return "select";
+    }
+
+    bool CanWait(SOCKET hSocket) const
+    {
+        return IsSelectableSocket(hSocket);
+    }
+
+    bool Add(SOCKET hSocket, int nInterest, bool fListen)
+    {
+        if (!CanWait(hSocket))
+            return false;
+        // A descriptor closed elsewhere may be reused before its old registration was removed
+        mapInterest[hSocket] = nInterest;
+        return true;
+    }
+
+    bool Modify(SOCKET hSocket, int nInterest)
+    {
+        std::map<SOCKET, int>::iterator it = mapInterest.find(hSocket);
+        if (it == mapInterest.end())
+            return false;
+        it->second = nInterest;
+        return true;
+    }
+
+    void Remove(SOCKET hSocket)
+    {
+        mapInterest.erase(hSocket);
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<std::pair<SOCKET, int> > &vReady)
+    {
+        vReady.clear();
+        if (mapInterest.empty()) {
+            // Not every platform can select() without any socket
+            MilliSleep(nTimeout);
+            return true;
+        }
+
+        struct timeval timeout = MillisToTimeval(nTimeout);
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+
+        for (std::map<SOCKET, int>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            if (it->second & EVENT_RECV)
+                FD_SET(it->first, &fdsetRecv);
+            if (it->second & EVENT_SEND)
+                FD_SET(it->first, &fdsetSend);
+            FD_SET(it->first, &fdsetError);
+            hSocketMax = std::max(hSocketMax, it->first);
+        }
+
+        int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (nSelect == SOCKET_ERROR) {
+            for (std::map<SOCKET, int>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it)
+                vReady.push_back(std::make_pair(it->first, (int)EVENT_RECV));
+            return false;
+        }
+
+        for (std::map<SOCKET, int>::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            int nEvents = 0;
+            if (FD_ISSET(it->first, &fdsetRecv))
+                nEvents |= EVENT_RECV;
+            if (FD_ISSET(it->first, &fdsetSend))
+                nEvents |= EVENT_SEND;
+            if (FD_ISSET(it->first, &fdsetError))
+                nEvents |= EVENT_ERROR;
+            if (nEvents)
+                vReady.push_back(std::make_pair(it->first, nEvents));
+        }
+        return true;
+    }
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+/** Linux epoll, the kernel keeps the interest list so a wait costs only as much as there are ready sockets */
+class CEpollSocketEvents : public CSocketEvents
+{
+private:
+    //! Most sockets reported by one wait, the rest are reported by the next one
+    static const int MAX_EVENTS = 256;
+
+    int fdEpoll;
+    struct epoll_event events[MAX_EVENTS];
+    //! The registered sockets, reported as ready when waiting fails
+    std::set<SOCKET> setSockets;
+
+    static uint32_t GetEpollEvents(int nInterest, bool fListen)
+    {
+        uint32_t nEvents = 0;
+        if (nInterest & EVENT_RECV)
+            nEvents |= EPOLLIN;
+        if (nInterest & EVENT_SEND)
+            nEvents |= EPOLLOUT;
+        // accept() takes one connection at a time, so listening sockets have to be reported for as long as the
+        // backlog isn't empty
+        if (!fListen)
+            nEvents |= EPOLLET | EPOLLRDHUP;
+        return nEvents;
+    }
+
+    bool Control(int nOp, SOCKET hSocket, uint32_t nEvents)
+    {
+        struct epoll_event event;
+        event.events = nEvents;
+        event.data.fd = hSocket;
+        if (epoll_ctl(fdEpoll, nOp, hSocket, &event) != 0) {
+            LogPrint("net", "epoll_ctl %d for socket %d failed: %s\n", nOp, hSocket, NetworkErrorString(errno));
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit CEpollSocketEvents(int fdEpollIn) : fdEpoll(fdEpollIn) {}
+
+    ~CEpollSocketEvents()
+    {
+        close(fdEpoll);
+    }
+
+    const char *GetName() const
+    {
+        return "epoll";
+    }
+
+    bool CanWait(SOCKET hSocket) const
+    {
+        return hSocket != INVALID_SOCKET;
+    }
+
+    bool Add(SOCKET hSocket, int nInterest, bool fListen)
+    {
+        if (!Control(EPOLL_CTL_ADD, hSocket, GetEpollEvents(nInterest, fListen)))
+            return false;
+        setSockets.insert(hSocket);
+        return true;
+    }
+
+    bool Modify(SOCKET hSocket, int nInterest)
+    {
+        // Re-arms the edge trigger, a socket which is ready already is reported by the next wait
+        return Control(EPOLL_CTL_MOD, hSocket, GetEpollEvents(nInterest, false));
+    }
+
+    void Remove(SOCKET hSocket)
+    {
+        // Closing a socket removes it from the epoll set, so this fails for sockets closed elsewhere
+        struct epoll_event event;
+        epoll_ctl(fdEpoll, EPOLL_CTL_DEL, hSocket, &event);
+        setSockets.erase(hSocket);
+    }
+
+    bool Wait(int64_t nTimeout, std::vector<std::pair<SOCKET, int> > &vReady)
+    {
+        vReady.clear();
+
+        int nReady = epoll_wait(fdEpoll, events, MAX_EVENTS, (int)nTimeout);
+        if (nReady < 0) {
+            if (errno == EINTR)
+                return true;
+            int nErr = errno;
+            for (std::set<SOCKET>::const_iterator it = setSockets.begin(); it != setSockets.end(); ++it)
+                vReady.push_back(std::make_pair(*it, (int)EVENT_RECV));
+            errno = nErr;
+            return false;
+        }
+
+        for (int i = 0; i < nReady; i++) {
+            int nEvents = 0;
+            if (events[i].events & EPOLLIN)
+                nEvents |= EVENT_RECV;
+            if (events[i].events & EPOLLOUT)
+                nEvents |= EVENT_SEND;
+            if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+                nEvents |= EVENT_ERROR;
+            vReady.push_back(std::make_pair((SOCKET)events[i].data.fd, nEvents));
+        }
+        return true;
+    }
+};
+#endif // HAVE_SYS_EPOLL_H
+
+}
+
+CSocketEvents *CreateSocketEvents(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT:
+        return new CSelectSocketEvents();
+    case SOCKETEVENTS_EPOLL:
+#ifdef HAVE_SYS_EPOLL_H
+    {
+        int fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (fdEpoll < 0) {
+            LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(errno));
+            return NULL;
+        }
+        return new CEpollSocketEvents(fdEpoll);
+    }
+#else
+        return NULL;
+#endif
+    }
+    return NULL;
+}
+
+bool ParseSocketEventsMode(const std::string &strMode, SocketEventsMode &mode)
+{
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT:
+        return "select";
+    case SOCKETEVENTS_EPOLL:
+        return "epoll";
+    }
+    return "unknown";
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+bool CanWaitForSocket(SocketEventsMode mode, SOCKET hSocket)
+{
+    if (mode == SOCKETEVENTS_SELECT)
+        return IsSelectableSocket(hSocket);
+    return hSocket != INVALID_SOCKET;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SOCKETEVENTS_H
+#define BITCOIN_SOCKETEVENTS_H
+
+#include "compat.h"
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** How the socket handler thread waits for the peer sockets */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1
+};
+
+//! -socketevents default, epoll where it is available
+extern const SocketEventsMode DEFAULT_SOCKETEVENTS;
+
+/**
+ * Readiness notifications for a set of sockets. The sockets and what is waited for on each of them are kept by the
+ * backend between waits, so only changes have to be passed on.
+ *
+ * Peer sockets are edge triggered where the backend supports it: a socket is reported once when it becomes ready and
+ * not again until new data arrives or send buffer space is freed. The caller has to remember the readiness until the
+ * socket was drained. Listening sockets are always level triggered.
+ */
+class CSocketEvents
+{
+public:
+    enum {
+        EVENT_RECV = 1,
+        EVENT_SEND = 2,
+        EVENT_ERROR = 4
+    };
+
+    virtual ~CSocketEvents() {}
+
+    virtual const char *GetName() const = 0;
+
+    //! Whether the backend can wait for the socket at all (select() is limited to descriptors below FD_SETSIZE)
+    virtual bool CanWait(SOCKET hSocket) const = 0;
+
+    //! Start waiting for the socket, nInterest is a combination of EVENT_RECV and EVENT_SEND
+    virtual bool Add(SOCKET hSocket, int nInterest, bool fListen) = 0;
+    virtual bool Modify(SOCKET hSocket, int nInterest) = 0;
+
+    //! Stop waiting for the socket, which may have been closed already
+    virtual void Remove(SOCKET hSocket) = 0;
+
+    /**
+     * Wait until at least one socket is ready or the timeout expires, and return the ready sockets with their events.
+     * Errors (EVENT_ERROR) are always reported. Returns false if waiting failed, in which case every socket is
+     * reported as ready to receive so that broken sockets are found by the caller.
+     */
+    virtual bool Wait(int64_t nTimeout, std::vector<std::pair<SOCKET, int> > &vReady) = 0;
+};
+
+/** Create a backend for the mode, NULL if the mode isn't supported on this platform */
+CSocketEvents *CreateSocketEvents(SocketEventsMode mode);
+
+bool ParseSocketEventsMode(const std::string &strMode, SocketEventsMode &mode);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+
+/** The modes supported on this platform, for the help message */
+std::string GetSupportedSocketEventsModes();
+
+/** Whether a backend of the mode could wait for the socket, usable before the backend is created */
+bool CanWaitForSocket(SocketEventsMode mode, SOCKET hSocket);
+
+#endif // BITCOIN_SOCKETEVENTS_H
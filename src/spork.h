@@ -44,6 +44,8 @@ static const int64_t SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT             = 407090
 static const int64_t SPORK_15_BLACKLIST_ENABLED_DEFAULT                 = 0;// ON by default
 
 extern std::map<uint256, CSporkMessage> mapSporks;
+// protects mapSporks and CSporkManager::mapSporksActive, sporks are read by the message workers
+extern CCriticalSection cs_mapSporks;
 
 //
 // Spork classes
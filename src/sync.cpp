@@ -9,6 +9,12 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <tuple>
+
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
@@ -20,6 +26,218 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+#ifdef DEBUG_LOCKSTATS
+//
+// Lock statistics.
+// Every LOCK site claims a slot of a fixed table when it is first reached,
+// found again by the addresses of its lock name and file and its line. The
+// counters are atomics, so that recording an acquisition takes no lock of
+// its own. Slots are never freed, like the sites themselves.
+//
+
+struct CLockSite
+{
+    std::atomic<int> nState; // 0 free, 1 being claimed, 2 in use
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nTryFailed;
+    std::atomic<int64_t> nWaitTotal;
+    std::atomic<int64_t> nWaitMax;
+    std::atomic<int64_t> nHoldTotal;
+    std::atomic<int64_t> nHoldMax;
+    std::atomic<uint64_t> waitHistogram[LOCKSTATS_BUCKETS];
+    std::atomic<uint64_t> holdHistogram[LOCKSTATS_BUCKETS];
+};
+
+static const size_t LOCK_SITE_SLOTS = 4096;
+static CLockSite lockSites[LOCK_SITE_SLOTS];
+// shared by the sites which no longer fit into the table
+static CLockSite lockSiteOverflow;
+
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine)
+{
+    size_t nHash = ((size_t)pszFile >> 3) ^ ((size_t)pszName >> 3) ^ ((size_t)nLine * 2654435761u);
+    for (size_t i = 0; i < LOCK_SITE_SLOTS; i++) {
+        CLockSite& site = lockSites[(nHash + i) % LOCK_SITE_SLOTS];
+        int nState = site.nState.load(std::memory_order_acquire);
+        if (nState == 0 && site.nState.compare_exchange_strong(nState, 1)) {
+            site.pszName = pszName;
+            site.pszFile = pszFile;
+            site.nLine = nLine;
+            site.nState.store(2, std::memory_order_release);
+            return &site;
+        }
+        // another thread is filling in the slot
+        while (nState == 1)
+            nState = site.nState.load(std::memory_order_acquire);
+        if (site.pszName == pszName && site.pszFile == pszFile && site.nLine == nLine)
+            return &site;
+    }
+    return &lockSiteOverflow;
+}
+
+static int LockStatsBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCKSTATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+static void UpdateMax(std::atomic<int64_t>& nMax, int64_t nValue)
+{
+    int64_t nCurrent = nMax.load(std::memory_order_relaxed);
+    while (nValue > nCurrent && !nMax.compare_exchange_weak(nCurrent, nValue, std::memory_order_relaxed))
+        ;
+}
+
+void RecordLockAcquired(CLockSite* site, int64_t nWaitMicros, bool fContended)
+{
+    site->nAcquired.fetch_add(1, std::memory_order_relaxed);
+    if (fContended)
+        site->nContended.fetch_add(1, std::memory_order_relaxed);
+    site->nWaitTotal.fetch_add(nWaitMicros, std::memory_order_relaxed);
+    UpdateMax(site->nWaitMax, nWaitMicros);
+    site->waitHistogram[LockStatsBucket(nWaitMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordLockReleased(CLockSite* site, int64_t nHoldMicros)
+{
+    site->nHoldTotal.fetch_add(nHoldMicros, std::memory_order_relaxed);
+    UpdateMax(site->nHoldMax, nHoldMicros);
+    site->holdHistogram[LockStatsBucket(nHoldMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordLockTryFailed(CLockSite* site)
+{
+    site->nTryFailed.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t LockStatsTimeMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void AddLockSite(CLockSiteStats& stats, const CLockSite& site)
+{
+    stats.nAcquired += site.nAcquired.load(std::memory_order_relaxed);
+    stats.nContended += site.nContended.load(std::memory_order_relaxed);
+    stats.nTryFailed += site.nTryFailed.load(std::memory_order_relaxed);
+    stats.nWaitTotal += site.nWaitTotal.load(std::memory_order_relaxed);
+    stats.nWaitMax = std::max(stats.nWaitMax, site.nWaitMax.load(std::memory_order_relaxed));
+    stats.nHoldTotal += site.nHoldTotal.load(std::memory_order_relaxed);
+    stats.nHoldMax = std::max(stats.nHoldMax, site.nHoldMax.load(std::memory_order_relaxed));
+    for (int i = 0; i < LOCKSTATS_BUCKETS; i++) {
+        stats.waitHistogram[i] += site.waitHistogram[i].load(std::memory_order_relaxed);
+        stats.holdHistogram[i] += site.holdHistogram[i].load(std::memory_order_relaxed);
+    }
+}
+
+static bool CompareLockWait(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nWaitTotal > b.nWaitTotal;
+}
+
+std::vector<CLockSiteStats> GetLockStats()
+{
+    // headers have a copy of their file name in every translation unit
+    std::map<std::tuple<std::string, std::string, int>, CLockSiteStats> mapSites;
+    for (size_t i = 0; i <= LOCK_SITE_SLOTS; i++) {
+        const CLockSite& site = i < LOCK_SITE_SLOTS ? lockSites[i] : lockSiteOverflow;
+        if (&site == &lockSiteOverflow) {
+            if (site.nAcquired.load() == 0 && site.nTryFailed.load() == 0)
+                continue;
+        } else if (site.nState.load(std::memory_order_acquire) != 2)
+            continue;
+
+        std::string strName = site.pszName ? site.pszName : "(other)";
+        std::string strFile = site.pszFile ? site.pszFile : "";
+        std::map<std::tuple<std::string, std::string, int>, CLockSiteStats>::iterator it =
+            mapSites.find(std::make_tuple(strName, strFile, site.nLine));
+        if (it == mapSites.end()) {
+            CLockSiteStats stats;
+            memset(stats.waitHistogram, 0, sizeof(stats.waitHistogram));
+            memset(stats.holdHistogram, 0, sizeof(stats.holdHistogram));
+            stats.strName = strName;
+            stats.strFile = strFile;
+            stats.nLine = site.nLine;
+            stats.nAcquired = stats.nContended = stats.nTryFailed = 0;
+            stats.nWaitTotal = stats.nWaitMax = stats.nHoldTotal = stats.nHoldMax = 0;
+            it = mapSites.insert(std::make_pair(std::make_tuple(strName, strFile, site.nLine), stats)).first;
+        }
+        AddLockSite(it->second, site);
+    }
+
+    std::vector<CLockSiteStats> vSites;
+    for (std::map<std::tuple<std::string, std::string, int>, CLockSiteStats>::const_iterator it = mapSites.begin(); it != mapSites.end(); ++it)
+        vSites.push_back(it->second);
+    std::sort(vSites.begin(), vSites.end(), CompareLockWait);
+    return vSites;
+}
+
+static void ResetLockSite(CLockSite& site)
+{
+    site.nAcquired = 0;
+    site.nContended = 0;
+    site.nTryFailed = 0;
+    site.nWaitTotal = 0;
+    site.nWaitMax = 0;
+    site.nHoldTotal = 0;
+    site.nHoldMax = 0;
+    for (int i = 0; i < LOCKSTATS_BUCKETS; i++) {
+        site.waitHistogram[i] = 0;
+        site.holdHistogram[i] = 0;
+    }
+}
+
+void ResetLockStats()
+{
+    for (size_t i = 0; i < LOCK_SITE_SLOTS; i++)
+        ResetLockSite(lockSites[i]);
+    ResetLockSite(lockSiteOverflow);
+}
+
+void LogLockStats(size_t nTop)
+{
+    std::vector<CLockSiteStats> vSites = GetLockStats();
+
+    std::map<std::string, CLockSiteStats> mapLocks;
+    for (size_t i = 0; i < vSites.size(); i++) {
+        std::map<std::string, CLockSiteStats>::iterator it = mapLocks.find(vSites[i].strName);
+        if (it == mapLocks.end()) {
+            mapLocks.insert(std::make_pair(vSites[i].strName, vSites[i]));
+            continue;
+        }
+        CLockSiteStats& lock = it->second;
+        lock.nAcquired += vSites[i].nAcquired;
+        lock.nContended += vSites[i].nContended;
+        lock.nWaitTotal += vSites[i].nWaitTotal;
+        lock.nWaitMax = std::max(lock.nWaitMax, vSites[i].nWaitMax);
+        lock.nHoldTotal += vSites[i].nHoldTotal;
+        lock.nHoldMax = std::max(lock.nHoldMax, vSites[i].nHoldMax);
+    }
+    std::vector<CLockSiteStats> vLocks;
+    for (std::map<std::string, CLockSiteStats>::const_iterator it = mapLocks.begin(); it != mapLocks.end(); ++it)
+        vLocks.push_back(it->second);
+    std::sort(vLocks.begin(), vLocks.end(), CompareLockWait);
+
+    LogPrintf("Lock statistics since startup or the last reset, by total wait:\n");
+    for (size_t i = 0; i < vLocks.size() && i < nTop; i++)
+        LogPrintf("  %s: acquired %u times, %u contended, waited %.3fs (max %dus), held %.3fs (max %dus)\n",
+            vLocks[i].strName, vLocks[i].nAcquired, vLocks[i].nContended,
+            vLocks[i].nWaitTotal * 0.000001, vLocks[i].nWaitMax, vLocks[i].nHoldTotal * 0.000001, vLocks[i].nHoldMax);
+    for (size_t i = 0; i < vSites.size() && i < nTop; i++)
+        LogPrintf("  %s at %s:%d: acquired %u times, %u contended, waited %.3fs (max %dus), held %.3fs (max %dus)\n",
+            vSites[i].strName, vSites[i].strFile, vSites[i].nLine, vSites[i].nAcquired, vSites[i].nContended,
+            vSites[i].nWaitTotal * 0.000001, vSites[i].nWaitMax, vSites[i].nHoldTotal * 0.000001, vSites[i].nHoldMax);
+}
+#endif /* DEBUG_LOCKSTATS */
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -13,6 +13,10 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 
 ////////////////////////////////////////////////
 //                                            //
@@ -108,23 +112,86 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+#ifdef DEBUG_LOCKSTATS
+struct CLockSite;
+/** The counters of a LOCK/LOCK2/TRY_LOCK site, created when it is first reached */
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine);
+void RecordLockAcquired(CLockSite* site, int64_t nWaitMicros, bool fContended);
+void RecordLockReleased(CLockSite* site, int64_t nHoldMicros);
+void RecordLockTryFailed(CLockSite* site);
+/** Monotonic clock used for the lock statistics */
+int64_t LockStatsTimeMicros();
+
+static const int LOCKSTATS_BUCKETS = 24;
+
+/**
+ * Acquisitions at one site. Bucket 0 of the histograms counts waits or holds
+ * below 1 microsecond, bucket i those from 2^(i-1) below 2^i microseconds and
+ * the last bucket everything longer.
+ */
+struct CLockSiteStats
+{
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nAcquired;
+    uint64_t nContended; //!< acquisitions which had to wait for another thread
+    uint64_t nTryFailed;
+    int64_t nWaitTotal;
+    int64_t nWaitMax;
+    int64_t nHoldTotal;
+    int64_t nHoldMax;
+    uint64_t waitHistogram[LOCKSTATS_BUCKETS];
+    uint64_t holdHistogram[LOCKSTATS_BUCKETS];
+};
+
+/** All sites reached so far, sites of the same file and line are merged */
+std::vector<CLockSiteStats> GetLockStats();
+void ResetLockStats();
+//! -lockstatsinterval default, seconds between the lock statistics written to the log
+static const int64_t DEFAULT_LOCKSTATS_INTERVAL = 600;
+//! Locks and sites of each log summary
+static const size_t LOCKSTATS_LOG_TOP = 10;
+
+/** Log the locks and sites with the longest total wait */
+void LogLockStats(size_t nTop);
+#endif
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+#ifdef DEBUG_LOCKSTATS
+    CLockSite* pLockSite;
+    int64_t nLockedTime;
+#endif
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
+#ifdef DEBUG_LOCKSTATS
+        pLockSite = GetLockSite(pszName, pszFile, nLine);
+        int64_t nWaitStart = LockStatsTimeMicros();
+        bool fContended = false;
+#endif
+#if defined(DEBUG_LOCKCONTENTION) || defined(DEBUG_LOCKSTATS)
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
+#endif
+#ifdef DEBUG_LOCKSTATS
+            fContended = true;
+#endif
 #endif
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+#if defined(DEBUG_LOCKCONTENTION) || defined(DEBUG_LOCKSTATS)
         }
+#endif
+#ifdef DEBUG_LOCKSTATS
+        nLockedTime = LockStatsTimeMicros();
+        RecordLockAcquired(pLockSite, nLockedTime - nWaitStart, fContended);
 #endif
     }
 
@@ -132,6 +199,14 @@ private:
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
         lock.try_lock();
+#ifdef DEBUG_LOCKSTATS
+        pLockSite = GetLockSite(pszName, pszFile, nLine);
+        if (lock.owns_lock()) {
+            nLockedTime = LockStatsTimeMicros();
+            RecordLockAcquired(pLockSite, 0, false);
+        } else
+            RecordLockTryFailed(pLockSite);
+#endif
         if (!lock.owns_lock())
             LeaveCritical();
         return lock.owns_lock();
@@ -159,8 +234,12 @@ public:
 
     ~CMutexLock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+#ifdef DEBUG_LOCKSTATS
+            RecordLockReleased(pLockSite, LockStatsTimeMicros() - nLockedTime);
+#endif
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -0,0 +1,92 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockstore.h"
+#include "clientversion.h"
+#include "main.h"
+#include "streams.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockstore_tests, TestingSetup)
+
+static const int TEST_FILE = 99999;
+
+static void WriteTestFile(const std::vector<char> &data)
+{
+    CAutoFile fileout(OpenBlockFile(CDiskBlockPos(TEST_FILE, 0)), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!fileout.IsNull());
+    fileout.write(data.data(), data.size());
+}
+
+BOOST_AUTO_TEST_CASE(blockstore_reader)
+{
+    // Bigger than the reader buffer so both buffered and direct reads are exercised
+    std::vector<char> data(200000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 7);
+    WriteTestFile(data);
+
+    CBlockFileReader reader(OpenBlockFileReader(CDiskBlockPos(TEST_FILE, 10)));
+    BOOST_REQUIRE(!reader.IsNull());
+
+    char small[5];
+    reader.read(small, sizeof(small));
+    BOOST_CHECK(std::equal(small, small + sizeof(small), data.begin() + 10));
+
+    reader.ignore(1000);
+    BOOST_CHECK_EQUAL(reader.GetPos(), 1015U);
+
+    std::vector<char> large(100000);
+    reader.read(large.data(), large.size());
+    BOOST_CHECK(std::equal(large.begin(), large.end(), data.begin() + 1015));
+
+    uint32_t n;
+    reader >> n;
+    CDataStream ss(&data[101015], &data[101019], SER_DISK, CLIENT_VERSION);
+    uint32_t nExpected;
+    ss >> nExpected;
+    BOOST_CHECK_EQUAL(n, nExpected);
+
+    reader.ignore(data.size());
+    BOOST_CHECK_THROW(reader.read(small, 1), std::ios_base::failure);
+
+    blockFileStore.Close(CBlockFileStore::BLOCK_FILE, TEST_FILE);
+}
+
+BOOST_AUTO_TEST_CASE(blockstore_sees_appended_data)
+{
+    std::vector<char> data(100, 'a');
+    WriteTestFile(data);
+
+    std::shared_ptr<CBlockFileHandle> handle = blockFileStore.Open(CBlockFileStore::BLOCK_FILE, TEST_FILE);
+    BOOST_REQUIRE(handle);
+    BOOST_CHECK(blockFileStore.Open(CBlockFileStore::BLOCK_FILE, TEST_FILE) == handle);
+
+    {
+        CAutoFile fileout(OpenBlockFile(CDiskBlockPos(TEST_FILE, 100)), SER_DISK, CLIENT_VERSION);
+        fileout.write("bcd", 3);
+    }
+
+    char buf[3];
+    BOOST_CHECK_EQUAL(handle->ReadAt(buf, sizeof(buf), 100), 3U);
+    BOOST_CHECK(std::string(buf, 3) == "bcd");
+
+    blockFileStore.Close(CBlockFileStore::BLOCK_FILE, TEST_FILE);
+    BOOST_CHECK(blockFileStore.Open(CBlockFileStore::BLOCK_FILE, TEST_FILE) != handle);
+    blockFileStore.Close(CBlockFileStore::BLOCK_FILE, TEST_FILE);
+
+    // An open handle stays usable after it is dropped from the store
+    BOOST_CHECK_EQUAL(handle->ReadAt(buf, 1, 0), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(blockstore_missing_file)
+{
+    BOOST_CHECK(OpenBlockFileReader(CDiskBlockPos(TEST_FILE + 1, 0)).IsNull());
+    BOOST_CHECK(OpenUndoFileReader(CDiskBlockPos()).IsNull());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,9 @@
 #include "test/test_bitcoin.h"
 #include "main.h"
 #include "consensus/validation.h"
+#include "txdb.h"
+#include "test/fixtures.h"
+#include "wallet/wallet.h"
 
 #include <vector>
 #include <map>
@@ -82,6 +85,55 @@ public:
 
 };
 
+class CCoinsViewDBTest : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBTest() : CCoinsViewDB(1 << 20, true, true) {}
+
+    //! Store coins in the per-transaction format of older versions
+    void WriteLegacyCoins(const uint256& txid, const CCoins& coins)
+    {
+        BOOST_CHECK(db.Write(std::make_pair('c', txid), coins));
+    }
+
+    //! Number of per-output records
+    size_t CountOutputRecords()
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+        size_t n = 0;
+        for (pcursor->Seek('C'); pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != 'C')
+                break;
+            n++;
+        }
+        return n;
+    }
+
+    //! Mark the database as being between two best blocks, as an interrupted batched write does
+    void WriteHeadBlocks(const uint256& hashNew, const uint256& hashOld)
+    {
+        std::vector<uint256> vhashHeads;
+        vhashHeads.push_back(hashNew);
+        vhashHeads.push_back(hashOld);
+        BOOST_CHECK(db.Write('H', vhashHeads));
+    }
+};
+
+CMutableTransaction CreateCoinsTestTransaction(unsigned int nOutputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        tx.vout[i].nValue = 1000 + i;
+        tx.vout[i].scriptPubKey = CScript() << OP_TRUE;
+    }
+    return tx;
+}
+
 }
 
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
@@ -415,4 +467,261 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(coins_db_per_output, TestingSetup)
+{
+    CCoinsViewDBTest db;
+    // More than 64 outputs, more than fit in a machine word of availability flags
+    CTransaction tx = CreateCoinsTestTransaction(70);
+    uint256 txid = tx.GetHash();
+
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyNewCoins(txid, false)->FromTx(tx, 10);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 70U);
+    CCoins coins;
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK(coins == CCoins(tx, 10));
+    BOOST_CHECK(db.HaveCoins(txid));
+
+    // Spend an output through a stack of caches, with the parent cache flushed in between
+    {
+        CCoinsViewCache parent(&db);
+        CCoinsViewCache child(&parent);
+        BOOST_CHECK(child.HaveCoins(txid));
+        BOOST_CHECK(parent.Flush());
+        BOOST_CHECK(child.ModifyCoins(txid)->Spend(1));
+        BOOST_CHECK(child.ModifyCoins(txid)->Spend(65));
+        BOOST_CHECK(child.Flush());
+        BOOST_CHECK(parent.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 68U);
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK(!coins.IsAvailable(1));
+    BOOST_CHECK(!coins.IsAvailable(65));
+    BOOST_CHECK(coins.IsAvailable(0) && coins.IsAvailable(2) && coins.IsAvailable(69));
+    BOOST_CHECK_EQUAL(coins.nHeight, 10);
+
+    // Without its first output the transaction is still found, by seeking to its other outputs
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 67U);
+    BOOST_CHECK(db.HaveCoins(txid));
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK(!coins.IsAvailable(0) && coins.IsAvailable(2));
+
+    // Spending the rest removes the transaction
+    {
+        CCoinsViewCache cache(&db);
+        for (unsigned int i = 0; i < tx.vout.size(); i++)
+            cache.ModifyCoins(txid)->Spend(i);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 0U);
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(!db.GetCoins(txid, coins));
+}
+
+BOOST_AUTO_TEST_CASE(coins_cache_entry_parent_state)
+{
+    CTransaction tx = CreateCoinsTestTransaction(70);
+    CCoinsCacheEntry entry;
+    entry.coins = CCoins(tx, 10);
+    entry.coins.Spend(66);
+    entry.SetParentState();
+    BOOST_CHECK_EQUAL(entry.ParentOutputs(), 70U);
+    BOOST_CHECK(entry.MaybeInParent(65) && !entry.MaybeInParent(66) && !entry.MaybeInParent(70));
+
+    // Only the outputs spent since are rewritten, wherever they are in the transaction
+    entry.coins.Spend(1);
+    entry.coins.Spend(65);
+    for (uint32_t n = 0; n < 70; n++)
+        BOOST_CHECK_EQUAL(entry.IsOutputChanged(n), n == 1 || n == 65);
+
+    CCoinsCacheEntry copy;
+    copy.coins = entry.coins;
+    copy.CopyParentState(entry);
+    for (uint32_t n = 0; n < 70; n++)
+        BOOST_CHECK_EQUAL(copy.IsOutputChanged(n), n == 1 || n == 65);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_upgrade, TestingSetup)
+{
+    CCoinsViewDBTest db;
+    CTransaction tx1 = CreateCoinsTestTransaction(3);
+    CTransaction tx2 = CreateCoinsTestTransaction(1);
+    CCoins coins1(tx1, 5);
+    coins1.Spend(1);
+    db.WriteLegacyCoins(tx1.GetHash(), coins1);
+    db.WriteLegacyCoins(tx2.GetHash(), CCoins(tx2, 7));
+    BOOST_CHECK(!db.HaveCoins(tx1.GetHash()));
+
+    BOOST_CHECK(db.Upgrade());
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 3U);
+    CCoins coins;
+    BOOST_CHECK(db.GetCoins(tx1.GetHash(), coins));
+    BOOST_CHECK(coins == coins1);
+    BOOST_CHECK(db.GetCoins(tx2.GetHash(), coins));
+    BOOST_CHECK(coins == CCoins(tx2, 7));
+
+    // The cursor returns whole transactions
+    size_t nTransactions = 0;
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        uint256 txid;
+        BOOST_CHECK(pcursor->GetKey(txid));
+        BOOST_CHECK(pcursor->GetValue(coins));
+        BOOST_CHECK(coins == (txid == tx1.GetHash() ? coins1 : CCoins(tx2, 7)));
+        nTransactions++;
+    }
+    BOOST_CHECK_EQUAL(nTransactions, 2U);
+
+    // Nothing left to convert
+    BOOST_CHECK(db.Upgrade());
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 3U);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_background_flush, TestingSetup)
+{
+    CCoinsViewDBTest db;
+    uint256 hashOld = GetRandHash();
+    {
+        CCoinsViewCache cache(&db);
+        cache.SetBestBlock(hashOld);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // A tiny batch size splits the write into a batch per transaction
+    CCoinsViewBackgroundFlush flusher(&db, &db, 100);
+    CCoinsViewCache cache(&flusher);
+    std::vector<CTransaction> vtx;
+    for (int i = 0; i < 10; i++) {
+        vtx.push_back(CreateCoinsTestTransaction(2));
+        cache.ModifyNewCoins(vtx.back().GetHash(), false)->FromTx(vtx.back(), 20);
+    }
+    uint256 hashNew = GetRandHash();
+    cache.SetBestBlock(hashNew);
+    BOOST_CHECK(flusher.Flush(cache, true, true));
+
+    // Flushed coins are visible whether or not the write is done
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(cache.HaveCoins(vtx[3].GetHash()));
+    BOOST_CHECK(cache.GetBestBlock() == hashNew);
+
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 20U);
+    CCoins coins;
+    BOOST_CHECK(db.GetCoins(vtx[9].GetHash(), coins));
+    BOOST_CHECK(coins == CCoins(vtx[9], 20));
+
+    CCoinsFlushStats stats = flusher.GetStats();
+    BOOST_CHECK_EQUAL(stats.nFlushes, 1U);
+    BOOST_CHECK_EQUAL(stats.nBackgroundFlushes, 1U);
+    BOOST_CHECK(!stats.fInProgress);
+    BOOST_CHECK(stats.nLastBatches > 1);
+
+    // Spending through a synchronous atomic flush
+    cache.ModifyCoins(vtx[0].GetHash())->Spend(0);
+    BOOST_CHECK(flusher.Flush(cache, false, false));
+    BOOST_CHECK_EQUAL(db.CountOutputRecords(), 19U);
+    BOOST_CHECK_EQUAL(flusher.GetStats().nLastBatches, 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_replay_partial_flush, ZerocoinTestingSetup200)
+{
+    pwalletMain->SetBroadcastTransactions(true);
+
+    // The database starts out at the old tip
+    FlushStateToDisk();
+    uint256 hashOld = chainActive.Tip()->GetBlockHash();
+    CCoinsViewDBTest db;
+    {
+        CCoinsViewCache cache(&db);
+        boost::scoped_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+        for (; pcursor->Valid(); pcursor->Next()) {
+            uint256 txid;
+            CCoins coins;
+            BOOST_CHECK(pcursor->GetKey(txid) && pcursor->GetValue(coins));
+            *cache.ModifyNewCoins(txid, coins.fCoinBase) = coins;
+        }
+        cache.SetBestBlock(hashOld);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // Connect blocks which create and spend outputs
+    CScript script = GetScriptForDestination(pubkey.GetID());
+    for (int i = 0; i < 3; i++) {
+        CWalletTx wtx;
+        CReserveKey reservekey(pwalletMain);
+        CAmount nFee;
+        int nChangePos = -1;
+        std::string strError;
+        std::vector<CRecipient> recipients = {{script, 10 * COIN, false}};
+        BOOST_CHECK_MESSAGE(pwalletMain->CreateTransaction(recipients, wtx, reservekey, nFee, nChangePos, strError), strError);
+        BOOST_CHECK(pwalletMain->CommitTransaction(wtx, reservekey));
+        CreateAndProcessBlock({}, scriptPubKey);
+        BOOST_CHECK(mempool.size() == 0);
+    }
+    uint256 hashNew = chainActive.Tip()->GetBlockHash();
+    BOOST_REQUIRE(pcoinsdbview->GetBestBlock() == hashOld);
+
+    // Transactions whose coins the new blocks changed
+    std::vector<uint256> vTouched;
+    {
+        LOCK(cs_main);
+        for (CBlockIndex* pindex = chainActive.Tip(); pindex->GetBlockHash() != hashOld; pindex = pindex->pprev) {
+            CBlock block;
+            BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+            BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+                vTouched.push_back(tx.GetHash());
+                if (!tx.IsCoinBase()) {
+                    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+                        vTouched.push_back(txin.prevout.hash);
+                }
+            }
+        }
+    }
+    BOOST_CHECK(vTouched.size() > 6);
+
+    // A write interrupted after some of its batches: part of the changes is in, the best block is still the old one
+    {
+        CCoinsViewCache cache(&db);
+        for (size_t i = 0; i < vTouched.size(); i += 2) {
+            CCoins coins;
+            if (pcoinsTip->GetCoins(vTouched[i], coins) && !coins.IsPruned())
+                *cache.ModifyCoins(vTouched[i]) = coins;
+            else
+                cache.ModifyCoins(vTouched[i])->Clear();
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+    db.WriteHeadBlocks(hashNew, hashOld);
+    BOOST_CHECK(db.GetBestBlock() == hashOld);
+    BOOST_CHECK_EQUAL(db.GetHeadBlocks().size(), 2U);
+
+    {
+        LOCK(cs_main);
+        CCoinsViewCache view(&db);
+        BOOST_CHECK(ReplayBlocks(Params(), &view));
+    }
+
+    // The replayed database matches the cleanly connected chain state
+    BOOST_CHECK(db.GetBestBlock() == hashNew);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_FOREACH(const uint256& txid, vTouched) {
+        CCoins expected, replayed;
+        bool fExpected = pcoinsTip->GetCoins(txid, expected) && !expected.IsPruned();
+        bool fReplayed = db.GetCoins(txid, replayed) && !replayed.IsPruned();
+        BOOST_CHECK_EQUAL(fExpected, fReplayed);
+        if (fExpected && fReplayed)
+            BOOST_CHECK(expected == replayed);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,224 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "base58.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "txdb.h"
+#include "wallet/wallet.h"
+
+#include "test/fixtures.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+// The index flags are globals, they are switched back off whatever the test left behind
+struct IndexBuilderTestingSetup : public ZerocoinTestingSetup200
+{
+    ~IndexBuilderTestingSetup()
+    {
+        fTxIndex = false;
+        fAddressIndex = false;
+        fSpentIndex = false;
+        fTimestampIndex = false;
+    }
+
+    // Step the index until it is in sync, the number of steps taken
+    int Sync(CIndexBuilder &builder, size_t nIndex)
+    {
+        int nSteps = 0;
+        CIndexBuilder::StepResult result;
+        while ((result = builder.Step(nIndex)) == CIndexBuilder::STEP_PROGRESS)
+            nSteps++;
+        BOOST_CHECK(result == CIndexBuilder::STEP_SYNCED);
+        return nSteps;
+    }
+
+    // Pay to the wallet's own key so the block has a fee paying transaction
+    CAmount SendAndMine()
+    {
+        CWalletTx wtx;
+        CReserveKey reservekey(pwalletMain);
+        CAmount nFee;
+        int nChangePos = -1;
+        std::string strError;
+        std::vector<CRecipient> recipients = {{GetScriptForDestination(pubkey.GetID()), 10 * COIN, false}};
+        BOOST_CHECK_MESSAGE(pwalletMain->CreateTransaction(recipients, wtx, reservekey, nFee, nChangePos, strError), strError);
+        BOOST_CHECK(pwalletMain->CommitTransaction(wtx, reservekey));
+        CreateAndProcessBlock({}, scriptPubKey);
+        BOOST_CHECK(mempool.size() == 0);
+        return nFee;
+    }
+
+    int TxIndexHeight()
+    {
+        LOCK(cs_main);
+        BlockMap::iterator it = mapBlockIndex.find(pblocktree->GetTxIndexBestBlock());
+        return it != mapBlockIndex.end() ? it->second->nHeight : -1;
+    }
+
+    // Disconnect the tip with the indexes switched off, leaving them on a stale fork
+    void InvalidateTip()
+    {
+        bool fTxIndexOld = fTxIndex, fAddressIndexOld = fAddressIndex;
+        fTxIndex = fAddressIndex = false;
+        CValidationState state;
+        {
+            LOCK(cs_main);
+            BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+        }
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+        fTxIndex = fTxIndexOld;
+        fAddressIndex = fAddressIndexOld;
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(indexbuilder_tests, IndexBuilderTestingSetup)
+
+BOOST_AUTO_TEST_CASE(indexbuilder_flags)
+{
+    CIndexBuilder none;
+    BOOST_CHECK(!none.AddIndexes());
+    BOOST_CHECK(none.GetProgress().empty());
+
+    fAddressIndex = true;
+    fTimestampIndex = true;
+    CIndexBuilder explorer;
+    BOOST_CHECK(explorer.AddIndexes());
+    std::vector<CIndexBuildProgress> vProgress = explorer.GetProgress();
+    BOOST_CHECK_EQUAL(vProgress.size(), 2U);
+    BOOST_CHECK_EQUAL(vProgress[0].strName, "addressindex");
+    BOOST_CHECK_EQUAL(vProgress[1].strName, "timestampindex");
+    BOOST_CHECK(!vProgress[0].fSynced && !vProgress[0].fFailed);
+    BOOST_CHECK_EQUAL(vProgress[0].nBestHeight, -1);
+
+    fTxIndex = true;
+    CIndexBuilder both;
+    BOOST_CHECK(both.AddIndexes());
+    vProgress = both.GetProgress();
+    BOOST_CHECK_EQUAL(vProgress.size(), 3U);
+    BOOST_CHECK_EQUAL(vProgress[0].strName, "txindex");
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_txindex_resume)
+{
+    // The chain was connected with the index off
+    BOOST_CHECK(pblocktree->GetTxIndexBestBlock().IsNull());
+    fTxIndex = true;
+
+    CIndexBuilder builder;
+    BOOST_REQUIRE(builder.AddIndexes());
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_PROGRESS);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), 0);
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_PROGRESS);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), 1);
+    CDiskTxPos pos;
+    BOOST_CHECK(pblocktree->ReadTxIndex(coinbaseTxns[0].GetHash(), pos));
+    BOOST_CHECK(!pblocktree->ReadTxIndex(coinbaseTxns[1].GetHash(), pos));
+
+    // A new builder, as after a restart, goes on from the cursor kept in the database
+    CIndexBuilder restarted;
+    BOOST_REQUIRE(restarted.AddIndexes());
+    BOOST_CHECK(restarted.Step(0) == CIndexBuilder::STEP_PROGRESS);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), 2);
+    BOOST_CHECK_EQUAL(Sync(restarted, 0), chainActive.Height() - 2);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), chainActive.Height());
+    for (const CTransaction &tx : coinbaseTxns) {
+        CTransaction txOut;
+        uint256 hashBlock;
+        BOOST_CHECK(pblocktree->ReadTxIndex(tx.GetHash(), pos));
+        BOOST_CHECK(GetTransaction(tx.GetHash(), txOut, Params().GetConsensus(), hashBlock) && txOut == tx);
+    }
+    BOOST_CHECK(restarted.GetProgress()[0].fSynced);
+
+    // Once in sync, block connection keeps the index up to date
+    SendAndMine();
+    BOOST_CHECK_EQUAL(TxIndexHeight(), chainActive.Height());
+    BOOST_CHECK(restarted.Step(0) == CIndexBuilder::STEP_SYNCED);
+
+    // Switched off, the index stays behind and is caught up once it is switched on again
+    fTxIndex = false;
+    CreateAndProcessEmptyBlocks(3, scriptPubKey);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), chainActive.Height() - 3);
+    fTxIndex = true;
+    CIndexBuilder switched;
+    BOOST_REQUIRE(switched.AddIndexes());
+    BOOST_CHECK_EQUAL(Sync(switched, 0), 3);
+    BOOST_CHECK_EQUAL(TxIndexHeight(), chainActive.Height());
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_txindex_disconnect)
+{
+    fTxIndex = true;
+    CIndexBuilder builder;
+    BOOST_REQUIRE(builder.AddIndexes());
+    Sync(builder, 0);
+    uint256 hashStale = chainActive.Tip()->GetBlockHash();
+
+    // The index is left on a block which is no longer in the active chain, the builder moves it back first
+    InvalidateTip();
+    BOOST_CHECK(pblocktree->GetTxIndexBestBlock() == hashStale);
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_PROGRESS);
+    BOOST_CHECK(pblocktree->GetTxIndexBestBlock() == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_SYNCED);
+
+    // Paid elsewhere so the new tip isn't the invalidated block again
+    CreateAndProcessEmptyBlocks(1, CScript() << OP_TRUE);
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_SYNCED);
+    BOOST_CHECK(pblocktree->GetTxIndexBestBlock() == chainActive.Tip()->GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_addressindex)
+{
+    // Blocks with fee paying transactions, the fees are not part of the supply
+    CAmount nFees = SendAndMine();
+    CAmount nFeeTip = SendAndMine();
+    nFees += nFeeTip;
+    BOOST_CHECK(nFeeTip > 0);
+    BOOST_CHECK(pindexdb->GetBestBlock().IsNull());
+
+    fAddressIndex = true;
+    CIndexBuilder builder;
+    BOOST_REQUIRE(builder.AddIndexes());
+    BOOST_CHECK_EQUAL(Sync(builder, 0), chainActive.Height() + 1);
+    BOOST_CHECK(pindexdb->GetBestBlock() == chainActive.Tip()->GetBlockHash());
+
+    CAmount nCoinbase = 0;
+    {
+        LOCK(cs_main);
+        for (CBlockIndex *pindex = chainActive.Tip(); pindex->pprev; pindex = pindex->pprev) {
+            CBlock block;
+            BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+            nCoinbase += block.vtx[0].GetValueOut();
+        }
+    }
+    CAmount nSupply = 0;
+    BOOST_CHECK(pindexdb->ReadTotalSupply(nSupply));
+    BOOST_CHECK_EQUAL(nSupply, nCoinbase - nFees);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    BOOST_CHECK(pindexdb->ReadAddressIndex(pubkey.GetID(), AddressType::payToPubKeyHash, addressIndex));
+    BOOST_CHECK(addressIndex.size() > coinbaseTxns.size());
+
+    // Rolling back the tip block removes its entries and supply again, the same as DisconnectBlock would
+    CBlock blockTip;
+    BOOST_REQUIRE(ReadBlockFromDisk(blockTip, chainActive.Tip(), Params().GetConsensus()));
+    InvalidateTip();
+    BOOST_CHECK(builder.Step(0) == CIndexBuilder::STEP_PROGRESS);
+    BOOST_CHECK(pindexdb->GetBestBlock() == chainActive.Tip()->GetBlockHash());
+    CAmount nSupplyBack = 0;
+    BOOST_CHECK(pindexdb->ReadTotalSupply(nSupplyBack));
+    BOOST_CHECK_EQUAL(nSupplyBack, nSupply - (blockTip.vtx[0].GetValueOut() - nFeeTip));
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndexBack;
+    BOOST_CHECK(pindexdb->ReadAddressIndex(pubkey.GetID(), AddressType::payToPubKeyHash, addressIndexBack));
+    BOOST_CHECK(addressIndexBack.size() < addressIndex.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+static bool CollectText(std::vector<std::string>* vChunks, size_t nMaxChunks, const std::string& strText)
+{
+    vChunks->push_back(strText);
+    return vChunks->size() < nMaxChunks;
+}
+
+// A document with nested and empty containers, escaped strings and all kinds of values
+static void WriteDocument(CJSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("hash", "00ff");
+    writer.KeyValue("height", 12);
+    writer.Key("tx");
+    writer.BeginArray();
+    for (int i = 0; i < 50 && !writer.IsClosed(); i++) {
+        UniValue tx(UniValue::VOBJ);
+        tx.push_back(Pair("n", i));
+        tx.push_back(Pair("note", "quote \" and\nnewline"));
+        writer.Value(tx);
+        writer.BeginArray();
+        writer.Value(i % 2 == 0);
+        writer.Value(NullUniValue);
+        writer.EndArray();
+    }
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Key("nested");
+    writer.BeginObject();
+    writer.Key("list");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.KeyValue("amount", 1.5);
+    writer.EndObject();
+    writer.EndObject();
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_tree)
+{
+    CJSONTreeWriter tree;
+    WriteDocument(tree);
+    const std::string strExpected = tree.GetResult().write();
+    BOOST_CHECK(tree.GetResult()["tx"].size() == 100);
+
+    // The text is the same whether it's handed on in small chunks or at once
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter stream(boost::bind(&CollectText, &vChunks, 1000, _1), 64);
+    WriteDocument(stream);
+    BOOST_CHECK(stream.HasFlushed());
+    BOOST_CHECK(vChunks.size() > 10);
+    stream.Flush();
+    std::string strText;
+    for (size_t i = 0; i < vChunks.size(); i++)
+        strText += vChunks[i];
+    BOOST_CHECK_EQUAL(strText, strExpected);
+
+    vChunks.clear();
+    CJSONStreamWriter whole(boost::bind(&CollectText, &vChunks, 1000, _1));
+    WriteDocument(whole);
+    BOOST_CHECK(!whole.HasFlushed());
+    BOOST_CHECK(vChunks.empty());
+    BOOST_CHECK_EQUAL(whole.GetBuffer(), strExpected);
+
+    // The text is valid JSON
+    UniValue val;
+    BOOST_CHECK(val.read(strText));
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_scalar)
+{
+    CJSONTreeWriter tree;
+    tree.Value("hex");
+    BOOST_CHECK_EQUAL(tree.GetResult().get_str(), "hex");
+
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter stream(boost::bind(&CollectText, &vChunks, 1000, _1));
+    stream.BeginObject();
+    stream.Key("result");
+    stream.Value(UniValue(UniValue::VARR));
+    stream.KeyValue("error", NullUniValue);
+    stream.KeyValue("id", 1);
+    stream.EndObject();
+    BOOST_CHECK_EQUAL(stream.GetBuffer(), "{\"result\":[],\"error\":null,\"id\":1}");
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_closed)
+{
+    // Once the sink refuses text, the writer reports it and drops the rest
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter stream(boost::bind(&CollectText, &vChunks, 2, _1), 64);
+    WriteDocument(stream);
+    stream.Flush();
+    BOOST_CHECK(stream.IsClosed());
+    BOOST_CHECK_EQUAL(vChunks.size(), 2);
+    BOOST_CHECK(stream.GetBuffer().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
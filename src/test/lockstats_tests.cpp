@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sync.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lockstats_tests, BasicTestingSetup)
+
+#ifdef DEBUG_LOCKSTATS
+// Sites are told apart by where they are, the same mutex is locked at several of them
+static const CLockSiteStats* FindSite(const std::vector<CLockSiteStats>& vSites, const std::string& strName, int nLine)
+{
+    for (size_t i = 0; i < vSites.size(); i++)
+        if (vSites[i].strName == strName && vSites[i].strFile == __FILE__ && vSites[i].nLine == nLine)
+            return &vSites[i];
+    return NULL;
+}
+
+static int nTryLockLine;
+
+static void TryLockStatsMutex(CCriticalSection* cs, bool* fLocked)
+{
+    TRY_LOCK(*cs, lockStatsTry); nTryLockLine = __LINE__;
+    *fLocked = lockStatsTry;
+}
+
+BOOST_AUTO_TEST_CASE(lockstats_sites)
+{
+    CCriticalSection csLockStatsTest;
+    ResetLockStats();
+    int nLoopLine, nHoldLine;
+    for (int i = 0; i < 3; i++) {
+        LOCK(csLockStatsTest); nLoopLine = __LINE__;
+    }
+    {
+        LOCK(csLockStatsTest); nHoldLine = __LINE__;
+        bool fLocked = true;
+        boost::thread thread(boost::bind(&TryLockStatsMutex, &csLockStatsTest, &fLocked));
+        thread.join();
+        BOOST_CHECK(!fLocked);
+    }
+
+    std::vector<CLockSiteStats> vSites = GetLockStats();
+    const CLockSiteStats* site = FindSite(vSites, "csLockStatsTest", nLoopLine);
+    BOOST_REQUIRE(site);
+    BOOST_CHECK_EQUAL(site->nAcquired, 3U);
+    uint64_t nHolds = 0;
+    for (int i = 0; i < LOCKSTATS_BUCKETS; i++)
+        nHolds += site->holdHistogram[i];
+    BOOST_CHECK_EQUAL(nHolds, 3U);
+
+    site = FindSite(vSites, "csLockStatsTest", nHoldLine);
+    BOOST_REQUIRE(site);
+    BOOST_CHECK_EQUAL(site->nAcquired, 1U);
+    BOOST_CHECK_EQUAL(site->nTryFailed, 0U);
+
+    site = FindSite(vSites, "*cs", nTryLockLine);
+    BOOST_REQUIRE(site);
+    BOOST_CHECK_EQUAL(site->nAcquired, 0U);
+    BOOST_CHECK_EQUAL(site->nTryFailed, 1U);
+
+    ResetLockStats();
+    vSites = GetLockStats();
+    site = FindSite(vSites, "csLockStatsTest", nLoopLine);
+    BOOST_CHECK(site == NULL || site->nAcquired == 0);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
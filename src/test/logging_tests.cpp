@@ -0,0 +1,171 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "util.h"
+
+#include "random.h"
+#include "utiltime.h"
+#include "test/test_bitcoin.h"
+#include "test/testutil.h"
+
+#include <stdio.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+// Writes debug.log into a data directory of its own, with the log settings back at their defaults afterwards
+struct LogTestingSetup : public BasicTestingSetup
+{
+    boost::filesystem::path pathTemp;
+
+    LogTestingSetup()
+    {
+        ClearDatadirCache();
+        pathTemp = GetTempPath() / strprintf("test_index_log_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+
+        // debug.log is opened once per process, later tests move it to their own data directory
+        static bool fOpened = false;
+        if (!fOpened) {
+            OpenDebugLog();
+            fOpened = true;
+        } else {
+            fReopenDebugLog = true;
+        }
+        fPrintToConsole = false;
+        fPrintToDebugLog = true;
+    }
+
+    ~LogTestingSetup()
+    {
+        StopLogWriter();
+        fPrintToDebugLog = false;
+        nLogQueueSize = DEFAULT_LOGQUEUE;
+        fLogDropDebug = DEFAULT_LOGDROPDEBUG;
+        nLogRateLimit = DEFAULT_LOGRATE;
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        boost::filesystem::remove_all(pathTemp);
+    }
+
+    std::vector<std::string> ReadLog()
+    {
+        std::vector<std::string> vLines;
+        std::ifstream file((GetDataDir() / "debug.log").string().c_str());
+        std::string strLine;
+        while (std::getline(file, strLine))
+            vLines.push_back(strLine);
+        return vLines;
+    }
+
+    size_t CountLines(const std::vector<std::string> &vLines, const std::string &strText)
+    {
+        size_t nCount = 0;
+        for (const std::string &strLine : vLines)
+            if (strLine.find(strText) != std::string::npos)
+                nCount++;
+        return nCount;
+    }
+};
+
+void LogProducerMessages(int nProducer, int nMessages)
+{
+    for (int i = 0; i < nMessages; i++)
+        LogPrintf("producer %d message %d\n", nProducer, i);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, LogTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logwriter_multiple_producers)
+{
+    const int nProducers = 4;
+    const int nMessages = 2000;
+    // Small enough for the producers to wait for room now and then
+    nLogQueueSize = 64;
+    StartLogWriter();
+
+    boost::thread_group threads;
+    for (int i = 0; i < nProducers; i++)
+        threads.create_thread(boost::bind(&LogProducerMessages, i, nMessages));
+    threads.join_all();
+    StopLogWriter();
+
+    // Every message is written once, and the messages of each producer in the order they were logged
+    std::vector<int> vNext(nProducers, 0);
+    for (const std::string &strLine : ReadLog()) {
+        size_t nPos = strLine.find("producer ");
+        if (nPos == std::string::npos)
+            continue;
+        int nProducer, nMessage;
+        BOOST_REQUIRE_EQUAL(sscanf(strLine.c_str() + nPos, "producer %d message %d", &nProducer, &nMessage), 2);
+        BOOST_REQUIRE(nProducer >= 0 && nProducer < nProducers);
+        BOOST_CHECK_EQUAL(nMessage, vNext[nProducer]);
+        vNext[nProducer] = nMessage + 1;
+    }
+    for (int i = 0; i < nProducers; i++)
+        BOOST_CHECK_EQUAL(vNext[i], nMessages);
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_rate_limit)
+{
+    nLogRateLimit = 5;
+
+    // Start early in a second, so that all messages fall into it
+    while (GetTimeMicros() % 1000000 > 200000)
+        MilliSleep(1);
+    int64_t nSecond = GetTimeMicros() / 1000000;
+    int nWritten = 0;
+    for (int i = 0; i < 20; i++)
+        if (LogPrintStr("rate limited\n", "lograte_test") > 0)
+            nWritten++;
+    BOOST_CHECK_EQUAL(nWritten, 5);
+
+    // Other categories and messages without one have limits of their own or none
+    BOOST_CHECK(LogPrintStr("other category\n", "lograte_other") > 0);
+    BOOST_CHECK(LogPrintStr("no category\n") > 0);
+
+    // The next second starts over and reports what was suppressed
+    while (GetTimeMicros() / 1000000 == nSecond)
+        MilliSleep(10);
+    BOOST_CHECK(LogPrintStr("rate limited\n", "lograte_test") > 0);
+
+    std::vector<std::string> vLines = ReadLog();
+    BOOST_CHECK_EQUAL(CountLines(vLines, "rate limited"), 6U);
+    BOOST_CHECK_EQUAL(CountLines(vLines, "15 lograte_test messages suppressed by -lograte"), 1U);
+    BOOST_CHECK_EQUAL(CountLines(vLines, "other category"), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_drop_debug)
+{
+    // A queue without room, as if the writer fell far behind
+    nLogQueueSize = 0;
+    fLogDropDebug = true;
+    StartLogWriter();
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK_EQUAL(LogPrintStr("droptest message\n", "logdrop_test"), 0);
+
+    // Without -logdropdebug the message waits for room, or until the writer is stopped
+    fLogDropDebug = false;
+    boost::thread waiting(boost::bind(&LogPrintStr, std::string("droptest waited\n"), "logdrop_test"));
+    MilliSleep(50);
+    StopLogWriter();
+    waiting.join();
+
+    std::vector<std::string> vLines = ReadLog();
+    BOOST_CHECK_EQUAL(CountLines(vLines, "droptest message"), 0U);
+    BOOST_CHECK_EQUAL(CountLines(vLines, "3 debug messages dropped"), 1U);
+    BOOST_CHECK_EQUAL(CountLines(vLines, "droptest waited"), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include "chainparams.h"
 #include "main.h"
 
+#include "test/fixtures.h"
 #include "test/test_bitcoin.h"
 
 #include <boost/signals2/signal.hpp>
@@ -28,4 +29,44 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_FIXTURE_TEST_CASE(read_raw_block, ZerocoinTestingSetup109)
+{
+    LOCK(cs_main);
+    const CBlockIndex *pindex = chainActive.Tip();
+
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+
+    std::vector<unsigned char> vRawBlock;
+    BOOST_CHECK(ReadRawBlockFromDisk(vRawBlock, pindex, Params().MessageStart()));
+    BOOST_CHECK(vRawBlock == std::vector<unsigned char>(ssBlock.begin(), ssBlock.end()));
+    BOOST_CHECK_EQUAL(RawBlockHasWitness(vRawBlock), !block.vtx[0].wit.IsNull());
+
+    CMessageHeader::MessageStartChars wrongStart = {0, 0, 0, 0};
+    BOOST_CHECK(!ReadRawBlockFromDisk(vRawBlock, pindex, wrongStart));
+
+    // A corrupted transaction leaves the header intact, the merkle root doesn't match any more
+    CDataStream ssHeader(SER_DISK, CLIENT_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    size_t nOffset = ssHeader.size() + GetSizeOfCompactSize(block.vtx.size());
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    pos.nPos += nOffset;
+    FILE *file = OpenBlockFile(pos);
+    BOOST_REQUIRE(file);
+    unsigned char chVersion = ssBlock[nOffset] ^ 0x80;
+    BOOST_CHECK_EQUAL(fwrite(&chVersion, 1, 1, file), 1U);
+    fclose(file);
+    BOOST_CHECK(!ReadRawBlockFromDisk(vRawBlock, pindex, Params().MessageStart()));
+
+    chVersion ^= 0x80;
+    file = OpenBlockFile(pos);
+    BOOST_REQUIRE(file);
+    BOOST_CHECK_EQUAL(fwrite(&chVersion, 1, 1, file), 1U);
+    fclose(file);
+    BOOST_CHECK(ReadRawBlockFromDisk(vRawBlock, pindex, Params().MessageStart()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
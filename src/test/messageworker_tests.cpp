@@ -0,0 +1,147 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "main.h"
+#include "net.h"
+#include "protocol.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+CAddress WorkerTestAddress(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = i;
+    return CAddress(CService(CNetAddr(s), Params().GetDefaultPort()), NODE_NONE);
+}
+
+void QueueTestMessage(CNode &node, const std::string &strCommand)
+{
+    CDataStream vRecv(SER_NETWORK, PROTOCOL_VERSION);
+    QueueWorkerMessage(&node, GetMessageLane(strCommand), strCommand, vRecv, GetTimeMicros(), 0);
+}
+
+// The command of the next message of a free lane, empty if there is none. The message is finished right away
+// unless it's kept in msgKeep
+std::string PopTestMessage(std::unique_ptr<CWorkerMessage> *msgKeep = NULL, int *pnLane = NULL)
+{
+    int nLane;
+    std::unique_ptr<CWorkerMessage> msg = PopWorkerMessage(nLane);
+    if (!msg)
+        return "";
+    std::string strCommand = msg->strCommand;
+    if (pnLane)
+        *pnLane = nLane;
+    if (msgKeep)
+        *msgKeep = std::move(msg);
+    else
+        FinishWorkerMessage(std::move(msg), nLane);
+    return strCommand;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(messageworker_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(message_lanes)
+{
+    int nPeerLane = GetMessageLane(NetMsgType::PING);
+    int nIndexnodeLane = GetMessageLane(NetMsgType::MNANNOUNCE);
+    int nPaymentsLane = GetMessageLane(NetMsgType::INDEXNODEPAYMENTVOTE);
+    BOOST_CHECK(nPeerLane >= 0 && nIndexnodeLane >= 0 && nPaymentsLane >= 0);
+    BOOST_CHECK(nPeerLane != nIndexnodeLane && nPeerLane != nPaymentsLane && nIndexnodeLane != nPaymentsLane);
+
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::PONG), nPeerLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::ADDR), nPeerLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::GETADDR), nPeerLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::MNPING), nIndexnodeLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::DSEG), nIndexnodeLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::MNVERIFY), nIndexnodeLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::SYNCSTATUSCOUNT), nIndexnodeLane);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::INDEXNODEPAYMENTSYNC), nPaymentsLane);
+
+    // Anything touching chain state stays with the message handler thread
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::VERSION), -1);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::BLOCK), -1);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::HEADERS), -1);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::TX), -1);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::INV), -1);
+    BOOST_CHECK_EQUAL(GetMessageLane(NetMsgType::GETDATA), -1);
+}
+
+BOOST_AUTO_TEST_CASE(worker_lane_order)
+{
+    CNode node1(INVALID_SOCKET, WorkerTestAddress(0xa0b0c001), "", true);
+    CNode node2(INVALID_SOCKET, WorkerTestAddress(0xa0b0c002), "", true);
+    int nRefCount1 = node1.GetRefCount();
+    int nRefCount2 = node2.GetRefCount();
+
+    QueueTestMessage(node1, NetMsgType::PING);
+    QueueTestMessage(node2, NetMsgType::ADDR);
+    QueueTestMessage(node1, NetMsgType::MNANNOUNCE);
+    QueueTestMessage(node1, NetMsgType::PONG);
+    BOOST_CHECK(node1.fWorkerMessage && node2.fWorkerMessage);
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), nRefCount1 + 3);
+    BOOST_CHECK_EQUAL(node2.GetRefCount(), nRefCount2 + 1);
+
+    // While a message of a lane is handled, the next one has to wait, other lanes go on
+    std::unique_ptr<CWorkerMessage> msgPing, msgAnnounce;
+    int nPingLane, nAnnounceLane;
+    BOOST_CHECK_EQUAL(PopTestMessage(&msgPing, &nPingLane), NetMsgType::PING);
+    BOOST_CHECK_EQUAL(PopTestMessage(&msgAnnounce, &nAnnounceLane), NetMsgType::MNANNOUNCE);
+    BOOST_CHECK_EQUAL(PopTestMessage(), "");
+
+    // Messages of a lane are handled in the order they were received, whichever node they came from
+    FinishWorkerMessage(std::move(msgPing), nPingLane);
+    BOOST_CHECK_EQUAL(PopTestMessage(), NetMsgType::ADDR);
+    BOOST_CHECK_EQUAL(PopTestMessage(), NetMsgType::PONG);
+    BOOST_CHECK_EQUAL(PopTestMessage(), "");
+    BOOST_CHECK_EQUAL(node2.GetRefCount(), nRefCount2);
+    BOOST_CHECK(!node2.fWorkerMessage);
+
+    FinishWorkerMessage(std::move(msgAnnounce), nAnnounceLane);
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), nRefCount1);
+    BOOST_CHECK(!node1.fWorkerMessage);
+}
+
+BOOST_AUTO_TEST_CASE(worker_shutdown_drain)
+{
+    CNode node1(INVALID_SOCKET, WorkerTestAddress(0xa0b0c001), "", true);
+    CNode node2(INVALID_SOCKET, WorkerTestAddress(0xa0b0c002), "", true);
+    int nRefCount1 = node1.GetRefCount();
+    int nRefCount2 = node2.GetRefCount();
+
+    QueueTestMessage(node1, NetMsgType::PING);
+    QueueTestMessage(node1, NetMsgType::PONG);
+    QueueTestMessage(node2, NetMsgType::INDEXNODEPAYMENTVOTE);
+    QueueTestMessage(node2, NetMsgType::MNPING);
+
+    // One message is being handled when the workers are stopped
+    std::unique_ptr<CWorkerMessage> msgPing;
+    int nLane;
+    BOOST_CHECK_EQUAL(PopTestMessage(&msgPing, &nLane), NetMsgType::PING);
+
+    // The queued ones are dropped and their nodes released, nothing is left for a worker
+    ClearWorkerMessages();
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), nRefCount1 + 1);
+    BOOST_CHECK_EQUAL(node2.GetRefCount(), nRefCount2);
+    BOOST_CHECK(!node2.fWorkerMessage);
+    BOOST_CHECK_EQUAL(PopTestMessage(), "");
+
+    FinishWorkerMessage(std::move(msgPing), nLane);
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), nRefCount1);
+    BOOST_CHECK(!node1.fWorkerMessage);
+
+    // The lanes are free again
+    QueueTestMessage(node1, NetMsgType::ADDR);
+    BOOST_CHECK_EQUAL(PopTestMessage(), NetMsgType::ADDR);
+    BOOST_CHECK_EQUAL(node1.GetRefCount(), nRefCount1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,7 +15,9 @@
 #include "uint256.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "wallet/wallet.h"
 
+#include "test/fixtures.h"
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
@@ -505,4 +507,72 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 */
+
+// Pays to the wallet's own key, the transaction is left in the mempool
+static uint256 SendToSelf(const CScript& scriptPubKey)
+{
+    CWalletTx wtx;
+    CReserveKey reservekey(pwalletMain);
+    CAmount nFee;
+    int nChangePos = -1;
+    std::string strError;
+    std::vector<CRecipient> recipients = {{scriptPubKey, 10 * COIN, false}};
+    BOOST_CHECK_MESSAGE(pwalletMain->CreateTransaction(recipients, wtx, reservekey, nFee, nChangePos, strError), strError);
+    BOOST_CHECK(pwalletMain->CommitTransaction(wtx, reservekey));
+    return wtx.GetHash();
+}
+
+static std::set<uint256> TemplateTxIds(const CBlockTemplate& tmpl)
+{
+    std::set<uint256> setTxIds;
+    for (size_t i = 1; i < tmpl.block.vtx.size(); i++)
+        setTxIds.insert(tmpl.block.vtx[i].GetHash());
+    return setTxIds;
+}
+
+BOOST_FIXTURE_TEST_CASE(cached_template, ZerocoinTestingSetup200)
+{
+    const CChainParams& chainparams = Params();
+
+    // The first template after a new tip selects everything
+    CBlockTemplateStats stats = GetBlockTemplateStats();
+    uint256 txid1 = SendToSelf(scriptPubKey);
+    std::unique_ptr<CBlockTemplate> first(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, {}));
+    BOOST_CHECK_EQUAL(GetBlockTemplateStats().nFullBuilds, stats.nFullBuilds + 1);
+    BOOST_CHECK(TemplateTxIds(*first) == std::set<uint256>({txid1}));
+
+    // Transactions which entered the mempool since are appended to the cached template
+    uint256 txid2 = SendToSelf(scriptPubKey);
+    uint256 txid3 = SendToSelf(scriptPubKey);
+    std::unique_ptr<CBlockTemplate> extended(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, {}));
+    BOOST_CHECK_EQUAL(GetBlockTemplateStats().nIncrementalBuilds, stats.nIncrementalBuilds + 1);
+    BOOST_REQUIRE_EQUAL(extended->block.vtx.size(), 4U);
+    BOOST_CHECK(extended->block.vtx[1].GetHash() == txid1);
+    BOOST_CHECK(TemplateTxIds(*extended) == std::set<uint256>({txid1, txid2, txid3}));
+
+    // A full selection of the same mempool ends up with the same transactions, fees and reward
+    std::vector<uint256> vTxIds;
+    {
+        LOCK(mempool.cs);
+        for (const CTxMemPoolEntry& entry : mempool.mapTx)
+            vTxIds.push_back(entry.GetTx().GetHash());
+    }
+    std::unique_ptr<CBlockTemplate> rebuilt(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, vTxIds));
+    BOOST_CHECK_EQUAL(GetBlockTemplateStats().nFullBuilds, stats.nFullBuilds + 2);
+    BOOST_CHECK(TemplateTxIds(*rebuilt) == TemplateTxIds(*extended));
+    BOOST_CHECK_EQUAL(rebuilt->vTxFees[0], extended->vTxFees[0]);
+    BOOST_CHECK(rebuilt->block.vtx[0].vout == extended->block.vtx[0].vout);
+
+    // A new tip needs a new selection, the cached one has transactions which are now confirmed
+    CreateAndProcessBlock({}, scriptPubKey);
+    BOOST_CHECK(mempool.size() == 0);
+    stats = GetBlockTemplateStats();
+    uint256 txid4 = SendToSelf(scriptPubKey);
+    std::unique_ptr<CBlockTemplate> next(BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, {}));
+    BOOST_CHECK_EQUAL(GetBlockTemplateStats().nFullBuilds, stats.nFullBuilds + 1);
+    BOOST_CHECK_EQUAL(GetBlockTemplateStats().nIncrementalBuilds, stats.nIncrementalBuilds);
+    BOOST_CHECK(next->block.hashPrevBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(TemplateTxIds(*next) == std::set<uint256>({txid4}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
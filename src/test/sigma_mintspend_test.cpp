@@ -110,12 +110,15 @@ BOOST_AUTO_TEST_CASE(sigma_mintspend_test)
 
         //Verify spend got into mempool
         BOOST_CHECK_MESSAGE(mempool.size() == 1, "Spend was not added to mempool");
+        BOOST_CHECK_MESSAGE(sigma::GetSpendCacheStats().nEntries > 0, "Verified spend was not cached");
+        uint64_t nCacheHits = sigma::GetSpendCacheStats().nHits;
 
         vtxid.clear();
         b = CreateBlock({}, scriptPubKey);
         previousHeight = chainActive.Height();
         BOOST_CHECK_MESSAGE(ProcessBlock(b), "ProcessBlock failed although valid spend inside");
         BOOST_CHECK_MESSAGE(previousHeight + 1 == chainActive.Height(), "Block not added to chain");
+        BOOST_CHECK_MESSAGE(sigma::GetSpendCacheStats().nHits > nCacheHits, "Spend proof verified again in block");
 
         BOOST_CHECK_MESSAGE(mempool.size() == 0, "Mempool not cleared");
 
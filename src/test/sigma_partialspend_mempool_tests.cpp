@@ -15,6 +15,7 @@
 #include "test/testutil.h"
 
 #include "wallet/db.h"
+#include "wallet/sigmaspendbuilder.h"
 #include "wallet/wallet.h"
 #include "wallet/walletexcept.h"
 
@@ -30,6 +31,78 @@ static bool addToMempool(const CWalletTx& tx) {
     return AcceptToMemoryPool(mempool, state, tx, true, false, &fMissingInputs, true, false, nMaxRawTxFee);
 }
 
+// Forwards to a sigma signer, and checks whether another thread can take cs_main and cs_wallet while
+// the proof is generated
+class LockProbeSigner : public InputSigner
+{
+public:
+    std::unique_ptr<InputSigner> signer;
+    bool fMainFree;
+    bool fWalletFree;
+
+public:
+    explicit LockProbeSigner(std::unique_ptr<InputSigner> signer) :
+        InputSigner(signer->output, signer->sequence),
+        signer(std::move(signer)),
+        fMainFree(false),
+        fWalletFree(false)
+    {
+    }
+
+    bool NeedsPrepare() const override
+    {
+        return signer->NeedsPrepare();
+    }
+
+    void Prepare() override
+    {
+        boost::thread probe([this] {
+            {
+                TRY_LOCK(cs_main, lockMain);
+                fMainFree = lockMain;
+            }
+            {
+                TRY_LOCK(pwalletMain->cs_wallet, lockWallet);
+                fWalletFree = lockWallet;
+            }
+        });
+        probe.join();
+
+        signer->Prepare();
+    }
+
+    CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy) override
+    {
+        return signer->Sign(tx, sig, fDummy);
+    }
+};
+
+class LockProbeSpendBuilder : public SigmaSpendBuilder
+{
+public:
+    std::vector<LockProbeSigner*> probes;
+
+public:
+    LockProbeSpendBuilder() : SigmaSpendBuilder(*pwalletMain, *zwalletMain)
+    {
+    }
+
+protected:
+    CAmount GetInputs(std::vector<std::unique_ptr<InputSigner>>& signers, CAmount required, bool fDummy) override
+    {
+        CAmount total = SigmaSpendBuilder::GetInputs(signers, required, fDummy);
+
+        probes.clear();
+        for (auto& signer : signers) {
+            auto probe = new LockProbeSigner(std::move(signer));
+            signer.reset(probe);
+            probes.push_back(probe);
+        }
+
+        return total;
+    }
+};
+
 BOOST_FIXTURE_TEST_SUITE(sigma_partialspend_mempool_tests, ZerocoinTestingSetup200)
 
 /*
@@ -201,6 +274,68 @@ BOOST_AUTO_TEST_CASE(partialspend)
     }
 }
 
+/*
+* 1. Create two mints with denomination 1
+* 2. Spend one of them and check that cs_main and cs_wallet are free while the proof is generated
+*/
+BOOST_AUTO_TEST_CASE(spend_proofs_without_locks) {
+
+    CPubKey newKey;
+    BOOST_CHECK_MESSAGE(pwalletMain->GetKeyFromPool(newKey), "Fail to get new address");
+
+    const CBitcoinAddress randomAddr(newKey.GetID());
+
+    sigma::CSigmaState* sigmaState = sigma::CSigmaState::GetState();
+
+    // Create 400-200+1 = 201 new empty blocks. // consensus.nMintV3SigmaStartBlock = 400
+    CreateAndProcessEmptyBlocks(201, scriptPubKey);
+
+    CAmount denomAmount1;
+    sigma::DenominationToInteger(sigma::CoinDenomination::SIGMA_DENOM_1, denomAmount1);
+
+    std::string stringError;
+    pwalletMain->SetBroadcastTransactions(true);
+
+    std::vector<std::pair<std::string, int>> denominationPairs = {{"1", 2}};
+    BOOST_CHECK_MESSAGE(pwalletMain->CreateZerocoinMintModel(
+            stringError, denominationPairs, SIGMA), stringError + " - Create Mint failed");
+
+    CreateAndProcessBlock({}, scriptPubKey);
+    CreateAndProcessEmptyBlocks(5, scriptPubKey);
+    BOOST_CHECK_MESSAGE(mempool.size() == 0, "Mempool was not cleared");
+
+    std::vector<CRecipient> recipients = {
+        {GetScriptForDestination(randomAddr.Get()), denomAmount1, true},
+    };
+
+    CWalletTx tx;
+    std::vector<CSigmaEntry> selected;
+    std::vector<CHDMint> changes;
+    {
+        LockProbeSpendBuilder builder;
+        CAmount fee;
+        bool fChangeAddedToFee;
+
+        BOOST_CHECK_NO_THROW(tx = builder.Build(recipients, fee, fChangeAddedToFee));
+
+        BOOST_CHECK(!builder.probes.empty());
+        for (auto probe : builder.probes) {
+            BOOST_CHECK_MESSAGE(probe->fMainFree, "cs_main was held while generating the proof");
+            BOOST_CHECK_MESSAGE(probe->fWalletFree, "cs_wallet was held while generating the proof");
+        }
+
+        selected = builder.selected;
+        changes = builder.changes;
+    }
+
+    // the proofs generated without the locks are valid
+    BOOST_CHECK_NO_THROW(pwalletMain->CommitSigmaTransaction(tx, selected, changes));
+    BOOST_CHECK_MESSAGE(mempool.size() == 1, "Spend was not added to mempool");
+
+    mempool.clear();
+    sigmaState->Reset();
+}
+
 /*
 * 1. Create two mints with denomination 1 in same transaction
 * 2. Spend all old coin and expect new coin from remint
@@ -0,0 +1,164 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigverifyqueue.h"
+
+#include "arith_uint256.h"
+#include "darksend.h"
+#include "key.h"
+#include "test/test_bitcoin.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigverifyqueue_tests, BasicTestingSetup)
+
+struct CSignedMessage
+{
+    uint256 hash;
+    std::string strMessage;
+    std::vector<unsigned char> vchSig;
+};
+
+static CSignedMessage SignTestMessage(const CKey& key, int n)
+{
+    CSignedMessage msg;
+    msg.hash = ArithToUint256(arith_uint256(n + 1));
+    msg.strMessage = strprintf("message %d", n);
+    BOOST_REQUIRE(darkSendSigner.SignMessage(msg.strMessage, msg.vchSig, key));
+    return msg;
+}
+
+static void RecordResult(boost::mutex* mutex, std::vector<std::pair<int, bool> >* vResults, int n, CNode* pfrom, bool fValid)
+{
+    boost::unique_lock<boost::mutex> lock(*mutex);
+    vResults->push_back(std::make_pair(n, fValid));
+}
+
+static void WaitForFlag(boost::mutex* mutex, boost::condition_variable* cond, bool* fFlag, CNode* pfrom, bool fValid)
+{
+    boost::unique_lock<boost::mutex> lock(*mutex);
+    while (!*fFlag)
+        cond->wait(lock);
+}
+
+static bool WaitForResults(boost::mutex& mutex, std::vector<std::pair<int, bool> >& vResults, size_t nCount)
+{
+    for (int i = 0; i < 1000; i++) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vResults.size() >= nCount)
+                return true;
+        }
+        MilliSleep(10);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(sigverifyqueue_inline)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CSignedMessage msg = SignTestMessage(key, 0);
+
+    // Without threads the callback runs right away
+    CSignatureVerifyQueue queue;
+    boost::mutex mutex;
+    std::vector<std::pair<int, bool> > vResults;
+    BOOST_CHECK(!queue.IsRunning());
+    BOOST_CHECK(queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage,
+                           boost::bind(&RecordResult, &mutex, &vResults, 0, _1, _2)));
+    BOOST_CHECK(queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage + "x",
+                           boost::bind(&RecordResult, &mutex, &vResults, 1, _1, _2)));
+    BOOST_REQUIRE_EQUAL(vResults.size(), 2);
+    BOOST_CHECK(vResults[0] == std::make_pair(0, true));
+    BOOST_CHECK(vResults[1] == std::make_pair(1, false));
+}
+
+BOOST_AUTO_TEST_CASE(sigverifyqueue_order)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+
+    CSignatureVerifyQueue queue;
+    boost::thread_group threads;
+    queue.Start(4, threads);
+    BOOST_CHECK(queue.IsRunning());
+
+    // Every third message is signed by another key, the results come back in the order the messages were pushed
+    const int nMessages = 200;
+    boost::mutex mutex;
+    std::vector<std::pair<int, bool> > vResults;
+    for (int i = 0; i < nMessages; i++) {
+        CSignedMessage msg = SignTestMessage(i % 3 == 2 ? keyOther : key, i);
+        BOOST_CHECK(queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage,
+                               boost::bind(&RecordResult, &mutex, &vResults, i, _1, _2)));
+    }
+    BOOST_REQUIRE(WaitForResults(mutex, vResults, nMessages));
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    BOOST_REQUIRE_EQUAL(vResults.size(), nMessages);
+    for (int i = 0; i < nMessages; i++) {
+        BOOST_CHECK_EQUAL(vResults[i].first, i);
+        BOOST_CHECK_EQUAL(vResults[i].second, i % 3 != 2);
+    }
+    lock.unlock();
+
+    threads.interrupt_all();
+    threads.join_all();
+    queue.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(sigverifyqueue_dedup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CSignedMessage msgFirst = SignTestMessage(key, 0);
+    CSignedMessage msg = SignTestMessage(key, 1);
+
+    CSignatureVerifyQueue queue;
+    boost::thread_group threads;
+    queue.Start(2, threads);
+
+    // The first callback blocks, so the message behind it stays queued
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fRelease = false;
+    std::vector<std::pair<int, bool> > vResults;
+    BOOST_CHECK(queue.Push(NULL, msgFirst.hash, key.GetPubKey(), msgFirst.vchSig, msgFirst.strMessage,
+                           boost::bind(&WaitForFlag, &mutex, &cond, &fRelease, _1, _2)));
+    BOOST_CHECK(queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage,
+                           boost::bind(&RecordResult, &mutex, &vResults, 1, _1, _2)));
+    BOOST_CHECK(!queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage,
+                            boost::bind(&RecordResult, &mutex, &vResults, 2, _1, _2)));
+    BOOST_CHECK_EQUAL(queue.size(), 2);
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRelease = true;
+    }
+    cond.notify_all();
+    BOOST_REQUIRE(WaitForResults(mutex, vResults, 1));
+    MilliSleep(50);
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        BOOST_REQUIRE_EQUAL(vResults.size(), 1);
+        BOOST_CHECK(vResults[0] == std::make_pair(1, true));
+    }
+    BOOST_CHECK_EQUAL(queue.size(), 0);
+
+    // Once applied, the hash may be queued again
+    BOOST_CHECK(queue.Push(NULL, msg.hash, key.GetPubKey(), msg.vchSig, msg.strMessage,
+                           boost::bind(&RecordResult, &mutex, &vResults, 3, _1, _2)));
+    BOOST_REQUIRE(WaitForResults(mutex, vResults, 2));
+
+    threads.interrupt_all();
+    threads.join_all();
+    queue.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
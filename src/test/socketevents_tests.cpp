@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "socketevents.h"
+
+#include "test/test_bitcoin.h"
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+#ifndef WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+BOOST_FIXTURE_TEST_SUITE(socketevents_tests, BasicTestingSetup)
+
+#ifndef WIN32
+
+static int GetEvents(const std::vector<std::pair<SOCKET, int> > &vReady, SOCKET hSocket)
+{
+    int nEvents = 0;
+    for (size_t i = 0; i < vReady.size(); i++)
+        if (vReady[i].first == hSocket)
+            nEvents |= vReady[i].second;
+    return nEvents;
+}
+
+static void TestSocketEvents(SocketEventsMode mode)
+{
+    std::unique_ptr<CSocketEvents> events(CreateSocketEvents(mode));
+    BOOST_REQUIRE(events);
+
+    int sockets[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    std::vector<std::pair<SOCKET, int> > vReady;
+
+    BOOST_CHECK(events->Add(sockets[1], CSocketEvents::EVENT_RECV, false));
+    BOOST_CHECK(events->Wait(0, vReady));
+    BOOST_CHECK_EQUAL(GetEvents(vReady, sockets[1]), 0);
+
+    BOOST_CHECK_EQUAL(send(sockets[0], "a", 1, 0), 1);
+    BOOST_CHECK(events->Wait(1000, vReady));
+    BOOST_CHECK(GetEvents(vReady, sockets[1]) & CSocketEvents::EVENT_RECV);
+
+    // Nothing was read, so only a level triggered backend reports the socket again
+    BOOST_CHECK(events->Wait(0, vReady));
+    if (mode == SOCKETEVENTS_SELECT)
+        BOOST_CHECK(GetEvents(vReady, sockets[1]) & CSocketEvents::EVENT_RECV);
+    else
+        BOOST_CHECK_EQUAL(GetEvents(vReady, sockets[1]), 0);
+
+    // A changed interest is reported by any backend
+    BOOST_CHECK(events->Modify(sockets[1], CSocketEvents::EVENT_SEND));
+    BOOST_CHECK(events->Wait(1000, vReady));
+    BOOST_CHECK(GetEvents(vReady, sockets[1]) & CSocketEvents::EVENT_SEND);
+
+    events->Remove(sockets[1]);
+    BOOST_CHECK_EQUAL(send(sockets[0], "b", 1, 0), 1);
+    BOOST_CHECK(events->Wait(0, vReady));
+    BOOST_CHECK_EQUAL(GetEvents(vReady, sockets[1]), 0);
+
+    // A closed peer is reported as an error or as readable, either way recv() finds out
+    BOOST_CHECK(events->Add(sockets[1], CSocketEvents::EVENT_RECV, false));
+    close(sockets[0]);
+    BOOST_CHECK(events->Wait(1000, vReady));
+    BOOST_CHECK(GetEvents(vReady, sockets[1]) & (CSocketEvents::EVENT_RECV | CSocketEvents::EVENT_ERROR));
+
+    events->Remove(sockets[1]);
+    close(sockets[1]);
+}
+
+BOOST_AUTO_TEST_CASE(socketevents_select)
+{
+    TestSocketEvents(SOCKETEVENTS_SELECT);
+}
+
+BOOST_AUTO_TEST_CASE(socketevents_default)
+{
+    TestSocketEvents(DEFAULT_SOCKETEVENTS);
+}
+
+#endif // WIN32
+
+BOOST_AUTO_TEST_CASE(socketevents_modes)
+{
+    SocketEventsMode mode;
+    BOOST_CHECK(ParseSocketEventsMode("select", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_SELECT);
+    BOOST_CHECK(ParseSocketEventsMode(GetSocketEventsModeName(DEFAULT_SOCKETEVENTS), mode));
+    BOOST_CHECK_EQUAL(mode, DEFAULT_SOCKETEVENTS);
+    BOOST_CHECK(!ParseSocketEventsMode("kqueue", mode));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
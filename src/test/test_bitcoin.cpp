@@ -85,6 +85,8 @@ TestingSetup::TestingSetup(const std::string& chainName, std::string suf) : Basi
         mapArgs["-datadir"] = pathTemp.string();
         mempool.setSanityCheck(1.0);
         pblocktree = new CBlockTreeDB(1 << 20, true);
+        pindexdb = new CIndexDB(1 << 20, true);
+        pzerocoinhintdb = new CZerocoinSpendHintDB(1 << 20, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
         pwalletMain = new CWallet(string("wallet_test.dat"));
@@ -136,6 +138,8 @@ TestingSetup::~TestingSetup()
     pwalletMain = NULL;
     delete pcoinsTip;
     delete pcoinsdbview;
+    delete pzerocoinhintdb;
+    delete pindexdb;
     delete pblocktree;
 	try {
 		boost::filesystem::remove_all(pathTemp);
@@ -339,4 +339,88 @@ BOOST_AUTO_TEST_CASE(dbindexhelper_zerospend)
     }
 }
 
+BOOST_AUTO_TEST_CASE(indexdb_write_block)
+{
+    //MTP Testnet: height: 7980, txid: 02fdd0c09e5e84c4fb2207f9a5b9bbdb181c71436660865ee0ce36e37fff3492
+    CTransaction tx = TxFromStr("01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff05022c1f0104ffffffff062059925300000000232102a9ba61c5b6d3b6bbff24f8f972745bb9922448251ded2fddc5fdbc21d15b0ae0ac80f0fa02000000001976a914296134d2415bf1f2b518b3f673816d7e603b160088ac80f0fa02000000001976a914e1e1dc06a889c1b6d3eb00eef7a96f6a7cfb884888ac80f0fa02000000001976a914ab03ecfddee6330497be894d16c29ae341c123aa88ac80d1f008000000001976a9144281a58a1d5b2d3285e00cb45a8492debbdad4c588ac80f0fa02000000001976a9141fd264c0bb53bd9fef18e2248ddf1383d6e811ae88ac00000000");
+    uint160 key;
+    AddressType type;
+    CBitcoinAddress("TDk19wPKYq91i18qmY6U9FeTdTxwPeSveo").GetIndexKey(key, type);
+
+    uint256 hashPrev = GetRandHash();
+    uint256 hash = GetRandHash();
+    CBlockIndex indexPrev, index;
+    indexPrev.phashBlock = &hashPrev;
+    index.phashBlock = &hash;
+    index.pprev = &indexPrev;
+    index.nHeight = 7980;
+    index.nTime = 1000;
+
+    CIndexDB indexdb(1 << 20, true);
+    BOOST_CHECK(indexdb.GetBestBlock().IsNull());
+
+    CDbIndexHelper connectHelper(true, true);
+    connectHelper.ConnectTransaction(tx, 7980, 0, viewCache);
+    BOOST_CHECK(indexdb.WriteBlock(&index, true, connectHelper, tx.GetValueOut(), true));
+    BOOST_CHECK(indexdb.GetBestBlock() == hash);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    BOOST_CHECK(indexdb.ReadAddressIndex(key, type, addressIndex));
+    BOOST_CHECK_EQUAL(addressIndex.size(), 1U);
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent;
+    BOOST_CHECK(indexdb.ReadAddressUnspentIndex(key, type, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), 1U);
+    CAmount supply = 0;
+    BOOST_CHECK(indexdb.ReadTotalSupply(supply));
+    BOOST_CHECK_EQUAL(supply, tx.GetValueOut());
+    std::vector<uint256> hashes;
+    BOOST_CHECK(indexdb.ReadTimestampIndex(2000, 0, hashes));
+    BOOST_CHECK(hashes.size() == 1 && hashes[0] == hash);
+
+    CDbIndexHelper disconnectHelper(true, true);
+    disconnectHelper.DisconnectTransactionOutputs(tx, 7980, 0, viewCache);
+    disconnectHelper.DisconnectTransactionInputs(tx, 7980, 0, viewCache);
+    BOOST_CHECK(indexdb.WriteBlock(&index, false, disconnectHelper, tx.GetValueOut(), true));
+    BOOST_CHECK(indexdb.GetBestBlock() == hashPrev);
+
+    addressIndex.clear();
+    unspent.clear();
+    BOOST_CHECK(indexdb.ReadAddressIndex(key, type, addressIndex));
+    BOOST_CHECK(indexdb.ReadAddressUnspentIndex(key, type, unspent));
+    BOOST_CHECK(addressIndex.empty() && unspent.empty());
+    BOOST_CHECK(indexdb.ReadTotalSupply(supply));
+    BOOST_CHECK_EQUAL(supply, 0);
+}
+
+BOOST_AUTO_TEST_CASE(indexdb_migrate)
+{
+    CBlockTreeDB blocktree(1 << 20, true);
+    CAddressIndexKey addressKey(AddressType::payToPubKeyHash, uint160(), 10, 1, GetRandHash(), 0, false);
+    CSpentIndexKey spentKey(GetRandHash(), 1);
+    CSpentIndexValue spentValue(GetRandHash(), 0, 10, 5000, AddressType::payToPubKeyHash, uint160());
+    BOOST_CHECK(blocktree.Write(std::make_pair('a', addressKey), CAmount(5000)));
+    BOOST_CHECK(blocktree.Write(std::make_pair('p', spentKey), spentValue));
+    BOOST_CHECK(blocktree.Write('S', CAmount(7000)));
+
+    uint256 hashBest = GetRandHash();
+    CIndexDB indexdb(1 << 20, true);
+    BOOST_CHECK(indexdb.MigrateFrom(blocktree, hashBest));
+    BOOST_CHECK(indexdb.GetBestBlock() == hashBest);
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    BOOST_CHECK(indexdb.ReadAddressIndex(uint160(), AddressType::payToPubKeyHash, addressIndex));
+    BOOST_CHECK(addressIndex.size() == 1 && addressIndex[0].second == 5000);
+    CSpentIndexValue value;
+    BOOST_CHECK(indexdb.ReadSpentIndex(spentKey, value));
+    BOOST_CHECK(value.txid == spentValue.txid);
+    CAmount supply = 0;
+    BOOST_CHECK(indexdb.ReadTotalSupply(supply));
+    BOOST_CHECK_EQUAL(supply, 7000);
+
+    // The old copies are gone
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('a', addressKey)));
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('p', spentKey)));
+    BOOST_CHECK(!blocktree.Exists('S'));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,93 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "validationstats.h"
+#include "arith_uint256.h"
+#include "chain.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(validationstats_blocks)
+{
+    CValidationStats stats;
+    uint256 hash = uint256S("1234");
+    CBlockIndex index;
+    index.nHeight = 10;
+    index.phashBlock = &hash;
+
+    // times are summed up per block
+    stats.Add(VALIDATION_SIGMA, hash, 3);
+    stats.Add(VALIDATION_SIGMA, hash, 5);
+    stats.Add(VALIDATION_READ, hash, 0);
+    stats.BlockConnected(&index);
+    stats.Add(VALIDATION_SIGMA, hash, 1000);
+    stats.BlockConnected(&index);
+    CValidationStageStats sigma = stats.GetStage(VALIDATION_SIGMA);
+    BOOST_CHECK_EQUAL(sigma.nBlocks, 2U);
+    BOOST_CHECK_EQUAL(sigma.nTotal, 1008);
+    BOOST_CHECK_EQUAL(sigma.nMax, 1000);
+    // 8 is in [8, 16), 1000 in [512, 1024)
+    BOOST_CHECK_EQUAL(sigma.histogram[4], 1U);
+    BOOST_CHECK_EQUAL(sigma.histogram[10], 1U);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_READ).histogram[0], 1U);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_FLUSH).nBlocks, 0U);
+
+    UniValue last = stats.LastBlockToJSON();
+    BOOST_CHECK_EQUAL(find_value(last, "height").get_int(), 10);
+    BOOST_CHECK_EQUAL(find_value(find_value(last, "stages"), "sigma").get_int64(), 1000);
+    BOOST_CHECK(find_value(find_value(last, "stages"), "read").isNull());
+    BOOST_CHECK_EQUAL(find_value(stats.ToJSON(), "blocks").get_int64(), 2);
+
+    // the longest stages all end up in the last bucket
+    stats.Add(VALIDATION_FLUSH, hash, (int64_t)1 << 40);
+    stats.BlockConnected(&index);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_FLUSH).histogram[VALIDATION_HISTOGRAM_BUCKETS - 1], 1U);
+
+    stats.Reset();
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_SIGMA).nBlocks, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(validationstats_other_blocks)
+{
+    CValidationStats stats;
+    uint256 hash = uint256S("1234");
+    uint256 hashOther = uint256S("5678");
+    CBlockIndex index, indexOther;
+    index.phashBlock = &hash;
+    indexOther.phashBlock = &hashOther;
+
+    // times of other blocks, and of none, aren't charged to the block connected
+    stats.Add(VALIDATION_HEADER, hashOther, 7);
+    stats.Add(VALIDATION_DESERIALIZE, uint256(), 9);
+    stats.Add(VALIDATION_SIGMA, hash, 3);
+    stats.BlockConnected(&index);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_SIGMA).nBlocks, 1U);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_HEADER).nBlocks, 0U);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_DESERIALIZE).nBlocks, 0U);
+
+    // they are kept until their own block is connected
+    stats.BlockConnected(&indexOther);
+    CValidationStageStats header = stats.GetStage(VALIDATION_HEADER);
+    BOOST_CHECK_EQUAL(header.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(header.nTotal, 7);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_SIGMA).nBlocks, 1U);
+    BOOST_CHECK(find_value(find_value(stats.LastBlockToJSON(), "stages"), "sigma").isNull());
+
+    // blocks which are never connected drop out, the oldest first
+    stats.Add(VALIDATION_HEADER, hashOther, 1);
+    for (size_t i = 1; i <= MAX_VALIDATION_PENDING_BLOCKS; i++)
+        stats.Add(VALIDATION_HEADER, ArithToUint256(arith_uint256(i)), 1);
+    stats.BlockConnected(&indexOther);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_HEADER).nBlocks, 1U);
+    CBlockIndex indexLast;
+    uint256 hashLast = ArithToUint256(arith_uint256(MAX_VALIDATION_PENDING_BLOCKS));
+    indexLast.phashBlock = &hashLast;
+    stats.BlockConnected(&indexLast);
+    BOOST_CHECK_EQUAL(stats.GetStage(VALIDATION_HEADER).nBlocks, 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,9 @@
 #include "main.h"
 #include "consensus/consensus.h"
 #include "base58.h"
+#include "init.h"
+#include "ui_interface.h"
+#include "zerocoin.h"
 
 #include <stdint.h>
 
@@ -19,9 +22,12 @@
 
 using namespace std;
 
+static const char DB_COIN = 'C';
+// per-transaction records of older versions, converted by CCoinsViewDB::Upgrade
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
+static const char DB_TXINDEX_BEST_BLOCK = 'T';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
@@ -29,22 +35,153 @@ static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 static const char DB_TOTAL_SUPPLY = 'S';
+static const char DB_ZEROCOIN_SPEND_HINT = 'z';
 
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+namespace {
+
+/** Key of the record of a single unspent output */
+struct CCoinOutputKey
+{
+    char key;
+    uint256 hash;
+    uint32_t n;
+
+    CCoinOutputKey() : key(DB_COIN), n(0) {}
+    CCoinOutputKey(const uint256 &hashIn, uint32_t nIn) : key(DB_COIN), hash(hashIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(key);
+        READWRITE(hash);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * Record of a single unspent output
+ *
+ * Serialized format:
+ * - VARINT(nHeight * 4 + fCoinStake * 2 + fCoinBase)
+ * - VARINT(nTxVersion)
+ * - the CTxOut (via CTxOutCompressor)
+ */
+class CCoinOutputRecord
+{
+public:
+    int nHeight;
+    bool fCoinBase;
+    bool fCoinStake;
+    int nTxVersion;
+    CTxOut out;
+
+    CCoinOutputRecord() : nHeight(0), fCoinBase(false), fCoinStake(false), nTxVersion(0) {}
+
+    CCoinOutputRecord(const CCoins &coins, uint32_t n) :
+        nHeight(coins.nHeight), fCoinBase(coins.fCoinBase), fCoinStake(coins.fCoinStake), nTxVersion(coins.nVersion),
+        out(coins.vout[n]) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return ::GetSerializeSize(VARINT(GetCode()), nType, nVersion) +
+               ::GetSerializeSize(VARINT(nTxVersion), nType, nVersion) +
+               ::GetSerializeSize(CTxOutCompressor(REF(out)), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s, int nType, int nVersion) const {
+        ::Serialize(s, VARINT(GetCode()), nType, nVersion);
+        ::Serialize(s, VARINT(nTxVersion), nType, nVersion);
+        ::Serialize(s, CTxOutCompressor(REF(out)), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s, int nType, int nVersion) {
+        unsigned int nCode = 0;
+        ::Unserialize(s, VARINT(nCode), nType, nVersion);
+        nHeight = nCode / 4;
+        fCoinStake = (nCode & 2) != 0;
+        fCoinBase = (nCode & 1) != 0;
+        ::Unserialize(s, VARINT(nTxVersion), nType, nVersion);
+        ::Unserialize(s, REF(CTxOutCompressor(out)), nType, nVersion);
+    }
+
+private:
+    unsigned int GetCode() const {
+        return nHeight * 4 + (fCoinStake ? 2 : 0) + (fCoinBase ? 1 : 0);
+    }
+};
+
+/** Read the output records of txid starting at the cursor position. Leaves the cursor after the last of them */
+bool ReadCoinOutputs(CDBIterator &cursor, const uint256 &txid, CCoins &coins, unsigned int *pnValueSize)
+{
+    coins.Clear();
+    bool fFound = false;
+    for (; cursor.Valid(); cursor.Next()) {
+        CCoinOutputKey key;
+        if (!cursor.GetKey(key) || key.key != DB_COIN || key.hash != txid)
+            break;
+        CCoinOutputRecord record;
+        if (!cursor.GetValue(record))
+            return error("%s: failed to read output %s:%u", __func__, txid.ToString(), key.n);
+        if (coins.vout.size() <= key.n)
+            coins.vout.resize(key.n + 1);
+        coins.vout[key.n] = record.out;
+        coins.nHeight = record.nHeight;
+        coins.fCoinBase = record.fCoinBase;
+        coins.fCoinStake = record.fCoinStake;
+        coins.nVersion = record.nTxVersion;
+        if (pnValueSize)
+            *pnValueSize += cursor.GetValueSize();
+        fFound = true;
+    }
+    return fFound;
+}
+
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true), nCursorWrites(0), nWrites(0)
 {
 }
 
+bool CCoinsViewDB::WriteBatch(CDBBatch &batch) {
+    bool fResult = db.WriteBatch(batch);
+    nWrites++;
+    return fResult;
+}
+
+CDBIterator &CCoinsViewDB::SeekOutputs(const uint256 &txid) const {
+    // A new iterator costs more than the seek, so it's only created once the old one missed a write
+    uint64_t nWritesNow = nWrites;
+    if (!pcursorOutputs || nCursorWrites != nWritesNow) {
+        pcursorOutputs.reset(const_cast<CDBWrapper&>(db).NewIterator(true));
+        nCursorWrites = nWritesNow;
+    }
+    // Outputs of a transaction are adjacent in the key space, one seek finds all of them
+    pcursorOutputs->Seek(CCoinOutputKey(txid, 0));
+    return *pcursorOutputs;
+}
+
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    LOCK(cs_cursor);
+    return ReadCoinOutputs(SeekOutputs(txid), txid, coins, NULL);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    // Most transactions still have their first output, a point read answers that through the bloom filters
+    if (db.Exists(CCoinOutputKey(txid, 0)))
+        return true;
+
+    LOCK(cs_cursor);
+    CDBIterator &cursor = SeekOutputs(txid);
+    CCoinOutputKey key;
+    return cursor.Valid() && cursor.GetKey(key) && key.key == DB_COIN && key.hash == txid;
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -54,30 +191,316 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
+std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    std::vector<uint256> vhashHeadBlocks;
+    if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks))
+        return std::vector<uint256>();
+    return vhashHeadBlocks;
+}
+
+/** Queue the outputs of a dirty entry that changed since it was read. Returns the number of outputs queued */
+static size_t WriteCoinsEntry(CDBBatch &batch, const uint256 &txid, const CCoinsCacheEntry &entry)
+{
+    size_t changedOutputs = 0;
+    uint32_t nOutputs = std::max<uint32_t>(entry.coins.vout.size(), entry.ParentOutputs());
+    for (uint32_t n = 0; n < nOutputs; n++) {
+        if (!entry.IsOutputChanged(n))
+            continue;
+        if (entry.coins.IsAvailable(n))
+            batch.Write(CCoinOutputKey(txid, n), CCoinOutputRecord(entry.coins, n));
+        else
+            batch.Erase(CCoinOutputKey(txid, n));
+        changedOutputs++;
+    }
+    return changedOutputs;
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
+    size_t changedOutputs = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            // Only the outputs spent or created since the entry was read are written
+            changedOutputs += WriteCoinsEntry(batch, it->first, it->second);
             changed++;
         }
         count++;
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
-    if (!hashBlock.IsNull())
+    if (!hashBlock.IsNull()) {
         batch.Write(DB_BEST_BLOCK, hashBlock);
+        batch.Erase(DB_HEAD_BLOCKS);
+    }
+
+    LogPrint("coindb", "Committing %u changed transactions (out of %u), %u outputs to coin database...\n",
+             (unsigned int)changed, (unsigned int)count, (unsigned int)changedOutputs);
+    return WriteBatch(batch);
+}
+
+bool CCoinsViewDB::WriteCoinsInBatches(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nMaxBatchSize,
+                                       size_t &nBytesWritten, unsigned int &nBatches) {
+    std::vector<uint256> vhashHeadBlocks;
+    vhashHeadBlocks.push_back(hashBlock);
+    vhashHeadBlocks.push_back(GetBestBlock());
+
+    nBytesWritten = 0;
+    nBatches = 0;
+    size_t changed = 0;
+    CDBBatch batch(db);
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY))
+            continue;
+        WriteCoinsEntry(batch, it->first, it->second);
+        changed++;
+        if (batch.SizeEstimate() > nMaxBatchSize) {
+            // The first partial batch marks the database as inconsistent until the last one is written
+            if (nBatches == 0)
+                batch.Write(DB_HEAD_BLOCKS, vhashHeadBlocks);
+            nBytesWritten += batch.SizeEstimate();
+            nBatches++;
+            if (!WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    batch.Erase(DB_HEAD_BLOCKS);
+    nBytesWritten += batch.SizeEstimate();
+    nBatches++;
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    LogPrint("coindb", "Committing %u changed transactions to coin database in %u batches...\n",
+             (unsigned int)changed, nBatches);
+    return WriteBatch(batch);
+}
+
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    std::pair<char, uint256> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS)
+        return true;
+
+    LogPrintf("Upgrading coin database to per-output records...\n");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    // Converted records and their erasure are committed together, so an interrupted upgrade resumes where it stopped
+    static const size_t nMaxBatchSize = 16 << 20;
+    CDBBatch batch(db);
+    int64_t nCount = 0;
+    int nReportDone = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        if (nCount++ % 256 == 0) {
+            // Keys are ordered by txid, its first two bytes tell how far we are
+            uint32_t nHigh = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
+            int nPercentageDone = (int)(nHigh * 100.0 / 65536.0 + 0.5);
+            uiInterface.ShowProgress(_("Upgrading UTXO database"), nPercentageDone);
+            if (nReportDone < nPercentageDone / 10) {
+                LogPrintf("[%d%%]...", nPercentageDone);
+                nReportDone = nPercentageDone / 10;
+            }
+        }
+        CCoins coins;
+        if (!pcursor->GetValue(coins))
+            return error("%s: cannot parse coins of %s", __func__, key.second.ToString());
+        for (uint32_t n = 0; n < coins.vout.size(); n++) {
+            if (!coins.vout[n].IsNull())
+                batch.Write(CCoinOutputKey(key.second, n), CCoinOutputRecord(coins, n));
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > nMaxBatchSize) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to write upgraded coins", __func__);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    if (!WriteBatch(batch))
+        return error("%s: failed to write upgraded coins", __func__);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView *baseIn, CCoinsViewDB *dbIn, size_t nMaxBatchSizeIn) :
+    CCoinsViewBacked(baseIn), db(dbIn), nMaxBatchSize(nMaxBatchSizeIn), nFlushingUsage(0), fFlushing(false),
+    fWritePending(false), fWriteFailed(false), fStop(false), fNextBackground(false), fNextBatched(false)
+{
+    writerThread = boost::thread(boost::bind(&CCoinsViewBackgroundFlush::ThreadWriter, this));
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    cond.notify_all();
+    // A pending write is finished before the thread exits
+    writerThread.join();
+}
+
+void CCoinsViewBackgroundFlush::ThreadWriter()
+{
+    RenameThread("bitcoin-coinsflush");
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (true) {
+        while (!fWritePending && !fStop)
+            cond.wait(lock);
+        if (!fWritePending)
+            break;
+        fWritePending = false;
+
+        // Nobody modifies mapFlushing until fFlushing is cleared, readers only look up entries
+        lock.unlock();
+        bool fOk = WriteCoins(mapFlushing, hashFlushing, nMaxBatchSize, true);
+        lock.lock();
+
+        if (fOk) {
+            mapFlushing.clear();
+            nFlushingUsage = 0;
+            fFlushing = false;
+        } else {
+            // Keep serving the entries, the database is behind them
+            LogPrintf("%s: failed to write to coin database\n", __func__);
+            fWriteFailed = true;
+        }
+        cond.notify_all();
+    }
+}
+
+bool CCoinsViewBackgroundFlush::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nBatchSize,
+                                           bool fBackground)
+{
+    int64_t nStart = GetTimeMicros();
+    size_t nBytes = 0;
+    unsigned int nBatches = 0;
+    bool fOk = db->WriteCoinsInBatches(mapCoins, hashBlock, nBatchSize, nBytes, nBatches);
+    int64_t nDuration = GetTimeMicros() - nStart;
+    LogPrint("coindb", "%s coin database write: %u bytes in %u batches, %.2fms\n",
+             fBackground ? "Background" : "Synchronous", nBytes, nBatches, nDuration * 0.001);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    stats.nFlushes++;
+    if (fBackground)
+        stats.nBackgroundFlushes++;
+    stats.nLastDuration = nDuration;
+    stats.nLastBytes = nBytes;
+    stats.nLastBatches = nBatches;
+    stats.nTotalDuration += nDuration;
+    stats.nTotalBytes += nBytes;
+    return fOk;
+}
+
+bool CCoinsViewBackgroundFlush::GetCoins(const uint256 &txid, CCoins &coins) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fFlushing) {
+            CCoinsMap::const_iterator it = mapFlushing.find(txid);
+            if (it != mapFlushing.end()) {
+                coins = it->second.coins;
+                return true;
+            }
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoins(const uint256 &txid) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fFlushing) {
+            CCoinsMap::const_iterator it = mapFlushing.find(txid);
+            if (it != mapFlushing.end())
+                return !it->second.coins.IsPruned();
+        }
+    }
+    return base->HaveCoins(txid);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fFlushing)
+            return hashFlushing;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    // One write in flight at a time
+    if (!Sync())
+        return false;
+
+    if (!fNextBackground) {
+        bool fOk = WriteCoins(mapCoins, hashBlock, fNextBatched ? nMaxBatchSize : std::numeric_limits<size_t>::max(), false);
+        mapCoins.clear();
+        return fOk;
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        mapFlushing.swap(mapCoins);
+        hashFlushing = hashBlock;
+        fFlushing = true;
+        fWritePending = true;
+    }
+    cond.notify_all();
+    mapCoins.clear();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::Flush(CCoinsViewCache &cache, bool fBatched, bool fBackground)
+{
+    assert(fBatched || !fBackground);
+    size_t nUsage = cache.DynamicMemoryUsage();
+    fNextBatched = fBatched;
+    fNextBackground = fBackground;
+    bool fOk = cache.Flush();
+    fNextBatched = false;
+    fNextBackground = false;
+    if (fOk && fBackground) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fFlushing)
+            nFlushingUsage = nUsage;
+    }
+    return fOk;
+}
+
+bool CCoinsViewBackgroundFlush::Sync()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (fWritePending || (fFlushing && !fWriteFailed))
+        cond.wait(lock);
+    return !fWriteFailed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nFlushingUsage;
+}
+
+CCoinsFlushStats CCoinsViewBackgroundFlush::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    CCoinsFlushStats ret = stats;
+    ret.fInProgress = fFlushing;
+    return ret;
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+    Read(DB_TXINDEX_BEST_BLOCK, hashTxIndexBestBlock);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -106,42 +529,53 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
-    // Cache key of first record
-    i->pcursor->GetKey(i->keyTmp);
+    i->pcursor->Seek(DB_COIN);
+    // Read the outputs of the first transaction
+    i->ReadNext();
     return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(uint256 &key) const
 {
-    // Return cached key
-    if (keyTmp.first == DB_COINS) {
-        key = keyTmp.second;
+    if (fValid) {
+        key = txid;
         return true;
     }
     return false;
 }
 
-bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
+bool CCoinsViewDBCursor::GetValue(CCoins &coinsOut) const
 {
-    return pcursor->GetValue(coins);
+    if (!fValid)
+        return false;
+    coinsOut = coins;
+    return true;
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
-    return pcursor->GetValueSize();
+    return nValueSize;
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return fValid;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    ReadNext();
+}
+
+void CCoinsViewDBCursor::ReadNext()
+{
+    fValid = false;
+    nValueSize = 0;
+    CCoinOutputKey key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.key != DB_COIN)
+        return;
+    txid = key.hash;
+    fValid = ReadCoinOutputs(*pcursor, txid, coins, &nValueSize);
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -160,139 +594,26 @@ bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
     return Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect, const uint256 &hashBlock) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
-}
-
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
-        }
-    }
-
-    return true;
-}
-
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, AddressType type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    if (start > 0 && end > 0) {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == type) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
-        }
-    }
-
+    batch.Write(DB_TXINDEX_BEST_BLOCK, hashBlock);
+    if (!WriteBatch(batch))
+        return false;
+    hashTxIndexBestBlock = hashBlock;
     return true;
 }
 
-
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+bool CBlockTreeDB::WriteTxIndexBestBlock(const uint256 &hashBlock) {
     CDBBatch batch(*this);
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
-        } else {
-            break;
-        }
-    }
-
+    if (hashBlock.IsNull())
+        batch.Erase(DB_TXINDEX_BEST_BLOCK);
+    else
+        batch.Write(DB_TXINDEX_BEST_BLOCK, hashBlock);
+    if (!WriteBatch(batch))
+        return false;
+    hashTxIndexBestBlock = hashBlock;
     return true;
 }
 
@@ -400,15 +721,163 @@ int CBlockTreeDB::GetBlockIndexVersion(uint256 const & blockHash)
 }
 
 
-bool CBlockTreeDB::AddTotalSupply(CAmount const & supply)
-{
-    CAmount current = 0;
-    Read(DB_TOTAL_SUPPLY, current);
-    current += supply;
-    return Write(DB_TOTAL_SUPPLY, current);
+CZerocoinSpendHintDB::CZerocoinSpendHintDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "zerocoinhints", nCacheSize, fMemory, fWipe) {
+}
+
+bool CZerocoinSpendHintDB::ReadHint(const uint256 &txid, int nIn, CZerocoinSpendHint &hint) {
+    return Read(make_pair(DB_ZEROCOIN_SPEND_HINT, make_pair(txid, nIn)), hint);
+}
+
+bool CZerocoinSpendHintDB::WriteHints(const std::vector<std::pair<std::pair<uint256, int>, CZerocoinSpendHint> > &hints) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<std::pair<uint256, int>, CZerocoinSpendHint> >::const_iterator it = hints.begin(); it != hints.end(); it++)
+        batch.Write(make_pair(DB_ZEROCOIN_SPEND_HINT, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CZerocoinSpendHintDB::EraseHints(const std::vector<std::pair<uint256, int> > &spends) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<uint256, int> >::const_iterator it = spends.begin(); it != spends.end(); it++)
+        batch.Erase(make_pair(DB_ZEROCOIN_SPEND_HINT, *it));
+    return WriteBatch(batch);
+}
+
+CIndexDB::CIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "indexes", nCacheSize, fMemory, fWipe) {
+    Read(DB_BEST_BLOCK, hashBestBlock);
+}
+
+bool CIndexDB::WriteBlock(const CBlockIndex *pindex, bool fConnect, const CDbIndexHelper &helper, CAmount nSupplyChange,
+                          bool fTimestampIndex) {
+    CDBBatch batch(*this);
+    if (helper.hasAddressIndex()) {
+        const CDbIndexHelper::AddressIndex &addressIndex = helper.getAddressIndex();
+        for (CDbIndexHelper::AddressIndex::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+            if (fConnect)
+                batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+            else
+                batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+        }
+
+        const CDbIndexHelper::AddressUnspentIndex &unspentIndex = helper.getAddressUnspentIndex();
+        for (CDbIndexHelper::AddressUnspentIndex::const_iterator it = unspentIndex.begin(); it != unspentIndex.end(); it++) {
+            if (it->second.IsNull())
+                batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+            else
+                batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+
+        CAmount nSupply = 0;
+        Read(DB_TOTAL_SUPPLY, nSupply);
+        batch.Write(DB_TOTAL_SUPPLY, nSupply + (fConnect ? nSupplyChange : -nSupplyChange));
+    }
+
+    if (fConnect && helper.hasSpentIndex()) {
+        const CDbIndexHelper::SpentIndex &spentIndex = helper.getSpentIndex();
+        for (CDbIndexHelper::SpentIndex::const_iterator it = spentIndex.begin(); it != spentIndex.end(); it++) {
+            if (it->second.IsNull())
+                batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+            else
+                batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+
+    if (fConnect && fTimestampIndex)
+        batch.Write(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())), 0);
+
+    uint256 hashNewBest = fConnect ? pindex->GetBlockHash() : (pindex->pprev ? pindex->pprev->GetBlockHash() : uint256());
+    batch.Write(DB_BEST_BLOCK, hashNewBest);
+    if (!WriteBatch(batch))
+        return false;
+    hashBestBlock = hashNewBest;
+    return true;
+}
+
+bool CIndexDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CIndexDB::ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                unspentOutputs.push_back(make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
 }
 
-bool CBlockTreeDB::ReadTotalSupply(CAmount & supply)
+bool CIndexDB::ReadAddressIndex(uint160 addressHash, AddressType type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    if (start > 0 && end > 0) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == type) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                addressIndex.push_back(make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CIndexDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
+            hashes.push_back(key.second.blockHash);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CIndexDB::ReadTotalSupply(CAmount & supply)
 {
     CAmount current = 0;
     if(Read(DB_TOTAL_SUPPLY, current)) {
@@ -418,6 +887,111 @@ bool CBlockTreeDB::ReadTotalSupply(CAmount & supply)
     return false;
 }
 
+namespace {
+
+/** Copy the records of one index from the block tree database in batches, adding their number to nCopied */
+template <typename K, typename V>
+bool CopyLegacyIndex(CBlockTreeDB &blocktree, CIndexDB &indexdb, char chPrefix, size_t &nCopied)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(blocktree.NewIterator(false));
+    CDBBatch batch(indexdb);
+    for (pcursor->Seek(chPrefix); pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chPrefix)
+            break;
+        V value;
+        if (!pcursor->GetValue(value))
+            return error("%s: unable to read index record", __func__);
+        batch.Write(key, value);
+        nCopied++;
+        if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!indexdb.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            if (ShutdownRequested())
+                return false;
+        }
+    }
+    return indexdb.WriteBatch(batch);
+}
+
+/** Erase the records of one index from the block tree database, in batches */
+template <typename K>
+bool EraseLegacyIndex(CBlockTreeDB &blocktree, char chPrefix)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(blocktree.NewIterator(false));
+    CDBBatch batch(blocktree);
+    for (pcursor->Seek(chPrefix); pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chPrefix)
+            break;
+        batch.Erase(key);
+        if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!blocktree.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+    return blocktree.WriteBatch(batch);
+}
+
+template <typename K>
+bool HaveLegacyIndex(CBlockTreeDB &blocktree, char chPrefix)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(blocktree.NewIterator(false));
+    pcursor->Seek(chPrefix);
+    std::pair<char, K> key;
+    return pcursor->Valid() && pcursor->GetKey(key) && key.first == chPrefix;
+}
+
+}
+
+bool CIndexDB::MigrateFrom(CBlockTreeDB &blocktree, const uint256 &hashBlock) {
+    CAmount nSupply = 0;
+    bool fHaveSupply = blocktree.Read(DB_TOTAL_SUPPLY, nSupply);
+    if (!fHaveSupply && !HaveLegacyIndex<CAddressIndexKey>(blocktree, DB_ADDRESSINDEX) &&
+        !HaveLegacyIndex<CAddressUnspentKey>(blocktree, DB_ADDRESSUNSPENTINDEX) &&
+        !HaveLegacyIndex<CSpentIndexKey>(blocktree, DB_SPENTINDEX) &&
+        !HaveLegacyIndex<CTimestampIndexKey>(blocktree, DB_TIMESTAMPINDEX))
+        return true;
+
+    // An interrupted migration is started over, the records already copied are overwritten. Without a chain state
+    // to be in sync with (-reindex-chainstate) the indexes are rebuilt instead
+    if (hashBestBlock.IsNull() && !hashBlock.IsNull()) {
+        LogPrintf("Moving address, spent and timestamp indexes to their own database...\n");
+        uiInterface.ShowProgress(_("Upgrading index database..."), 0);
+        size_t nCopied = 0;
+        bool fOk = CopyLegacyIndex<CAddressIndexKey, CAmount>(blocktree, *this, DB_ADDRESSINDEX, nCopied);
+        uiInterface.ShowProgress(_("Upgrading index database..."), 40);
+        fOk = fOk && CopyLegacyIndex<CAddressUnspentKey, CAddressUnspentValue>(blocktree, *this, DB_ADDRESSUNSPENTINDEX, nCopied);
+        uiInterface.ShowProgress(_("Upgrading index database..."), 60);
+        fOk = fOk && CopyLegacyIndex<CSpentIndexKey, CSpentIndexValue>(blocktree, *this, DB_SPENTINDEX, nCopied);
+        uiInterface.ShowProgress(_("Upgrading index database..."), 90);
+        fOk = fOk && CopyLegacyIndex<CTimestampIndexKey, int>(blocktree, *this, DB_TIMESTAMPINDEX, nCopied);
+        uiInterface.ShowProgress("", 100);
+        if (!fOk)
+            return false;
+
+        CDBBatch batch(*this);
+        if (fHaveSupply)
+            batch.Write(DB_TOTAL_SUPPLY, nSupply);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+        if (!WriteBatch(batch, true))
+            return false;
+        hashBestBlock = hashBlock;
+        LogPrintf("Moved %u index records\n", nCopied);
+    }
+
+    // Everything is in the index database now, drop the old copies
+    CDBBatch batch(blocktree);
+    batch.Erase(DB_TOTAL_SUPPLY);
+    return blocktree.WriteBatch(batch) &&
+           EraseLegacyIndex<CAddressIndexKey>(blocktree, DB_ADDRESSINDEX) &&
+           EraseLegacyIndex<CAddressUnspentKey>(blocktree, DB_ADDRESSUNSPENTINDEX) &&
+           EraseLegacyIndex<CSpentIndexKey>(blocktree, DB_SPENTINDEX) &&
+           EraseLegacyIndex<CTimestampIndexKey>(blocktree, DB_TIMESTAMPINDEX);
+}
+
 /******************************************************************************/
 
 CDbIndexHelper::CDbIndexHelper(bool addressIndex_, bool spentIndex_)
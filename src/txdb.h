@@ -10,16 +10,23 @@
 #include "dbwrapper.h"
 #include "chain.h"
 #include "spentindex.h"
+#include "sync.h"
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CZerocoinSpendHint;
 class uint256;
 
 //! -dbcache default (MiB)
@@ -36,6 +43,12 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to the address/spent/timestamp index database cache (MiB)
+static const int64_t nMaxIndexDBCache = 1024;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+//! -dbbatchsize default, bytes per coin database write batch when flushing in batches
+static const int64_t nDefaultDbBatchSize = 16 << 20;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -67,14 +80,112 @@ class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+private:
+    //! Cursor GetCoins and HaveCoins seek to the outputs of a transaction, reused until the database is written to
+    mutable CCriticalSection cs_cursor;
+    mutable boost::scoped_ptr<CDBIterator> pcursorOutputs;
+    mutable uint64_t nCursorWrites;
+    //! Batches written so far, a cursor doesn't see the writes made after it was created
+    std::atomic<uint64_t> nWrites;
+
+    bool WriteBatch(CDBBatch &batch);
+    //! Seek the reused cursor to the first output record of txid (requires cs_cursor)
+    CDBIterator &SeekOutputs(const uint256 &txid) const;
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
+    std::vector<uint256> GetHeadBlocks() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+
+    /**
+     * Write the dirty entries of mapCoins in batches of about nMaxBatchSize bytes. Until the last batch, which
+     * moves the best block to hashBlock, the database is marked as being between the current best block and
+     * hashBlock (see GetHeadBlocks). mapCoins is not modified.
+     */
+    bool WriteCoinsInBatches(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nMaxBatchSize,
+                             size_t &nBytesWritten, unsigned int &nBatches);
+
+    //! Convert per-transaction records of older versions to per-output records. Returns false if interrupted
+    bool Upgrade();
+};
+
+/** Chainstate flush counters, times in microseconds */
+struct CCoinsFlushStats
+{
+    uint64_t nFlushes;
+    uint64_t nBackgroundFlushes;
+    bool fInProgress;
+    int64_t nLastDuration;
+    uint64_t nLastBytes;
+    unsigned int nLastBatches;
+    int64_t nTotalDuration;
+    uint64_t nTotalBytes;
+
+    CCoinsFlushStats() : nFlushes(0), nBackgroundFlushes(0), fInProgress(false), nLastDuration(0), nLastBytes(0),
+                         nLastBatches(0), nTotalDuration(0), nTotalBytes(0) {}
+};
+
+/**
+ * Sits between the coins cache and the coin database and writes flushed coins to the database, optionally on a
+ * background thread. While a background write is in progress the flushed entries are served from memory, so the
+ * cache above can keep connecting blocks. Only one write is in flight at a time; the next flush waits for it.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB *db;
+    size_t nMaxBatchSize;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable cond;
+    // entries handed to the writer and the best block they bring the database to
+    CCoinsMap mapFlushing;
+    uint256 hashFlushing;
+    size_t nFlushingUsage;
+    // set from handing entries over until they are written
+    bool fFlushing;
+    // set until the writer thread picks the entries up
+    bool fWritePending;
+    bool fWriteFailed;
+    bool fStop;
+    CCoinsFlushStats stats;
+    boost::thread writerThread;
+
+    // how the next BatchWrite call writes, see Flush
+    bool fNextBackground;
+    bool fNextBatched;
+
+    void ThreadWriter();
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, size_t nBatchSize, bool fBackground);
+
+public:
+    /** Reads go through baseIn, writes go to dbIn which has to be at the bottom of baseIn */
+    CCoinsViewBackgroundFlush(CCoinsView *baseIn, CCoinsViewDB *dbIn, size_t nMaxBatchSizeIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    bool HaveCoins(const uint256 &txid) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    /**
+     * Flush the cache into the database. With fBatched the write is split into bounded batches, which requires the
+     * new best block to descend from the one in the database so that an interrupted write can be completed by
+     * replaying blocks. fBackground additionally returns before the write is done.
+     */
+    bool Flush(CCoinsViewCache &cache, bool fBatched, bool fBackground);
+
+    //! Wait until the write in flight, if any, is done. Returns false if it failed
+    bool Sync();
+
+    //! Memory held by entries being written in the background
+    size_t DynamicMemoryUsage() const;
+
+    CCoinsFlushStats GetStats() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -92,9 +203,15 @@ public:
 
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), fValid(false), nValueSize(0) {}
+    void ReadNext();
+
     boost::scoped_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    // outputs of the current transaction, read from the consecutive per-output records
+    bool fValid;
+    uint256 txid;
+    CCoins coins;
+    unsigned int nValueSize;
 
     friend class CCoinsViewDB;
 };
@@ -105,6 +222,9 @@ class CBlockTreeDB : public CDBWrapper
 public:
     CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 private:
+    // cached copy of the transaction index best block record
+    uint256 hashTxIndexBestBlock;
+
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
 public:
@@ -114,27 +234,16 @@ public:
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool ReadAddressIndex(uint160 addressHash, AddressType type,
-                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    //! Write the positions of the transactions of a block and make it the transaction index best block
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list, const uint256 &hashBlock);
+    //! Block the transaction index is in sync with, null if nothing was indexed yet
+    uint256 GetTxIndexBestBlock() const { return hashTxIndexBestBlock; }
+    bool WriteTxIndexBestBlock(const uint256 &hashBlock);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
     int GetBlockIndexVersion();
     int GetBlockIndexVersion(uint256 const & blockHash);
-    bool AddTotalSupply(CAmount const & supply);
-    bool ReadTotalSupply(CAmount & supply);
 };
 
 
@@ -159,6 +268,9 @@ public:
     using AddressUnspentIndex = std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >;
     using SpentIndex = std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >;
 
+    bool hasAddressIndex() const { return bool(addressIndex); }
+    bool hasSpentIndex() const { return bool(spentIndex); }
+
     AddressIndex const & getAddressIndex() const;
     AddressUnspentIndex const & getAddressUnspentIndex() const;
     SpentIndex const & getSpentIndex() const;
@@ -169,4 +281,68 @@ private:
     boost::optional<SpentIndex> spentIndex;
 };
 
+/**
+ * Access to the optional explorer indexes: address, address unspent, spent and timestamp index and the total supply.
+ * Kept apart from the block tree database so that index lookups and writes have their own cache and compactions.
+ * The indexes may lag behind the active chain, they are in sync with the block returned by GetBestBlock().
+ */
+class CIndexDB : public CDBWrapper
+{
+private:
+    // cached copy of the best block record
+    uint256 hashBestBlock;
+
+    CIndexDB(const CIndexDB&);
+    void operator=(const CIndexDB&);
+
+public:
+    CIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    //! Block the indexes are in sync with, null if nothing was indexed yet
+    uint256 GetBestBlock() const { return hashBestBlock; }
+
+    /**
+     * Write the index changes of a connected or disconnected block and move the best block to the block or its
+     * parent, all in one batch. The spent and timestamp index are only extended, never rolled back.
+     */
+    bool WriteBlock(const CBlockIndex *pindex, bool fConnect, const CDbIndexHelper &helper, CAmount nSupplyChange,
+                    bool fTimestampIndex);
+
+    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    bool ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    bool ReadAddressIndex(uint160 addressHash, AddressType type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int start = 0, int end = 0);
+    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool ReadTotalSupply(CAmount & supply);
+
+    /**
+     * Move index records that older versions kept in the block tree database here. The moved indexes are taken to
+     * be in sync with hashBlock. Returns false if interrupted or on error
+     */
+    bool MigrateFrom(CBlockTreeDB &blocktree, const uint256 &hashBlock);
+};
+
+/**
+ * Accumulators the legacy zerocoin spends of connected blocks were verified against (zerocoinhints/). Not wiped on
+ * reindex, so replaying the chain verifies each spend once instead of searching again. Hints are checked against the
+ * recomputed accumulator before use, a stale one only costs the search.
+ */
+class CZerocoinSpendHintDB : public CDBWrapper
+{
+private:
+    CZerocoinSpendHintDB(const CZerocoinSpendHintDB&);
+    void operator=(const CZerocoinSpendHintDB&);
+
+public:
+    CZerocoinSpendHintDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool ReadHint(const uint256 &txid, int nIn, CZerocoinSpendHint &hint);
+    //! Hints of the spends of a connected block
+    bool WriteHints(const std::vector<std::pair<std::pair<uint256, int>, CZerocoinSpendHint> > &hints);
+    //! Drop the hints of the spends of a disconnected block
+    bool EraseHints(const std::vector<std::pair<uint256, int> > &spends);
+};
+
 #endif // BITCOIN_TXDB_H
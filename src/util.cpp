@@ -212,6 +212,53 @@ static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
 static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static list<string> *vMsgsBeforeOpenLog;
+static boost::condition_variable* condLogWriter = NULL;
+static boost::thread* threadLogWriter = NULL;
+
+unsigned int nLogQueueSize = DEFAULT_LOGQUEUE;
+bool fLogDropDebug = DEFAULT_LOGDROPDEBUG;
+unsigned int nLogRateLimit = DEFAULT_LOGRATE;
+
+/**
+ * Messages waiting for the log writer. Logging threads push onto a lock-free
+ * intrusive list by swapping its head, the writer pops from the tail it owns.
+ * The stub node keeps the list from ever being empty. Like the objects above,
+ * everything here stays usable during global destruction.
+ */
+struct CLogNode
+{
+    std::atomic<CLogNode*> next;
+};
+
+struct CLogMessage : public CLogNode
+{
+    int64_t nTimeMicros; //!< captured by the logging thread
+    std::string str;
+};
+
+static CLogNode logQueueStub;
+static std::atomic<CLogNode*> logQueueHead(&logQueueStub);
+static CLogNode* logQueueTail = &logQueueStub; // guarded by mutexDebugLog
+static std::atomic<unsigned int> nLogQueued(0);
+static std::atomic<uint64_t> nLogDropped(0);
+static std::atomic<bool> fLogWriterRunning(false);
+//! Logging threads between checking fLogWriterRunning and queueing their message
+static std::atomic<int> nLogProducers(0);
+
+//! Queued messages are written with one fwrite() per this many bytes
+static const size_t LOG_WRITE_BATCH = 64 * 1024;
+
+/** Messages of a debug category within the current second, for -lograte */
+struct CLogCategoryRate
+{
+    std::atomic<const char*> category;
+    std::atomic<int64_t> nSecond;
+    std::atomic<unsigned int> nMessages;
+    std::atomic<unsigned int> nSuppressed;
+};
+
+static const size_t LOG_CATEGORY_SLOTS = 64;
+static CLogCategoryRate logCategoryRates[LOG_CATEGORY_SLOTS];
 
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
@@ -223,6 +270,7 @@ static void DebugPrintInit()
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new list<string>;
+    condLogWriter = new boost::condition_variable();
 }
 
 void OpenDebugLog()
@@ -275,12 +323,55 @@ bool LogAcceptCategory(const char* category)
     return true;
 }
 
+static CLogCategoryRate* GetLogCategoryRate(const char* category)
+{
+    size_t nHash = 0;
+    for (const char* p = category; *p; p++)
+        nHash = nHash * 31 + (unsigned char)*p;
+
+    for (size_t i = 0; i < LOG_CATEGORY_SLOTS; i++) {
+        CLogCategoryRate& rate = logCategoryRates[(nHash + i) % LOG_CATEGORY_SLOTS];
+        const char* slotCategory = rate.category.load();
+        // on failure slotCategory is the category another thread claimed the slot for
+        if (slotCategory == NULL && rate.category.compare_exchange_strong(slotCategory, category))
+            return &rate;
+        if (strcmp(slotCategory, category) == 0)
+            return &rate;
+    }
+    return NULL;
+}
+
+/**
+ * Whether a message of the category goes beyond -lograte. The first message
+ * of a new second reports how many were suppressed during the one before.
+ */
+static bool LogRateExceeded(const char* category)
+{
+    CLogCategoryRate* rate = GetLogCategoryRate(category);
+    if (rate == NULL)
+        return false;
+
+    int64_t nNow = GetTimeMicros() / 1000000;
+    int64_t nSecond = rate->nSecond.load();
+    if (nSecond != nNow && rate->nSecond.compare_exchange_strong(nSecond, nNow)) {
+        rate->nMessages = 0;
+        unsigned int nSuppressed = rate->nSuppressed.exchange(0);
+        if (nSuppressed > 0)
+            LogPrintStr(strprintf("%u %s messages suppressed by -lograte\n", nSuppressed, category));
+    }
+
+    if (++rate->nMessages <= nLogRateLimit)
+        return false;
+    rate->nSuppressed++;
+    return true;
+}
+
 /**
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
  * end in a newline. Initialize it to true, and hold it, in the calling context.
  */
-static std::string LogTimestampStr(const std::string &str, bool *fStartedNewLine)
+static std::string LogTimestampStr(const std::string &str, int64_t nTimeMicros, bool *fStartedNewLine)
 {
     string strStamped;
 
@@ -288,7 +379,6 @@ static std::string LogTimestampStr(const std::string &str, bool *fStartedNewLine
         return str;
 
     if (*fStartedNewLine) {
-        int64_t nTimeMicros = GetLogTimeMicros();
         strStamped = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTimeMicros/1000000);
         if (fLogTimeMicros)
             strStamped += strprintf(".%06d", nTimeMicros%1000000);
@@ -304,24 +394,186 @@ static std::string LogTimestampStr(const std::string &str, bool *fStartedNewLine
     return strStamped;
 }
 
-int LogPrintStr(const std::string &str)
+static bool fStartedNewLine = true;
+
+// reopen the log file, if requested; mutexDebugLog held
+static void ReopenDebugLog()
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        fs::path pathDebug = GetDataDir() / "debug.log";
+        FILE* new_fileout = fsbridge::fopen(pathDebug, "a");
+        if (new_fileout) {
+            setbuf(new_fileout, nullptr); // unbuffered
+            fclose(fileout);
+            fileout = new_fileout;
+        }
+    }
+}
+
+static void PushLogMessage(CLogNode* node)
+{
+    node->next.store(NULL, std::memory_order_relaxed);
+    CLogNode* prev = logQueueHead.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+// NULL when the queue is empty or its last message is still being linked in; mutexDebugLog held
+static CLogMessage* PopLogMessage()
+{
+    CLogNode* tail = logQueueTail;
+    CLogNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &logQueueStub) {
+        if (next == NULL)
+            return NULL;
+        logQueueTail = tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != NULL) {
+        logQueueTail = next;
+        return static_cast<CLogMessage*>(tail);
+    }
+    if (tail != logQueueHead.load(std::memory_order_acquire))
+        return NULL;
+    // put the stub behind the last message, so that it can be taken off
+    PushLogMessage(&logQueueStub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != NULL) {
+        logQueueTail = next;
+        return static_cast<CLogMessage*>(tail);
+    }
+    return NULL;
+}
+
+// Write out the queued messages in batches; mutexDebugLog held
+static void WriteQueuedMessages()
+{
+    ReopenDebugLog();
+
+    std::string strBatch;
+    CLogMessage* msg;
+    while ((msg = PopLogMessage()) != NULL) {
+        strBatch += LogTimestampStr(msg->str, msg->nTimeMicros, &fStartedNewLine);
+        delete msg;
+        nLogQueued--;
+        if (strBatch.size() >= LOG_WRITE_BATCH) {
+            FileWriteStr(strBatch, fileout);
+            strBatch.clear();
+        }
+    }
+
+    uint64_t nDropped = nLogDropped.exchange(0);
+    if (nDropped > 0)
+        strBatch += LogTimestampStr(strprintf("%u debug messages dropped, the log writer fell behind\n", nDropped),
+            GetLogTimeMicros(), &fStartedNewLine);
+
+    if (!strBatch.empty())
+        FileWriteStr(strBatch, fileout);
+}
+
+static void LogWriterThread()
+{
+    RenameThread("bitcoin-logwriter");
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    while (true) {
+        bool fStopping = !fLogWriterRunning;
+        WriteQueuedMessages();
+        if (fStopping)
+            break;
+        // logging threads only wake us when the queue was empty, anything else is picked up by the timeout
+        condLogWriter->timed_wait(scoped_lock, boost::posix_time::milliseconds(100));
+    }
+}
+
+void StartLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    if (threadLogWriter != NULL || fileout == NULL)
+        return;
+    fLogWriterRunning = true;
+    threadLogWriter = new boost::thread(&LogWriterThread);
+}
+
+void StopLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    boost::thread* thread;
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        if (threadLogWriter == NULL)
+            return;
+        thread = threadLogWriter;
+        threadLogWriter = NULL;
+        fLogWriterRunning = false;
+    }
+    condLogWriter->notify_one();
+    thread->join();
+    delete thread;
+
+    // messages of threads which still saw the writer running, they may not have been queued yet
+    while (nLogProducers.load() > 0)
+        MilliSleep(1);
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    WriteQueuedMessages();
+}
+
+/**
+ * Hand a message to the log writer. Once -logqueue messages are waiting, debug
+ * categories are dropped with -logdropdebug, everything else waits for room.
+ */
+static int QueueLogMessage(const std::string &str, int64_t nTimeMicros, const char* category)
+{
+    while (nLogQueued.load(std::memory_order_relaxed) >= nLogQueueSize && fLogWriterRunning) {
+        if (category != NULL && fLogDropDebug) {
+            nLogDropped++;
+            return 0;
+        }
+        MilliSleep(1);
+    }
+
+    CLogMessage* msg = new CLogMessage;
+    msg->nTimeMicros = nTimeMicros;
+    msg->str = str;
+    bool fWasEmpty = nLogQueued++ == 0;
+    PushLogMessage(msg);
+    if (fWasEmpty)
+        condLogWriter->notify_one();
+    return str.size();
+}
+
+int LogPrintStr(const std::string &str, const char* category)
 {
     int ret = 0; // Returns total number of characters written
-    static bool fStartedNewLine = true;
 
-    string strTimestamped = LogTimestampStr(str, &fStartedNewLine);
+    if (category != NULL && nLogRateLimit > 0 && LogRateExceeded(category))
+        return ret;
+
+    int64_t nTimeMicros = GetLogTimeMicros();
 
     if (fPrintToConsole)
     {
         // print to console
+        string strTimestamped = LogTimestampStr(str, nTimeMicros, &fStartedNewLine);
         ret = fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
         fflush(stdout);
     }
     else if (fPrintToDebugLog)
     {
+        // counted before the check, so that StopLogWriter either waits for the message or we see it stopped
+        nLogProducers++;
+        if (fLogWriterRunning) {
+            ret = QueueLogMessage(str, nTimeMicros, category);
+            nLogProducers--;
+            return ret;
+        }
+        nLogProducers--;
+
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
         boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
 
+        string strTimestamped = LogTimestampStr(str, nTimeMicros, &fStartedNewLine);
+
         // buffer if we haven't opened the log yet
         if (fileout == NULL) {
             assert(vMsgsBeforeOpenLog);
@@ -330,18 +582,7 @@ int LogPrintStr(const std::string &str)
         }
         else
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                fs::path pathDebug = GetDataDir() / "debug.log";
-                FILE* new_fileout = fsbridge::fopen(pathDebug, "a");
-                if (new_fileout) {
-                    setbuf(new_fileout, nullptr); // unbuffered
-                    fclose(fileout);
-                    fileout = new_fileout;
-                }
-            }
-
+            ReopenDebugLog();
             ret = FileWriteStr(strTimestamped, fileout);
         }
     }
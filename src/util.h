@@ -35,6 +35,14 @@
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+//! -logqueue default, messages waiting for the log writer before they are dropped or their callers wait
+static const unsigned int DEFAULT_LOGQUEUE = 10000;
+//! -logqueue is capped here, each waiting message is a separate allocation
+static const unsigned int MAX_LOGQUEUE = 1000000;
+//! -logdropdebug default
+static const bool DEFAULT_LOGDROPDEBUG = true;
+//! -lograte default, messages per second of each debug category (0 = unlimited)
+static const unsigned int DEFAULT_LOGRATE = 0;
 
 const char * const PERSISTENT_FILENAME = "persistent/";
 
@@ -66,6 +74,9 @@ extern std::string strMiscWarning;
 extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogIPs;
+extern unsigned int nLogQueueSize;
+extern bool fLogDropDebug;
+extern unsigned int nLogRateLimit;
 extern std::atomic<bool> fReopenDebugLog;
 extern CTranslationInterface translationInterface;
 
@@ -101,8 +112,8 @@ bool SetupNetworking();
 
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
-/** Send a string to the log output */
-int LogPrintStr(const std::string &str);
+/** Send a string to the log output, messages of a debug category may be dropped under load */
+int LogPrintStr(const std::string &str, const char* category = NULL);
 
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
@@ -110,7 +121,7 @@ template<typename T1, typename... Args>
 static inline int LogPrint(const char* category, const char* fmt, const T1& v1, const Args&... args)
 {
     if(!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(tfm::format(fmt, v1, args...));
+    return LogPrintStr(tfm::format(fmt, v1, args...), category);
 }
 
 template<typename T1, typename... Args>
@@ -128,7 +139,7 @@ bool error(const char* fmt, const T1& v1, const Args&... args)
 static inline int LogPrint(const char* category, const char* s)
 {
     if(!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(s);
+    return LogPrintStr(s, category);
 }
 static inline bool error(const char* s)
 {
@@ -170,6 +181,10 @@ void ReadConfigFile(std::map<std::string, std::string>& mapSettingsRet, std::map
 fs::path GetSpecialFolderPath(int nFolder, bool fCreate = true);
 #endif
 void OpenDebugLog();
+/** Write debug.log from a background thread, logging threads only queue their messages from then on */
+void StartLogWriter();
+/** Write out the queued messages and stop the log writer, messages are written by their callers again */
+void StopLogWriter();
 void ShrinkDebugFile();
 void runCommand(const std::string& strCommand);
 
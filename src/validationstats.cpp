@@ -0,0 +1,168 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "validationstats.h"
+
+#include "chain.h"
+
+#include <algorithm>
+#include <string.h>
+
+CValidationStats validationStats;
+
+static const char *validationStageNames[VALIDATION_STAGE_COUNT] = {
+    "read",
+    "deserialize",
+    "header",
+    "stake",
+    "scripts",
+    "zerocoin",
+    "sigma",
+    "indexnode",
+    "elysium",
+    "index",
+    "flush",
+    "connect"
+};
+
+const char *GetValidationStageName(ValidationStage stage)
+{
+    return stage < VALIDATION_STAGE_COUNT ? validationStageNames[stage] : "unknown";
+}
+
+CValidationStageStats::CValidationStageStats() : nBlocks(0), nTotal(0), nMax(0)
+{
+    memset(histogram, 0, sizeof(histogram));
+}
+
+void CValidationStageStats::Add(int64_t nMicros)
+{
+    nBlocks++;
+    nTotal += nMicros;
+    nMax = std::max(nMax, nMicros);
+
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < VALIDATION_HISTOGRAM_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    histogram[nBucket]++;
+}
+
+CValidationPendingBlock::CValidationPendingBlock() : nSequence(0)
+{
+    for (int i = 0; i < VALIDATION_STAGE_COUNT; i++) {
+        times[i] = 0;
+        fTimed[i] = false;
+    }
+}
+
+CValidationStats::CValidationStats()
+{
+    Reset();
+}
+
+void CValidationStats::Add(ValidationStage stage, const uint256 &hashBlock, int64_t nMicros)
+{
+    if (hashBlock.IsNull())
+        return;
+
+    LOCK(cs);
+    std::map<uint256, CValidationPendingBlock>::iterator it = mapPending.find(hashBlock);
+    if (it == mapPending.end()) {
+        if (mapPending.size() >= MAX_VALIDATION_PENDING_BLOCKS) {
+            std::map<uint256, CValidationPendingBlock>::iterator itOldest = mapPending.begin();
+            for (std::map<uint256, CValidationPendingBlock>::iterator itOld = mapPending.begin(); itOld != mapPending.end(); ++itOld)
+                if (itOld->second.nSequence < itOldest->second.nSequence)
+                    itOldest = itOld;
+            mapPending.erase(itOldest);
+        }
+        it = mapPending.insert(std::make_pair(hashBlock, CValidationPendingBlock())).first;
+        it->second.nSequence = nPendingSequence++;
+    }
+    it->second.times[stage] += nMicros;
+    it->second.fTimed[stage] = true;
+}
+
+void CValidationStats::BlockConnected(const CBlockIndex *pindex)
+{
+    LOCK(cs);
+    nBlocks++;
+    nLastHeight = pindex->nHeight;
+    hashLast = pindex->GetBlockHash();
+
+    CValidationPendingBlock block;
+    std::map<uint256, CValidationPendingBlock>::iterator it = mapPending.find(hashLast);
+    if (it != mapPending.end()) {
+        block = it->second;
+        mapPending.erase(it);
+    }
+    for (int i = 0; i < VALIDATION_STAGE_COUNT; i++) {
+        if (block.fTimed[i])
+            stages[i].Add(block.times[i]);
+        last[i] = block.times[i];
+        fLast[i] = block.fTimed[i];
+    }
+}
+
+void CValidationStats::Reset()
+{
+    LOCK(cs);
+    nBlocks = 0;
+    nLastHeight = -1;
+    hashLast.SetNull();
+    mapPending.clear();
+    nPendingSequence = 0;
+    for (int i = 0; i < VALIDATION_STAGE_COUNT; i++) {
+        stages[i] = CValidationStageStats();
+        last[i] = 0;
+        fLast[i] = false;
+    }
+}
+
+CValidationStageStats CValidationStats::GetStage(ValidationStage stage) const
+{
+    LOCK(cs);
+    return stages[stage];
+}
+
+UniValue CValidationStats::ToJSON() const
+{
+    LOCK(cs);
+    UniValue stagesJSON(UniValue::VOBJ);
+    for (int i = 0; i < VALIDATION_STAGE_COUNT; i++) {
+        const CValidationStageStats &stage = stages[i];
+        UniValue histogram(UniValue::VARR);
+        for (int j = 0; j < VALIDATION_HISTOGRAM_BUCKETS; j++)
+            histogram.push_back(stage.histogram[j]);
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("blocks", stage.nBlocks));
+        obj.push_back(Pair("total", stage.nTotal));
+        obj.push_back(Pair("average", stage.nBlocks ? stage.nTotal / (int64_t)stage.nBlocks : 0));
+        obj.push_back(Pair("max", stage.nMax));
+        obj.push_back(Pair("histogram", histogram));
+        stagesJSON.push_back(Pair(GetValidationStageName((ValidationStage)i), obj));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("blocks", nBlocks));
+    result.push_back(Pair("stages", stagesJSON));
+    return result;
+}
+
+UniValue CValidationStats::LastBlockToJSON() const
+{
+    LOCK(cs);
+    UniValue stagesJSON(UniValue::VOBJ);
+    for (int i = 0; i < VALIDATION_STAGE_COUNT; i++)
+        if (fLast[i])
+            stagesJSON.push_back(Pair(GetValidationStageName((ValidationStage)i), last[i]));
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("height", nLastHeight));
+    result.push_back(Pair("hash", hashLast.GetHex()));
+    result.push_back(Pair("stages", stagesJSON));
+    return result;
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_VALIDATIONSTATS_H
+#define BITCOIN_VALIDATIONSTATS_H
+
+#include "sync.h"
+#include "uint256.h"
+#include "utiltime.h"
+
+#include <stdint.h>
+
+#include <map>
+
+#include <univalue.h>
+
+class CBlockIndex;
+
+/** The stages of getting a block onto the chain, timed by CValidationTimer */
+enum ValidationStage {
+    VALIDATION_READ = 0,     //!< loading a block from disk to connect it
+    VALIDATION_DESERIALIZE,  //!< decoding a block received from a peer
+    VALIDATION_HEADER,       //!< proof-of-work header checks
+    VALIDATION_STAKE,        //!< proof-of-stake kernel and block signature checks
+    VALIDATION_SCRIPTS,      //!< input checks, including the wait for the script check threads
+    VALIDATION_ZEROCOIN,     //!< zerocoin transaction checks and state updates
+    VALIDATION_SIGMA,        //!< sigma proof checks and state updates
+    VALIDATION_INDEXNODE,    //!< block value and indexnode payment checks
+    VALIDATION_ELYSIUM,      //!< Elysium block handlers
+    VALIDATION_INDEX,        //!< undo data and transaction, address, spent and timestamp index writes
+    VALIDATION_FLUSH,        //!< flushing the coins cache and block index
+    VALIDATION_CONNECT,      //!< a whole ConnectTip, all of the stages above included
+    VALIDATION_STAGE_COUNT
+};
+
+const char *GetValidationStageName(ValidationStage stage);
+
+static const int VALIDATION_HISTOGRAM_BUCKETS = 24;
+
+/**
+ * Time spent on one stage per block. Bucket 0 of the histogram counts blocks
+ * below 1 microsecond, bucket i those from 2^(i-1) below 2^i microseconds and
+ * the last bucket everything longer.
+ */
+struct CValidationStageStats
+{
+    uint64_t nBlocks;
+    int64_t nTotal;
+    int64_t nMax;
+    uint64_t histogram[VALIDATION_HISTOGRAM_BUCKETS];
+
+    CValidationStageStats();
+    void Add(int64_t nMicros);
+};
+
+/** Blocks with times added that are kept waiting to be connected, the oldest are dropped beyond it */
+static const size_t MAX_VALIDATION_PENDING_BLOCKS = 1000;
+
+/** Stage times added to a block which isn't connected yet */
+struct CValidationPendingBlock
+{
+    uint64_t nSequence;
+    int64_t times[VALIDATION_STAGE_COUNT];
+    bool fTimed[VALIDATION_STAGE_COUNT];
+
+    CValidationPendingBlock();
+};
+
+/**
+ * Stage timings of connected blocks. Times are added to the block they were
+ * spent on, by hash; they are filed as that block's when it is connected.
+ * Blocks which are never connected drop out once MAX_VALIDATION_PENDING_BLOCKS
+ * newer ones are waiting.
+ */
+class CValidationStats
+{
+private:
+    mutable CCriticalSection cs;
+    uint64_t nBlocks;
+    CValidationStageStats stages[VALIDATION_STAGE_COUNT];
+    std::map<uint256, CValidationPendingBlock> mapPending;
+    uint64_t nPendingSequence;
+
+    int nLastHeight;
+    uint256 hashLast;
+    int64_t last[VALIDATION_STAGE_COUNT];
+    bool fLast[VALIDATION_STAGE_COUNT];
+
+public:
+    CValidationStats();
+
+    /** Add time spent on a block, nothing is added for a null hash */
+    void Add(ValidationStage stage, const uint256 &hashBlock, int64_t nMicros);
+    /** File the times added to the block of pindex */
+    void BlockConnected(const CBlockIndex *pindex);
+    void Reset();
+
+    CValidationStageStats GetStage(ValidationStage stage) const;
+    UniValue ToJSON() const;
+    /** The times of the last block connected */
+    UniValue LastBlockToJSON() const;
+};
+
+extern CValidationStats validationStats;
+
+/**
+ * Adds the time from its construction until Stop() or its destruction to a
+ * stage of a block. Timers of VALIDATION_STAGE_COUNT or a null block hash time
+ * nothing.
+ */
+class CValidationTimer
+{
+private:
+    ValidationStage stage;
+    uint256 hashBlock;
+    int64_t nStart;
+
+public:
+    CValidationTimer(ValidationStage stageIn, const uint256 &hashBlockIn) : stage(stageIn), hashBlock(hashBlockIn),
+        nStart(stageIn < VALIDATION_STAGE_COUNT && !hashBlockIn.IsNull() ? GetTimeMicros() : 0) {}
+    ~CValidationTimer() { Stop(); }
+
+    void Stop()
+    {
+        if (nStart != 0) {
+            validationStats.Add(stage, hashBlock, GetTimeMicros() - nStart);
+            nStart = 0;
+        }
+    }
+};
+
+#endif // BITCOIN_VALIDATIONSTATS_H
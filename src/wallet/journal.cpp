@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/journal.h"
+
+#include "random.h"
+
+#include <limits>
+#include <map>
+
+CWalletJournal::CWalletJournal(size_t nMaxChangesIn) :
+    nId(GetRand(std::numeric_limits<uint64_t>::max())), nFirstSequence(1), nNextSequence(1), nMaxChanges(nMaxChangesIn)
+{
+}
+
+uint64_t CWalletJournal::GetId() const
+{
+    return nId;
+}
+
+uint64_t CWalletJournal::GetLastSequence() const
+{
+    LOCK(cs);
+    return nNextSequence - 1;
+}
+
+void CWalletJournal::Append(const uint256 &hash, WalletChangeType type)
+{
+    LOCK(cs);
+    changes.push_back(CWalletChange(nNextSequence++, hash, type));
+    while (changes.size() > nMaxChanges) {
+        nFirstSequence = changes.front().nSequence + 1;
+        changes.pop_front();
+    }
+}
+
+bool CWalletJournal::GetChangesSince(uint64_t nIdIn, uint64_t nSequence, std::vector<CWalletChange> &vChanges) const
+{
+    vChanges.clear();
+    LOCK(cs);
+    if (nIdIn != nId || nSequence + 1 < nFirstSequence || nSequence >= nNextSequence)
+        return false;
+    if (changes.empty())
+        return true;
+
+    // Changes are in sequence order, the first one to look at is nSequence + 1
+    std::deque<CWalletChange>::const_iterator it = changes.begin() + (nSequence + 1 - changes.front().nSequence);
+    std::map<uint256, size_t> mapLatest;
+    for (; it != changes.end(); ++it) {
+        std::map<uint256, size_t>::iterator mi = mapLatest.find(it->hash);
+        if (mi == mapLatest.end()) {
+            mapLatest[it->hash] = vChanges.size();
+            vChanges.push_back(*it);
+        } else {
+            // A transaction added meanwhile is still new to the client
+            if (vChanges[mi->second].type != WALLET_TX_ADDED || it->type == WALLET_TX_DELETED)
+                vChanges[mi->second].type = it->type;
+            vChanges[mi->second].nSequence = it->nSequence;
+        }
+    }
+    return true;
+}
+
+std::string GetWalletChangeTypeName(WalletChangeType type)
+{
+    switch (type) {
+    case WALLET_TX_ADDED:
+        return "added";
+    case WALLET_TX_UPDATED:
+        return "updated";
+    case WALLET_TX_CONFIRMED:
+        return "confirmed";
+    case WALLET_TX_DELETED:
+        return "deleted";
+    }
+    return "unknown";
+}
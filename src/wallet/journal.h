@@ -0,0 +1,72 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_JOURNAL_H
+#define BITCOIN_WALLET_JOURNAL_H
+
+#include "sync.h"
+#include "uint256.h"
+
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//! Changes kept by the wallet journal, clients further behind have to reload the whole wallet state
+static const size_t DEFAULT_WALLET_JOURNAL_SIZE = 10000;
+
+enum WalletChangeType {
+    WALLET_TX_ADDED,
+    WALLET_TX_UPDATED,
+    //! The transaction was included in a block
+    WALLET_TX_CONFIRMED,
+    WALLET_TX_DELETED
+};
+
+struct CWalletChange
+{
+    uint64_t nSequence;
+    uint256 hash;
+    WalletChangeType type;
+
+    CWalletChange(uint64_t nSequenceIn, const uint256 &hashIn, WalletChangeType typeIn) :
+        nSequence(nSequenceIn), hash(hashIn), type(typeIn) {}
+};
+
+/**
+ * In memory log of the wallet transactions added, updated, confirmed or deleted, numbered by an increasing sequence.
+ * Clients remember the last sequence they have seen and only ask for what changed since, instead of listing the whole
+ * wallet. The journal is identified by a random id: it starts empty with every run, so a client holding the id of
+ * another journal has to reload the whole wallet state.
+ */
+class CWalletJournal
+{
+private:
+    mutable CCriticalSection cs;
+    std::deque<CWalletChange> changes;
+    uint64_t nId;
+    uint64_t nFirstSequence; //!< oldest sequence which has not been dropped
+    uint64_t nNextSequence;
+    size_t nMaxChanges;
+
+public:
+    explicit CWalletJournal(size_t nMaxChangesIn = DEFAULT_WALLET_JOURNAL_SIZE);
+
+    uint64_t GetId() const;
+    //! Sequence of the latest change, 0 if there was none yet
+    uint64_t GetLastSequence() const;
+
+    void Append(const uint256 &hash, WalletChangeType type);
+
+    /**
+     * The changes after nSequence, one per transaction with its latest sequence, in the order the transactions first
+     * changed. A transaction added after nSequence is reported as added until it is deleted. Returns false if the
+     * journal is not nId or does not reach back to nSequence any more.
+     */
+    bool GetChangesSince(uint64_t nId, uint64_t nSequence, std::vector<CWalletChange> &vChanges) const;
+};
+
+std::string GetWalletChangeTypeName(WalletChangeType type);
+
+#endif // BITCOIN_WALLET_JOURNAL_H
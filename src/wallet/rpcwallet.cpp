@@ -1523,10 +1523,13 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Un
     }
 }
 
-UniValue listtransactions(const UniValue& params, bool fHelp)
+void listtransactions(const UniValue& params, bool fHelp, CJSONWriter& writer)
 {
     if (!EnsureWalletIsAvailable(fHelp))
-        return NullUniValue;
+    {
+        writer.Value(NullUniValue);
+        return;
+    }
 
     if (fHelp || params.size() > 4)
         throw runtime_error(
@@ -1587,8 +1590,6 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
         );
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-
     string strAccount = "*";
     if (params.size() > 0)
         strAccount = params[0].get_str();
@@ -1610,19 +1611,23 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
 
     UniValue ret(UniValue::VARR);
 
-    const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
-
-    // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
     {
-        CWalletTx *const pwtx = (*it).second.first;
-        if (pwtx != 0)
-            ListTransactions(*pwtx, strAccount, 0, true, ret, filter);
-        CAccountingEntry *const pacentry = (*it).second.second;
-        if (pacentry != 0)
-            AcentryToJSON(*pacentry, strAccount, ret);
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+
+        const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
 
-        if ((int)ret.size() >= (nCount+nFrom)) break;
+        // iterate backwards until we have nCount items to return:
+        for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+        {
+            CWalletTx *const pwtx = (*it).second.first;
+            if (pwtx != 0)
+                ListTransactions(*pwtx, strAccount, 0, true, ret, filter);
+            CAccountingEntry *const pacentry = (*it).second.second;
+            if (pacentry != 0)
+                AcentryToJSON(*pacentry, strAccount, ret);
+
+            if ((int)ret.size() >= (nCount+nFrom)) break;
+        }
     }
     // ret is newest to oldest
 
@@ -1631,23 +1636,18 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
     if ((nFrom + nCount) > (int)ret.size())
         nCount = ret.size() - nFrom;
 
-    vector<UniValue> arrTmp = ret.getValues();
-
-    vector<UniValue>::iterator first = arrTmp.begin();
-    std::advance(first, nFrom);
-    vector<UniValue>::iterator last = arrTmp.begin();
-    std::advance(last, nFrom+nCount);
-
-    if (last != arrTmp.end()) arrTmp.erase(last, arrTmp.end());
-    if (first != arrTmp.begin()) arrTmp.erase(arrTmp.begin(), first);
-
-    std::reverse(arrTmp.begin(), arrTmp.end()); // Return oldest to newest
-
-    ret.clear();
-    ret.setArray();
-    ret.push_backV(arrTmp);
+    // Return oldest to newest, written once the wallet is unlocked again
+    writer.BeginArray();
+    for (int i = nFrom + nCount - 1; i >= nFrom && !writer.IsClosed(); i--)
+        writer.Value(ret[i]);
+    writer.EndArray();
+}
 
-    return ret;
+UniValue listtransactions(const UniValue& params, bool fHelp)
+{
+    CJSONTreeWriter writer;
+    listtransactions(params, fHelp, writer);
+    return writer.GetResult();
 }
 
 UniValue listaccounts(const UniValue& params, bool fHelp)
@@ -3380,7 +3380,7 @@ UniValue spendmany(const UniValue& params, bool fHelp) {
 
     EnsureSigmaWalletIsAvailable();
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
+    // cs_main and cs_wallet aren't held here so SpendSigma can release them while the proofs are generated
 
     // Only account "" have sigma coins.
     std::string strAccount = AccountFromValue(params[0]);
@@ -3432,7 +3432,10 @@ UniValue spendmany(const UniValue& params, bool fHelp) {
         vecSend.push_back({scriptPubKey, nAmount, fSubtractFeeFromAmount});
     }
 
-    EnsureWalletIsUnlocked();
+    {
+        LOCK(pwalletMain->cs_wallet);
+        EnsureWalletIsUnlocked();
+    }
 
     CAmount nFeeRequired = 0;
 
@@ -4167,8 +4170,16 @@ static const CRPCCommand rpcCommands[] =
     { "wallet",             "remintzerocointosigma",    &remintzerocointosigma,    false }
 };
 
+static const CRPCStreamCommand rpcStreamCommands[] =
+{ //  name                      streamActor
+  //  ------------------------  ------------------------
+    { "listtransactions",       &listtransactions       },
+};
+
 void RegisterWalletRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(rpcCommands); vcidx++)
         tableRPC.appendCommand(rpcCommands[vcidx].name, &rpcCommands[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(rpcStreamCommands); vcidx++)
+        tableRPC.appendStreamActor(rpcStreamCommands[vcidx].name, rpcStreamCommands[vcidx].streamActor);
 }
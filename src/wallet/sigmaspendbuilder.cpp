@@ -15,6 +15,8 @@
 #include "../sigma.h"
 #include "../hdmint/wallet.h"
 
+#include <exception>
+#include <memory>
 #include <stdexcept>
 #include <tuple>
 
@@ -26,28 +28,51 @@ public:
     uint256 lastBlockOfGroup;
     bool fPadding;
 
+    // proof generated by Prepare(), it does not depend on the transaction being signed
+    std::unique_ptr<sigma::CoinSpend> spend;
+
 public:
     SigmaSpendSigner(const sigma::PrivateCoin& coin) : coin(coin)
     {
         fPadding = true;
     }
 
-    CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy) override
+    bool NeedsPrepare() const override
+    {
+        return !spend;
+    }
+
+    void Prepare() override
     {
-        // construct spend
-        sigma::SpendMetaData meta(output.n, lastBlockOfGroup, sig);
-        sigma::CoinSpend spend(coin.getParams(), coin, group, meta, fPadding);
+        // the meta data only affects the ecdsa signature, which is redone by Sign()
+        sigma::SpendMetaData meta(output.n, lastBlockOfGroup, uint256());
+        std::unique_ptr<sigma::CoinSpend> result(new sigma::CoinSpend(coin.getParams(), coin, group, meta, fPadding));
 
-        spend.setVersion(coin.getVersion());
+        result->setVersion(coin.getVersion());
 
-        if (!fDummy && !spend.Verify(group, meta, fPadding)) {
+        if (!result->Verify(group, meta, fPadding)) {
             throw std::runtime_error(_("The spend coin transaction failed to verify"));
         }
 
-        // construct spend script
+        spend = std::move(result);
+    }
+
+    CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy) override
+    {
         CDataStream serialized(SER_NETWORK, PROTOCOL_VERSION);
-        serialized << spend;
 
+        if (spend) {
+            sigma::SpendMetaData meta(output.n, lastBlockOfGroup, sig);
+            spend->updateMetaData(coin, meta);
+            serialized << *spend;
+        } else {
+            // placeholder with the size of the final spend
+            sigma::CoinSpend placeholder(coin.getParams(), coin.getPublicCoin().getDenomination(), lastBlockOfGroup);
+            placeholder.setVersion(coin.getVersion());
+            serialized << placeholder;
+        }
+
+        // construct spend script
         CScript script;
 
         script << OP_SIGMASPEND;
@@ -118,12 +143,12 @@ SigmaSpendBuilder::SigmaSpendBuilder(CWallet& wallet, CHDMintWallet& mintWallet,
     TxBuilder(wallet),
     mintWallet(mintWallet)
 {
-    cs_main.lock();
+    ENTER_CRITICAL_SECTION(cs_main);
 
     try {
-        wallet.cs_wallet.lock();
+        ENTER_CRITICAL_SECTION(wallet.cs_wallet);
     } catch (...) {
-        cs_main.unlock();
+        LEAVE_CRITICAL_SECTION(cs_main);
         throw;
     }
 
@@ -132,8 +157,13 @@ SigmaSpendBuilder::SigmaSpendBuilder(CWallet& wallet, CHDMintWallet& mintWallet,
 
 SigmaSpendBuilder::~SigmaSpendBuilder()
 {
-    wallet.cs_wallet.unlock();
-    cs_main.unlock();
+    // the coins are either committed by now, or can be selected again
+    for (const auto& hash : reserved) {
+        wallet.setSigmaSpendReserved.erase(hash);
+    }
+
+    LEAVE_CRITICAL_SECTION(wallet.cs_wallet);
+    LEAVE_CRITICAL_SECTION(cs_main);
 }
 
 CAmount SigmaSpendBuilder::GetInputs(std::vector<std::unique_ptr<InputSigner>>& signers, CAmount required, bool fDummy)
@@ -142,6 +172,7 @@ CAmount SigmaSpendBuilder::GetInputs(std::vector<std::unique_ptr<InputSigner>>&
 
     selected.clear();
     denomChanges.clear();
+    groupBlocks.clear();
 
     auto& consensusParams = Params().GetConsensus();
 
@@ -154,12 +185,73 @@ CAmount SigmaSpendBuilder::GetInputs(std::vector<std::unique_ptr<InputSigner>>&
     CAmount total = 0;
     for (auto& coin : selected) {
         total += coin.get_denomination_value();
-        signers.push_back(CreateSigner(coin));
+
+        auto signer = CreateSigner(coin);
+        groupBlocks.insert(signer->lastBlockOfGroup);
+        signers.push_back(std::move(signer));
     }
 
     return total;
 }
 
+void SigmaSpendBuilder::PrepareSigners(std::vector<std::unique_ptr<InputSigner>>& signers)
+{
+    // Signers already hold their anonymity sets so the proofs can be generated without blocking
+    // validation or the rest of the wallet. This only frees the locks if the caller doesn't hold them.
+    // Other spends can run meanwhile, so the selected coins are reserved for this one first. The change
+    // mints already have their own HD counts, GenerateMint() advances the count as it derives them.
+    for (const auto& coin : selected) {
+        auto hash = primitives::GetPubCoinValueHash(coin.value);
+
+        if (wallet.setSigmaSpendReserved.insert(hash).second) {
+            reserved.push_back(hash);
+        }
+    }
+
+    LEAVE_CRITICAL_SECTION(wallet.cs_wallet);
+    LEAVE_CRITICAL_SECTION(cs_main);
+
+    std::exception_ptr error;
+
+    try {
+        TxBuilder::PrepareSigners(signers);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    ENTER_CRITICAL_SECTION(cs_main);
+    ENTER_CRITICAL_SECTION(wallet.cs_wallet);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    CheckInputs();
+}
+
+void SigmaSpendBuilder::CheckInputs()
+{
+    // the chain and the wallet may have moved on while the locks were released
+    sigma::CSigmaState* state = sigma::CSigmaState::GetState();
+
+    for (const auto& coin : selected) {
+        CMintMeta meta;
+
+        if (!state->CanAddSpendToMempool(coin.serialNumber) ||
+            (mintWallet.GetTracker().GetMetaFromPubcoin(primitives::GetPubCoinValueHash(coin.value), meta) && meta.isUsed)) {
+            throw std::runtime_error(_("One of the selected coins was spent while the transaction was being created"));
+        }
+    }
+
+    for (const auto& hash : groupBlocks) {
+        auto it = mapBlockIndex.find(hash);
+
+        if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+            throw std::runtime_error(_("The chain was reorganized while the transaction was being created"));
+        }
+    }
+}
+
 CAmount SigmaSpendBuilder::GetChanges(std::vector<CTxOut>& outputs, CAmount amount, bool fDummy)
 {
     outputs.clear();
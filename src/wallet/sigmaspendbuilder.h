@@ -5,6 +5,7 @@
 
 #include "../hdmint/wallet.h"
 
+#include <set>
 #include <vector>
 
 class SigmaSpendBuilder : public TxBuilder
@@ -13,6 +14,8 @@ public:
     std::vector<CSigmaEntry> selected;
     std::vector<CHDMint> changes;
     std::vector<sigma::CoinDenomination> denomChanges;
+    // last blocks of the anonymity sets used by the selected coins
+    std::set<uint256> groupBlocks;
 
 public:
     SigmaSpendBuilder(CWallet& wallet, CHDMintWallet& mintWallet, const CCoinControl *coinControl = nullptr);
@@ -22,9 +25,17 @@ protected:
     CAmount GetInputs(std::vector<std::unique_ptr<InputSigner>>& signers, CAmount required, bool fDummy) override;
     // remint change
     CAmount GetChanges(std::vector<CTxOut>& outputs, CAmount amount, bool fDummy) override;
+    // generate proofs with cs_main and cs_wallet released, callers must not hold them for this to help
+    void PrepareSigners(std::vector<std::unique_ptr<InputSigner>>& signers) override;
+
+private:
+    // throws if the selected coins can't be spent any more after the locks were released
+    void CheckInputs();
 
 private:
     CHDMintWallet& mintWallet;
+    // entries this builder added to CWallet::setSigmaSpendReserved
+    std::vector<uint256> reserved;
 };
 
 #endif
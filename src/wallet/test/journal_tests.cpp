@@ -0,0 +1,89 @@
+// Copyright (c) 2020 The Index Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_bitcoin.h"
+#include "wallet/journal.h"
+#include "wallet/test/wallet_test_fixture.h"
+#include "wallet/wallet.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(wallet_journal_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(journal_changes_since)
+{
+    CWalletJournal journal(3);
+    uint256 hashA = uint256S("a1");
+    uint256 hashB = uint256S("b2");
+    std::vector<CWalletChange> vChanges;
+
+    BOOST_CHECK_EQUAL(journal.GetLastSequence(), 0);
+    BOOST_CHECK(journal.GetChangesSince(journal.GetId(), 0, vChanges));
+    BOOST_CHECK(vChanges.empty());
+
+    journal.Append(hashA, WALLET_TX_CONFIRMED);
+    journal.Append(hashB, WALLET_TX_ADDED);
+    journal.Append(hashB, WALLET_TX_CONFIRMED);
+    BOOST_CHECK_EQUAL(journal.GetLastSequence(), 3);
+
+    // Only the latest change of each transaction, a transaction added meanwhile stays added
+    BOOST_CHECK(journal.GetChangesSince(journal.GetId(), 0, vChanges));
+    BOOST_REQUIRE_EQUAL(vChanges.size(), 2);
+    BOOST_CHECK(vChanges[0].hash == hashA);
+    BOOST_CHECK_EQUAL(vChanges[0].type, WALLET_TX_CONFIRMED);
+    BOOST_CHECK(vChanges[1].hash == hashB);
+    BOOST_CHECK_EQUAL(vChanges[1].type, WALLET_TX_ADDED);
+    BOOST_CHECK_EQUAL(vChanges[1].nSequence, 3);
+
+    BOOST_CHECK(journal.GetChangesSince(journal.GetId(), 2, vChanges));
+    BOOST_REQUIRE_EQUAL(vChanges.size(), 1);
+    BOOST_CHECK_EQUAL(vChanges[0].type, WALLET_TX_CONFIRMED);
+
+    BOOST_CHECK(journal.GetChangesSince(journal.GetId(), 3, vChanges));
+    BOOST_CHECK(vChanges.empty());
+
+    // Unknown journals and sequences need a reload
+    BOOST_CHECK(!journal.GetChangesSince(journal.GetId() + 1, 3, vChanges));
+    BOOST_CHECK(!journal.GetChangesSince(journal.GetId(), 4, vChanges));
+
+    // The first change was dropped
+    journal.Append(hashA, WALLET_TX_DELETED);
+    BOOST_CHECK(!journal.GetChangesSince(journal.GetId(), 0, vChanges));
+    BOOST_CHECK(journal.GetChangesSince(journal.GetId(), 1, vChanges));
+    BOOST_REQUIRE_EQUAL(vChanges.size(), 2);
+    BOOST_CHECK(vChanges[1].hash == hashA);
+    BOOST_CHECK_EQUAL(vChanges[1].type, WALLET_TX_DELETED);
+}
+
+BOOST_FIXTURE_TEST_CASE(journal_erase_from_wallet, WalletTestingSetup)
+{
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = COIN;
+    CWalletTx wtx(pwalletMain, tx);
+    uint256 hash = wtx.GetHash();
+    std::vector<CWalletChange> vChanges;
+
+    LOCK(pwalletMain->cs_wallet);
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    BOOST_CHECK(pwalletMain->AddToWallet(wtx, false, &walletdb));
+    uint64_t nSequence = pwalletMain->journal.GetLastSequence();
+
+    // Erasing a transaction, as removetxwallet does, is a change clients have to see
+    BOOST_CHECK(pwalletMain->EraseFromWallet(hash));
+    BOOST_CHECK(!pwalletMain->mapWallet.count(hash));
+    BOOST_CHECK_EQUAL(pwalletMain->journal.GetLastSequence(), nSequence + 1);
+    BOOST_CHECK(pwalletMain->journal.GetChangesSince(pwalletMain->journal.GetId(), nSequence, vChanges));
+    BOOST_REQUIRE_EQUAL(vChanges.size(), 1);
+    BOOST_CHECK(vChanges[0].hash == hash);
+    BOOST_CHECK_EQUAL(vChanges[0].type, WALLET_TX_DELETED);
+
+    // Erasing it again changes nothing
+    BOOST_CHECK(pwalletMain->EraseFromWallet(hash));
+    BOOST_CHECK_EQUAL(pwalletMain->journal.GetLastSequence(), nSequence + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
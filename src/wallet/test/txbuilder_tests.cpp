@@ -6,7 +6,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <vector>
 
 static const CBitcoinAddress randomAddr1("aHEog3QYDGa8wH4Go9igKLDFkpaMsi3btq");
@@ -34,6 +36,39 @@ public:
     }
 };
 
+class TestPreparedInputSigner : public TestInputSigner
+{
+public:
+    CScript placeholder;
+    std::shared_ptr<std::atomic<int>> prepareCalls;
+    bool fPrepared;
+
+public:
+    TestPreparedInputSigner(const CScript& sig, const CScript& placeholder, std::shared_ptr<std::atomic<int>> prepareCalls) :
+        TestInputSigner(sig),
+        placeholder(placeholder),
+        prepareCalls(prepareCalls),
+        fPrepared(false)
+    {
+    }
+
+    bool NeedsPrepare() const override
+    {
+        return !fPrepared;
+    }
+
+    void Prepare() override
+    {
+        (*prepareCalls)++;
+        fPrepared = true;
+    }
+
+    CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy = false) override
+    {
+        return fPrepared ? signature : placeholder;
+    }
+};
+
 class TestTxBuilder : public TxBuilder
 {
 public:
@@ -228,5 +263,43 @@ BOOST_AUTO_TEST_CASE(build_with_changes)
     BOOST_CHECK(std::find_if(tx.vout.begin(), tx.vout.end(), [](const CTxOut& o) { return o.nValue == 20; }) != tx.vout.end());
 }
 
+BOOST_AUTO_TEST_CASE(build_with_prepared_signers)
+{
+    TestTxBuilder builder(*pwalletMain);
+    CAmount fee;
+    CScript in1, in2, placeholder;
+    auto prepareCalls = std::make_shared<std::atomic<int>>(0);
+
+    in1 << std::vector<unsigned char>({ 0x21, 0xe3, 0xad, 0x9a, 0xec, 0x5b, 0x70, 0xcb, 0x4c, 0xc1, 0xd8, 0xe2, 0x95, 0x27, 0xe3, 0x7c });
+    in2 << std::vector<unsigned char>({ 0xac, 0xd9, 0x86, 0x7d, 0xd7, 0x6e, 0xc1, 0xb7, 0x9d, 0xde, 0xdc, 0xbd, 0x91, 0xc1, 0x8e, 0xed });
+    placeholder << std::vector<unsigned char>(16, 0);
+
+    builder.getInputs = [&](std::vector<std::unique_ptr<InputSigner>>& signers, CAmount required, bool fDummy) {
+        signers.push_back(std::unique_ptr<InputSigner>(new TestPreparedInputSigner(in1, placeholder, prepareCalls)));
+        signers.push_back(std::unique_ptr<InputSigner>(new TestPreparedInputSigner(in2, placeholder, prepareCalls)));
+        return required;
+    };
+
+    std::vector<CRecipient> recipients = {
+        {.scriptPubKey = GetScriptForDestination(randomAddr1.Get()), .nAmount = 10, .fSubtractFeeFromAmount = true}
+    };
+    bool fChangeAddedToFee;
+    auto tx = builder.Build(recipients, fee, fChangeAddedToFee);
+
+    // every input is prepared exactly once no matter how many fee iterations were needed
+    BOOST_CHECK_EQUAL(prepareCalls->load(), 2);
+
+    BOOST_CHECK_EQUAL(tx.vin.size(), 2);
+    BOOST_CHECK(tx.vin[0].scriptSig == in1);
+    BOOST_CHECK(tx.vin[1].scriptSig == in2);
+
+    // dummy transactions only need the placeholders
+    prepareCalls->store(0);
+    auto dummyTx = builder.Build(recipients, fee, fChangeAddedToFee, true);
+
+    BOOST_CHECK_EQUAL(prepareCalls->load(), 0);
+    BOOST_CHECK(dummyTx.vin[0].scriptSig == placeholder);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
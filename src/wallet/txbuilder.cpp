@@ -10,8 +10,11 @@
 #include "../util.h"
 
 #include <boost/format.hpp>
+#include <boost/thread.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -31,6 +34,15 @@ InputSigner::~InputSigner()
 {
 }
 
+bool InputSigner::NeedsPrepare() const
+{
+    return false;
+}
+
+void InputSigner::Prepare()
+{
+}
+
 TxBuilder::TxBuilder(CWallet& wallet) noexcept : wallet(wallet)
 {
 }
@@ -102,6 +114,9 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
     assert(tx.nLockTime <= static_cast<unsigned>(chainActive.Height()));
     assert(tx.nLockTime < LOCKTIME_THRESHOLD);
 
+    std::vector<std::unique_ptr<InputSigner>> signers;
+    uint256 sig;
+
     // Start with no fee and loop until there is enough fee;
     for (fee = payTxFee.GetFeePerK();;) {
         // In case of not enough fee, reset mint seed counter on each iteration
@@ -160,7 +175,7 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
         }
 
         // get inputs
-        std::vector<std::unique_ptr<InputSigner>> signers;
+        signers.clear();
         CAmount total = GetInputs(signers, required, fDummy);
 
         // add changes
@@ -210,8 +225,9 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
             tx.vin.emplace_back(signer->output, CScript(), signer->sequence);
         }
 
-        // now every fields is populated then we can sign transaction
-        uint256 sig = tx.GetHash();
+        // now every fields is populated then we can sign transaction, signers that still need to be
+        // prepared only give a placeholder of the final size here
+        sig = tx.GetHash();
 
         for (size_t i = 0; i < tx.vin.size(); i++) {
             tx.vin[i].scriptSig = signers[i]->Sign(tx, sig, fDummy);
@@ -242,6 +258,28 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
         fee = feeNeeded;
     }
 
+    // The fee is settled, do the expensive signing work exactly once. Dummy transactions are only
+    // used for fee estimation so the placeholders are good enough for them.
+    bool fNeedsPrepare = std::any_of(signers.begin(), signers.end(), [](const std::unique_ptr<InputSigner>& signer) {
+        return signer->NeedsPrepare();
+    });
+
+    if (fNeedsPrepare && !fDummy) {
+        unsigned sizeEstimated = GetVirtualTransactionSize(result);
+
+        PrepareSigners(signers);
+
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            tx.vin[i].scriptSig = signers[i]->Sign(tx, sig, fDummy);
+        }
+
+        static_cast<CTransaction&>(result) = CTransaction(tx);
+
+        if (GetVirtualTransactionSize(result) > sizeEstimated) {
+            throw std::runtime_error(_("Transaction size changed after signing"));
+        }
+    }
+
     if (GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS)) {
         // Lastly, ensure this tx will pass the mempool's chain limits
         LockPoints lp;
@@ -265,3 +303,49 @@ CAmount TxBuilder::AdjustFee(CAmount needed, unsigned txSize)
 {
     return needed;
 }
+
+void TxBuilder::PrepareSigners(std::vector<std::unique_ptr<InputSigner>>& signers)
+{
+    std::vector<InputSigner*> pending;
+    for (auto& signer : signers) {
+        if (signer->NeedsPrepare()) {
+            pending.push_back(signer.get());
+        }
+    }
+
+    if (pending.empty()) {
+        return;
+    }
+
+    size_t nWorkers = std::min<size_t>(pending.size(), std::max(GetNumCores(), 1));
+    std::atomic<size_t> next(0);
+    std::vector<std::exception_ptr> errors(nWorkers);
+
+    auto worker = [&pending, &next, &errors](size_t id) {
+        try {
+            for (size_t i = next++; i < pending.size(); i = next++) {
+                pending[i]->Prepare();
+            }
+        } catch (...) {
+            errors[id] = std::current_exception();
+        }
+    };
+
+    boost::thread_group threads;
+    for (size_t i = 1; i < nWorkers; i++) {
+        threads.create_thread([&worker, i]() {
+            RenameThread("index-txbuilder");
+            worker(i);
+        });
+    }
+
+    // the calling thread works too
+    worker(0);
+    threads.join_all();
+
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -25,6 +25,15 @@ public:
     virtual ~InputSigner();
 
     virtual CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy = false) = 0;
+
+    // Signers with expensive signatures (e.g. zero-knowledge proofs) return true until Prepare() has
+    // been called. Until then Sign() returns a placeholder of the final size, which is enough to
+    // calculate the fee.
+    virtual bool NeedsPrepare() const;
+
+    // Does the expensive part of the signature. May be called concurrently for different signers
+    // and without holding cs_main or cs_wallet.
+    virtual void Prepare();
 };
 
 class TxBuilder
@@ -43,6 +52,9 @@ protected:
     virtual CAmount GetInputs(std::vector<std::unique_ptr<InputSigner>>& signers, CAmount required, bool fDummy = false) = 0;
     virtual CAmount GetChanges(std::vector<CTxOut>& outputs, CAmount amount, bool fDummy = false) = 0;
     virtual CAmount AdjustFee(CAmount needed, unsigned txSize);
+
+    // Runs Prepare() on all signers that need it, concurrently on a pool of worker threads.
+    virtual void PrepareSigners(std::vector<std::unique_ptr<InputSigner>>& signers);
 };
 
 #endif
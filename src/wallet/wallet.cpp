@@ -8,6 +8,7 @@
 #include "sigmaspendbuilder.h"
 #include "amount.h"
 #include "base58.h"
+#include "blockstore.h"
 #include "checkpoints.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -1298,6 +1299,11 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
+        if (fInsertedNew)
+            journal.Append(hash, WALLET_TX_ADDED);
+        else if (fUpdated)
+            journal.Append(hash, !wtxIn.hashUnset() && wtxIn.nIndex != -1 ? WALLET_TX_CONFIRMED : WALLET_TX_UPDATED);
+
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -1411,6 +1417,7 @@ bool CWallet::AbandonTransaction(const uint256 &hashTx) {
             wtx.setAbandoned();
             wtx.MarkDirty();
             walletdb.WriteTx(wtx);
+            journal.Append(wtx.GetHash(), WALLET_TX_UPDATED);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(hashTx, 0));
@@ -1535,6 +1542,7 @@ void CWallet::MarkConflicted(const uint256 &hashBlock, const uint256 &hashTx) {
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
             walletdb.WriteTx(wtx);
+            journal.Append(now, WALLET_TX_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
             while (iter != mapTxSpends.end() && iter->first.hash == now) {
@@ -2080,6 +2088,7 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
     CBlockIndex *pindex = pindexStart;
     {
         LOCK2(cs_main, cs_wallet);
+        CBlockFileSequentialScan sequentialScan;
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
@@ -2898,6 +2907,13 @@ bool CWallet::GetCoinsToSpend(
 
     std::list<CSigmaEntry> coins = GetAvailableCoins(coinControl, false, fDummy);
 
+    {
+        LOCK(cs_wallet);
+        coins.remove_if([this](const CSigmaEntry& coin) {
+            return setSigmaSpendReserved.count(primitives::GetPubCoinValueHash(coin.value)) != 0;
+        });
+    }
+
     CAmount availableBalance = CalculateCoinsBalance(coins.begin(), coins.end());
 
     if (roundedRequired * zeros > availableBalance) {
@@ -4529,8 +4545,10 @@ bool CWallet::EraseFromWallet(uint256 hash) {
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
             CWalletDB(strWalletFile).EraseTx(hash);
+            journal.Append(hash, WALLET_TX_DELETED);
+        }
     }
     return true;
 }
@@ -6285,7 +6303,11 @@ CWalletTx CWallet::CreateSigmaSpendTransaction(
     const CCoinControl *coinControl,
     bool fDummy)
 {
-    int nHeight = chainActive.Height();
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
     if(nHeight >= ::Params().GetConsensus().nDisableUnpaddedSigmaBlock && nHeight < ::Params().GetConsensus().nSigmaPaddingBlock)
         throw std::runtime_error(_("Sigma is disabled at this period."));
     // sanity check
@@ -6295,7 +6317,8 @@ CWalletTx CWallet::CreateSigmaSpendTransaction(
         throw std::runtime_error(_("Wallet locked"));
     }
 
-    // create transaction
+    // create transaction, the builder takes cs_main and cs_wallet itself and releases them while the
+    // proofs are generated
     SigmaSpendBuilder builder(*this, *zwalletMain, coinControl);
 
     CWalletTx tx = builder.Build(recipients, fee, fChangeAddedToFee, fDummy);
@@ -7661,6 +7684,9 @@ std::vector<CSigmaEntry> CWallet::SpendSigma(
     CWalletTx& result,
     CAmount& fee)
 {
+    // keep other spends from selecting the same coins until this one is committed
+    LOCK(cs_sigmaSpend);
+
     // create transaction
     std::vector<CSigmaEntry> coins;
     std::vector<CHDMint> changes;
@@ -7675,6 +7701,8 @@ std::vector<CSigmaEntry> CWallet::SpendSigma(
 bool CWallet::CommitSigmaTransaction(CWalletTx& wtxNew, std::vector<CSigmaEntry>& selectedCoins, std::vector<CHDMint>& changes) {
     EnsureMintWalletAvailable();
 
+    LOCK2(cs_main, cs_wallet);
+
     // commit
     try {
         CommitTransaction(wtxNew);
@@ -8276,6 +8304,7 @@ void CWallet::DisableTransaction(const CTransaction &tx)
         }
         CWalletTx& wtx = mapWallet[hash];
         wtx.BindWallet(this);
+        journal.Append(hash, WALLET_TX_DELETED);
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
 }
@@ -8333,8 +8362,10 @@ void CWallet::UpdatedTransaction(const uint256 &hashTx) {
         LOCK(cs_wallet);
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
-        if (mi != mapWallet.end())
+        if (mi != mapWallet.end()) {
+            journal.Append(hashTx, WALLET_TX_UPDATED);
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
+        }
     }
 }
 
@@ -16,6 +16,7 @@
 #include "validationinterface.h"
 #include "script/ismine.h"
 #include "wallet/crypter.h"
+#include "wallet/journal.h"
 #include "wallet/walletdb.h"
 #include "wallet/rpcwallet.h"
 #include "pos.h"
@@ -701,6 +702,12 @@ public:
      */
     mutable CCriticalSection cs_wallet;
 
+    /*
+     * Held from coin selection until commit by sigma spends which do both, so that concurrent
+     * spends don't select the same coins. Taken before cs_main and cs_wallet.
+     */
+    CCriticalSection cs_sigmaSpend;
+
     bool fFileBacked;
     std::string strWalletFile;
 
@@ -751,6 +758,8 @@ public:
     }
 
     std::map<uint256, CWalletTx> mapWallet;
+    //! Changes of mapWallet since the wallet was loaded, for clients following the wallet incrementally
+    CWalletJournal journal;
     std::list<CAccountingEntry> laccentries;
     bool EraseFromWallet(uint256 hash);
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
@@ -766,6 +775,9 @@ public:
 
     std::set<COutPoint> setLockedCoins;
 
+    // pubcoin hashes of sigma mints selected by a spend whose proofs are being generated, not offered to other spends
+    std::set<uint256> setSigmaSpendReserved;
+
     int64_t nTimeFirstKey;
 
     const CWalletTx* GetWalletTx(const uint256& hash) const;
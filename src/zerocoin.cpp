@@ -2,6 +2,7 @@
 #include "zerocoin.h"
 #include "sigma.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "chainparams.h"
 #include "util.h"
 #include "base58.h"
@@ -35,6 +36,8 @@ libzerocoin::Params *ZCParamsV2 = new libzerocoin::Params(bnTrustedModulusV2, bn
 
 static CZerocoinState zerocoinState;
 
+uint256 hashZerocoinAssumeValid;
+
 static bool CheckZerocoinSpendSerial(CValidationState &state, const Consensus::Params &params, CZerocoinTxInfo *zerocoinTxInfo, libzerocoin::CoinDenomination denomination, const CBigNum &serial, int nHeight, bool fConnectTip) {
     if (nHeight > params.nCheckBugFixedAtBlock) {
         // check for zerocoin transaction in this block as well
@@ -215,6 +218,33 @@ bool CheckRemintZcoinTransaction(const CTransaction &tx,
     return true;
 }
 
+// Coins minted in the group, sorted by the time of mint
+static vector<CBigNum> GetCoinGroupPubCoins(const CZerocoinState::CoinGroupInfo &coinGroup, const pair<int,int> &denominationAndId) {
+    CBlockIndex *index = coinGroup.lastBlock;
+    vector<CBigNum> pubCoins = index->mintedPubCoins[denominationAndId];
+    if (index != coinGroup.firstBlock) {
+        do {
+            index = index->pprev;
+            if (index->mintedPubCoins.count(denominationAndId) > 0)
+                pubCoins.insert(pubCoins.begin(),
+                                index->mintedPubCoins[denominationAndId].cbegin(),
+                                index->mintedPubCoins[denominationAndId].cend());
+        } while (index != coinGroup.firstBlock);
+    }
+    return pubCoins;
+}
+
+bool IsZerocoinSpendAssumedValid(const CBlockIndex *pindex) {
+    if (hashZerocoinAssumeValid.IsNull())
+        return false;
+
+    BlockMap::const_iterator it = mapBlockIndex.find(hashZerocoinAssumeValid);
+    if (it == mapBlockIndex.end())
+        return false;
+
+    return it->second->GetAncestor(pindex->nHeight) == pindex;
+}
+
 bool CheckSpendZcoinTransaction(const CTransaction &tx,
                                 const Consensus::Params &params,
                                 const vector<libzerocoin::CoinDenomination>& targetDenominations,
@@ -290,7 +320,7 @@ bool CheckSpendZcoinTransaction(const CTransaction &tx,
             }
         }
 
-        if (fModulusV2InIndex != fModulusV2 && fStatefulZerocoinCheck)
+        if (fModulusV2InIndex != fModulusV2 && fStatefulZerocoinCheck && !(zerocoinTxInfo && zerocoinTxInfo->fSpendsAssumedValid))
             zerocoinState.CalculateAlternativeModulusAccumulatorValues(&chainActive, (int)targetDenominations[vinIndex], pubcoinId);
 
         uint256 txHashForMetadata;
@@ -367,81 +397,127 @@ bool CheckSpendZcoinTransaction(const CTransaction &tx,
         if (!zerocoinState.GetCoinGroupInfo(targetDenominations[vinIndex], pubcoinId, coinGroup))
             return state.DoS(100, false, NO_MINT_ZEROCOIN, "CheckSpendZcoinTransaction: Error: no coins were minted with such parameters");
 
+        if (zerocoinTxInfo && zerocoinTxInfo->fSpendsAssumedValid)
+            continue;
+
         bool passVerify = false;
-        CBlockIndex *index = coinGroup.lastBlock;
+        CBlockIndex *index;
 
         pair<int,int> denominationAndId = make_pair(targetDenominations[vinIndex], pubcoinId);
 
-        bool spendHasBlockHash = false;
-
-        // Zerocoin v1.5/v2 transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
-        // up verification
-        if (spendVersion > ZEROCOIN_TX_VERSION_1 && !spend->getAccumulatorBlockHash().IsNull()) {
-			spendHasBlockHash = true;
-			uint256 accumulatorBlockHash = spend->getAccumulatorBlockHash();
-
-			// find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-			while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-				index = index->pprev;
-		}
-
         decltype(&CBlockIndex::accumulatorChanges) accChanges = fModulusV2 == fModulusV2InIndex ?
                     &CBlockIndex::accumulatorChanges : &CBlockIndex::alternativeAccumulatorChanges;
 
-        // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
-        // In most cases the latest accumulator value will be used for verification
-        do {
-            if ((index->*accChanges).count(denominationAndId) > 0) {
-                libzerocoin::Accumulator accumulator(zcParams,
-                                                     (index->*accChanges)[denominationAndId].first,
-                                                     targetDenominations[vinIndex]);
-                LogPrintf("CheckSpendZcoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-                passVerify = spend->Verify(accumulator, newMetadata);
+        // If this spend was verified before (reindex or resync) try the accumulator it was verified against first
+        CZerocoinSpendHint hint;
+        bool fHaveHint = pzerocoinhintdb && pzerocoinhintdb->ReadHint(hashTx, vinIndex, hint);
+        if (fHaveHint) {
+            if (hint.nType == CZerocoinSpendHint::ACCUMULATOR_CHANGE) {
+                index = coinGroup.lastBlock;
+                while (index != coinGroup.firstBlock && index->nHeight > hint.nValue)
+                    index = index->pprev;
+                if (index->nHeight == hint.nValue && (index->*accChanges).count(denominationAndId) > 0) {
+                    const CBigNum &accumulatorValue = (index->*accChanges)[denominationAndId].first;
+                    if (hint.Matches(accumulatorValue)) {
+                        libzerocoin::Accumulator accumulator(zcParams, accumulatorValue, targetDenominations[vinIndex]);
+                        passVerify = spend->Verify(accumulator, newMetadata);
+                    }
+                }
+            }
+            else if (spendVersion == ZEROCOIN_TX_VERSION_1) {
+                vector<CBigNum> pubCoins = GetCoinGroupPubCoins(coinGroup, denominationAndId);
+                if (hint.nValue > 0 && hint.nValue <= (int)pubCoins.size()) {
+                    bool fReverse = hint.nType == CZerocoinSpendHint::COINS_BACKWARD;
+                    libzerocoin::Accumulator accumulator(zcParams, targetDenominations[vinIndex]);
+                    for (int i = 0; i < hint.nValue; i++) {
+                        const CBigNum &pubCoin = fReverse ? pubCoins[pubCoins.size()-1-i] : pubCoins[i];
+                        accumulator += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)targetDenominations[vinIndex]);
+                    }
+                    if (hint.Matches(accumulator.getValue()))
+                        passVerify = spend->Verify(accumulator, newMetadata);
+                }
             }
 
-            // if spend has block hash we don't need to look further
-            if (index == coinGroup.firstBlock || spendHasBlockHash)
-                break;
-            else
-                index = index->pprev;
-        } while (!passVerify);
-
-        // Rare case: accumulator value contains some but NOT ALL coins from one block. In this case we will
-        // have to enumerate over coins manually. No optimization is really needed here because it's a rarity
-        // This can't happen if spend is of version 1.5 or 2.0
-        if (!passVerify && spendVersion == ZEROCOIN_TX_VERSION_1) {
-            // Build vector of coins sorted by the time of mint
+            if (!passVerify)
+                LogPrintf("CheckSpendZcoinTransaction: spend hint for %s:%d doesn't match, searching\n", hashTx.ToString(), vinIndex);
+        }
+
+        if (!passVerify) {
             index = coinGroup.lastBlock;
-            vector<CBigNum> pubCoins = index->mintedPubCoins[denominationAndId];
-            if (index != coinGroup.firstBlock) {
-                do {
+
+            bool spendHasBlockHash = false;
+
+            // Zerocoin v1.5/v2 transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
+            // up verification
+            if (spendVersion > ZEROCOIN_TX_VERSION_1 && !spend->getAccumulatorBlockHash().IsNull()) {
+                spendHasBlockHash = true;
+                uint256 accumulatorBlockHash = spend->getAccumulatorBlockHash();
+
+                // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
+                while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
                     index = index->pprev;
-                    if (index->mintedPubCoins.count(denominationAndId) > 0)
-                        pubCoins.insert(pubCoins.begin(),
-                                        index->mintedPubCoins[denominationAndId].cbegin(),
-                                        index->mintedPubCoins[denominationAndId].cend());
-                } while (index != coinGroup.firstBlock);
             }
 
-            libzerocoin::Accumulator accumulator(zcParams, targetDenominations[vinIndex]);
-            BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
-                accumulator += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)targetDenominations[vinIndex]);
-                LogPrintf("CheckSpendZcoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-                if ((passVerify = spend->Verify(accumulator, newMetadata)) == true)
+            // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
+            // In most cases the latest accumulator value will be used for verification
+            do {
+                if ((index->*accChanges).count(denominationAndId) > 0) {
+                    const CBigNum &accumulatorValue = (index->*accChanges)[denominationAndId].first;
+                    libzerocoin::Accumulator accumulator(zcParams, accumulatorValue, targetDenominations[vinIndex]);
+                    LogPrintf("CheckSpendZcoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
+                    if ((passVerify = spend->Verify(accumulator, newMetadata)) == true) {
+                        hint = CZerocoinSpendHint(CZerocoinSpendHint::ACCUMULATOR_CHANGE, index->nHeight, accumulatorValue);
+                        break;
+                    }
+                }
+
+                // if spend has block hash we don't need to look further
+                if (index == coinGroup.firstBlock || spendHasBlockHash)
                     break;
-            }
+                else
+                    index = index->pprev;
+            } while (!passVerify);
+
+            // Rare case: accumulator value contains some but NOT ALL coins from one block. In this case we will
+            // have to enumerate over coins manually. No optimization is really needed here because it's a rarity
+            // This can't happen if spend is of version 1.5 or 2.0
+            if (!passVerify && spendVersion == ZEROCOIN_TX_VERSION_1) {
+                // Build vector of coins sorted by the time of mint
+                vector<CBigNum> pubCoins = GetCoinGroupPubCoins(coinGroup, denominationAndId);
 
-            if (!passVerify) {
-                // One more time now in reverse direction. The only reason why it's required is compatibility with
-                // previous client versions
                 libzerocoin::Accumulator accumulator(zcParams, targetDenominations[vinIndex]);
-                BOOST_REVERSE_FOREACH(const CBigNum &pubCoin, pubCoins) {
+                int nCoins = 0;
+                BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
                     accumulator += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)targetDenominations[vinIndex]);
-                    LogPrintf("CheckSpendZcoinTransaction: accumulatorRev=%s\n", accumulator.getValue().ToString().substr(0,15));
-                    if ((passVerify = spend->Verify(accumulator, newMetadata)) == true)
+                    nCoins++;
+                    LogPrintf("CheckSpendZcoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
+                    if ((passVerify = spend->Verify(accumulator, newMetadata)) == true) {
+                        hint = CZerocoinSpendHint(CZerocoinSpendHint::COINS_FORWARD, nCoins, accumulator.getValue());
                         break;
+                    }
+                }
+
+                if (!passVerify) {
+                    // One more time now in reverse direction. The only reason why it's required is compatibility with
+                    // previous client versions
+                    libzerocoin::Accumulator accumulator(zcParams, targetDenominations[vinIndex]);
+                    nCoins = 0;
+                    BOOST_REVERSE_FOREACH(const CBigNum &pubCoin, pubCoins) {
+                        accumulator += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)targetDenominations[vinIndex]);
+                        nCoins++;
+                        LogPrintf("CheckSpendZcoinTransaction: accumulatorRev=%s\n", accumulator.getValue().ToString().substr(0,15));
+                        if ((passVerify = spend->Verify(accumulator, newMetadata)) == true) {
+                            hint = CZerocoinSpendHint(CZerocoinSpendHint::COINS_BACKWARD, nCoins, accumulator.getValue());
+                            break;
+                        }
+                    }
                 }
             }
+
+            // Remember where the search ended so the next replay of this spend verifies once. Only spends in a
+            // block have a zerocoinTxInfo, the hints are written when the block is connected
+            if (passVerify && zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete)
+                zerocoinTxInfo->spendHints.push_back(make_pair(make_pair(hashTx, vinIndex), hint));
         }
 
         if (!passVerify) {
@@ -677,8 +753,23 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
     return true;
 }
 
-void DisconnectTipZC(CBlock & /*block*/, CBlockIndex *pindexDelete) {
+void DisconnectTipZC(CBlock &block, CBlockIndex *pindexDelete) {
     zerocoinState.RemoveBlock(pindexDelete);
+
+    // The spends may be verified against other accumulators if they are connected again
+    if (pzerocoinhintdb) {
+        vector<pair<uint256,int> > spends;
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            if (!tx.IsZerocoinSpend())
+                continue;
+            for (size_t i = 0; i < tx.vin.size(); i++) {
+                if (tx.vin[i].IsZerocoinSpend())
+                    spends.push_back(make_pair(tx.GetHash(), (int)i));
+            }
+        }
+        if (!spends.empty() && !pzerocoinhintdb->EraseHints(spends))
+            LogPrintf("DisconnectTipZC: failed to erase zerocoin spend hints\n");
+    }
 }
 
 CBigNum ZerocoinGetSpendSerialNumber(const CTransaction &tx, const CTxIn &txin) {
@@ -737,6 +828,11 @@ bool ConnectBlockZC(CValidationState &state, const CChainParams &chainParams, CB
         if (fJustCheck)
             return true;
 
+        // Hints only speed up later replays of the chain, so failing to write them isn't fatal
+        if (pzerocoinhintdb && !pblock->zerocoinTxInfo->spendHints.empty() &&
+                !pzerocoinhintdb->WriteHints(pblock->zerocoinTxInfo->spendHints))
+            LogPrintf("ConnectTipZC: failed to write zerocoin spend hints\n");
+
         // Update minted values and accumulators
         BOOST_FOREACH(const PAIRTYPE(int,CBigNum) &mint, pblock->zerocoinTxInfo->mints) {
             CBigNum oldAccValue(0);
@@ -5,6 +5,7 @@
 #include "chain.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "hash.h"
 #include "libzerocoin/Zerocoin.h"
 #include "zerocoin_params.h"
 #include <unordered_set>
@@ -23,6 +24,42 @@ inline bool IsZerocoinTxV2(libzerocoin::CoinDenomination denomination, const Con
 	    || ((denomination == libzerocoin::ZQ_WILLIAMSON) && (coinId >= params.nSpendV2ID_100));
 }
 
+// Remembers which accumulator a legacy zerocoin spend was verified against, so replaying the chain
+// (reindex, resync) doesn't have to search for it again. Stored in the zerocoin spend hint database
+class CZerocoinSpendHint {
+public:
+    enum Type {
+        // accumulator from accumulatorChanges of the block at height nValue
+        ACCUMULATOR_CHANGE = 0,
+        // v1 only: accumulator built from first nValue coins of the group in order of minting
+        COINS_FORWARD = 1,
+        // v1 only: same in reverse order
+        COINS_BACKWARD = 2
+    };
+
+    int nType;
+    int nValue;
+    // hash of the accumulator value, hint is ignored if the recomputed accumulator doesn't match
+    uint256 accumulatorHash;
+
+    CZerocoinSpendHint(): nType(ACCUMULATOR_CHANGE), nValue(0) {}
+    CZerocoinSpendHint(int type, int value, const CBigNum &accumulatorValue):
+        nType(type), nValue(value), accumulatorHash(SerializeHash(accumulatorValue)) {}
+
+    bool Matches(const CBigNum &accumulatorValue) const {
+        return accumulatorHash == SerializeHash(accumulatorValue);
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType_, int nVersion) {
+        READWRITE(nType);
+        READWRITE(nValue);
+        READWRITE(accumulatorHash);
+    }
+};
+
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
 // index
 class CZerocoinTxInfo {
@@ -40,11 +77,23 @@ public:
     // information about transactions in the block is complete
     bool fInfoIsComplete;
 
-    CZerocoinTxInfo(): fHasSpendV1(false), fInfoIsComplete(false) {}
+    // block is an ancestor of -zcassumevalid block, spend proofs needn't be verified
+    bool fSpendsAssumedValid;
+
+    // <<txid, input>, hint> for spends which had to search for their accumulator, written once the block is connected
+    vector<pair<pair<uint256,int>, CZerocoinSpendHint> > spendHints;
+
+    CZerocoinTxInfo(): fHasSpendV1(false), fInfoIsComplete(false), fSpendsAssumedValid(false) {}
     // finalize everything
     void Complete();
 };
 
+// -zcassumevalid: zerocoin spends in this block and its ancestors are not re-verified
+extern uint256 hashZerocoinAssumeValid;
+
+// Requires cs_main
+bool IsZerocoinSpendAssumedValid(const CBlockIndex *pindex);
+
 CBigNum ParseZerocoinMintScript(const CScript& script);
 std::pair<std::unique_ptr<libzerocoin::CoinSpend>, uint32_t> ParseZerocoinSpend(const CTxIn& in);
 
@@ -144,6 +144,7 @@ CZMQPublisherInterface* CZMQPublisherInterface::Create()
     std::vector<std::string> pubIndexes = {
         "pubblock", 
         "pubrawtx", 
+        "pubwalletchanges",
         "pubblockinfo", 
         "pubbalance", 
         "pubindexnodeupdate", 
@@ -152,9 +153,12 @@ CZMQPublisherInterface* CZMQPublisherInterface::Create()
         "pubstatus",
         "pubindexnodelist",
     };
+    if (GetBoolArg("-apipubvalidationstats", DEFAULT_API_PUB_VALIDATION_STATS))
+        pubIndexes.push_back("pubvalidationstats");
 
     factories["pubblock"] = CZMQAbstract::Create<CZMQBlockDataTopic>;
     factories["pubrawtx"] = CZMQAbstract::Create<CZMQTransactionTopic>;
+    factories["pubwalletchanges"] = CZMQAbstract::Create<CZMQWalletChangesTopic>;
     factories["pubblockinfo"] = CZMQAbstract::Create<CZMQBlockInfoTopic>;
     factories["pubbalance"] = CZMQAbstract::Create<CZMQBalanceTopic>;
     factories["pubindexnodeupdate"] = CZMQAbstract::Create<CZMQIndexnodeTopic>;
@@ -162,6 +166,7 @@ CZMQPublisherInterface* CZMQPublisherInterface::Create()
     factories["pubsettings"] = CZMQAbstract::Create<CZMQSettingsTopic>;
     factories["pubstatus"] = CZMQAbstract::Create<CZMQAPIStatusTopic>;
     factories["pubindexnodelist"] = CZMQAbstract::Create<CZMQIndexnodeListTopic>;
+    factories["pubvalidationstats"] = CZMQAbstract::Create<CZMQValidationStatsTopic>;
     
     BOOST_FOREACH(string pubIndex, pubIndexes)
     {
@@ -13,6 +13,9 @@
 class CBlockIndex;
 class CZMQAbstract;
 
+//! -apipubvalidationstats default
+static const bool DEFAULT_API_PUB_VALIDATION_STATS = false;
+
 class CZMQInterface
 {
 public:
@@ -264,6 +264,42 @@ bool CZMQBlockEvent::NotifyBlock(const CBlockIndex *pindex){
     return true;
 }
 
+bool CZMQValidationStatsEvent::NotifyBlock(const CBlockIndex *pindex){
+    request.replace("data", pindex->ToJSON());
+    Execute();
+    return true;
+}
+
+bool CZMQWalletChangesEvent::PublishChanges(){
+    // Nothing to publish unless the journal moved on
+    if(!pwalletMain || (sequence == pwalletMain->journal.GetLastSequence() &&
+                        journal == strprintf("%016x", pwalletMain->journal.GetId()))){
+        return true;
+    }
+
+    UniValue requestData(UniValue::VOBJ);
+    requestData.push_back(Pair("journal", journal));
+    requestData.push_back(Pair("sequence", sequence));
+    request.replace("data", requestData);
+    Execute();
+
+    // continue after the changes published
+    if(publish.isObject() && find_value(publish, "sequence").isNum()){
+        journal = find_value(publish, "journal").get_str();
+        sequence = find_value(publish, "sequence").get_int64();
+    }
+
+    return true;
+}
+
+bool CZMQWalletChangesEvent::NotifyBlock(const CBlockIndex *pindex){
+    return PublishChanges();
+}
+
+bool CZMQWalletChangesEvent::NotifyTransaction(const CTransaction &transaction){
+    return PublishChanges();
+}
+
 bool CZMQIndexnodeEvent::NotifyIndexnodeUpdate(CIndexnode &indexnode){
     request.replace("data", indexnode.ToJSON());
     Execute();
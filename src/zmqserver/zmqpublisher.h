@@ -132,6 +132,30 @@ public:
     bool NotifyBalance();
 };
 
+class CZMQValidationStatsEvent : virtual public CZMQAbstractPublisher
+{
+    /* Stage timings, after every block connected
+    */
+public:
+    bool NotifyBlock(const CBlockIndex *pindex);
+};
+
+class CZMQWalletChangesEvent : virtual public CZMQAbstractPublisher
+{
+    /* Wallet transactions changed since the last publication
+    */
+public:
+    CZMQWalletChangesEvent() : sequence(0) {}
+    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyTransaction(const CTransaction &transaction);
+
+protected:
+    std::string journal;
+    uint64_t sequence;
+
+    bool PublishChanges();
+};
+
 /* Topics. inheriting from an event class implies publishing on that event. 
    'method' string is the API method called in client-api/ 
 */
@@ -168,6 +192,20 @@ public:
     void SetMethod(){ method= "transaction";}
 };
 
+class CZMQWalletChangesTopic : public CZMQWalletChangesEvent
+{
+public:
+    void SetTopic(){ topic = "walletChanges";}
+    void SetMethod(){ method= "walletChanges";}
+};
+
+class CZMQValidationStatsTopic : public CZMQValidationStatsEvent
+{
+public:
+    void SetTopic(){ topic = "validationStats";}
+    void SetMethod(){ method= "validationStats";}
+};
+
 class CZMQSettingsTopic : public CZMQSettingsEvent
 {
 public:
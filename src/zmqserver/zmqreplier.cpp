@@ -2,132 +2,207 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include "zmqreplier.h"
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/thread.hpp>
-#include <boost/chrono.hpp>
+#include "crypto/common.h"
 #include "util.h"
+#include "utiltime.h"
 #include "univalue.h"
 #include "client-api/server.h"
 #include "client-api/protocol.h"
 
-//*********** threads waiting for responses ***********//
-void* CZMQOpenReplier::Thread()
-{
-    LogPrintf("ZMQ: IN REQREP_ZMQ_open\n");
-    while (KEEPALIVE) {
-        /* Create an empty ØMQ message to hold the message part. */
-        /* message assumed to contain an API command to be executed with data */
-        rc = zmq_msg_init (&request);
-
-        /* Block until a message is available to be received from socket */
-        if(!Wait()){
-            break;
-        }
-
-        LogPrintf("ZMQ: read open request\n");
-        std::string requestStr = ReadRequest();
-        LogPrintf("requestStr: %s\n", requestStr);
-        APIJSONRequest jreq;
-        try {
-            // Parse request
-            UniValue valRequest;
-            if (!valRequest.read(requestStr))
-                throw JSONAPIError(API_PARSE_ERROR, "Parse error");
+#include <list>
 
-            jreq.parse(valRequest);
+// Commands which change state run alone, everything else runs alongside each other
+static boost::shared_mutex csExecute;
 
-            UniValue result = tableAPI.execute(jreq, false);
+static boost::mutex csRepliers;
+static std::list<CZMQAbstractReplier*> repliers;
 
-            // Send reply
-            message = JSONAPIReply(result, NullUniValue);
-            if(!SendMessage()){
-                break;
-            }
+static bool IsExclusiveRequest(const APIJSONRequest& jreq)
+{
+    if (jreq.type == Create || jreq.type == Update || jreq.type == Delete)
+        return true;
+    // the wallet is unlocked for the duration of these
+    const CAPICommand *pcmd = tableAPI[jreq.collection];
+    return pcmd && pcmd->authPassphrase;
+}
 
-        } catch (const UniValue& objError) {
-            message = JSONAPIReply(NullUniValue, objError);
-            if(!SendMessage()){
-                break;
-            }
-        } catch (const std::exception& e) {
-            message = JSONAPIReply(NullUniValue, JSONAPIError(API_PARSE_ERROR, e.what()));
-            if(!SendMessage()){
-                break;
-            }
-            return NULL;
+// Receive all parts of a message, false once the context was shut down
+static bool ReceiveMultipart(void *psocket, std::vector<std::string>& parts)
+{
+    parts.clear();
+    int more;
+    do {
+        zmq_msg_t part;
+        zmq_msg_init(&part);
+        if (zmq_msg_recv(&part, psocket, 0) == -1) {
+            zmq_msg_close(&part);
+            return false;
         }
-    }
-    return NULL;
+        parts.push_back(std::string((const char*)zmq_msg_data(&part), zmq_msg_size(&part)));
+        more = zmq_msg_more(&part);
+        zmq_msg_close(&part);
+    } while (more);
+    return true;
 }
 
-void* CZMQAuthReplier::Thread(){
-    LogPrintf("ZMQ: IN REQREP_ZMQ_auth\n");
-    while (KEEPALIVE) {
-        /* Create an empty ØMQ message to hold the message part. */
-        /* message assumed to contain an API command to be executed with data */
-        rc = zmq_msg_init (&request);
+static bool SendPart(void *psocket, const std::string& part, int flags)
+{
+    return zmq_send(psocket, part.data(), part.size(), flags) != -1;
+}
 
-        /* Block until a message is available to be received from socket */
-        if(!Wait()){
-            break;
+//*********** threads waiting for responses ***********//
+std::string CZMQAbstractReplier::Execute(const std::string& requestStr)
+{
+    APIJSONRequest jreq;
+    try {
+        // Parse request
+        UniValue valRequest;
+        if (!valRequest.read(requestStr))
+            throw JSONAPIError(API_PARSE_ERROR, "Parse error");
+
+        jreq.parse(valRequest);
+
+        UniValue result;
+        if (IsExclusiveRequest(jreq)) {
+            boost::unique_lock<boost::shared_mutex> lock(csExecute);
+            result = tableAPI.execute(jreq, AuthPort());
+        } else {
+            boost::shared_lock<boost::shared_mutex> lock(csExecute);
+            result = tableAPI.execute(jreq, AuthPort());
         }
 
-        APIJSONRequest jreq;
-        try {
-            // Parse request
-            UniValue valRequest;
-            if (!valRequest.read(ReadRequest()))
-                throw JSONAPIError(API_PARSE_ERROR, "Parse error");
-
-            jreq.parse(valRequest);
+        return JSONAPIReply(result, NullUniValue);
+    } catch (const UniValue& objError) {
+        return JSONAPIReply(NullUniValue, objError);
+    } catch (const std::exception& e) {
+        return JSONAPIReply(NullUniValue, JSONAPIError(API_PARSE_ERROR, e.what()));
+    }
+}
 
-            UniValue result = tableAPI.execute(jreq, true);
+void CZMQAbstractReplier::WorkerThread()
+{
+    void *preply = zmq_socket(pcontext, ZMQ_PUSH);
+    if (!preply || zmq_connect(preply, resultsAddress.c_str()) == -1) {
+        zmqError("Unable to connect API worker");
+        if (preply)
+            zmq_close(preply);
+        return;
+    }
 
-            // Send reply
-            message = JSONAPIReply(result, NullUniValue);
-            if(!SendMessage()){
+    while (true) {
+        CZMQRequest request;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (KEEPALIVE && queue.empty())
+                cond.wait(lock);
+            if (!KEEPALIVE)
                 break;
-            }
+            request = queue.front();
+            queue.pop_front();
+            stats.nRunning++;
+        }
 
-        } catch (const UniValue& objError) {
-            message = JSONAPIReply(NullUniValue, objError);
-            if(!SendMessage()){
-                break;
-            }
-        } catch (const std::exception& e) {
-            message = JSONAPIReply(NullUniValue, JSONAPIError(API_PARSE_ERROR, e.what()));
-            if(!SendMessage()){
-                break;
-            }
-            return NULL;
+        std::string reply = Execute(request.body);
+
+        // The socket thread appends the sequence number
+        bool fSent = true;
+        for (size_t i = 0; i < request.envelope.size(); i++)
+            fSent = fSent && SendPart(preply, request.envelope[i], ZMQ_SNDMORE);
+        fSent = fSent && SendPart(preply, reply, 0);
+
+        int64_t nLatency = GetTimeMicros() - request.nTimeReceived;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            stats.nRunning--;
+            stats.nRequests++;
+            stats.nTotalLatency += nLatency;
+            stats.nMaxLatency = std::max(stats.nMaxLatency, nLatency);
         }
+        if (!fSent)
+            break;
     }
-    return NULL;
+
+    int linger = 0;
+    zmq_setsockopt(preply, ZMQ_LINGER, &linger, sizeof(linger));
+    zmq_close(preply);
 }
 
-// 'Wait' thread. hangs waiting for REQ
-bool CZMQAbstractReplier::Wait(){
+// Queue a request of the ROUTER socket: the envelope identifying the client, then the request itself
+bool CZMQAbstractReplier::ForwardRequest()
+{
+    std::vector<std::string> parts;
+    if (!ReceiveMultipart(psocket, parts))
+        return false;
+    if (parts.size() < 2)
+        return true;
+
+    CZMQRequest request;
+    request.body = parts.back();
+    parts.pop_back();
+    request.envelope.swap(parts);
+    request.nTimeReceived = GetTimeMicros();
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        queue.push_back(request);
+    }
+    cond.notify_one();
+    return true;
+}
 
-    if(rc==-1) return false;
-    /* Block until a message is available to be received from socket */
-    do {
-        rc = zmq_recvmsg (psocket, &request, ZMQ_DONTWAIT);
-        if ((EAGAIN != errno && rc==0) || !KEEPALIVE){
+// Send a reply of a worker to its client, followed by a LE 4byte sequence number
+bool CZMQAbstractReplier::ForwardReply()
+{
+    std::vector<std::string> parts;
+    if (!ReceiveMultipart(presults, parts))
+        return false;
+
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nReplySequence++);
+    // Clients which went away meanwhile are not routable any more, the reply is dropped then
+    for (size_t i = 0; i < parts.size(); i++)
+        SendPart(psocket, parts[i], ZMQ_SNDMORE);
+    SendPart(psocket, std::string((const char*)msgseq, sizeof(msgseq)), 0);
+    return true;
+}
+
+// Socket thread, sleeps in zmq_poll until a request or a reply arrives or the context is shut down
+void CZMQAbstractReplier::Thread()
+{
+    LogPrintf("ZMQ: IN REQREP_ZMQ_%s\n", type);
+    zmq_pollitem_t items[] = {
+        { psocket, 0, ZMQ_POLLIN, 0 },
+        { presults, 0, ZMQ_POLLIN, 0 }
+    };
+
+    while (true) {
+        if (zmq_poll(items, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
             break;
         }
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-    } while(rc==-1);
-
-    if (!KEEPALIVE) return false;
+        if ((items[0].revents & ZMQ_POLLIN) && !ForwardRequest())
+            break;
+        if ((items[1].revents & ZMQ_POLLIN) && !ForwardReply())
+            break;
+    }
 
-    return true;
+    int linger = 0;
+    zmq_setsockopt(psocket, ZMQ_LINGER, &linger, sizeof(linger));
+    zmq_close(psocket);
+    psocket = 0;
+    zmq_setsockopt(presults, ZMQ_LINGER, &linger, sizeof(linger));
+    zmq_close(presults);
+    presults = 0;
 }
 
-std::string CZMQAbstractReplier::ReadRequest(){
-    char* requestChars = (char*) malloc (rc + 1);
-    memcpy (requestChars, zmq_msg_data (&request), rc);
-    zmq_msg_close(&request);
-    requestChars[rc]=0;
-    return std::string(requestChars);
+CZMQReplierStats CZMQAbstractReplier::GetStats()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    CZMQReplierStats result = stats;
+    result.nQueued = queue.size();
+    return result;
 }
 
 bool CZMQAbstractReplier::Socket(){
@@ -144,12 +219,18 @@ bool CZMQAbstractReplier::Socket(){
 
     assert(!psocket);
 
-    psocket = zmq_socket(pcontext,ZMQ_REP);
+    psocket = zmq_socket(pcontext,ZMQ_ROUTER);
     if(!psocket){
         //TODO fail
         LogPrintf("ZMQ: Failed to create psocket\n");
         return false;
     }
+
+    presults = zmq_socket(pcontext,ZMQ_PULL);
+    if(!presults){
+        LogPrintf("ZMQ: Failed to create results socket\n");
+        return false;
+    }
     return true;
 }
 
@@ -180,6 +261,14 @@ bool CZMQAbstractReplier::Bind(){
         LogPrintf("ZMQ: Unable to send ZMQ msg\n");
         return false;
     }
+
+    resultsAddress = "inproc://replies" + port;
+    rc = zmq_bind(presults, resultsAddress.c_str());
+    if (rc == -1)
+    {
+        zmqError("Unable to bind results socket");
+        return false;
+    }
     LogPrintf("ZMQ: Bound socket\n");
     return true;
 }
@@ -192,35 +281,63 @@ bool CZMQAbstractReplier::Initialize()
     Socket();
     Auth();
     Bind();
-    worker = new boost::thread(boost::bind(&CZMQAbstractReplier::Thread, this));
-    LogPrintf("ZMQ: created and ran thread\n");
+
+    int nWorkers = std::max(1, std::min((int)GetArg("-apiworkers", DEFAULT_API_WORKERS), MAX_API_WORKERS));
+    threads.create_thread(boost::bind(&CZMQAbstractReplier::Thread, this));
+    for (int i = 0; i < nWorkers; i++)
+        threads.create_thread(boost::bind(&CZMQAbstractReplier::WorkerThread, this));
+    LogPrintf("ZMQ: created and ran thread with %d workers\n", nWorkers);
+
+    boost::unique_lock<boost::mutex> lock(csRepliers);
+    repliers.push_back(this);
     return true;
 }
 
 void CZMQAbstractReplier::Shutdown()
 {
+    // The replier interface shuts down once more when it is deleted
+    if (!pcontext)
+        return;
     LogPrintf("shutting down replier..\n");
-    if (pcontext) // prematurely end context in order to let threads run out
+
     {
-        pcontext = 0;
+        boost::unique_lock<boost::mutex> lock(csRepliers);
+        repliers.remove(this);
     }
 
-    KEEPALIVE = 0; // end infinite loop in thread 
-    worker->interrupt(); // terminate boost thread
-
-    boost::this_thread::sleep_for(boost::chrono::milliseconds(100)); // wait allowing thread to finish up
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        KEEPALIVE = 0; // end infinite loop in workers
+        queue.clear();
+    }
+    cond.notify_all();
 
-    assert(psocket);
+    // Wakes the socket thread with ETERM, the threads close their sockets before they exit
+    zmq_ctx_shutdown(pcontext);
+    threads.join_all();
 
     LogPrint(NULL, "Close socket at authority %s\n", authority);
 
-    int linger = 0;
-    zmq_setsockopt(psocket, ZMQ_LINGER, &linger, sizeof(linger));
-    zmq_close(psocket);
-    psocket = 0;
-    LogPrintf("closed psocket\n");
-
-    zmq_ctx_destroy(pcontext);
+    zmq_ctx_term(pcontext);
+    pcontext = 0;
 
     LogPrintf("replier shutdown\n");
 }
+
+UniValue GetReplierStatus()
+{
+    UniValue result(UniValue::VOBJ);
+    boost::unique_lock<boost::mutex> lock(csRepliers);
+    for (std::list<CZMQAbstractReplier*>::iterator it = repliers.begin(); it != repliers.end(); ++it) {
+        CZMQReplierStats stats = (*it)->GetStats();
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("queued", (uint64_t)stats.nQueued));
+        obj.push_back(Pair("running", (uint64_t)stats.nRunning));
+        obj.push_back(Pair("requests", stats.nRequests));
+        // microseconds
+        obj.push_back(Pair("averageLatency", stats.nRequests ? stats.nTotalLatency / (int64_t)stats.nRequests : 0));
+        obj.push_back(Pair("maxLatency", stats.nMaxLatency));
+        result.push_back(Pair((*it)->GetType(), obj));
+    }
+    return result;
+}
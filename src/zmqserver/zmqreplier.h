@@ -6,19 +6,67 @@
 #define ZCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstract.h"
+#include "univalue.h"
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
 class CBlockIndex;
 
+//! -apiworkers default, threads executing the requests of each API port
+static const int DEFAULT_API_WORKERS = 4;
+static const int MAX_API_WORKERS = 16;
+
+/** A request received on the API port, with the envelope needed to route the reply back to its client */
+struct CZMQRequest
+{
+    std::vector<std::string> envelope;
+    std::string body;
+    int64_t nTimeReceived;
+};
+
+/** Queue and latency figures of a replier, reported by apiStatus */
+struct CZMQReplierStats
+{
+    size_t nQueued;
+    size_t nRunning;
+    uint64_t nRequests;
+    int64_t nTotalLatency; //!< microseconds from receiving requests until their replies were queued
+    int64_t nMaxLatency;
+
+    CZMQReplierStats() : nQueued(0), nRunning(0), nRequests(0), nTotalLatency(0), nMaxLatency(0) {}
+};
+
+/**
+ * Serves API requests on a ROUTER socket. The socket thread only moves messages: requests are queued for a pool of
+ * workers executing them, and the workers pass the replies back through an inproc PULL socket, so that both sockets
+ * are served by one zmq_poll() and a slow command only holds up its own client.
+ */
 class CZMQAbstractReplier : public CZMQAbstract
-{  
+{
 protected:
     int KEEPALIVE = 1;
-    int rc;
-    zmq_msg_t request;
-    boost::thread* worker;
+    void *presults;
+    std::string resultsAddress;
+    uint32_t nReplySequence;
+    boost::thread_group threads;
+
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<CZMQRequest> queue;
+    CZMQReplierStats stats;
+
+    bool ForwardRequest();
+    bool ForwardReply();
+    std::string Execute(const std::string& requestStr);
 
 public:
+    CZMQAbstractReplier() : presults(0), nReplySequence(0) {}
+
     // Initialization
     bool Initialize();
     void Shutdown();
@@ -26,19 +74,21 @@ public:
     bool Bind();
 
     // Thread handling
-    std::string ReadRequest();
-    bool Wait();
-    bool SendResponse();
+    void Thread();
+    void WorkerThread();
+
+    CZMQReplierStats GetStats();
 
-    virtual void* Thread() = 0;
     virtual bool Auth() = 0;
+    //! Whether the port may execute the commands requiring authentication
+    virtual bool AuthPort() const = 0;
 };
 
 class CZMQAuthReplier : public CZMQAbstractReplier
 {
 public:
     bool Auth();
-    void* Thread();
+    bool AuthPort() const { return true; }
 
 };
 
@@ -46,8 +96,11 @@ class CZMQOpenReplier : public CZMQAbstractReplier
 {
 public:
     bool Auth(){ return true; };
-    void* Thread();
+    bool AuthPort() const { return false; }
 
 };
 
+/** Queue and latency figures of the running repliers, by port type */
+UniValue GetReplierStatus();
+
 #endif // ZCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H